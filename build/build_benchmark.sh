@@ -0,0 +1,6 @@
+#!/bin/sh
+# Builds the Linux microbenchmarks, run from the build directory like build.bat
+
+IGNORED_WARNINGS="-Wno-write-strings -Wno-unused-function -Wno-unused-variable -Wno-unused-but-set-variable -Wno-missing-field-initializers"
+
+g++ -std=c++17 -O2 -msse4.1 -Wall $IGNORED_WARNINGS -I../dependencies ../src/benchmark_main.cpp -o benchmark -lpthread
@@ -0,0 +1,215 @@
+// Serializes imported data into asset payloads, the inverse of LoadMeshAsset and
+// LoadImageAsset. References between joints, animations and keyframes are self relative
+// so the payloads are used as they are by the loader.
+
+struct asset_payload
+{
+    u8* Data;
+    u64 Size;
+};
+
+//Layout: asset_mesh header, vertex arrays (Positions - Normals - Tangents - UVs -
+//Weights - Joints), indices, then if animated the joints, the animations, the
+//joint animations of every animation and all the keyframes, and finally the quantized
+//streams of MESH_QUANTIZED meshes
+internal asset_payload
+BuildMeshAsset(mesh_data* Mesh)
+{
+    b32 HasAnimation = Mesh->Flags & MESH_HAS_ANIMATION;
+    u32 VerticesCount = Mesh->VerticesCount;
+    u32 JointsCount = HasAnimation ? Mesh->JointsCount : 0;
+    u32 AnimationsCount = HasAnimation ? Mesh->AnimationsCount : 0;
+    
+    u64 VertexDataOffset = ALIGN_UP(sizeof(asset_mesh), 16);
+    u64 VertexDataSize = (sizeof(vec3) * 3 + sizeof(vec2)) * VerticesCount;
+    if(HasAnimation)
+    {
+        VertexDataSize += (sizeof(vec4) + sizeof(ivec4)) * VerticesCount;
+    }
+    u64 IndicesOffset = VertexDataOffset + VertexDataSize;
+    u64 JointsOffset = IndicesOffset + sizeof(u32) * Mesh->IndicesCount;
+    u64 AnimationsOffset = JointsOffset + sizeof(mesh_joint) * JointsCount;
+    u64 JointAnimationsOffset = AnimationsOffset + sizeof(mesh_animation) * AnimationsCount;
+    u64 KeyframesOffset = JointAnimationsOffset + sizeof(joint_animation) * JointsCount * AnimationsCount;
+    
+    u64 KeyframesCount = 0;
+    for(u32 AnimationIndex = 0; AnimationIndex < AnimationsCount; AnimationIndex++)
+    {
+        for(u32 JointIndex = 0; JointIndex < JointsCount; JointIndex++)
+        {
+            KeyframesCount += GetAnimationJoints(&Mesh->Animations[AnimationIndex])[JointIndex].KeyframesCount;
+        }
+    }
+    
+    u64 KeyframesEnd = KeyframesOffset + sizeof(animation_keyframe) * KeyframesCount;
+    b32 Quantized = Mesh->Flags & MESH_QUANTIZED;
+    Assert(!(Quantized && (Mesh->Flags & MESH_HAS_ANIMATION)));
+    u64 QuantizedOffset = Quantized ? ALIGN_UP(KeyframesEnd, 16) : 0;
+    
+    asset_payload Result = {};
+    Result.Size = KeyframesEnd;
+    if(Quantized)
+    {
+        Result.Size = QuantizedOffset + (sizeof(quantized_position) + sizeof(quantized_shading_vertex)) * VerticesCount;
+    }
+    Assert(Result.Size <= UINT_MAX);
+    Result.Data = (u8*)ZeroAlloc(Result.Size);
+    
+    asset_mesh* Asset = (asset_mesh*)Result.Data;
+    Asset->Flags = Mesh->Flags & (MESH_HAS_ANIMATION | MESH_INTERLEAVED | MESH_QUANTIZED);
+    Asset->VerticesCount = VerticesCount;
+    Asset->IndicesCount = Mesh->IndicesCount;
+    Asset->TexturesCount = 0;
+    Asset->JointsCount = JointsCount;
+    Asset->AnimationsCount = AnimationsCount;
+    Asset->VertexDataOffset = (u32)VertexDataOffset;
+    Asset->TextureAssetsOffset = 0;
+    Asset->JointsOffset = HasAnimation ? (u32)JointsOffset : 0;
+    Asset->AnimationsOffset = HasAnimation ? (u32)AnimationsOffset : 0;
+    Asset->UVDensity = ComputeMeshUVDensity(Mesh);
+    
+    u8* At = Result.Data + VertexDataOffset;
+    memcpy(At, Mesh->Positions, sizeof(vec3) * VerticesCount); At += sizeof(vec3) * VerticesCount;
+    memcpy(At, Mesh->Normals, sizeof(vec3) * VerticesCount); At += sizeof(vec3) * VerticesCount;
+    memcpy(At, Mesh->Tangents, sizeof(vec3) * VerticesCount); At += sizeof(vec3) * VerticesCount;
+    memcpy(At, Mesh->UVs, sizeof(vec2) * VerticesCount); At += sizeof(vec2) * VerticesCount;
+    if(HasAnimation)
+    {
+        memcpy(At, Mesh->Weights, sizeof(vec4) * VerticesCount); At += sizeof(vec4) * VerticesCount;
+        memcpy(At, Mesh->Joints, sizeof(ivec4) * VerticesCount); At += sizeof(ivec4) * VerticesCount;
+    }
+    memcpy(At, Mesh->Indices, sizeof(u32) * Mesh->IndicesCount);
+    
+    if(Quantized)
+    {
+        quantized_mesh_vertices Streams = {};
+        Streams.Positions = (quantized_position*)(Result.Data + QuantizedOffset);
+        Streams.Shading = (quantized_shading_vertex*)(Streams.Positions + VerticesCount);
+        QuantizeMeshVertices(Mesh, &Streams);
+        
+        Asset->QuantizedOffset = (u32)QuantizedOffset;
+        Asset->PositionMin = Streams.Min;
+        Asset->PositionMax = Streams.Max;
+        Asset->UVMin = Streams.UVMin;
+        Asset->UVMax = Streams.UVMax;
+    }
+    
+    if(!HasAnimation)
+    {
+        return Result;
+    }
+    
+    //Joints are a single array starting at the root, children are offsets into it
+    mesh_joint* Joints = (mesh_joint*)(Result.Data + JointsOffset);
+    for(u32 JointIndex = 0; JointIndex < JointsCount; JointIndex++)
+    {
+        mesh_joint* Joint = &Mesh->RootJoint[JointIndex];
+        mesh_joint* Out = &Joints[JointIndex];
+        Out->NameOffset = 0;
+        Out->Id = Joint->Id;
+        Out->InverseBindMatrix = Joint->InverseBindMatrix;
+        Out->ChildrenCount = Joint->ChildrenCount;
+        if(Joint->ChildrenCount)
+        {
+            u64 ChildIndex = GetJointChildren(Joint) - Mesh->RootJoint;
+            Assert(ChildIndex + Joint->ChildrenCount <= JointsCount);
+            SET_RELATIVE_POINTER(Out->ChildrenOffset, &Joints[ChildIndex]);
+        }
+    }
+    
+    mesh_animation* Animations = (mesh_animation*)(Result.Data + AnimationsOffset);
+    joint_animation* JointAnimations = (joint_animation*)(Result.Data + JointAnimationsOffset);
+    u64 KeyframeOffset = KeyframesOffset;
+    for(u32 AnimationIndex = 0; AnimationIndex < AnimationsCount; AnimationIndex++)
+    {
+        mesh_animation* Animation = &Mesh->Animations[AnimationIndex];
+        joint_animation* AnimationJoints = &JointAnimations[JointsCount * AnimationIndex];
+        Animations[AnimationIndex].Duration = Animation->Duration;
+        SET_RELATIVE_POINTER(Animations[AnimationIndex].JointsOffset, AnimationJoints);
+        
+        for(u32 JointIndex = 0; JointIndex < JointsCount; JointIndex++)
+        {
+            joint_animation* JointAnimation = &GetAnimationJoints(Animation)[JointIndex];
+            joint_animation* Out = &AnimationJoints[JointIndex];
+            u64 Size = sizeof(animation_keyframe) * JointAnimation->KeyframesCount;
+            
+            Out->KeyframesCount = JointAnimation->KeyframesCount;
+            SET_RELATIVE_POINTER(Out->KeyframesOffset, Result.Data + KeyframeOffset);
+            memcpy(Result.Data + KeyframeOffset, GetJointKeyframes(JointAnimation), Size);
+            KeyframeOffset += Size;
+        }
+    }
+    Assert(KeyframeOffset == KeyframesEnd);
+    
+    return Result;
+}
+
+internal asset_payload
+BuildImageAsset(image_data* Image)
+{
+    Assert((u32)Image->Pitch == GetImageLevelPitch(Image->Width, Image->BytesPerPixel, Image->BlockFormat, 0));
+    
+    asset_payload Result = {};
+    u32 NumberOfMips = Image->NumberOfMips ? Image->NumberOfMips : 1;
+    u64 DataSize = GetImageMipChainSize(Image->Width, Image->Height, Image->BytesPerPixel, NumberOfMips, Image->BlockFormat);
+    Result.Size = sizeof(asset_image) + DataSize;
+    Result.Data = (u8*)ZeroAlloc(Result.Size);
+    
+    asset_image* Asset = (asset_image*)Result.Data;
+    Asset->Width = Image->Width;
+    Asset->Height = Image->Height;
+    Asset->BytesPerPixel = Image->BytesPerPixel;
+    Asset->Pitch = Image->Pitch;
+    Asset->NumberOfMips = NumberOfMips;
+    Asset->BlockFormat = Image->BlockFormat;
+    memcpy(Result.Data + sizeof(asset_image), Image->Data, DataSize);
+    
+    return Result;
+}
+
+internal asset_payload
+BuildCubemapAsset(cubemap_data* Cubemap)
+{
+    Assert((u32)Cubemap->Pitch == GetCubemapLevelPitch(Cubemap->Size, Cubemap->Format, 0));
+    
+    asset_payload Result = {};
+    u32 NumberOfMips = Cubemap->NumberOfMips ? Cubemap->NumberOfMips : 1;
+    u64 DataSize = 6 * GetCubemapFaceSize(Cubemap->Size, Cubemap->Format, NumberOfMips);
+    Result.Size = sizeof(asset_cubemap) + DataSize;
+    Result.Data = (u8*)ZeroAlloc(Result.Size);
+    
+    asset_cubemap* Asset = (asset_cubemap*)Result.Data;
+    Asset->Size = Cubemap->Size;
+    Asset->Pitch = Cubemap->Pitch;
+    Asset->BytesPerPixel = CubemapFormatBytesPerPixel[Cubemap->Format];
+    Asset->NumberOfMips = NumberOfMips;
+    Asset->Format = Cubemap->Format;
+    memcpy(Result.Data + sizeof(asset_cubemap), Cubemap->Data, DataSize);
+    
+    return Result;
+}
+
+//Frees everything the importers allocated, joints and animations of imported meshes
+//are single arrays so they are released with their first element
+internal void
+FreeImportedMesh(mesh_data* Mesh)
+{
+    for(u32 Index = 0; Index < ArrayCount(Mesh->VertexData); Index++)
+    {
+        Free(Mesh->VertexData[Index]);
+    }
+    Free(Mesh->Indices);
+    
+    for(u32 AnimationIndex = 0; Mesh->Animations && AnimationIndex < Mesh->AnimationsCount; AnimationIndex++)
+    {
+        joint_animation* JointAnimations = GetAnimationJoints(&Mesh->Animations[AnimationIndex]);
+        for(u32 JointIndex = 0; JointIndex < Mesh->JointsCount; JointIndex++)
+        {
+            Free(GetJointKeyframes(&JointAnimations[JointIndex]));
+        }
+        Free(JointAnimations);
+    }
+    Free(Mesh->Animations);
+    Free(Mesh->RootJoint);
+    *Mesh = {};
+}
@@ -0,0 +1,436 @@
+// Block compression of asset payloads.
+// A compressed payload is split into chunks that are filtered and compressed independently
+// so that a single large entry can be decoded by several threads. The codec is a byte
+// oriented LZ77 with the LZ4 block layout: a token with the literal and match length
+// nibbles, the literals, a 16 bit little endian offset and the extra match length bytes.
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 14
+
+//The last match has to start this many bytes before the end of the chunk and the last
+//bytes are always literals, same rules as LZ4 so the data stays LZ4 compatible
+#define LZ_LAST_LITERALS 5
+#define LZ_MATCH_SAFE_DISTANCE 12
+
+internal u64
+LZCompressBound(u64 Size)
+{
+    return Size + Size / 255 + 16;
+}
+
+internal u32
+LZRead32(u8* At)
+{
+    u32 Result;
+    memcpy(&Result, At, sizeof(u32));
+    return Result;
+}
+
+internal u8*
+LZWriteLength(u8* Out, u64 Length)
+{
+    while(Length >= 255)
+    {
+        *Out++ = 255;
+        Length -= 255;
+    }
+    *Out++ = (u8)Length;
+    return Out;
+}
+
+//Returns the compressed size, 0 if the output doesn't fit in DstCapacity
+internal u64
+LZCompress(u8* Src, u64 SrcSize, u8* Dst, u64 DstCapacity)
+{
+    Assert(SrcSize < 0xFFFFFFFF);
+    
+    u32* HashTable = (u32*)ZeroAlloc(sizeof(u32) << LZ_HASH_BITS);
+    u8* Out = Dst;
+    u8* OutEnd = Dst + DstCapacity;
+    
+    u8* At = Src;
+    u8* End = Src + SrcSize;
+    u8* Anchor = Src;
+    u8* MatchLimit = SrcSize > LZ_MATCH_SAFE_DISTANCE ? End - LZ_MATCH_SAFE_DISTANCE : Src;
+    
+    while(At < MatchLimit)
+    {
+        u32 Sequence = LZRead32(At);
+        u32 Hash = (Sequence * 2654435761U) >> (32 - LZ_HASH_BITS);
+        u8* Candidate = Src + HashTable[Hash];
+        HashTable[Hash] = (u32)(At - Src);
+        
+        if(Candidate >= At || At - Candidate > LZ_MAX_OFFSET || LZRead32(Candidate) != Sequence)
+        {
+            At++;
+            continue;
+        }
+        
+        //Extend the match forward, the last literals must stay literals
+        u8* MatchEnd = At + LZ_MIN_MATCH;
+        u8* Candidate2 = Candidate + LZ_MIN_MATCH;
+        while(MatchEnd < End - LZ_LAST_LITERALS && *MatchEnd == *Candidate2)
+        {
+            MatchEnd++;
+            Candidate2++;
+        }
+        
+        //And backwards over the pending literals
+        while(At > Anchor && Candidate > Src && At[-1] == Candidate[-1])
+        {
+            At--;
+            Candidate--;
+        }
+        
+        u64 LiteralLength = At - Anchor;
+        u64 MatchLength = MatchEnd - At - LZ_MIN_MATCH;
+        if(Out + 1 + LiteralLength / 255 + 1 + LiteralLength + 2 + MatchLength / 255 + 1 > OutEnd)
+        {
+            Free(HashTable);
+            return 0;
+        }
+        
+        u8* Token = Out++;
+        *Token = (u8)((LiteralLength >= 15 ? 15 : LiteralLength) << 4);
+        if(LiteralLength >= 15) Out = LZWriteLength(Out, LiteralLength - 15);
+        memcpy(Out, Anchor, LiteralLength);
+        Out += LiteralLength;
+        
+        u16 Offset = (u16)(At - Candidate);
+        *Out++ = (u8)(Offset & 0xFF);
+        *Out++ = (u8)(Offset >> 8);
+        
+        *Token |= (u8)(MatchLength >= 15 ? 15 : MatchLength);
+        if(MatchLength >= 15) Out = LZWriteLength(Out, MatchLength - 15);
+        
+        At = MatchEnd;
+        Anchor = At;
+    }
+    
+    //Remaining literals
+    u64 LiteralLength = End - Anchor;
+    if(Out + 1 + LiteralLength + LiteralLength / 255 + 1 > OutEnd)
+    {
+        Free(HashTable);
+        return 0;
+    }
+    
+    u8* Token = Out++;
+    *Token = (u8)((LiteralLength >= 15 ? 15 : LiteralLength) << 4);
+    if(LiteralLength >= 15) Out = LZWriteLength(Out, LiteralLength - 15);
+    memcpy(Out, Anchor, LiteralLength);
+    Out += LiteralLength;
+    
+    Free(HashTable);
+    return Out - Dst;
+}
+
+//Every read and write is bounds checked, corrupted data makes this fail instead of crashing
+internal b32
+LZDecompress(u8* Src, u64 SrcSize, u8* Dst, u64 DstSize)
+{
+    u8* In = Src;
+    u8* InEnd = Src + SrcSize;
+    u8* Out = Dst;
+    u8* OutEnd = Dst + DstSize;
+    
+    while(In < InEnd)
+    {
+        u8 Token = *In++;
+        
+        u64 LiteralLength = Token >> 4;
+        if(LiteralLength == 15)
+        {
+            u8 Byte;
+            do
+            {
+                if(In >= InEnd) return false;
+                Byte = *In++;
+                LiteralLength += Byte;
+            } while(Byte == 255);
+        }
+        
+        if((u64)(InEnd - In) < LiteralLength || (u64)(OutEnd - Out) < LiteralLength) return false;
+        memcpy(Out, In, LiteralLength);
+        In += LiteralLength;
+        Out += LiteralLength;
+        
+        //The last sequence has no match
+        if(In == InEnd) break;
+        
+        if(InEnd - In < 2) return false;
+        u64 Offset = In[0] | (In[1] << 8);
+        In += 2;
+        if(Offset == 0 || Offset > (u64)(Out - Dst)) return false;
+        
+        u64 MatchLength = Token & 0xF;
+        if(MatchLength == 15)
+        {
+            u8 Byte;
+            do
+            {
+                if(In >= InEnd) return false;
+                Byte = *In++;
+                MatchLength += Byte;
+            } while(Byte == 255);
+        }
+        MatchLength += LZ_MIN_MATCH;
+        
+        if((u64)(OutEnd - Out) < MatchLength) return false;
+        u8* Match = Out - Offset;
+        if(Offset >= MatchLength)
+        {
+            memcpy(Out, Match, MatchLength);
+            Out += MatchLength;
+        }
+        else
+        {
+            //Overlapping copy, repeats the last Offset bytes
+            for(u64 Index = 0; Index < MatchLength; Index++)
+            {
+                *Out++ = *Match++;
+            }
+        }
+    }
+    
+    return Out == OutEnd;
+}
+
+//Byte shuffle filter: groups byte 0 of every element, then byte 1, etc. Floats in a
+//stream have similar exponents and signs so this turns them into long runs for the LZ.
+//Trailing bytes that don't form a whole element are copied as they are
+internal void
+ShuffleBytes(u8* Src, u8* Dst, u64 Size, u32 Stride)
+{
+    u64 Count = Size / Stride;
+    for(u32 Byte = 0; Byte < Stride; Byte++)
+    {
+        u8* In = Src + Byte;
+        u8* Out = Dst + Byte * Count;
+        for(u64 Index = 0; Index < Count; Index++)
+        {
+            Out[Index] = In[Index * Stride];
+        }
+    }
+    memcpy(Dst + Count * Stride, Src + Count * Stride, Size - Count * Stride);
+}
+
+internal void
+UnshuffleBytes(u8* Src, u8* Dst, u64 Size, u32 Stride)
+{
+    u64 Count = Size / Stride;
+    if(Stride == 4)
+    {
+        //Most common case for float streams, transpose 16 elements at a time
+        u64 Index = 0;
+        for(; Index + 16 <= Count; Index += 16)
+        {
+            __m128i B0 = _mm_loadu_si128((__m128i*)(Src + Index));
+            __m128i B1 = _mm_loadu_si128((__m128i*)(Src + Count + Index));
+            __m128i B2 = _mm_loadu_si128((__m128i*)(Src + Count * 2 + Index));
+            __m128i B3 = _mm_loadu_si128((__m128i*)(Src + Count * 3 + Index));
+            
+            __m128i B01Lo = _mm_unpacklo_epi8(B0, B1);
+            __m128i B01Hi = _mm_unpackhi_epi8(B0, B1);
+            __m128i B23Lo = _mm_unpacklo_epi8(B2, B3);
+            __m128i B23Hi = _mm_unpackhi_epi8(B2, B3);
+            
+            u8* Out = Dst + Index * 4;
+            _mm_storeu_si128((__m128i*)(Out +  0), _mm_unpacklo_epi16(B01Lo, B23Lo));
+            _mm_storeu_si128((__m128i*)(Out + 16), _mm_unpackhi_epi16(B01Lo, B23Lo));
+            _mm_storeu_si128((__m128i*)(Out + 32), _mm_unpacklo_epi16(B01Hi, B23Hi));
+            _mm_storeu_si128((__m128i*)(Out + 48), _mm_unpackhi_epi16(B01Hi, B23Hi));
+        }
+        
+        for(; Index < Count; Index++)
+        {
+            Dst[Index * 4 + 0] = Src[Index];
+            Dst[Index * 4 + 1] = Src[Count + Index];
+            Dst[Index * 4 + 2] = Src[Count * 2 + Index];
+            Dst[Index * 4 + 3] = Src[Count * 3 + Index];
+        }
+    }
+    else
+    {
+        for(u32 Byte = 0; Byte < Stride; Byte++)
+        {
+            u8* In = Src + Byte * Count;
+            u8* Out = Dst + Byte;
+            for(u64 Index = 0; Index < Count; Index++)
+            {
+                Out[Index * Stride] = In[Index];
+            }
+        }
+    }
+    memcpy(Dst + Count * Stride, Src + Count * Stride, Size - Count * Stride);
+}
+
+internal u64
+GetCompressedChunksCount(u64 Size, u32 ChunkSize)
+{
+    return Size ? (Size + ChunkSize - 1) / ChunkSize : 0;
+}
+
+//Chunks that don't shrink are stored raw, a chunk is raw when its stored size equals
+//its decompressed size. Returns a ZeroAlloc'd payload ready to be written
+internal void*
+CompressAssetPayload(void* Data, u64 Size, asset_codec Codec, u32 FilterStride, u64* OutStoredSize,
+                     u32 ChunkSize = ASSET_DEFAULT_CHUNK_SIZE)
+{
+    Assert(Codec == ASSET_CODEC_LZ);
+    if(FilterStride > 1)
+    {
+        //Keep the shuffle filter aligned with the elements in every chunk
+        ChunkSize -= ChunkSize % FilterStride;
+    }
+    
+    u64 ChunksCount = GetCompressedChunksCount(Size, ChunkSize);
+    u64 HeaderSize = sizeof(asset_compressed_header) + sizeof(u64) * (ChunksCount + 1);
+    u64 Capacity = HeaderSize + ChunksCount * LZCompressBound(ChunkSize);
+    u8* Result = (u8*)ZeroAlloc(Capacity);
+    u8* Filtered = (u8*)ZeroAlloc(ChunkSize);
+    
+    asset_compressed_header* Header = (asset_compressed_header*)Result;
+    Header->ChunkSize = ChunkSize;
+    Header->FilterStride = FilterStride;
+    Header->ChunksCount = ChunksCount;
+    u64* ChunkOffsets = (u64*)(Header + 1);
+    
+    u64 At = HeaderSize;
+    for(u64 ChunkIndex = 0; ChunkIndex < ChunksCount; ChunkIndex++)
+    {
+        u64 Begin = ChunkIndex * ChunkSize;
+        u64 Length = MIN(Size - Begin, ChunkSize);
+        u8* Chunk = (u8*)Data + Begin;
+        if(FilterStride > 1)
+        {
+            ShuffleBytes(Chunk, Filtered, Length, FilterStride);
+            Chunk = Filtered;
+        }
+        
+        ChunkOffsets[ChunkIndex] = At;
+        u64 Compressed = LZCompress(Chunk, Length, Result + At, Length - 1);
+        if(Compressed)
+        {
+            At += Compressed;
+        }
+        else
+        {
+            //Raw chunks are stored unfiltered so they can be copied straight out
+            memcpy(Result + At, (u8*)Data + Begin, Length);
+            At += Length;
+        }
+    }
+    ChunkOffsets[ChunksCount] = At;
+    
+    Free(Filtered);
+    *OutStoredSize = At;
+    return Result;
+}
+
+struct decompress_chunk_work
+{
+    u8* Src;
+    u64 SrcSize;
+    u8* Dst;
+    u64 DstSize;
+    u32 FilterStride;
+    b32 Failed;
+    
+    volatile u32* PendingCount;
+};
+
+internal void
+DecompressChunk(decompress_chunk_work* Work)
+{
+    if(Work->SrcSize == Work->DstSize)
+    {
+        memcpy(Work->Dst, Work->Src, Work->DstSize);
+    }
+    else if(Work->FilterStride > 1)
+    {
+        u8* Filtered = (u8*)ZeroAlloc(Work->DstSize);
+        Work->Failed = !LZDecompress(Work->Src, Work->SrcSize, Filtered, Work->DstSize);
+        UnshuffleBytes(Filtered, Work->Dst, Work->DstSize, Work->FilterStride);
+        Free(Filtered);
+    }
+    else
+    {
+        Work->Failed = !LZDecompress(Work->Src, Work->SrcSize, Work->Dst, Work->DstSize);
+    }
+}
+
+internal void
+DecompressChunkWork(void* Param)
+{
+    decompress_chunk_work* Work = (decompress_chunk_work*)Param;
+    DecompressChunk(Work);
+    Platform_AtomicAdd(Work->PendingCount, (u32)-1);
+}
+
+//Decodes a payload written by CompressAssetPayload into Dst. With a queue the chunks are
+//spread over the workers and the calling thread helps until all of them are done
+internal b32
+DecompressAssetPayload(void* Stored, u64 StoredSize, void* Dst, u64 Size, work_queue* Queue)
+{
+    if(StoredSize < sizeof(asset_compressed_header)) return false;
+    
+    //A corrupted header fails the load, the chunk count is checked against both sizes
+    //before the offsets are touched
+    asset_compressed_header* Header = (asset_compressed_header*)Stored;
+    u64 ChunksCount = Header->ChunksCount;
+    if(!Header->ChunkSize || ChunksCount != GetCompressedChunksCount(Size, Header->ChunkSize) ||
+       ChunksCount >= (StoredSize - sizeof(asset_compressed_header)) / sizeof(u64)) return false;
+    u64 HeaderSize = sizeof(asset_compressed_header) + sizeof(u64) * (ChunksCount + 1);
+    
+    u64* ChunkOffsets = (u64*)(Header + 1);
+    decompress_chunk_work* Works = (decompress_chunk_work*)ZeroAlloc(sizeof(decompress_chunk_work) * ChunksCount);
+    volatile u32 PendingCount = (u32)ChunksCount;
+    
+    for(u64 ChunkIndex = 0; ChunkIndex < ChunksCount; ChunkIndex++)
+    {
+        u64 Begin = ChunkOffsets[ChunkIndex];
+        u64 End = ChunkOffsets[ChunkIndex + 1];
+        if(Begin < HeaderSize || End < Begin || End > StoredSize)
+        {
+            Free(Works);
+            return false;
+        }
+        
+        decompress_chunk_work* Work = &Works[ChunkIndex];
+        Work->Src = (u8*)Stored + Begin;
+        Work->SrcSize = End - Begin;
+        Work->Dst = (u8*)Dst + ChunkIndex * Header->ChunkSize;
+        Work->DstSize = MIN(Size - ChunkIndex * Header->ChunkSize, Header->ChunkSize);
+        Work->FilterStride = Header->FilterStride;
+        Work->PendingCount = &PendingCount;
+    }
+    
+    for(u64 ChunkIndex = 0; ChunkIndex < ChunksCount; ChunkIndex++)
+    {
+        //Keep the last chunk for ourselves, no point in queueing work we are going to wait for
+        if(Queue && ChunkIndex + 1 < ChunksCount)
+        {
+            AddWorkQueueEntry(Queue, DecompressChunkWork, &Works[ChunkIndex]);
+        }
+        else
+        {
+            DecompressChunkWork(&Works[ChunkIndex]);
+        }
+    }
+    
+    if(Queue)
+    {
+        WaitForWorkCounter(Queue, &PendingCount);
+    }
+    
+    b32 Success = true;
+    for(u64 ChunkIndex = 0; ChunkIndex < ChunksCount; ChunkIndex++)
+    {
+        Success &= !Works[ChunkIndex].Failed;
+    }
+    
+    Free(Works);
+    return Success;
+}
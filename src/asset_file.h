@@ -4,12 +4,32 @@
 #define ASSET_NAME_LENGTH 80
 #define ASSET_TAG_LENGTH 28
 
+//Version 2 adds a precomputed hash to each table entry and a hash index after the table
+#define ASSET_FILE_VERSION_HASHED_INDEX 2
+//Version 3 adds the codec fields to the table entry, see asset_compressed_header
+#define ASSET_FILE_VERSION_COMPRESSION 3
+//Version 4 adds the mip chain to images, see asset_image
+#define ASSET_FILE_VERSION_IMAGE_MIPS 4
+//Version 5 adds block compressed formats to images
+#define ASSET_FILE_VERSION_IMAGE_BLOCKS 5
+//Version 6 stores the references between joints, animations and keyframes of meshes as
+//self relative offsets (see RELATIVE_POINTER) instead of offsets from the payload start
+#define ASSET_FILE_VERSION_RELATIVE_MESH 6
+//Version 7 adds the UV density to meshes, see asset_mesh
+#define ASSET_FILE_VERSION_MESH_UV_DENSITY 7
+//Version 8 adds the format to cubemaps, see asset_cubemap
+#define ASSET_FILE_VERSION_CUBEMAP_FORMAT 8
+//Version 9 adds the quantized vertex streams of MESH_QUANTIZED meshes, see asset_mesh
+#define ASSET_FILE_VERSION_QUANTIZED_MESH 9
+#define ASSET_FILE_VERSION 9
+
 struct asset_file_header
 {
     u32 Magic;
     u32 Version;
     u64 TableEntryCount; //Size of table is TableEntryCount * sizeof(asset_table_entry)
     //Table begins right after header
+    //From version 2 an asset_index_header and the index slots begin right after the table
 };
 
 enum asset_type
@@ -30,22 +50,89 @@ char* AssetTypeToName[] =
     "ASSET_CUBEMAP",
 };
 
-struct asset_table_entry
+struct asset_table_entry_v1
+{
+    char Name[ASSET_NAME_LENGTH];
+    char Tag[ASSET_TAG_LENGTH];
+    asset_type Type;
+    u64 Offset;
+    u64 Size;
+};
+
+struct asset_table_entry_v2
 {
     char Name[ASSET_NAME_LENGTH];
     char Tag[ASSET_TAG_LENGTH];
     asset_type Type;
     u64 Offset;
     u64 Size;
+    u64 Hash;
+};
+
+//Hints for the runtime, files that predate a flag just have it cleared
+enum asset_entry_flag
+{
+    ASSET_ENTRY_PREFETCH = 0x1, //Read during startup, see PrefetchAssetArchive
+};
+
+enum asset_codec
+{
+    ASSET_CODEC_NONE,
+    ASSET_CODEC_LZ, //LZ4 style block compression, see asset_compression.cpp
+};
+
+struct asset_table_entry
+{
+    char Name[ASSET_NAME_LENGTH];
+    char Tag[ASSET_TAG_LENGTH];
+    asset_type Type;
+    u64 Offset;
+    u64 Size; //Size of the payload once decompressed, this is what the loaders see
+    u64 Hash; //AssetHash(Name, Tag)
+    
+    u32 Codec; //asset_codec, with ASSET_CODEC_NONE the payload is stored as it is
+    u32 Flags; //asset_entry_flag, was always 0 before they were added
+    u64 StoredSize; //Bytes at Offset in the file, equal to Size if not compressed
+};
+
+struct asset_index_header
+{
+    u64 SlotsCount; //Always a power of two
+    //Slots begin right after
+};
+
+//Open addressing hash table with linear probing, the first slot
+//to probe is (Hash & (SlotsCount - 1))
+struct asset_index_slot
+{
+    u32 HashHigh;   //Upper 32 bits of the entry hash, to skip most entry compares
+    u32 EntryIndex; //Index in the table + 1, 0 if the slot is empty
 };
 
 struct asset_table
 {
     asset_table_entry* Entries;
     u64 Count;
+    u32 Version; //Of the file, payload layouts of older versions are still supported
+    
+    asset_index_slot* Slots;
+    u64 SlotsCount;
 };
 
-struct asset_image
+#define ASSET_DEFAULT_CHUNK_SIZE (256 * 1024)
+
+//Compressed payloads start with this header followed by ChunksCount + 1 offsets,
+//relative to the start of the payload, of the compressed chunks and of their end.
+//Every chunk decompresses to ChunkSize bytes except the last one, chunks whose
+//stored size is the same as their decompressed size are stored raw
+struct asset_compressed_header
+{
+    u32 ChunkSize;
+    u32 FilterStride; //If > 1 the bytes of each chunk are shuffled with this element size
+    u64 ChunksCount;
+};
+
+struct asset_image_v1
 {
     u32 Width;
     u32 Height;
@@ -54,6 +141,27 @@ struct asset_image
     //Data begins right after
 };
 
+struct asset_image_v4
+{
+    u32 Width;
+    u32 Height;
+    u32 BytesPerPixel;
+    u32 Pitch;
+    u32 NumberOfMips;
+};
+
+struct asset_image
+{
+    u32 Width;
+    u32 Height;
+    u32 BytesPerPixel;
+    u32 Pitch; //Bytes in a row of blocks if compressed
+    u32 NumberOfMips; //0 is the same as 1, basically just the image
+    u32 BlockFormat; //image_block_format
+    //Data begins right after with the first level of Height * Pitch bytes (or rows of
+    //blocks * Pitch), then every mip tightly packed at half the size of the previous one
+};
+
 struct asset_mesh
 {
     u32 Flags;
@@ -65,7 +173,8 @@ struct asset_mesh
     
     //Vertices are stored as contiguos arrays in this order
     //Positions - Normals - Tangents - UVs - Weights - Joints - Indices
-    //weights and joints are there only if the MESH_HAS_ANIMATION flag is set
+    //weights and joints are there only if the MESH_HAS_ANIMATION flag is set. The arrays
+    //are the same with MESH_INTERLEAVED, it only changes the layout of the vertex buffers
     u32 VertexDataOffset;
     
     //Textures are stored as an array TexturesCount names of ASSET_NAME_LENGTH chars
@@ -73,19 +182,99 @@ struct asset_mesh
     u32 TextureAssetsOffset;
     
     //Those are 0s if the MESH_HAS_ANIMATION flag is NOT set
+    //JointsCount mesh_joint starting at the root, then AnimationsCount mesh_animation,
+    //their joint_animation arrays and the keyframes
     u32 JointsOffset;
     u32 AnimationsOffset;
+    
+    //From version 7, see ComputeMeshUVDensity
+    f32 UVDensity;
+    
+    //From version 9, 0 unless MESH_QUANTIZED. VerticesCount quantized_position then as
+    //many quantized_shading_vertex, after the keyframes. See quantized_mesh_vertices
+    u32 QuantizedOffset;
+    vec3 PositionMin;
+    vec3 PositionMax;
+    vec2 UVMin;
+    vec2 UVMax;
+};
+
+struct asset_cubemap_v1
+{
+    s32 Size;
+    s32 Pitch;
+    s32 BytesPerPixel; //16 for RGBA32F, 8 for RGBA16F
+    u32 NumberOfMips;
 };
 
 struct asset_cubemap
 {
     s32 Size; //Width and height of a face
-    s32 Pitch; //Size * BytesPerPixel
-    s32 BytesPerPixel;
+    s32 Pitch; //Size * BytesPerPixel, or bytes in a row of blocks if compressed
+    s32 BytesPerPixel; //0 if compressed
     u32 NumberOfMips; //0 is the same as 1, basically just the image
-    //Data starts here with 6 faces of Size dimension,
-    //If has 1st level mips then 6 face of Size / 2 dimension, etc..
+    u32 Format; //cubemap_format
+    //Data starts here with the first face of Size dimension followed by its mips
+    //tightly packed, then the other 5 faces the same way
 };
 
 
 #pragma pack(pop)
+
+//64 bit FNV-1a of the name, a 0xFF separator and the tag, this is what the
+//packer stores in asset_table_entry::Hash
+#define ASSET_HASH_OFFSET_BASIS 0xCBF29CE484222325ULL
+#define ASSET_HASH_PRIME 0x100000001B3ULL
+
+constexpr u64
+AssetHashString(u64 Hash, const char* String, u32 MaxLength)
+{
+    for(u32 Index = 0; Index < MaxLength && String[Index]; Index++)
+    {
+        Hash = (Hash ^ (u8)String[Index]) * ASSET_HASH_PRIME;
+    }
+    return Hash;
+}
+
+constexpr u64
+AssetHash(const char* Name, const char* Tag = "")
+{
+    u64 Hash = AssetHashString(ASSET_HASH_OFFSET_BASIS, Name, ASSET_NAME_LENGTH);
+    Hash = (Hash ^ 0xFF) * ASSET_HASH_PRIME;
+    Hash = AssetHashString(Hash, Tag, ASSET_TAG_LENGTH);
+    return Hash;
+}
+
+//FNV-1a style, eight bytes at a time. Used for cache keys and to find identical payloads,
+//where it's fast enough to not matter next to the IO
+internal u64
+HashBytes(u64 Hash, void* Data, u64 Size)
+{
+    u8* At = (u8*)Data;
+    for(; Size >= 8; Size -= 8, At += 8)
+    {
+        u64 Word;
+        memcpy(&Word, At, 8);
+        Hash = (Hash ^ Word) * ASSET_HASH_PRIME;
+        Hash ^= Hash >> 32;
+    }
+    for(; Size; Size--, At++)
+    {
+        Hash = (Hash ^ *At) * ASSET_HASH_PRIME;
+    }
+    return Hash;
+}
+
+struct asset_id
+{
+    u64 Hash;
+};
+
+template<u64 Hash>
+struct asset_id_constant
+{
+    static constexpr asset_id Value = { Hash };
+};
+
+//Hashed at compile time, use like FindAsset(ASSET_ID("helmet"), ...) or ASSET_ID("harbor", "skybox")
+#define ASSET_ID(...) (asset_id_constant<AssetHash(__VA_ARGS__)>::Value)
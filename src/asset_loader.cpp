@@ -1,44 +1,819 @@
+#include "asset_loader.h"
+
+internal u64
+GetAssetIndexSlotsCount(u64 EntriesCount)
+{
+    //Keep the load factor under 0.5 so that probe sequences stay short
+    u64 Result = 16;
+    while(Result < EntriesCount * 2)
+    {
+        Result *= 2;
+    }
+    return Result;
+}
+
+internal void
+BuildAssetIndex(asset_table_entry* Entries, u64 Count, asset_index_slot* Slots, u64 SlotsCount)
+{
+    Assert(IS_POW2(SlotsCount) && Count < SlotsCount);
+    memset(Slots, 0, sizeof(asset_index_slot) * SlotsCount);
+    
+    u64 Mask = SlotsCount - 1;
+    for(u64 Index = 0; Index < Count; Index++)
+    {
+        u64 Hash = Entries[Index].Hash;
+        u64 Slot = Hash & Mask;
+        while(Slots[Slot].EntryIndex)
+        {
+            Slot = (Slot + 1) & Mask;
+        }
+        
+        Slots[Slot].HashHigh = (u32)(Hash >> 32);
+        Slots[Slot].EntryIndex = (u32)(Index + 1);
+    }
+}
+
+//Returns the first entry that was inserted with this hash, entries with the same name and tag
+//later in the table are shadowed like they were with the old linear search
+internal asset_table_entry*
+FindAssetByHash(u64 Hash, asset_table Table)
+{
+    if(!Table.SlotsCount) return 0;
+    
+    u64 Mask = Table.SlotsCount - 1;
+    u32 HashHigh = (u32)(Hash >> 32);
+    for(u64 Slot = Hash & Mask;; Slot = (Slot + 1) & Mask)
+    {
+        asset_index_slot* IndexSlot = &Table.Slots[Slot];
+        if(!IndexSlot->EntryIndex)
+        {
+            return 0;
+        }
+        
+        if(IndexSlot->HashHigh == HashHigh)
+        {
+            asset_table_entry* Entry = &Table.Entries[IndexSlot->EntryIndex - 1];
+            if(Entry->Hash == Hash)
+            {
+                return Entry;
+            }
+        }
+    }
+}
+
+internal asset_table_entry*
+FindAsset(asset_id Id, asset_table Table, asset_type Type)
+{
+    asset_table_entry* Entry = FindAssetByHash(Id.Hash, Table);
+    if(Entry && Entry->Type != Type)
+    {
+        return 0;
+    }
+    
+    return Entry;
+}
+
+internal b32
+IsAssetNamed(asset_table_entry* Entry, char* Name, char* Tag)
+{
+    return strncmp(Name, Entry->Name, ASSET_NAME_LENGTH) == 0 &&
+           strncmp(Tag, Entry->Tag, ASSET_TAG_LENGTH) == 0;
+}
+
+//The hash is only 64 bits, entries that collide with the name are skipped by comparing
+//the names until an empty slot ends the probe sequence
 internal asset_table_entry*
 FindAsset(char* Name, asset_table Table, asset_type Type, char* Tag = "")
 {
-    for(u32 Index = 0; Index < Table.Count; Index++)
+    if(!Table.SlotsCount) return 0;
+    
+    u64 Hash = AssetHash(Name, Tag);
+    u64 Mask = Table.SlotsCount - 1;
+    u32 HashHigh = (u32)(Hash >> 32);
+    for(u64 Slot = Hash & Mask;; Slot = (Slot + 1) & Mask)
+    {
+        asset_index_slot* IndexSlot = &Table.Slots[Slot];
+        if(!IndexSlot->EntryIndex)
+        {
+            return 0;
+        }
+        
+        if(IndexSlot->HashHigh == HashHigh)
+        {
+            asset_table_entry* Entry = &Table.Entries[IndexSlot->EntryIndex - 1];
+            if(Entry->Hash == Hash && IsAssetNamed(Entry, Name, Tag))
+            {
+                return Entry->Type == Type ? Entry : 0;
+            }
+        }
+    }
+}
+
+//The index is sized for every entry of every mount, shadowed ones are just skipped
+internal void
+BuildAssetLibraryIndex(asset_library* Library)
+{
+    u64 EntriesCount = 0;
+    for(u32 Mount = 0; Mount < Library->MountsCount; Mount++)
+    {
+        EntriesCount += Library->Mounts[Mount]->Table.Count;
+    }
+    
+    Free(Library->Slots);
+    Library->SlotsCount = GetAssetIndexSlotsCount(EntriesCount);
+    Library->Slots = (asset_library_slot*)ZeroAlloc(sizeof(asset_library_slot) * Library->SlotsCount);
+    
+    //Newest mount first, so the first entry inserted with a hash is the one that wins
+    //like in the index of a single archive
+    u64 Mask = Library->SlotsCount - 1;
+    for(u32 Mount = Library->MountsCount; Mount-- > 0;)
+    {
+        asset_table* Table = &Library->Mounts[Mount]->Table;
+        for(u64 Index = 0; Index < Table->Count; Index++)
+        {
+            asset_table_entry* Entry = &Table->Entries[Index];
+            u64 Hash = Entry->Hash;
+            u64 Slot = Hash & Mask;
+            b32 Shadowed = false;
+            while(Library->Slots[Slot].EntryIndex && !Shadowed)
+            {
+                asset_library_slot* Other = &Library->Slots[Slot];
+                asset_table_entry* OtherEntry = &Library->Mounts[Other->Mount]->Table.Entries[Other->EntryIndex - 1];
+                Shadowed = OtherEntry->Hash == Hash && IsAssetNamed(OtherEntry, Entry->Name, Entry->Tag);
+                Slot = (Slot + 1) & Mask;
+            }
+            if(Shadowed) continue;
+            
+            Library->Slots[Slot].HashHigh = (u32)(Hash >> 32);
+            Library->Slots[Slot].Mount = Mount;
+            Library->Slots[Slot].EntryIndex = (u32)(Index + 1);
+        }
+    }
+}
+
+//The archive has to stay open as long as the library is used
+internal void
+MountAssetArchive(asset_library* Library, asset_archive* Archive)
+{
+    Assert(Library->MountsCount < ASSET_MAX_MOUNTS);
+    Library->Mounts[Library->MountsCount++] = Archive;
+    BuildAssetLibraryIndex(Library);
+}
+
+internal asset_table_entry*
+FindAssetByHash(u64 Hash, asset_library* Library)
+{
+    if(!Library->SlotsCount) return 0;
+    
+    u64 Mask = Library->SlotsCount - 1;
+    u32 HashHigh = (u32)(Hash >> 32);
+    for(u64 Slot = Hash & Mask;; Slot = (Slot + 1) & Mask)
+    {
+        asset_library_slot* LibrarySlot = &Library->Slots[Slot];
+        if(!LibrarySlot->EntryIndex)
+        {
+            return 0;
+        }
+        
+        if(LibrarySlot->HashHigh == HashHigh)
+        {
+            asset_table_entry* Entry = &Library->Mounts[LibrarySlot->Mount]->Table.Entries[LibrarySlot->EntryIndex - 1];
+            if(Entry->Hash == Hash)
+            {
+                return Entry;
+            }
+        }
+    }
+}
+
+internal asset_table_entry*
+FindAsset(asset_id Id, asset_library* Library, asset_type Type)
+{
+    asset_table_entry* Entry = FindAssetByHash(Id.Hash, Library);
+    if(Entry && Entry->Type != Type)
     {
-        if(strncmp(Name, Table.Entries[Index].Name, ASSET_NAME_LENGTH) == 0 &&
-           strncmp(Tag, Table.Entries[Index].Tag, ASSET_TAG_LENGTH) == 0)
+        return 0;
+    }
+    
+    return Entry;
+}
+
+internal asset_table_entry*
+FindAsset(char* Name, asset_library* Library, asset_type Type, char* Tag = "")
+{
+    if(!Library->SlotsCount) return 0;
+    
+    u64 Hash = AssetHash(Name, Tag);
+    u64 Mask = Library->SlotsCount - 1;
+    u32 HashHigh = (u32)(Hash >> 32);
+    for(u64 Slot = Hash & Mask;; Slot = (Slot + 1) & Mask)
+    {
+        asset_library_slot* LibrarySlot = &Library->Slots[Slot];
+        if(!LibrarySlot->EntryIndex)
+        {
+            return 0;
+        }
+        
+        if(LibrarySlot->HashHigh == HashHigh)
         {
-            if(Type != Table.Entries[Index].Type)
+            asset_table_entry* Entry = &Library->Mounts[LibrarySlot->Mount]->Table.Entries[LibrarySlot->EntryIndex - 1];
+            if(Entry->Hash == Hash && IsAssetNamed(Entry, Name, Tag))
             {
-                return 0;
+                return Entry->Type == Type ? Entry : 0;
             }
-            return &Table.Entries[Index];
+        }
+    }
+}
+
+//Archive that owns an entry returned by the lookups above, to read it
+internal asset_archive*
+GetAssetArchive(asset_library* Library, asset_table_entry* Entry)
+{
+    for(u32 Mount = 0; Mount < Library->MountsCount; Mount++)
+    {
+        asset_table* Table = &Library->Mounts[Mount]->Table;
+        if(Entry >= Table->Entries && Entry < Table->Entries + Table->Count)
+        {
+            return Library->Mounts[Mount];
         }
     }
     
     return 0;
 }
 
-//Patches the children addresses by adding DataBegin to each Children pointer
+//Reads the table and the index of an asset file. Tables older than version 3 are
+//converted to the current entry layout and get a fresh index, version 1 files
+//don't have hashes on disk so we compute them here.
+//If the file is mapped current tables are used in place
+internal asset_table
+ReadAssetTable(platform_file File, platform_file_mapping* Mapping)
+{
+    asset_table Result = {};
+    
+    asset_file_header Header = {};
+    if(!Platform_ReadAtOffset(File, &Header, sizeof(asset_file_header), 0) ||
+       Header.Magic != ASSET_FILE_MAGIC || Header.Version > ASSET_FILE_VERSION)
+    {
+        return Result;
+    }
+    
+    //Truncated or corrupted files fail the open instead of reading past the end
+    u64 Count = Header.TableEntryCount;
+    u64 TableOffset = sizeof(asset_file_header);
+    u64 FileSize = Mapping->Data ? Mapping->Size : Platform_GetFileSize(File);
+    Result.Version = Header.Version;
+    
+    if(Header.Version >= ASSET_FILE_VERSION_COMPRESSION)
+    {
+        u64 TableSize = sizeof(asset_table_entry) * Count;
+        if(Count > FileSize / sizeof(asset_table_entry) ||
+           TableOffset + TableSize + sizeof(asset_index_header) > FileSize)
+        {
+            return Result;
+        }
+        
+        asset_index_header IndexHeader = {};
+        if(!Platform_ReadAtOffset(File, &IndexHeader, sizeof(asset_index_header), TableOffset + TableSize) ||
+           !IS_POW2(IndexHeader.SlotsCount) || Count >= IndexHeader.SlotsCount ||
+           IndexHeader.SlotsCount > FileSize / sizeof(asset_index_slot))
+        {
+            return Result;
+        }
+        
+        u64 IndexSize = sizeof(asset_index_slot) * IndexHeader.SlotsCount;
+        u64 TotalSize = TableSize + sizeof(asset_index_header) + IndexSize;
+        if(TableOffset + TotalSize > FileSize)
+        {
+            return Result;
+        }
+        
+        u8* Data = 0;
+        if(Mapping->Data)
+        {
+            Data = Mapping->Data + TableOffset;
+        }
+        else
+        {
+            //Table and index are contiguous on disk, read them with a single call
+            Data = (u8*)ZeroAlloc(TotalSize);
+            if(!Platform_ReadAtOffset(File, Data, TotalSize, TableOffset))
+            {
+                Free(Data);
+                return Result;
+            }
+        }
+        
+        Result.Entries = (asset_table_entry*)Data;
+        Result.Count = Count;
+        Result.Slots = (asset_index_slot*)(Data + TableSize + sizeof(asset_index_header));
+        Result.SlotsCount = IndexHeader.SlotsCount;
+    }
+    else
+    {
+        //Version 2 entries only add the hash at the end of the version 1 layout
+        b32 HasHashes = Header.Version >= ASSET_FILE_VERSION_HASHED_INDEX;
+        u64 OldEntrySize = HasHashes ? sizeof(asset_table_entry_v2) : sizeof(asset_table_entry_v1);
+        if(Count > FileSize / OldEntrySize || TableOffset + OldEntrySize * Count > FileSize)
+        {
+            return Result;
+        }
+        
+        u8* OldEntries = (u8*)ZeroAlloc(MAX(OldEntrySize * Count, 1));
+        if(!Platform_ReadAtOffset(File, OldEntries, OldEntrySize * Count, TableOffset))
+        {
+            Free(OldEntries);
+            return Result;
+        }
+        
+        u64 SlotsCount = GetAssetIndexSlotsCount(Count);
+        u8* Data = (u8*)ZeroAlloc(sizeof(asset_table_entry) * Count + sizeof(asset_index_slot) * SlotsCount);
+        Result.Entries = (asset_table_entry*)Data;
+        Result.Count = Count;
+        Result.Slots = (asset_index_slot*)(Data + sizeof(asset_table_entry) * Count);
+        Result.SlotsCount = SlotsCount;
+        
+        for(u64 Index = 0; Index < Count; Index++)
+        {
+            asset_table_entry_v1* Old = (asset_table_entry_v1*)(OldEntries + OldEntrySize * Index);
+            asset_table_entry* Entry = &Result.Entries[Index];
+            memcpy(Entry->Name, Old->Name, ASSET_NAME_LENGTH);
+            memcpy(Entry->Tag, Old->Tag, ASSET_TAG_LENGTH);
+            Entry->Type = Old->Type;
+            Entry->Offset = Old->Offset;
+            Entry->Size = Old->Size;
+            Entry->Hash = HasHashes ? ((asset_table_entry_v2*)Old)->Hash : AssetHash(Entry->Name, Entry->Tag);
+            Entry->Codec = ASSET_CODEC_NONE;
+            Entry->StoredSize = Old->Size;
+        }
+        Free(OldEntries);
+        
+        BuildAssetIndex(Result.Entries, Result.Count, Result.Slots, Result.SlotsCount);
+    }
+    
+    return Result;
+}
+
+//In mapped mode the whole file is mapped and ReadAssetData returns pointers into the
+//mapping, otherwise every payload is read into its own buffer. The mapping is read only
+//unless the file predates ASSET_FILE_VERSION_RELATIVE_MESH and meshes need patching.
+//If a queue is given compressed payloads are decompressed in parallel
+internal b32
+OpenAssetArchive(asset_archive* Archive, char* Path, b32 Mapped, work_queue* Queue = 0)
+{
+    *Archive = {};
+    Archive->Queue = Queue;
+    Archive->DirectFile = PLATFORM_INVALID_FILE;
+    Archive->File = Platform_OpenFileForReading(Path);
+    if(Archive->File == PLATFORM_INVALID_FILE)
+    {
+        return false;
+    }
+    
+    if(Mapped)
+    {
+        asset_file_header Header = {};
+        Platform_ReadAtOffset(Archive->File, &Header, sizeof(Header), 0);
+        Archive->Mapping = Platform_MapFile(Archive->File, Header.Version < ASSET_FILE_VERSION_RELATIVE_MESH);
+    }
+    else
+    {
+        Archive->DirectFile = Platform_OpenFileForDirectReading(Path);
+    }
+    
+    Archive->Table = ReadAssetTable(Archive->File, &Archive->Mapping);
+    
+    u64 PrefetchBegin = ULLONG_MAX;
+    u64 PrefetchEnd = 0;
+    for(u64 Index = 0; Index < Archive->Table.Count; Index++)
+    {
+        asset_table_entry* Entry = &Archive->Table.Entries[Index];
+        if(Entry->Flags & ASSET_ENTRY_PREFETCH)
+        {
+            PrefetchBegin = MIN(PrefetchBegin, Entry->Offset);
+            PrefetchEnd = MAX(PrefetchEnd, Entry->Offset + Entry->StoredSize);
+        }
+    }
+    if(PrefetchEnd)
+    {
+        Archive->PrefetchOffset = PrefetchBegin;
+        Archive->PrefetchSize = PrefetchEnd - PrefetchBegin;
+    }
+    
+    return Archive->Table.Entries != 0;
+}
+
+#define ASSET_PREFETCH_CHUNK_SIZE Megabytes(4)
+
+internal void
+PrefetchAssetWork(void* Data)
+{
+    asset_archive* Archive = (asset_archive*)Data;
+    u8* Chunk = (u8*)ZeroAlloc(ASSET_PREFETCH_CHUNK_SIZE);
+    
+    u64 End = Archive->PrefetchOffset + Archive->PrefetchSize;
+    for(u64 Offset = Archive->PrefetchOffset; Offset < End; Offset += ASSET_PREFETCH_CHUNK_SIZE)
+    {
+        u64 Size = MIN(ASSET_PREFETCH_CHUNK_SIZE, End - Offset);
+        if(!Platform_ReadAtOffset(Archive->File, Chunk, Size, Offset)) break;
+    }
+    
+    Free(Chunk);
+}
+
+//Reads the startup entries front to back in large chunks on the queue, so that the
+//OS cache is warm by the time they are requested. The data is thrown away, reads and
+//mappings of the file are both served from the cache afterwards. Without a queue or
+//prefetch entries this does nothing
+internal void
+PrefetchAssetArchive(asset_archive* Archive)
+{
+    if(Archive->Queue && Archive->PrefetchSize)
+    {
+        AddWorkQueueEntry(Archive->Queue, PrefetchAssetWork, Archive);
+    }
+}
+
+//Traces are used by the packer to lay out the entries in the order they are first
+//read, see -order in packer_main.cpp. Reads past Capacity are dropped
+internal void
+BeginAssetReadTrace(asset_archive* Archive, u32 Capacity)
+{
+    asset_read_trace* Trace = (asset_read_trace*)ZeroAlloc(sizeof(asset_read_trace));
+    Trace->Records = (asset_read_record*)ZeroAlloc(sizeof(asset_read_record) * Capacity);
+    Trace->Capacity = Capacity;
+    Trace->Begin = Platform_GetMicroseconds();
+    Archive->Trace = Trace;
+}
+
+//Can be called by multiple threads at the same time
 internal void
-LoadAssetJointTreeRecursively(mesh_joint* Joint, u8* DataBegin, u8* DataEnd)
+RecordAssetRead(asset_read_trace* Trace, asset_table* Table, asset_table_entry* Entry)
+{
+    u64 Microseconds = Platform_GetMicroseconds() - Trace->Begin;
+    u32 Index = Platform_AtomicAdd(&Trace->Count, 1);
+    if(Index < Trace->Capacity)
+    {
+        asset_read_record* Record = &Trace->Records[Index];
+        Record->EntryIndex = (u32)(Entry - Table->Entries);
+        Record->Offset = Entry->Offset;
+        Record->StoredSize = Entry->StoredSize;
+        Record->Microseconds = Microseconds;
+    }
+}
+
+//One line per read in the order they happened: name, tag ('-' if empty), offset,
+//stored size and microseconds since the trace began
+internal b32
+WriteAssetReadTrace(asset_archive* Archive, char* Path)
+{
+    asset_read_trace* Trace = Archive->Trace;
+    FILE* File = fopen(Path, "wb");
+    if(!Trace || !File)
+    {
+        if(File) fclose(File);
+        return false;
+    }
+    
+    fprintf(File, "# name tag offset size microseconds\n");
+    u32 Count = MIN(Trace->Count, Trace->Capacity);
+    for(u32 Index = 0; Index < Count; Index++)
+    {
+        asset_read_record* Record = &Trace->Records[Index];
+        asset_table_entry* Entry = &Archive->Table.Entries[Record->EntryIndex];
+        fprintf(File, "%.*s %.*s %llu %llu %llu\n", ASSET_NAME_LENGTH, Entry->Name,
+                ASSET_TAG_LENGTH, Entry->Tag[0] ? Entry->Tag : "-", (unsigned long long)Record->Offset,
+                (unsigned long long)Record->StoredSize, (unsigned long long)Record->Microseconds);
+    }
+    
+    return fclose(File) == 0;
+}
+
+internal void*
+AllocateAssetBuffer(memory_arena* Arena, u64 Size)
+{
+    return Arena ? PushSize(Arena, Size) : ZeroAlloc(Size);
+}
+
+//Size of the arena ReadAssetData needs for the entry, the result is pushed first and the
+//staging for compressed entries after it. 0 if the result is a view into the mapping
+internal u64
+GetAssetReadArenaSize(asset_archive* Archive, asset_table_entry* Entry, b32 Writable = false)
+{
+    b32 Mapped = Archive->Mapping.Data != 0;
+    b32 Compressed = Entry->Codec != ASSET_CODEC_NONE;
+    
+    u64 Result = 0;
+    if(Compressed || (Writable && Mapped))
+    {
+        Result += ALIGN_UP(Entry->Size, 16);
+    }
+    if(!Mapped)
+    {
+        Result += Entry->StoredSize;
+    }
+    return Result;
+}
+
+//Compressed entries are always decompressed into a new buffer, in mapped mode they
+//are decoded straight from the mapping. Writable asks for a private copy even in mapped
+//mode, the mapping is read only for current archives.
+//With an Arena every buffer comes from it and the data is released with the arena
+//instead of ReleaseAssetData, staging for compressed entries is popped before returning.
+//Returns 0 if a compressed payload is corrupted
+internal void*
+ReadAssetData(asset_archive* Archive, asset_table_entry* Entry, b32 Writable = false, memory_arena* Arena = 0)
+{
+    if(Archive->Trace)
+    {
+        RecordAssetRead(Archive->Trace, &Archive->Table, Entry);
+    }
+    
+    b32 Mapped = Archive->Mapping.Data != 0;
+    b32 Compressed = Entry->Codec != ASSET_CODEC_NONE;
+    Assert(!Compressed || Entry->Codec == ASSET_CODEC_LZ);
+    
+    //The result goes first so that the staging above it can be popped
+    u8* Data = 0;
+    if(Compressed || (Writable && Mapped))
+    {
+        Data = (u8*)AllocateAssetBuffer(Arena, Entry->Size);
+    }
+    
+    u8* Stored = 0;
+    temporary_memory Staging = {};
+    if(Mapped)
+    {
+        Assert(Entry->Offset + Entry->StoredSize <= Archive->Mapping.Size);
+        Stored = Archive->Mapping.Data + Entry->Offset;
+    }
+    else
+    {
+        if(Arena && Compressed)
+        {
+            Staging = BeginTemporaryMemory(Arena);
+        }
+        Stored = (u8*)AllocateAssetBuffer(Arena, Entry->StoredSize);
+        b32 Success = Platform_ReadAtOffset(Archive->File, Stored, Entry->StoredSize, Entry->Offset);
+        Assert(Success);
+    }
+    
+    if(!Compressed)
+    {
+        if(Data)
+        {
+            memcpy(Data, Stored, Entry->Size);
+            return Data;
+        }
+        return Stored;
+    }
+    
+    b32 Success = DecompressAssetPayload(Stored, Entry->StoredSize, Data, Entry->Size, Archive->Queue);
+    
+    if(Staging.Arena)
+    {
+        EndTemporaryMemory(Staging);
+    }
+    else if(!Mapped && !Arena)
+    {
+        Free(Stored);
+    }
+    
+    if(!Success)
+    {
+        if(!Arena) Free(Data);
+        return 0;
+    }
+    return Data;
+}
+
+//Bytes [Begin, Begin + Size) of the decompressed payload, compressed entries only decode
+//the chunks that overlap them. Like ReadAssetData the result is a view into the mapping
+//when possible, release it with ReleaseAssetData. Returns 0 if the payload is corrupted
+internal void*
+ReadAssetDataRange(asset_archive* Archive, asset_table_entry* Entry, u64 Begin, u64 Size)
 {
-    Assert((u64)Joint >= (u64)DataBegin && (u64)Joint < (u64)DataEnd);
+    Assert(Begin + Size <= Entry->Size);
+    if(Archive->Trace)
+    {
+        RecordAssetRead(Archive->Trace, &Archive->Table, Entry);
+    }
+    
+    u8* Mapped = Archive->Mapping.Data ? Archive->Mapping.Data + Entry->Offset : 0;
+    if(Entry->Codec == ASSET_CODEC_NONE)
+    {
+        if(Mapped)
+        {
+            return Mapped + Begin;
+        }
+        
+        u8* Data = (u8*)ZeroAlloc(MAX(Size, 1));
+        b32 Success = Platform_ReadAtOffset(Archive->File, Data, Size, Entry->Offset + Begin);
+        Assert(Success);
+        return Data;
+    }
+    
+    Assert(Entry->Codec == ASSET_CODEC_LZ);
+    u8* Data = (u8*)ZeroAlloc(MAX(Size, 1));
+    if(!Size) return Data;
+    
+    //Header, then the offsets of the chunks in the range and of the end of the last one.
+    //Like in DecompressAssetPayload the table is checked against the stored size before
+    //it's used, a corrupted one fails the read
+    asset_compressed_header Header = {};
+    b32 HeaderRead = Entry->StoredSize >= sizeof(Header);
+    if(HeaderRead && Mapped)
+    {
+        memcpy(&Header, Mapped, sizeof(Header));
+    }
+    else if(HeaderRead)
+    {
+        HeaderRead = Platform_ReadAtOffset(Archive->File, &Header, sizeof(Header), Entry->Offset);
+    }
+    
+    if(!HeaderRead || !Header.ChunkSize || Header.ChunksCount != GetCompressedChunksCount(Entry->Size, Header.ChunkSize) ||
+       Header.ChunksCount >= (Entry->StoredSize - sizeof(Header)) / sizeof(u64))
+    {
+        Free(Data);
+        return 0;
+    }
+    u64 HeaderSize = sizeof(Header) + sizeof(u64) * (Header.ChunksCount + 1);
+    
+    u64 FirstChunk = Begin / Header.ChunkSize;
+    u64 EndChunk = (Begin + Size - 1) / Header.ChunkSize + 1;
+    
+    u64 OffsetsCount = EndChunk - FirstChunk + 1;
+    u64 OffsetsBegin = sizeof(Header) + sizeof(u64) * FirstChunk;
+    u64* Offsets = (u64*)ZeroAlloc(sizeof(u64) * OffsetsCount);
+    b32 OffsetsRead = true;
+    if(Mapped)
+    {
+        memcpy(Offsets, Mapped + OffsetsBegin, sizeof(u64) * OffsetsCount);
+    }
+    else
+    {
+        OffsetsRead = Platform_ReadAtOffset(Archive->File, Offsets, sizeof(u64) * OffsetsCount, Entry->Offset + OffsetsBegin);
+    }
+    
+    u64 StoredBegin = Offsets[0];
+    u64 StoredEnd = Offsets[OffsetsCount - 1];
+    b32 Failed = !OffsetsRead || StoredBegin < HeaderSize || StoredEnd < StoredBegin || StoredEnd > Entry->StoredSize;
+    for(u64 Index = 1; Index < OffsetsCount; Index++)
+    {
+        Failed |= Offsets[Index] < Offsets[Index - 1];
+    }
+    if(Failed)
+    {
+        Free(Offsets);
+        Free(Data);
+        return 0;
+    }
+    
+    u64 StoredSize = StoredEnd - StoredBegin;
+    u8* Stored = Mapped ? Mapped + StoredBegin : (u8*)ZeroAlloc(MAX(StoredSize, 1));
+    if(!Mapped)
+    {
+        Failed = !Platform_ReadAtOffset(Archive->File, Stored, StoredSize, Entry->Offset + StoredBegin);
+    }
+    
+    //Chunks inside the range are decoded in place, the ones at its ends go through Chunk
+    u8* Chunk = (u8*)ZeroAlloc(Header.ChunkSize);
+    for(u64 ChunkIndex = FirstChunk; ChunkIndex < EndChunk && !Failed; ChunkIndex++)
+    {
+        u64 ChunkBegin = ChunkIndex * Header.ChunkSize;
+        u64 ChunkEnd = MIN(ChunkBegin + Header.ChunkSize, Entry->Size);
+        b32 Inside = ChunkBegin >= Begin && ChunkEnd <= Begin + Size;
+        
+        decompress_chunk_work Work = {};
+        Work.Src = Stored + Offsets[ChunkIndex - FirstChunk] - StoredBegin;
+        Work.SrcSize = Offsets[ChunkIndex - FirstChunk + 1] - Offsets[ChunkIndex - FirstChunk];
+        Work.Dst = Inside ? Data + (ChunkBegin - Begin) : Chunk;
+        Work.DstSize = ChunkEnd - ChunkBegin;
+        Work.FilterStride = Header.FilterStride;
+        DecompressChunk(&Work);
+        Failed |= Work.Failed;
+        
+        if(!Inside)
+        {
+            u64 CopyBegin = MAX(ChunkBegin, Begin);
+            u64 CopyEnd = MIN(ChunkEnd, Begin + Size);
+            memcpy(Data + (CopyBegin - Begin), Chunk + (CopyBegin - ChunkBegin), CopyEnd - CopyBegin);
+        }
+    }
+    
+    Free(Chunk);
+    Free(Offsets);
+    if(!Mapped)
+    {
+        Free(Stored);
+    }
     
-    if(Joint->ChildrenCount)
+    if(Failed)
     {
-        Joint->Children = (mesh_joint*)(DataBegin + (u64)Joint->Children);
+        Free(Data);
+        return 0;
     }
-    for(u32 Index = 0; Index < Joint->ChildrenCount; Index++)
+    return Data;
+}
+
+//Entries at least this big are aligned by the packer so that ReadAssetEntries can read
+//them bypassing the OS cache
+#define ASSET_DIRECT_READ_MIN_SIZE Megabytes(1)
+
+//Reads the stored bytes of many entries with a single Platform_ReadBatch. Every buffer in
+//Stored comes from Platform_AllocateMemory and is released with Platform_FreeMemory.
+//Big payloads are usually read once, the aligned part of them goes through the direct
+//handle so that they are not copied through the OS cache too
+internal b32
+ReadAssetEntries(asset_archive* Archive, asset_table_entry** Entries, u32 Count, u8** Stored)
+{
+    platform_read* Reads = (platform_read*)ZeroAlloc(sizeof(platform_read) * Count * 2);
+    u32 ReadsCount = 0;
+    b32 Success = true;
+    for(u32 Index = 0; Index < Count; Index++)
+    {
+        asset_table_entry* Entry = Entries[Index];
+        if(Archive->Trace)
+        {
+            RecordAssetRead(Archive->Trace, &Archive->Table, Entry);
+        }
+        
+        u8* Data = (u8*)Platform_AllocateMemory(MAX(Entry->StoredSize, 1));
+        Stored[Index] = Data;
+        if(!Data)
+        {
+            Success = false;
+            continue;
+        }
+        
+        u64 DirectSize = 0;
+        if(Archive->DirectFile != PLATFORM_INVALID_FILE && Entry->StoredSize >= ASSET_DIRECT_READ_MIN_SIZE &&
+           Entry->Offset % PLATFORM_DIRECT_READ_ALIGNMENT == 0)
+        {
+            DirectSize = ALIGN_DOWN(Entry->StoredSize, PLATFORM_DIRECT_READ_ALIGNMENT);
+            Reads[ReadsCount++] = { Archive->DirectFile, Data, DirectSize, Entry->Offset };
+        }
+        if(Entry->StoredSize > DirectSize)
+        {
+            Reads[ReadsCount++] = { Archive->File, Data + DirectSize, Entry->StoredSize - DirectSize, Entry->Offset + DirectSize };
+        }
+    }
+    
+    Success = Platform_ReadBatch(Reads, ReadsCount) && Success;
+    Free(Reads);
+    return Success;
+}
+
+//Only frees copies, views into the mapping stay valid as long as the archive is open.
+//Not for data read into an arena
+internal void
+ReleaseAssetData(asset_archive* Archive, void* Data)
+{
+    platform_file_mapping* Mapping = &Archive->Mapping;
+    b32 InMapping = (u8*)Data >= Mapping->Data && (u8*)Data < Mapping->Data + Mapping->Size;
+    if(!InMapping)
     {
-        LoadAssetJointTreeRecursively(&Joint->Children[Index], DataBegin, DataEnd);
+        Free(Data);
     }
 }
 
-#define PATCH_ADDRESS(Address, Type, Begin, End) \
-Address = (Type*)((u8*)Begin + (u64)Address); \
-Assert((u64)Address <= (u64)End);
+//Before ASSET_FILE_VERSION_RELATIVE_MESH references were offsets from the start of the
+//payload, they are rewritten in place as self relative ones. This is the only time mesh
+//payloads are written to, archives that old are mapped copy-on-write for it
+internal void
+ConvertMeshAssetReferences(u8* DataBegin, u64 Size, mesh_data* Mesh)
+{
+    for(u32 JointIndex = 0; JointIndex < Mesh->JointsCount; JointIndex++)
+    {
+        mesh_joint* Joint = &Mesh->RootJoint[JointIndex];
+        u64 ChildrenOffset = (u64)Joint->ChildrenOffset;
+        Assert(ChildrenOffset + sizeof(mesh_joint) * Joint->ChildrenCount <= Size);
+        
+        Joint->NameOffset = 0;
+        SET_RELATIVE_POINTER(Joint->ChildrenOffset, Joint->ChildrenCount ? DataBegin + ChildrenOffset : 0);
+    }
+    
+    for(u32 AnimationIndex = 0; AnimationIndex < Mesh->AnimationsCount; AnimationIndex++)
+    {
+        mesh_animation* Animation = &Mesh->Animations[AnimationIndex];
+        u64 JointsOffset = (u64)Animation->JointsOffset;
+        Assert(JointsOffset + sizeof(joint_animation) * Mesh->JointsCount <= Size);
+        SET_RELATIVE_POINTER(Animation->JointsOffset, DataBegin + JointsOffset);
+        
+        joint_animation* JointAnimations = GetAnimationJoints(Animation);
+        for(u32 JointIndex = 0; JointIndex < Mesh->JointsCount; JointIndex++)
+        {
+            joint_animation* JointAnimation = &JointAnimations[JointIndex];
+            u64 KeyframesOffset = (u64)JointAnimation->KeyframesOffset;
+            Assert(KeyframesOffset + sizeof(animation_keyframe) * JointAnimation->KeyframesCount <= Size);
+            SET_RELATIVE_POINTER(JointAnimation->KeyframesOffset, DataBegin + KeyframesOffset);
+        }
+    }
+}
 
+//Version is the one of the file the asset comes from. From ASSET_FILE_VERSION_RELATIVE_MESH
+//the data is only read, the returned mesh points into it
 internal mesh_data
-LoadMeshAsset(void* Data, u64 Size)
+LoadMeshAsset(void* Data, u64 Size, u32 Version)
 {
     mesh_data Result = {};
     
@@ -48,6 +823,7 @@ LoadMeshAsset(void* Data, u64 Size)
     Result.IndicesCount = Asset->IndicesCount;
     Result.JointsCount = Asset->JointsCount;
     Result.AnimationsCount = Asset->AnimationsCount;
+    Result.UVDensity = Version >= ASSET_FILE_VERSION_MESH_UV_DENSITY ? Asset->UVDensity : 0.0f;
     
     u32 Vec4ArraySize = sizeof(vec4) * Asset->VerticesCount;
     u32 Vec3ArraySize = sizeof(vec3) * Asset->VerticesCount;
@@ -77,64 +853,154 @@ LoadMeshAsset(void* Data, u64 Size)
     Result.Indices = (u32*)(DataBegin + IndicesOffset);
     Assert(IndicesOffset + sizeof(u32) * Asset->IndicesCount <= Size);
     
+    //Older files could flag meshes as quantized without storing the streams, they are
+    //drawn from the float arrays
+    if(Version < ASSET_FILE_VERSION_QUANTIZED_MESH)
+    {
+        Result.Flags = (mesh_flag)(Result.Flags & ~MESH_QUANTIZED);
+    }
+    else if(Result.Flags & MESH_QUANTIZED)
+    {
+        quantized_mesh_vertices* Quantized = &Result.Quantized;
+        Quantized->VerticesCount = Asset->VerticesCount;
+        Quantized->Min = Asset->PositionMin;
+        Quantized->Max = Asset->PositionMax;
+        Quantized->UVMin = Asset->UVMin;
+        Quantized->UVMax = Asset->UVMax;
+        Quantized->Positions = (quantized_position*)(DataBegin + Asset->QuantizedOffset);
+        Quantized->Shading = (quantized_shading_vertex*)(Quantized->Positions + Asset->VerticesCount);
+        Assert(Asset->QuantizedOffset + (sizeof(quantized_position) + sizeof(quantized_shading_vertex)) * Asset->VerticesCount <= Size);
+    }
+    
     if(HasAnimation)
     {
         u32 RootJointOffset = IndicesOffset + sizeof(u32) * Asset->IndicesCount;
         Assert(RootJointOffset == Asset->JointsOffset);
         Result.RootJoint = (mesh_joint*)(DataBegin + RootJointOffset);
-        LoadAssetJointTreeRecursively(Result.RootJoint, DataBegin, DataBegin + Size);
-    
+        
         u32 AnimationsOffset = RootJointOffset + sizeof(mesh_joint) * Asset->JointsCount;
         Assert(AnimationsOffset == Asset->AnimationsOffset);
+        Assert(AnimationsOffset + sizeof(mesh_animation) * Asset->AnimationsCount <= Size);
         
         Result.Animations = (mesh_animation*)(DataBegin + AnimationsOffset);
         
-        //Patch all the addressses with DataBegin
-        for(u32 AnimIndex = 0; AnimIndex < Asset->AnimationsCount; AnimIndex++)
+        if(Version < ASSET_FILE_VERSION_RELATIVE_MESH)
         {
-            mesh_animation* Animation = &Result.Animations[AnimIndex];
-            PATCH_ADDRESS(Animation->Joints, joint_animation, DataBegin, DataBegin + Size);
-            for(u32 JointIndex = 0; JointIndex < Asset->JointsCount; JointIndex++)
-            {
-                joint_animation* Joint = &Animation->Joints[JointIndex];
-                PATCH_ADDRESS(Joint->Keyframes, animation_keyframe, DataBegin, DataBegin + Size);
-            }
+            ConvertMeshAssetReferences(DataBegin, Size, &Result);
         }
     }
     
     return Result;
 }
 
-#undef PATCH_ADDRESS
-
+//Version is the one of the file the asset comes from, images before
+//ASSET_FILE_VERSION_IMAGE_MIPS have a smaller header and no mips
 internal image_data
-LoadImageAsset(void* Data, u64 Size)
+LoadImageAsset(void* Data, u64 Size, u32 Version)
 {
+    image_data Result = {};
+    if(Version < ASSET_FILE_VERSION_IMAGE_MIPS)
+    {
+        asset_image_v1* Asset = (asset_image_v1*)Data;
+        Assert(Asset->Pitch == Asset->Width * Asset->BytesPerPixel);
+        Assert(Size == sizeof(asset_image_v1) + Asset->Height * Asset->Pitch);
+        
+        Result.Width = Asset->Width;
+        Result.Height = Asset->Height;
+        Result.BytesPerPixel = Asset->BytesPerPixel;
+        Result.Pitch = Asset->Pitch;
+        Result.NumberOfMips = 1;
+        Result.Data = ((u8*)Data) + sizeof(asset_image_v1);
+        return Result;
+    }
+    
+    //Version 4 is the current header without the block format
     asset_image* Asset = (asset_image*)Data;
-    Assert(Asset->Pitch == Asset->Width * Asset->BytesPerPixel);
-    Assert(Size == sizeof(asset_image) + Asset->Height * Asset->Pitch);
+    b32 HasBlockFormat = Version >= ASSET_FILE_VERSION_IMAGE_BLOCKS;
+    u64 HeaderSize = HasBlockFormat ? sizeof(asset_image) : sizeof(asset_image_v4);
     
-    image_data Result = {};
     Result.Width = Asset->Width;
     Result.Height = Asset->Height;
     Result.BytesPerPixel = Asset->BytesPerPixel;
     Result.Pitch = Asset->Pitch;
-    Result.Data = ((u8*)Data) + sizeof(asset_image);
+    Result.NumberOfMips = Asset->NumberOfMips ? Asset->NumberOfMips : 1;
+    Result.BlockFormat = HasBlockFormat ? (image_block_format)Asset->BlockFormat : IMAGE_UNCOMPRESSED;
+    Result.Data = ((u8*)Data) + HeaderSize;
+    Assert((u32)Result.Pitch == GetImageLevelPitch(Result.Width, Result.BytesPerPixel, Result.BlockFormat, 0));
+    Assert(Size == HeaderSize + GetImageMipChainSize(Result.Width, Result.Height, Result.BytesPerPixel,
+                                                     Result.NumberOfMips, Result.BlockFormat));
     
     return Result;
 }
 
+//Reads only the mips of an image with no side bigger than MaxSize, the most detailed
+//level is picked by GetImageFirstMipForSize. The smaller mips are at the end of the payload,
+//so this is the header and a single range. Image->Data points to the returned data, to be
+//released with ReleaseAssetData, 0 means the payload is corrupted
+internal void*
+ReadImageAssetMips(asset_archive* Archive, asset_table_entry* Entry, u32 MaxSize, image_data* Image)
+{
+    u32 Version = Archive->Table.Version;
+    if(Version < ASSET_FILE_VERSION_IMAGE_MIPS)
+    {
+        void* Data = ReadAssetData(Archive, Entry);
+        if(Data) *Image = LoadImageAsset(Data, Entry->Size, Version);
+        return Data;
+    }
+    
+    b32 HasBlockFormat = Version >= ASSET_FILE_VERSION_IMAGE_BLOCKS;
+    u64 HeaderSize = HasBlockFormat ? sizeof(asset_image) : sizeof(asset_image_v4);
+    asset_image Asset = {};
+    void* Header = ReadAssetDataRange(Archive, Entry, 0, HeaderSize);
+    if(!Header) return 0;
+    memcpy(&Asset, Header, HeaderSize);
+    ReleaseAssetData(Archive, Header);
+    
+    image_data Result = {};
+    Result.Width = Asset.Width;
+    Result.Height = Asset.Height;
+    Result.BytesPerPixel = Asset.BytesPerPixel;
+    Result.Pitch = Asset.Pitch;
+    Result.NumberOfMips = Asset.NumberOfMips ? Asset.NumberOfMips : 1;
+    Result.BlockFormat = HasBlockFormat ? (image_block_format)Asset.BlockFormat : IMAGE_UNCOMPRESSED;
+    Assert(Entry->Size == HeaderSize + GetImageMipChainSize(Result.Width, Result.Height, Result.BytesPerPixel,
+                                                            Result.NumberOfMips, Result.BlockFormat));
+    
+    Result.FirstMip = GetImageFirstMipForSize(Result.Width, Result.Height, Result.NumberOfMips, Result.BlockFormat, MaxSize);
+    u64 Skipped = GetImageMipOffset(Result.Width, Result.Height, Result.BytesPerPixel, Result.FirstMip, Result.BlockFormat);
+    void* Data = ReadAssetDataRange(Archive, Entry, HeaderSize + Skipped, Entry->Size - HeaderSize - Skipped);
+    Result.Data = (u8*)Data;
+    
+    *Image = Result;
+    return Data;
+}
+
+//Version is the one of the file the asset comes from, cubemaps before
+//ASSET_FILE_VERSION_CUBEMAP_FORMAT are float and have no format in the header
 internal cubemap_data
-LoadCubemapAsset(void* Data, u64 Size)
+LoadCubemapAsset(void* Data, u64 Size, u32 Version)
 {
     asset_cubemap* Asset = (asset_cubemap*)Data;
+    b32 HasFormat = Version >= ASSET_FILE_VERSION_CUBEMAP_FORMAT;
+    u64 HeaderSize = HasFormat ? sizeof(asset_cubemap) : sizeof(asset_cubemap_v1);
     
     cubemap_data Result = {};
     Result.Size = Asset->Size;
     Result.BytesPerPixel = Asset->BytesPerPixel;
     Result.Pitch = Asset->Pitch;
     Result.NumberOfMips = Asset->NumberOfMips ? Asset->NumberOfMips : 1;
-    Result.Data = ((u8*)Data) + sizeof(asset_cubemap);
+    if(HasFormat)
+    {
+        Result.Format = (cubemap_format)Asset->Format;
+    }
+    else
+    {
+        Assert(Asset->BytesPerPixel == 16 || Asset->BytesPerPixel == 8);
+        Result.Format = Asset->BytesPerPixel == 16 ? CUBEMAP_RGBA32F : CUBEMAP_RGBA16F;
+    }
+    Result.Data = ((u8*)Data) + HeaderSize;
+    Assert(Result.Format < CUBEMAP_FORMATS_COUNT);
+    Assert(Size >= HeaderSize + 6 * GetCubemapFaceSize(Result.Size, Result.Format, Result.NumberOfMips));
     
     return Result;
 }
\ No newline at end of file
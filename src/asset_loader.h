@@ -0,0 +1,60 @@
+struct asset_read_record
+{
+    u32 EntryIndex;
+    u64 Offset;
+    u64 StoredSize;
+    u64 Microseconds; //Since BeginAssetReadTrace
+};
+
+//Every ReadAssetData of a traced archive is recorded here, see WriteAssetReadTrace
+struct asset_read_trace
+{
+    asset_read_record* Records;
+    u32 Capacity;
+    volatile u32 Count;
+    u64 Begin;
+};
+
+struct asset_archive
+{
+    platform_file File;
+    asset_table Table;
+    
+    //Only set in mapped mode, payloads are then views into the mapping instead of copies
+    platform_file_mapping Mapping;
+    
+    //Only opened when not mapped, PLATFORM_INVALID_FILE if direct reads are not supported
+    platform_file DirectFile;
+    
+    //Optional, used to decompress the chunks of large entries in parallel
+    work_queue* Queue;
+    
+    //Range covered by the ASSET_ENTRY_PREFETCH entries, the packer puts them together
+    u64 PrefetchOffset;
+    u64 PrefetchSize;
+    
+    //Optional, only set while tracing
+    asset_read_trace* Trace;
+};
+
+#define ASSET_MAX_MOUNTS 16
+
+//Same probing as asset_index_slot, over the entries of every mount
+struct asset_library_slot
+{
+    u32 HashHigh;
+    u32 Mount;
+    u32 EntryIndex; //Index in the table of the mount + 1, 0 if the slot is empty
+};
+
+//Stack of mounted archives, entries of later mounts shadow the entries with the same
+//name and tag of earlier ones. Lookups go through a single index of all the mounts
+//that is rebuilt by MountAssetArchive
+struct asset_library
+{
+    asset_archive* Mounts[ASSET_MAX_MOUNTS];
+    u32 MountsCount;
+    
+    asset_library_slot* Slots;
+    u64 SlotsCount;
+};
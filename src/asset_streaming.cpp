@@ -0,0 +1,315 @@
+// Asynchronous asset loading on top of the work queue.
+// Workers read the payload and parse it (LoadMeshAsset, LoadImageAsset, ...), an optional
+// Process callback can do more CPU work on the worker. The main thread calls
+// ProcessCompletedAssetLoads once per frame, which runs the Complete callbacks where
+// GPU resources are created.
+// Both halves of every load are recorded as startup trace events, see WriteStartupTrace.
+// Payloads are read into arenas carved out by the main thread when the request is
+// submitted, so workers never share one. Most come from the streamer staging arena, which
+// is reset whenever no request is in flight.
+
+#define ASSET_STREAMER_MAX_REQUESTS 256
+
+//Holds the startup loads that don't skip mips (BRDF LUT, light probe cubemaps and
+//environment), bigger bursts and mip range reads fall back to the heap
+#define ASSET_STREAMER_STAGING_SIZE Megabytes(32)
+
+enum asset_load_state
+{
+    ASSET_LOAD_FREE,
+    ASSET_LOAD_QUEUED,
+    ASSET_LOAD_PARSED,
+    ASSET_LOAD_FAILED,
+    ASSET_LOAD_DONE,
+};
+
+struct asset_load_request;
+
+//Context is whatever the main thread passes to ProcessCompletedAssetLoads
+typedef void asset_complete_callback(asset_load_request* Request, void* Context);
+typedef void asset_process_callback(asset_load_request* Request);
+
+struct asset_load_request
+{
+    volatile u32 State;
+    u32 Generation;
+    
+    asset_archive* Archive;
+    asset_table_entry* Entry;
+    
+    //Raw payload, released after the Complete callback unless KeepData is set. Writable
+    //requests get a private copy that the Process callback can modify, see ReadAssetData
+    void* Data;
+    b32 KeepData;
+    b32 Writable;
+    
+    //Where Data is read, empty if it's read on the heap. Payloads in an arena are never
+    //released by the streamer
+    memory_arena Arena;
+    
+    //Images only, when set the mips larger than this are not read, see ReadImageAssetMips
+    u32 ImageMaxSize;
+    
+    union
+    {
+        mesh_data Mesh;
+        image_data Image;
+        cubemap_data Cubemap;
+    };
+    
+    asset_process_callback* Process;
+    asset_complete_callback* Complete;
+    void* UserData;
+    u32 UserIndex;
+};
+
+struct asset_load_handle
+{
+    u32 Index;
+    u32 Generation;
+};
+
+struct asset_streamer
+{
+    asset_library* Library;
+    work_queue* Queue;
+    
+    asset_load_request Requests[ASSET_STREAMER_MAX_REQUESTS];
+    u32 NextRequest;
+    u32 ActiveCount;
+    
+    memory_arena Staging;
+};
+
+//The staging arena is carved out of Memory
+internal void
+InitAssetStreamer(asset_streamer* Streamer, asset_library* Library, work_queue* Queue, memory_arena* Memory)
+{
+    *Streamer = {};
+    Streamer->Library = Library;
+    Streamer->Queue = Queue;
+    SubArena(&Streamer->Staging, Memory, ASSET_STREAMER_STAGING_SIZE);
+}
+
+//Size of the decoded payload, which is about what the Complete callback uploads.
+//Image loads can skip the top mips
+internal u64
+GetAssetLoadSize(asset_load_request* Request)
+{
+    image_data* Image = &Request->Image;
+    if(Request->Entry->Type == ASSET_IMAGE && Image->FirstMip)
+    {
+        return GetImageMipChainSize(Image->Width, Image->Height, Image->BytesPerPixel, Image->NumberOfMips, Image->BlockFormat) -
+            GetImageMipOffset(Image->Width, Image->Height, Image->BytesPerPixel, Image->FirstMip, Image->BlockFormat);
+    }
+    return Request->Entry->Size;
+}
+
+internal void
+RecordAssetLoadEvent(asset_load_request* Request, char* Category, u64 Begin, u64 BytesRead, u64 BytesUploaded)
+{
+    asset_table_entry* Entry = Request->Entry;
+    char Name[STARTUP_TRACE_NAME_LENGTH];
+    snprintf(Name, sizeof(Name), "%.*s%s%.*s", ASSET_NAME_LENGTH, Entry->Name, Entry->Tag[0] ? " " : "",
+             ASSET_TAG_LENGTH, Entry->Tag);
+    AddStartupTraceEvent(Category, Name, Begin, Platform_GetMicroseconds(), BytesRead, BytesUploaded);
+}
+
+internal void
+LoadAssetWork(void* Param)
+{
+    asset_load_request* Request = (asset_load_request*)Param;
+    asset_table_entry* Entry = Request->Entry;
+    u64 Begin = Platform_GetMicroseconds();
+    
+    if(Entry->Type == ASSET_IMAGE && Request->ImageMaxSize)
+    {
+        //The payload only starts at the first mip read, it can't be parsed again
+        Assert(!Request->Process && !Request->Writable);
+        Request->Data = ReadImageAssetMips(Request->Archive, Entry, Request->ImageMaxSize, &Request->Image);
+    }
+    else
+    {
+        memory_arena* Arena = Request->Arena.Base ? &Request->Arena : 0;
+        Request->Data = ReadAssetData(Request->Archive, Entry, Request->Writable, Arena);
+        if(Request->Data)
+        {
+            switch(Entry->Type)
+            {
+                case ASSET_MESH: Request->Mesh = LoadMeshAsset(Request->Data, Entry->Size, Request->Archive->Table.Version); break;
+                case ASSET_IMAGE: Request->Image = LoadImageAsset(Request->Data, Entry->Size, Request->Archive->Table.Version); break;
+                case ASSET_CUBEMAP: Request->Cubemap = LoadCubemapAsset(Request->Data, Entry->Size, Request->Archive->Table.Version); break;
+                default: break;
+            }
+        }
+    }
+    
+    //Corrupted payloads fail the load, Complete sees ASSET_LOAD_FAILED like for missing assets
+    if(!Request->Data)
+    {
+        Platform_AtomicCompareExchange(&Request->State, ASSET_LOAD_QUEUED, ASSET_LOAD_FAILED);
+        return;
+    }
+    
+    if(Request->Process)
+    {
+        Request->Process(Request);
+    }
+    
+    //Partial reads of compressed entries read whole chunks, their size is an estimate
+    RecordAssetLoadEvent(Request, "load", Begin, Entry->StoredSize * GetAssetLoadSize(Request) / MAX(Entry->Size, 1), 0);
+    
+    Platform_AtomicCompareExchange(&Request->State, ASSET_LOAD_QUEUED, ASSET_LOAD_PARSED);
+}
+
+//Requests are only submitted and retired by the main thread, workers only move them
+//from QUEUED to PARSED.
+//With an Arena the payload is read there and left to the caller once the request
+//completes, for data that stays resident. If it doesn't fit it's read on the heap and
+//KeepData is set instead
+internal asset_load_handle
+RequestAssetLoad(asset_streamer* Streamer, asset_table_entry* Entry, asset_complete_callback* Complete,
+                 void* UserData = 0, u32 UserIndex = 0, asset_process_callback* Process = 0, b32 Writable = false,
+                 u32 ImageMaxSize = 0, memory_arena* Arena = 0)
+{
+    Assert(Streamer->ActiveCount < ASSET_STREAMER_MAX_REQUESTS);
+    
+    asset_load_request* Request = 0;
+    u32 Index = Streamer->NextRequest;
+    for(;; Index = (Index + 1) % ASSET_STREAMER_MAX_REQUESTS)
+    {
+        Request = &Streamer->Requests[Index];
+        if(Request->State == ASSET_LOAD_FREE) break;
+    }
+    Streamer->NextRequest = (Index + 1) % ASSET_STREAMER_MAX_REQUESTS;
+    Streamer->ActiveCount++;
+    
+    u32 Generation = Request->Generation + 1;
+    *Request = {};
+    Request->Generation = Generation;
+    Request->Archive = Entry ? GetAssetArchive(Streamer->Library, Entry) : 0;
+    Request->Entry = Entry;
+    Request->Process = Process;
+    Request->Writable = Writable;
+    Request->Complete = Complete;
+    Request->UserData = UserData;
+    Request->UserIndex = UserIndex;
+    Request->ImageMaxSize = ImageMaxSize;
+    
+    if(Entry && !ImageMaxSize)
+    {
+        memory_arena* Parent = Arena ? Arena : &Streamer->Staging;
+        u64 Size = GetAssetReadArenaSize(Request->Archive, Entry, Writable);
+        if(Size && Size <= GetArenaSizeRemaining(Parent))
+        {
+            SubArena(&Request->Arena, Parent, Size);
+        }
+        Request->KeepData = Arena && !Request->Arena.Base;
+    }
+    
+    if(Entry)
+    {
+        Request->State = ASSET_LOAD_QUEUED;
+        AddWorkQueueEntry(Streamer->Queue, LoadAssetWork, Request);
+    }
+    else
+    {
+        //Still goes through Complete so the caller finds out
+        Request->State = ASSET_LOAD_FAILED;
+    }
+    
+    asset_load_handle Result = { Index, Generation };
+    return Result;
+}
+
+internal asset_load_handle
+RequestAssetLoad(asset_streamer* Streamer, asset_id Id, asset_type Type, asset_complete_callback* Complete,
+                 void* UserData = 0, u32 UserIndex = 0, asset_process_callback* Process = 0, b32 Writable = false,
+                 memory_arena* Arena = 0)
+{
+    asset_table_entry* Entry = FindAsset(Id, Streamer->Library, Type);
+    return RequestAssetLoad(Streamer, Entry, Complete, UserData, UserIndex, Process, Writable, 0, Arena);
+}
+
+internal asset_load_handle
+RequestAssetLoad(asset_streamer* Streamer, char* Name, asset_type Type, char* Tag, asset_complete_callback* Complete,
+                 void* UserData = 0, u32 UserIndex = 0, asset_process_callback* Process = 0, b32 Writable = false)
+{
+    asset_table_entry* Entry = FindAsset(Name, Streamer->Library, Type, Tag);
+    return RequestAssetLoad(Streamer, Entry, Complete, UserData, UserIndex, Process, Writable);
+}
+
+//Loads the mips of the image from the first one no larger than MaxSize, Image.FirstMip
+//tells which one that is
+internal asset_load_handle
+RequestImageMipsLoad(asset_streamer* Streamer, char* Name, u32 MaxSize, asset_complete_callback* Complete,
+                     void* UserData = 0, u32 UserIndex = 0)
+{
+    asset_table_entry* Entry = FindAsset(Name, Streamer->Library, ASSET_IMAGE, "");
+    return RequestAssetLoad(Streamer, Entry, Complete, UserData, UserIndex, 0, false, MaxSize);
+}
+
+//Once a request is retired its slot can be reused, so old handles report DONE
+internal asset_load_state
+GetAssetLoadState(asset_streamer* Streamer, asset_load_handle Handle)
+{
+    asset_load_request* Request = &Streamer->Requests[Handle.Index];
+    if(Request->Generation != Handle.Generation)
+    {
+        return ASSET_LOAD_DONE;
+    }
+    
+    return (asset_load_state)Request->State;
+}
+
+internal void
+RetireAssetLoad(asset_streamer* Streamer, asset_load_request* Request, void* Context)
+{
+    if(Request->Complete)
+    {
+        u64 Begin = Platform_GetMicroseconds();
+        Request->Complete(Request, Context);
+        if(Request->State == ASSET_LOAD_PARSED)
+        {
+            RecordAssetLoadEvent(Request, "upload", Begin, 0, GetAssetLoadSize(Request));
+        }
+    }
+    
+    //Staging is reset once nothing is in flight, payloads read there can't be kept
+    u8* ArenaBase = Request->Arena.Base;
+    b32 Staged = ArenaBase >= Streamer->Staging.Base && ArenaBase < Streamer->Staging.Base + Streamer->Staging.Size;
+    Assert(!(Request->KeepData && Staged));
+    if(Request->Data && !Request->KeepData && !Request->Arena.Base)
+    {
+        ReleaseAssetData(Request->Archive, Request->Data);
+    }
+    
+    //Handles to the retired request report DONE from now on
+    Request->Generation++;
+    Request->State = ASSET_LOAD_FREE;
+    Streamer->ActiveCount--;
+    
+    if(Streamer->ActiveCount == 0)
+    {
+        ResetArena(&Streamer->Staging);
+    }
+}
+
+//Main thread only. Runs at most MaxCount completions so uploads can be spread over
+//several frames, returns the number of requests still in flight
+internal u32
+ProcessCompletedAssetLoads(asset_streamer* Streamer, void* Context, u32 MaxCount = ASSET_STREAMER_MAX_REQUESTS)
+{
+    u32 Completed = 0;
+    for(u32 Index = 0; Index < ASSET_STREAMER_MAX_REQUESTS && Streamer->ActiveCount && Completed < MaxCount; Index++)
+    {
+        asset_load_request* Request = &Streamer->Requests[Index];
+        if(Request->State == ASSET_LOAD_PARSED || Request->State == ASSET_LOAD_FAILED)
+        {
+            RetireAssetLoad(Streamer, Request, Context);
+            Completed++;
+        }
+    }
+    
+    return Streamer->ActiveCount;
+}
@@ -32,4 +32,164 @@ GetEarthAtmosphereParameters()
     Result.GroundAlbedo = vec3(0.5f);
     
     return Result;
-}
\ No newline at end of file
+}
+
+//Converts Count RGBA32F texels, Dest must have room for Count texels of Format
+internal void
+ConvertAtmosphereLut(f32* Source, u64 Count, atmosphere_lut_format Format, void* Dest)
+{
+    switch(Format)
+    {
+        case ATMOSPHERE_LUT_RGBA32F:
+        {
+            memcpy(Dest, Source, Count * 16);
+        } break;
+        
+        case ATMOSPHERE_LUT_RGBA16F:
+        {
+            ConvertF32ToF16Array(Source, Count * 4, (u16*)Dest);
+        } break;
+        
+        case ATMOSPHERE_LUT_R11G11B10F:
+        {
+            u32* Out = (u32*)Dest;
+            for(u64 Index = 0; Index < Count; Index++)
+            {
+                f32* Texel = Source + Index * 4;
+                Out[Index] = ConvertF32ToR11G11B10F(Texel[0], Texel[1], Texel[2]);
+            }
+        } break;
+        
+        case ATMOSPHERE_LUT_RGB9E5:
+        {
+            u32* Out = (u32*)Dest;
+            for(u64 Index = 0; Index < Count; Index++)
+            {
+                f32* Texel = Source + Index * 4;
+                Out[Index] = ConvertF32ToRGB9E5(Texel[0], Texel[1], Texel[2]);
+            }
+        } break;
+        
+        default: Assert(0);
+    }
+}
+
+//The LUTs are RGBA32F, as read back from the precomputation. Returns the file in a
+//buffer to release with Free. RGB formats asked for the scattering LUT use RGBA16F instead
+internal void*
+BuildAtmosphereFile(atmosphere_parameters* Parameters, image_data* Transmittance, image_data* Irradiance,
+                    image_3d_data* Scattering, atmosphere_lut_format* Formats, u64* OutSize)
+{
+    atmosphere_file_header Header = {};
+    Header.Magic = ATMOSPHERE_FILE_MAGIC;
+    Header.Version = ATMOSPHERE_FILE_VERSION;
+    Header.HeaderSize = sizeof(atmosphere_file_header);
+    Header.Parameters = *Parameters;
+    
+    u32 Sizes[ATMOSPHERE_LUTS_COUNT][3] = {
+        { (u32)Transmittance->Width, (u32)Transmittance->Height, 1 },
+        { (u32)Irradiance->Width, (u32)Irradiance->Height, 1 },
+        { (u32)Scattering->Width, (u32)Scattering->Height, (u32)Scattering->Depth },
+    };
+    f32* Sources[ATMOSPHERE_LUTS_COUNT] = {
+        (f32*)Transmittance->Data, (f32*)Irradiance->Data, (f32*)Scattering->Data,
+    };
+    Assert(Transmittance->Pitch == Transmittance->Width * 16 && Irradiance->Pitch == Irradiance->Width * 16);
+    Assert(Scattering->BytesPerPixel == 16);
+    
+    u64 Offset = ALIGN_UP(sizeof(atmosphere_file_header), 16);
+    for(u32 Lut = 0; Lut < ATMOSPHERE_LUTS_COUNT; Lut++)
+    {
+        atmosphere_lut_format Format = Formats[Lut];
+        if(Lut == ATMOSPHERE_SCATTERING && (Format == ATMOSPHERE_LUT_R11G11B10F || Format == ATMOSPHERE_LUT_RGB9E5))
+        {
+            Format = ATMOSPHERE_LUT_RGBA16F;
+        }
+        
+        atmosphere_lut_header* Info = &Header.Luts[Lut];
+        Info->Format = Format;
+        Info->Width = Sizes[Lut][0];
+        Info->Height = Sizes[Lut][1];
+        Info->Depth = Sizes[Lut][2];
+        Info->Offset = Offset;
+        Info->Size = (u64)Info->Width * Info->Height * Info->Depth * AtmosphereLutFormatSizes[Format];
+        Offset = ALIGN_UP(Offset + Info->Size, 16);
+    }
+    
+    u8* Result = (u8*)ZeroAlloc(Offset);
+    memcpy(Result, &Header, sizeof(Header));
+    for(u32 Lut = 0; Lut < ATMOSPHERE_LUTS_COUNT; Lut++)
+    {
+        atmosphere_lut_header* Info = &Header.Luts[Lut];
+        u64 Count = (u64)Info->Width * Info->Height * Info->Depth;
+        ConvertAtmosphereLut(Sources[Lut], Count, (atmosphere_lut_format)Info->Format, Result + Info->Offset);
+    }
+    
+    *OutSize = Offset;
+    return Result;
+}
+
+//Accepts both versions, returns false if the file is truncated or not an .atmo file
+internal b32
+ParseAtmosphereFile(void* Data, u64 Size, atmosphere_file* File)
+{
+    *File = {};
+    u8* Bytes = (u8*)Data;
+    atmosphere_file_header* Header = (atmosphere_file_header*)Data;
+    if(Size >= sizeof(atmosphere_file_header) && Header->Magic == ATMOSPHERE_FILE_MAGIC)
+    {
+        if(Header->Version > ATMOSPHERE_FILE_VERSION || Header->HeaderSize < sizeof(atmosphere_file_header))
+        {
+            return false;
+        }
+        
+        File->Version = Header->Version;
+        File->Parameters = Header->Parameters;
+        for(u32 Lut = 0; Lut < ATMOSPHERE_LUTS_COUNT; Lut++)
+        {
+            atmosphere_lut_header* Info = &Header->Luts[Lut];
+            if(Info->Format >= ATMOSPHERE_LUT_FORMATS_COUNT ||
+               Info->Size != (u64)Info->Width * Info->Height * Info->Depth * AtmosphereLutFormatSizes[Info->Format] ||
+               Info->Offset > Size || Info->Size > Size - Info->Offset)
+            {
+                return false;
+            }
+            File->Luts[Lut] = *Info;
+            File->LutData[Lut] = Bytes + Info->Offset;
+        }
+        return true;
+    }
+    
+    //Version 1, the sizes are the ones of the shaders
+    u64 Offset = ALIGN_UP(sizeof(atmosphere_parameters), 16);
+    if(Size < Offset) return false;
+    File->Version = 1;
+    memcpy(&File->Parameters, Data, sizeof(atmosphere_parameters));
+    for(u32 Lut = 0; Lut < ATMOSPHERE_LUTS_COUNT; Lut++)
+    {
+        atmosphere_lut_header* Info = &File->Luts[Lut];
+        Info->Format = ATMOSPHERE_LUT_RGBA32F;
+        Info->Width = AtmosphereLutSizes[Lut][0];
+        Info->Height = AtmosphereLutSizes[Lut][1];
+        Info->Depth = AtmosphereLutSizes[Lut][2];
+        Info->Offset = Offset;
+        Info->Size = (u64)Info->Width * Info->Height * Info->Depth * 16;
+        File->LutData[Lut] = Bytes + Offset;
+        Offset += Info->Size;
+    }
+    return Offset == Size;
+}
+
+//Files written for other LUT sizes parse but can't be sampled by the shaders
+internal b32
+HasAtmosphereShaderLutSizes(atmosphere_file* File)
+{
+    b32 Result = true;
+    for(u32 Lut = 0; Lut < ATMOSPHERE_LUTS_COUNT; Lut++)
+    {
+        atmosphere_lut_header* Info = &File->Luts[Lut];
+        Result &= Info->Width == AtmosphereLutSizes[Lut][0] && Info->Height == AtmosphereLutSizes[Lut][1] &&
+            Info->Depth == AtmosphereLutSizes[Lut][2];
+    }
+    return Result;
+}
@@ -17,6 +17,10 @@
 
 #define MAX_SCATTERING_ORDER 4
 
+// Bump when the precomputation shaders change their results, cached atmospheres computed
+// with other shaders are then computed again
+#define ATMOSPHERE_PRECOMPUTE_VERSION 1
+
 // An atmosphere layer of width 'width', and whose density is defined as
 // 'exp_term' * exp('exp_scale' * h) + 'linear_term' * h + 'constant_term',
 // clamped to [0,1], and where h is the altitude.
@@ -59,3 +63,84 @@ struct atmosphere_parameters
     float MuSMin;
     vec3 GroundAlbedo;
 };
+
+// .atmo files, the parameters and the precomputed LUTs.
+// Version 1 files have no header, they are the parameters padded to 16 bytes followed by
+// the transmittance, irradiance and scattering LUTs as RGBA32F.
+// From version 2 a header records the format, size and offset of every LUT. Only the
+// scattering LUT uses alpha, it stores the single Mie scattering, so the RGB formats
+// are only valid for the other two.
+
+#define ATMOSPHERE_FILE_MAGIC 0x4F4D5441 //"ATMO"
+#define ATMOSPHERE_FILE_VERSION 2
+
+enum atmosphere_lut
+{
+    ATMOSPHERE_TRANSMITTANCE,
+    ATMOSPHERE_IRRADIANCE,
+    ATMOSPHERE_SCATTERING,
+    
+    ATMOSPHERE_LUTS_COUNT,
+};
+
+enum atmosphere_lut_format
+{
+    ATMOSPHERE_LUT_RGBA32F,
+    ATMOSPHERE_LUT_RGBA16F,
+    ATMOSPHERE_LUT_R11G11B10F, //Unsigned, 6 bits of mantissa for red and green and 5 for blue
+    ATMOSPHERE_LUT_RGB9E5,     //Unsigned, 9 bits of mantissa per channel and a shared exponent
+    
+    ATMOSPHERE_LUT_FORMATS_COUNT,
+};
+
+u32 AtmosphereLutFormatSizes[] = {
+    16,
+    8,
+    4,
+    4,
+};
+
+static_assert(ArrayCount(AtmosphereLutFormatSizes) == ATMOSPHERE_LUT_FORMATS_COUNT);
+
+//Used by the exporter and the atmosphere cache when no formats are given
+atmosphere_lut_format AtmosphereDefaultLutFormats[ATMOSPHERE_LUTS_COUNT] = {
+    ATMOSPHERE_LUT_RGB9E5,
+    ATMOSPHERE_LUT_RGB9E5,
+    ATMOSPHERE_LUT_RGBA16F,
+};
+
+//Width, height and depth of every LUT, the shaders are compiled for these
+u32 AtmosphereLutSizes[ATMOSPHERE_LUTS_COUNT][3] = {
+    { TRANSMITTANCE_TEXTURE_WIDTH, TRANSMITTANCE_TEXTURE_HEIGHT, 1 },
+    { IRRADIANCE_TEXTURE_WIDTH, IRRADIANCE_TEXTURE_HEIGHT, 1 },
+    { SCATTERING_TEXTURE_WIDTH, SCATTERING_TEXTURE_HEIGHT, SCATTERING_TEXTURE_DEPTH },
+};
+
+struct atmosphere_lut_header
+{
+    u32 Format;
+    u32 Width;
+    u32 Height;
+    u32 Depth;
+    u64 Offset; //From the beginning of the file, tightly packed texels
+    u64 Size;
+};
+
+struct atmosphere_file_header
+{
+    u32 Magic;
+    u32 Version;
+    u32 HeaderSize;
+    u32 __padding0;
+    atmosphere_parameters Parameters;
+    atmosphere_lut_header Luts[ATMOSPHERE_LUTS_COUNT];
+};
+
+//Result of ParseAtmosphereFile, the LUTs point into the file
+struct atmosphere_file
+{
+    u32 Version;
+    atmosphere_parameters Parameters;
+    atmosphere_lut_header Luts[ATMOSPHERE_LUTS_COUNT];
+    u8* LutData[ATMOSPHERE_LUTS_COUNT];
+};
@@ -0,0 +1,316 @@
+// Cache of precomputed atmospheres, one atmo file per set of parameters in the cache
+// directory, named after the key of the parameters. The key also covers the LUT sizes,
+// the scattering order, the version of the precomputation shaders and the LUT formats,
+// so a change to any of them is a miss.
+// index.txt lists the files with the time they were last used, when there are more than
+// MAX_ATMOSPHERE_CACHE_ENTRIES the least recently used is removed. Files are checked
+// against the parameters on load, a file that is missing or doesn't match is a miss.
+
+#define ATMOSPHERE_CACHE_VERSION 2
+#define MAX_ATMOSPHERE_CACHE_ENTRIES 16
+#define ATMOSPHERE_CACHE_NAME_LENGTH 64
+#define ATMOSPHERE_CACHE_DEFAULT_DIRECTORY "../res/atmosphere_cache"
+
+struct atmosphere_cache_entry
+{
+    u64 Key;
+    u64 LastUse;
+    u64 Size;
+    char Name[ATMOSPHERE_CACHE_NAME_LENGTH]; //Only for the index, can't contain spaces
+};
+
+struct atmosphere_cache
+{
+    char Directory[512];
+    atmosphere_cache_entry Entries[MAX_ATMOSPHERE_CACHE_ENTRIES];
+    u32 EntriesCount;
+    u64 UseCounter;
+    
+    u32 HitsCount;
+    u32 MissesCount;
+};
+
+//The padding is never read by the shaders, it must not change the key
+internal atmosphere_parameters
+ClearAtmosphereParametersPadding(atmosphere_parameters* Parameters)
+{
+    atmosphere_parameters Result = *Parameters;
+    Result.__padding0 = 0.0f;
+    Result.__padding1 = 0.0f;
+    Result.__padding2 = 0.0f;
+    return Result;
+}
+
+internal u64
+GetAtmosphereCacheKey(atmosphere_parameters* Parameters, atmosphere_lut_format* Formats)
+{
+    struct
+    {
+        u32 CacheVersion;
+        u32 FileVersion;
+        u32 PrecomputeVersion;
+        u32 TransmittanceSize[2];
+        u32 IrradianceSize[2];
+        u32 ScatteringSize[4]; //R, Mu, MuS and Nu
+        u32 MaxScatteringOrder;
+        u32 Formats[ATMOSPHERE_LUTS_COUNT];
+    } Settings = {};
+    Settings.CacheVersion = ATMOSPHERE_CACHE_VERSION;
+    Settings.FileVersion = ATMOSPHERE_FILE_VERSION;
+    Settings.PrecomputeVersion = ATMOSPHERE_PRECOMPUTE_VERSION;
+    Settings.TransmittanceSize[0] = TRANSMITTANCE_TEXTURE_WIDTH;
+    Settings.TransmittanceSize[1] = TRANSMITTANCE_TEXTURE_HEIGHT;
+    Settings.IrradianceSize[0] = IRRADIANCE_TEXTURE_WIDTH;
+    Settings.IrradianceSize[1] = IRRADIANCE_TEXTURE_HEIGHT;
+    Settings.ScatteringSize[0] = SCATTERING_TEXTURE_R_SIZE;
+    Settings.ScatteringSize[1] = SCATTERING_TEXTURE_MU_SIZE;
+    Settings.ScatteringSize[2] = SCATTERING_TEXTURE_MU_S_SIZE;
+    Settings.ScatteringSize[3] = SCATTERING_TEXTURE_NU_SIZE;
+    Settings.MaxScatteringOrder = MAX_SCATTERING_ORDER;
+    for(u32 Lut = 0; Lut < ATMOSPHERE_LUTS_COUNT; Lut++)
+    {
+        Settings.Formats[Lut] = Formats[Lut];
+    }
+    
+    atmosphere_parameters Hashed = ClearAtmosphereParametersPadding(Parameters);
+    u64 Hash = HashBytes(ASSET_HASH_OFFSET_BASIS, &Settings, sizeof(Settings));
+    Hash = HashBytes(Hash, &Hashed, sizeof(Hashed));
+    return Hash;
+}
+
+internal void
+GetAtmosphereCachePath(atmosphere_cache* Cache, u64 Key, char* Path, u32 PathSize)
+{
+    snprintf(Path, PathSize, "%s/%016llx.atmo", Cache->Directory, (unsigned long long)Key);
+}
+
+internal atmosphere_cache_entry*
+FindAtmosphereCacheEntry(atmosphere_cache* Cache, u64 Key)
+{
+    for(u32 Index = 0; Index < Cache->EntriesCount; Index++)
+    {
+        if(Cache->Entries[Index].Key == Key)
+        {
+            return &Cache->Entries[Index];
+        }
+    }
+    return 0;
+}
+
+internal void
+RemoveAtmosphereCacheEntry(atmosphere_cache* Cache, atmosphere_cache_entry* Entry)
+{
+    char Path[1024];
+    GetAtmosphereCachePath(Cache, Entry->Key, Path, sizeof(Path));
+    remove(Path);
+    
+    *Entry = Cache->Entries[--Cache->EntriesCount];
+}
+
+//Written next to the index and moved over it, so a crash never leaves half an index
+internal b32
+WriteAtmosphereCacheIndex(atmosphere_cache* Cache)
+{
+    char Path[1024], TempPath[1024];
+    snprintf(Path, sizeof(Path), "%s/index.txt", Cache->Directory);
+    snprintf(TempPath, sizeof(TempPath), "%s/index.tmp", Cache->Directory);
+    FILE* File = fopen(TempPath, "wb");
+    if(!File) return false;
+    
+    fprintf(File, "# key last_use size name\n");
+    for(u32 Index = 0; Index < Cache->EntriesCount; Index++)
+    {
+        atmosphere_cache_entry* Entry = &Cache->Entries[Index];
+        fprintf(File, "%016llx %llu %llu %s\n", (unsigned long long)Entry->Key, (unsigned long long)Entry->LastUse,
+                (unsigned long long)Entry->Size, Entry->Name[0] ? Entry->Name : "-");
+    }
+    if(fclose(File) != 0) return false;
+    
+    return Platform_MoveFile(TempPath, Path);
+}
+
+//Creates the directory if needed, returns false if it can't be used. The cache is empty
+//if the index is missing
+internal b32
+OpenAtmosphereCache(atmosphere_cache* Cache, char* Directory = ATMOSPHERE_CACHE_DEFAULT_DIRECTORY)
+{
+    *Cache = {};
+    snprintf(Cache->Directory, sizeof(Cache->Directory), "%s", Directory);
+    if(!Platform_CreateDirectory(Cache->Directory)) return false;
+    
+    char Path[1024];
+    snprintf(Path, sizeof(Path), "%s/index.txt", Cache->Directory);
+    FILE* File = fopen(Path, "rb");
+    if(!File) return true;
+    
+    char Line[1024];
+    while(fgets(Line, sizeof(Line), File) && Cache->EntriesCount < MAX_ATMOSPHERE_CACHE_ENTRIES)
+    {
+        char Name[ATMOSPHERE_CACHE_NAME_LENGTH] = {};
+        unsigned long long Key = 0, LastUse = 0, Size = 0;
+        if(sscanf(Line, "%llx %llu %llu %63s", &Key, &LastUse, &Size, Name) != 4) continue;
+        if(strcmp(Name, "-") == 0) Name[0] = 0;
+        
+        atmosphere_cache_entry* Entry = &Cache->Entries[Cache->EntriesCount++];
+        Entry->Key = Key;
+        Entry->LastUse = LastUse;
+        Entry->Size = Size;
+        memcpy(Entry->Name, Name, sizeof(Name));
+        Cache->UseCounter = MAX(Cache->UseCounter, LastUse);
+    }
+    fclose(File);
+    
+    return true;
+}
+
+//Returns the atmo file for the parameters, to release with Free, or 0 on a miss
+internal void*
+LoadCachedAtmosphere(atmosphere_cache* Cache, atmosphere_parameters* Parameters, atmosphere_lut_format* Formats,
+                     u64* OutSize)
+{
+    u64 Key = GetAtmosphereCacheKey(Parameters, Formats);
+    atmosphere_cache_entry* Entry = FindAtmosphereCacheEntry(Cache, Key);
+    if(!Entry)
+    {
+        Cache->MissesCount++;
+        return 0;
+    }
+    
+    char Path[1024];
+    GetAtmosphereCachePath(Cache, Key, Path, sizeof(Path));
+    platform_file File = Platform_OpenFileForReading(Path);
+    void* Data = 0;
+    u64 Size = 0;
+    if(File != PLATFORM_INVALID_FILE)
+    {
+        Size = Platform_GetFileSize(File);
+        Data = ZeroAlloc(Size);
+        if(Size != Entry->Size || !Platform_ReadAtOffset(File, Data, Size, 0))
+        {
+            Free(Data);
+            Data = 0;
+        }
+        Platform_CloseFile(File);
+    }
+    
+    //A file written by another build or damaged is dropped and computed again
+    atmosphere_file Parsed;
+    b32 Valid = Data && ParseAtmosphereFile(Data, Size, &Parsed) && Parsed.Version == ATMOSPHERE_FILE_VERSION &&
+        HasAtmosphereShaderLutSizes(&Parsed);
+    if(Valid)
+    {
+        atmosphere_parameters Expected = ClearAtmosphereParametersPadding(Parameters);
+        atmosphere_parameters Stored = ClearAtmosphereParametersPadding(&Parsed.Parameters);
+        Valid = memcmp(&Stored, &Expected, sizeof(atmosphere_parameters)) == 0;
+    }
+    if(!Valid)
+    {
+        Free(Data);
+        RemoveAtmosphereCacheEntry(Cache, Entry);
+        WriteAtmosphereCacheIndex(Cache);
+        Cache->MissesCount++;
+        return 0;
+    }
+    
+    Entry->LastUse = ++Cache->UseCounter;
+    WriteAtmosphereCacheIndex(Cache);
+    Cache->HitsCount++;
+    
+    *OutSize = Size;
+    return Data;
+}
+
+//Data is the atmo file built from the parameters with these formats. Returns false if it
+//couldn't be written, the cache is unchanged then
+internal b32
+StoreCachedAtmosphere(atmosphere_cache* Cache, atmosphere_parameters* Parameters, atmosphere_lut_format* Formats,
+                      char* Name, void* Data, u64 Size)
+{
+    u64 Key = GetAtmosphereCacheKey(Parameters, Formats);
+    char Path[1024], TempPath[1024];
+    GetAtmosphereCachePath(Cache, Key, Path, sizeof(Path));
+    snprintf(TempPath, sizeof(TempPath), "%s/%016llx.tmp", Cache->Directory, (unsigned long long)Key);
+    
+    FILE* File = fopen(TempPath, "wb");
+    if(!File) return false;
+    b32 Written = fwrite(Data, 1, Size, File) == Size;
+    Written = fclose(File) == 0 && Written;
+    if(!Written || !Platform_MoveFile(TempPath, Path))
+    {
+        remove(TempPath);
+        return false;
+    }
+    
+    atmosphere_cache_entry* Entry = FindAtmosphereCacheEntry(Cache, Key);
+    if(!Entry)
+    {
+        if(Cache->EntriesCount == MAX_ATMOSPHERE_CACHE_ENTRIES)
+        {
+            atmosphere_cache_entry* Oldest = &Cache->Entries[0];
+            for(u32 Index = 1; Index < Cache->EntriesCount; Index++)
+            {
+                if(Cache->Entries[Index].LastUse < Oldest->LastUse) Oldest = &Cache->Entries[Index];
+            }
+            RemoveAtmosphereCacheEntry(Cache, Oldest);
+        }
+        Entry = &Cache->Entries[Cache->EntriesCount++];
+    }
+    
+    Entry->Key = Key;
+    Entry->LastUse = ++Cache->UseCounter;
+    Entry->Size = Size;
+    snprintf(Entry->Name, sizeof(Entry->Name), "%s", Name ? Name : "");
+    for(char* At = Entry->Name; *At; At++)
+    {
+        if(*At == ' ') *At = '_';
+    }
+    
+    return WriteAtmosphereCacheIndex(Cache);
+}
+
+//Adds the entry for the parameters from a shipped atmo file, like res/earth.atmo, when a
+//lookup misses. The file is only used if it was computed from the same parameters with
+//float LUTs of the sizes of the shaders, they are converted to Formats. Returns the entry
+//like LoadCachedAtmosphere, or 0 if the file can't be used
+internal void*
+SeedCachedAtmosphere(atmosphere_cache* Cache, atmosphere_parameters* Parameters, atmosphere_lut_format* Formats,
+                     char* Path, char* Name, u64* OutSize)
+{
+    platform_file File = Platform_OpenFileForReading(Path);
+    if(File == PLATFORM_INVALID_FILE) return 0;
+    
+    u64 Size = Platform_GetFileSize(File);
+    void* Data = ZeroAlloc(MAX(Size, 1));
+    b32 Usable = Platform_ReadAtOffset(File, Data, Size, 0);
+    Platform_CloseFile(File);
+    
+    atmosphere_file Parsed;
+    Usable = Usable && ParseAtmosphereFile(Data, Size, &Parsed);
+    if(Usable)
+    {
+        atmosphere_parameters Expected = ClearAtmosphereParametersPadding(Parameters);
+        atmosphere_parameters Stored = ClearAtmosphereParametersPadding(&Parsed.Parameters);
+        Usable = memcmp(&Stored, &Expected, sizeof(atmosphere_parameters)) == 0 && HasAtmosphereShaderLutSizes(&Parsed);
+        for(u32 Lut = 0; Lut < ATMOSPHERE_LUTS_COUNT; Lut++)
+        {
+            Usable &= Parsed.Luts[Lut].Format == ATMOSPHERE_LUT_RGBA32F;
+        }
+    }
+    if(!Usable)
+    {
+        Free(Data);
+        return 0;
+    }
+    
+    image_data Transmittance = CreateImage(Parsed.LutData[ATMOSPHERE_TRANSMITTANCE], TRANSMITTANCE_TEXTURE_WIDTH,
+                                           TRANSMITTANCE_TEXTURE_HEIGHT, TRANSMITTANCE_TEXTURE_WIDTH * 16, 16);
+    image_data Irradiance = CreateImage(Parsed.LutData[ATMOSPHERE_IRRADIANCE], IRRADIANCE_TEXTURE_WIDTH,
+                                        IRRADIANCE_TEXTURE_HEIGHT, IRRADIANCE_TEXTURE_WIDTH * 16, 16);
+    image_3d_data Scattering = CreateImage3D(Parsed.LutData[ATMOSPHERE_SCATTERING], SCATTERING_TEXTURE_WIDTH,
+                                             SCATTERING_TEXTURE_HEIGHT, SCATTERING_TEXTURE_DEPTH, 16);
+    void* Result = BuildAtmosphereFile(Parameters, &Transmittance, &Irradiance, &Scattering, Formats, OutSize);
+    Free(Data);
+    
+    StoreCachedAtmosphere(Cache, Parameters, Formats, Name, Result, *OutSize);
+    return Result;
+}
@@ -0,0 +1,1242 @@
+// Linux microbenchmarks for the asset pipeline.
+//
+// Usage: benchmark reads <archive> [-size GB] [-batch MB]
+//   Compares reading every entry of an archive with one Platform_ReadAtOffset each, like
+//   ReadAssetData does, against ReadAssetEntries batches (io_uring and O_DIRECT) of up to
+//   -batch MB, 512 by default. Entries bigger than that are read in a batch of their own.
+//   If the archive doesn't exist a synthetic one of about -size GB is written first, with
+//   a mix of small and large entries and, from 5GB, one entry bigger than 4GB.
+//   The archive is dropped from the page cache before every run so all reads are cold.
+//
+// Usage: benchmark residency [-textures N] [-budget MB] [-frames N]
+//   Runs the texture residency policy over a scene of 2048x2048 BC7 textures seen through
+//   a window that sweeps across them, restores complete the frame after they are issued.
+//   The default budget of 64MB is below the working set so mips are dropped and restored.
+//   Fails if the resident bytes go over budget or stop matching the mips of the textures,
+//   or if a texture is missing a resident mip after a restore.
+//
+// Usage: benchmark atmosphere [-dir path] [-presets N]
+//   Looks up N atmosphere presets in the atmosphere cache at -dir, atmosphere_cache by
+//   default, twice. Misses build the file and store it, the second pass should only hit
+//   while N fits in the cache. Then one file is damaged to check it's dropped, and a
+//   version 1 file is checked to only seed the entry of its own parameters.
+//
+// Usage: benchmark meshes [-archive path] [-cache N]
+//   Runs the vertex cache, overdraw and vertex fetch passes of OptimizeMesh over grids in
+//   order and shuffled, then over every mesh of the archive, printing ACMR and ATVR for a
+//   FIFO cache of N vertices, 16 by default, and the time of every pass.
+//
+// Usage: benchmark interleave [-vertices N] [-runs N]
+//   Interleaves the shading attributes of N random vertices for MESH_INTERLEAVED meshes,
+//   checks the result against the source attributes and prints the speed.
+//
+// Usage: benchmark quantize [-archive path]
+//   Quantizes the vertices of a grid, then of every mesh of the archive, like the packer
+//   does for MESH_QUANTIZED meshes, decodes them back and prints the largest error of every
+//   attribute, the time of both ways and the size of the vertex streams. Archive meshes
+//   that are already quantized are decoded from their stored streams.
+//
+// Usage: benchmark indices [-runs N]
+//   Converts the strip of AllocSphereMesh to an optimized list, then packs the indices of
+//   grids just under and over the 16 bit limit N times, checking them against the source
+//   and printing the size of the index buffer and the speed of the packing.
+//
+// Usage: benchmark meshlets [-size N] [-archive path]
+//   Builds the meshlets of an optimized NxN grid, 1024 by default, and of every mesh of the
+//   archive twice, checking that both builds match, that every triangle is kept once and
+//   that limits and bounds hold. Then culls them from cameras around and inside the mesh,
+//   printing the triangles kept against the ones a test per triangle keeps, and checking
+//   that no culled meshlet had a visible triangle. Culling runs for both windings, the
+//   renderer culls the meshlets facing the eye since its front faces are clockwise.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+#include <float.h>
+#include <limits.h>
+#include <immintrin.h>
+
+#include "defines.h"
+#include "platform.h"
+
+#include "math/math.cpp"
+#include "math/math_vec.cpp"
+#include "math/math_mat.cpp"
+#include "math/math_quaternion.cpp"
+
+#include "geometry.cpp"
+#include "mesh.cpp"
+#include "image.cpp"
+#include "vertex_quantization.cpp"
+#include "atmosphere.cpp"
+#include "memory_arena.cpp"
+#include "work_queue.cpp"
+#include "texture_residency.cpp"
+
+#include "asset_file.h"
+#include "asset_compression.cpp"
+#include "asset_loader.cpp"
+#include "atmosphere_cache.cpp"
+#include "linux.cpp"
+
+//Every 8 bytes of a payload are its offset in the file, so reads can be checked
+internal u64
+ChecksumPayload(u8* Data, u64 Size, u64 Offset)
+{
+    u64 Errors = 0;
+    Assert(Offset % 8 == 0);
+    for(u64 At = 0; At + 8 <= Size; At += 8)
+    {
+        Errors += *(u64*)(Data + At) != Offset + At;
+    }
+    return Errors;
+}
+
+internal b32
+WriteSyntheticArchive(char* Path, u64 TotalSize)
+{
+    //Mostly texture sized entries with a few big ones, like cubemaps and LUTs
+    u64 Count = 0;
+    u64 Sizes[4096];
+    u64 Remaining = TotalSize;
+    u32 Seed = 12345;
+    if(TotalSize >= Gigabytes(5))
+    {
+        Sizes[Count++] = Gigabytes(4) + Megabytes(100) + 123;
+        Remaining -= Sizes[0];
+    }
+    while(Remaining && Count < ArrayCount(Sizes))
+    {
+        Seed = Seed * 1664525 + 1013904223;
+        u64 Size = (Seed >> 8) % 16 == 0 ? Megabytes(64) + (Seed % Megabytes(192)) : Kilobytes(64) + (Seed % Megabytes(4));
+        Size = MIN(Size, Remaining);
+        Sizes[Count++] = Size;
+        Remaining -= Size;
+    }
+    
+    u64 SlotsCount = GetAssetIndexSlotsCount(Count);
+    asset_table_entry* Table = (asset_table_entry*)ZeroAlloc(sizeof(asset_table_entry) * Count);
+    asset_index_slot* Slots = (asset_index_slot*)ZeroAlloc(sizeof(asset_index_slot) * SlotsCount);
+    
+    //Same layout as the packer
+    u64 Offset = sizeof(asset_file_header) + sizeof(asset_table_entry) * Count +
+        sizeof(asset_index_header) + sizeof(asset_index_slot) * SlotsCount;
+    for(u64 Index = 0; Index < Count; Index++)
+    {
+        asset_table_entry* Entry = &Table[Index];
+        b32 DirectRead = Sizes[Index] >= ASSET_DIRECT_READ_MIN_SIZE;
+        Offset = ALIGN_UP(Offset, DirectRead ? PLATFORM_DIRECT_READ_ALIGNMENT : 64);
+        snprintf(Entry->Name, ASSET_NAME_LENGTH, "entry%llu", (unsigned long long)Index);
+        Entry->Type = ASSET_NONE;
+        Entry->Offset = Offset;
+        Entry->Size = Sizes[Index];
+        Entry->StoredSize = Sizes[Index];
+        Entry->Hash = AssetHash(Entry->Name);
+        Offset += Sizes[Index];
+    }
+    BuildAssetIndex(Table, Count, Slots, SlotsCount);
+    
+    FILE* File = fopen(Path, "wb");
+    if(!File) return false;
+    
+    asset_file_header Header = {};
+    Header.Magic = ASSET_FILE_MAGIC;
+    Header.Version = ASSET_FILE_VERSION;
+    Header.TableEntryCount = Count;
+    asset_index_header IndexHeader = {};
+    IndexHeader.SlotsCount = SlotsCount;
+    
+    b32 Success = fwrite(&Header, sizeof(Header), 1, File) == 1;
+    Success = Success && fwrite(Table, sizeof(asset_table_entry), Count, File) == Count;
+    Success = Success && fwrite(&IndexHeader, sizeof(IndexHeader), 1, File) == 1;
+    Success = Success && fwrite(Slots, sizeof(asset_index_slot), SlotsCount, File) == SlotsCount;
+    
+    //Written in 8MB blocks of the offset pattern, padding included. The table and the
+    //index are a multiple of 8 bytes so the pattern stays aligned to the file
+    u64 BlockSize = Megabytes(8);
+    u64* Block = (u64*)ZeroAlloc(BlockSize);
+    for(u64 At = (u64)ftell(File); At < Offset && Success; At += BlockSize)
+    {
+        Assert(At % 8 == 0);
+        u64 Size = MIN(BlockSize, Offset - At);
+        for(u64 Word = 0; Word < BlockSize / 8; Word++)
+        {
+            Block[Word] = At + Word * 8;
+        }
+        Success = fwrite(Block, 1, Size, File) == Size;
+    }
+    
+    Success = fclose(File) == 0 && Success;
+    Free(Block);
+    Free(Slots);
+    Free(Table);
+    return Success;
+}
+
+internal void
+DropFromPageCache(asset_archive* Archive)
+{
+    posix_fadvise(Archive->File, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+internal void
+BenchmarkReads(char* Path, u64 TotalSize, u64 BatchSize)
+{
+    asset_archive Archive = {};
+    if(!OpenAssetArchive(&Archive, Path, false))
+    {
+        printf("Writing synthetic archive %s of %.1f GB\n", Path, (f64)TotalSize / Gigabytes(1));
+        if(!WriteSyntheticArchive(Path, TotalSize) || !OpenAssetArchive(&Archive, Path, false))
+        {
+            fprintf(stderr, "Cannot create %s\n", Path);
+            return;
+        }
+    }
+    
+    u32 Count = (u32)Archive.Table.Count;
+    u64 Bytes = 0;
+    asset_table_entry** Entries = (asset_table_entry**)ZeroAlloc(sizeof(asset_table_entry*) * Count);
+    u8** Stored = (u8**)ZeroAlloc(sizeof(u8*) * Count);
+    for(u32 Index = 0; Index < Count; Index++)
+    {
+        Entries[Index] = &Archive.Table.Entries[Index];
+        Bytes += Entries[Index]->StoredSize;
+    }
+    printf("%u entries, %.1f MB, direct reads %s\n", Count, (f64)Bytes / Megabytes(1),
+           Archive.DirectFile != PLATFORM_INVALID_FILE ? "supported" : "not supported");
+    
+    //Baseline, one blocking read per entry. Only the reads are timed
+    DropFromPageCache(&Archive);
+    u64 Errors = 0;
+    u64 Microseconds = 0;
+    for(u32 Index = 0; Index < Count; Index++)
+    {
+        asset_table_entry* Entry = Entries[Index];
+        u8* Data = (u8*)Platform_AllocateMemory(Entry->StoredSize);
+        u64 Begin = Platform_GetMicroseconds();
+        b32 Success = Platform_ReadAtOffset(Archive.File, Data, Entry->StoredSize, Entry->Offset);
+        Microseconds += Platform_GetMicroseconds() - Begin;
+        Errors += !Success + ChecksumPayload(Data, Entry->StoredSize, Entry->Offset);
+        Platform_FreeMemory(Data, Entry->StoredSize);
+    }
+    f64 Seconds = (f64)Microseconds / 1000000.0;
+    printf("pread:            %8.3f s %8.1f MB/s %llu errors\n", Seconds, (f64)Bytes / Megabytes(1) / Seconds, (unsigned long long)Errors);
+    
+    //The same reads in batches of up to BatchSize bytes, so that they fit in memory
+    DropFromPageCache(&Archive);
+    Errors = 0;
+    Microseconds = 0;
+    for(u32 First = 0; First < Count;)
+    {
+        u32 End = First + 1;
+        u64 Size = Entries[First]->StoredSize;
+        while(End < Count && Size + Entries[End]->StoredSize <= BatchSize)
+        {
+            Size += Entries[End++]->StoredSize;
+        }
+        
+        u64 Begin = Platform_GetMicroseconds();
+        b32 Success = ReadAssetEntries(&Archive, Entries + First, End - First, Stored + First);
+        Microseconds += Platform_GetMicroseconds() - Begin;
+        Errors += !Success;
+        for(u32 Index = First; Index < End; Index++)
+        {
+            Errors += ChecksumPayload(Stored[Index], Entries[Index]->StoredSize, Entries[Index]->Offset);
+            Platform_FreeMemory(Stored[Index], Entries[Index]->StoredSize);
+        }
+        First = End;
+    }
+    Seconds = (f64)Microseconds / 1000000.0;
+    printf("ReadAssetEntries: %8.3f s %8.1f MB/s %llu errors\n", Seconds, (f64)Bytes / Megabytes(1) / Seconds, (unsigned long long)Errors);
+    
+    Free(Stored);
+    Free(Entries);
+}
+
+//Stands for the data of a mip in the benchmark, 0 when the mip is not loaded
+internal u32
+GetResidencyMipSignature(u32 Id, u32 Mip)
+{
+    return (Id << 8 | Mip) + 1;
+}
+
+//Resident mips must hold the data of their texture and the others none, the bytes of
+//a texture being restored are the ones reserved for it
+internal b32
+CheckResidentTexture(texture_residency* Residency, u32 (*Contents)[RESIDENCY_MAX_MIPS], u32 Id, u64* Bytes)
+{
+    resident_texture* Texture = &Residency->Textures[Id];
+    b32 Result = true;
+    for(u32 Mip = 0; Mip < Texture->MipsCount; Mip++)
+    {
+        u32 Expected = Mip >= Texture->FirstMip ? GetResidencyMipSignature(Id, Mip) : 0;
+        Result &= Contents[Id][Mip] == Expected;
+    }
+    
+    *Bytes += GetResidentTextureBytes(Texture, Texture->Restoring ? Texture->RestoreMip : Texture->FirstMip);
+    return Result;
+}
+
+internal b32
+BenchmarkResidency(u32 TexturesCount, u64 Budget, u32 FramesCount)
+{
+    texture_residency* Residency = (texture_residency*)ZeroAlloc(sizeof(texture_residency));
+    InitTextureResidency(Residency, Budget);
+    
+    //Textures start with their tail only, as streamed by StreamMaterialFromAssetFile
+    TexturesCount = MIN(TexturesCount, MAX_RESIDENT_TEXTURES - 1);
+    u32 MipsCount = GetImageMipsCount(2048, 2048);
+    u32 TailMip = GetImageFirstMipForSize(2048, 2048, MipsCount, IMAGE_BC7, RESIDENCY_MIN_MIP_SIZE);
+    u32 (*Contents)[RESIDENCY_MAX_MIPS] = (u32 (*)[RESIDENCY_MAX_MIPS])ZeroAlloc(sizeof(u32) * RESIDENCY_MAX_MIPS * MAX_RESIDENT_TEXTURES);
+    for(u32 Index = 0; Index < TexturesCount; Index++)
+    {
+        u32 Id = AddResidentTexture(Residency, 2048, 2048, 0, IMAGE_BC7, MipsCount, TailMip);
+        for(u32 Mip = TailMip; Mip < MipsCount; Mip++)
+        {
+            Contents[Id][Mip] = GetResidencyMipSignature(Id, Mip);
+        }
+    }
+    
+    //A quarter of the textures is visible, the window moves by one texture every 8 frames.
+    //Visible textures need mips 0 to 3 depending on the texture
+    u32 Visible = MAX(TexturesCount / 4, 1);
+    u64 WorkingSet = 0;
+    for(u32 Id = 1; Id < Residency->TexturesCount; Id++)
+    {
+        u32 WantedMip = (Id - 1) < Visible ? Id % 4 : TailMip;
+        WorkingSet += GetResidentTextureBytes(&Residency->Textures[Id], WantedMip);
+    }
+    
+    u32 Counts[3] = {};
+    u64 MaxResident = 0;
+    u32 FramesOverBudget = 0;
+    u32 AccountingErrors = 0;
+    u32 RestoreErrors = 0;
+    u32 ContentErrors = 0;
+    residency_action Pending[MAX_RESIDENT_TEXTURES];
+    u32 PendingCount = 0;
+    u64 Begin = Platform_GetMicroseconds();
+    for(u32 Frame = 0; Frame < FramesCount; Frame++)
+    {
+        //Restores load every mip from the one asked for down, like RequestImageMipsLoad
+        for(u32 Index = 0; Index < PendingCount; Index++)
+        {
+            u32 Id = Pending[Index].Texture;
+            for(u32 Mip = Pending[Index].FirstMip; Mip < MipsCount; Mip++)
+            {
+                Contents[Id][Mip] = GetResidencyMipSignature(Id, Mip);
+            }
+            CompleteTextureRestore(Residency, Id, true, Pending[Index].FirstMip);
+            
+            u64 Ignored = 0;
+            RestoreErrors += Residency->Textures[Id].FirstMip != Pending[Index].FirstMip ||
+                !CheckResidentTexture(Residency, Contents, Id, &Ignored);
+        }
+        PendingCount = 0;
+        
+        u32 First = Frame / 8;
+        for(u32 Index = 0; Index < Visible; Index++)
+        {
+            u32 Id = 1 + (First + Index) % TexturesCount;
+            MarkTextureUsed(Residency, Id, (f32)(1 << (Id % 4)) / 2048.0f);
+        }
+        
+        residency_action Actions[64];
+        u32 ActionsCount = UpdateTextureResidency(Residency, Actions, ArrayCount(Actions));
+        for(u32 Index = 0; Index < ActionsCount; Index++)
+        {
+            residency_action* Action = &Actions[Index];
+            Counts[Action->Kind]++;
+            if(Action->Kind == RESIDENCY_RESTORE)
+            {
+                Pending[PendingCount++] = *Action;
+            }
+            else
+            {
+                u32 FirstMip = Action->Kind == RESIDENCY_EVICT ? MipsCount : Action->FirstMip;
+                for(u32 Mip = 0; Mip < FirstMip; Mip++)
+                {
+                    Contents[Action->Texture][Mip] = 0;
+                }
+            }
+        }
+        
+        u64 Bytes = 0;
+        for(u32 Id = 1; Id < Residency->TexturesCount; Id++)
+        {
+            ContentErrors += !CheckResidentTexture(Residency, Contents, Id, &Bytes);
+        }
+        AccountingErrors += Bytes != Residency->ResidentBytes;
+        
+        MaxResident = MAX(MaxResident, Residency->ResidentBytes);
+        FramesOverBudget += Residency->ResidentBytes > Residency->Budget;
+    }
+    f64 Microseconds = (f64)(Platform_GetMicroseconds() - Begin);
+    
+    u32 FullTextures = 0;
+    u32 FirstMips = 0;
+    for(u32 Id = 1; Id < Residency->TexturesCount; Id++)
+    {
+        FullTextures += Residency->Textures[Id].FirstMip == 0;
+        FirstMips += Residency->Textures[Id].FirstMip;
+    }
+    printf("%u textures, %u visible, budget %.1f MB, working set %.1f MB, %u frames, %.2f us per update\n",
+           TexturesCount, Visible, (f64)Budget / Megabytes(1), (f64)WorkingSet / Megabytes(1), FramesCount,
+           Microseconds / FramesCount);
+    printf("drops %u, evictions %u, restores %u, %.1f MB dropped, %.1f MB restored\n",
+           Counts[RESIDENCY_DROP_MIPS], Counts[RESIDENCY_EVICT], Counts[RESIDENCY_RESTORE],
+           (f64)Residency->DroppedBytes / Megabytes(1), (f64)Residency->RestoredBytes / Megabytes(1));
+    printf("max resident %.1f MB, %u frames over budget, %u textures at full resolution, average first mip %.2f\n",
+           (f64)MaxResident / Megabytes(1), FramesOverBudget, FullTextures, (f64)FirstMips / MAX(TexturesCount, 1));
+    printf("%u frames with wrong resident bytes, %u texture frames with wrong mips, %u bad restores\n",
+           AccountingErrors, ContentErrors, RestoreErrors);
+    
+    b32 Passed = !FramesOverBudget && !AccountingErrors && !ContentErrors && !RestoreErrors;
+    printf("%s\n", Passed ? "passed" : "FAILED");
+    
+    Free(Contents);
+    Free(Residency);
+    return Passed;
+}
+
+//Presets differ by their Mie anisotropy. Without a GPU the LUTs are random and building
+//the file stands for the precomputation. The cache is opened again before the second
+//pass, like on the next run of the editor
+internal void
+BenchmarkAtmosphereCache(char* Directory, u32 PresetsCount)
+{
+    u32 TransmittanceCount = TRANSMITTANCE_TEXTURE_WIDTH * TRANSMITTANCE_TEXTURE_HEIGHT;
+    u32 IrradianceCount = IRRADIANCE_TEXTURE_WIDTH * IRRADIANCE_TEXTURE_HEIGHT;
+    u32 ScatteringCount = SCATTERING_TEXTURE_WIDTH * SCATTERING_TEXTURE_HEIGHT * SCATTERING_TEXTURE_DEPTH;
+    f32* Texels = (f32*)ZeroAlloc(sizeof(f32) * 4 * (TransmittanceCount + IrradianceCount + ScatteringCount));
+    for(u32 Index = 0; Index < 4 * (TransmittanceCount + IrradianceCount + ScatteringCount); Index++)
+    {
+        Texels[Index] = (f32)rand() / RAND_MAX * 2.0f;
+    }
+    image_data Transmittance = CreateImage(Texels, TRANSMITTANCE_TEXTURE_WIDTH, TRANSMITTANCE_TEXTURE_HEIGHT,
+                                           TRANSMITTANCE_TEXTURE_WIDTH * 16, 16);
+    image_data Irradiance = CreateImage(Texels + 4 * TransmittanceCount, IRRADIANCE_TEXTURE_WIDTH, IRRADIANCE_TEXTURE_HEIGHT,
+                                        IRRADIANCE_TEXTURE_WIDTH * 16, 16);
+    image_3d_data Scattering = CreateImage3D(Texels + 4 * (TransmittanceCount + IrradianceCount), SCATTERING_TEXTURE_WIDTH,
+                                             SCATTERING_TEXTURE_HEIGHT, SCATTERING_TEXTURE_DEPTH, 16);
+    
+    atmosphere_cache* Cache = (atmosphere_cache*)ZeroAlloc(sizeof(atmosphere_cache));
+    atmosphere_parameters Parameters = GetEarthAtmosphereParameters();
+    for(u32 Pass = 0; Pass < 2; Pass++)
+    {
+        if(!OpenAtmosphereCache(Cache, Directory))
+        {
+            fprintf(stderr, "Cannot use %s\n", Directory);
+            break;
+        }
+        
+        u32 Errors = 0;
+        u64 LoadMicroseconds = 0;
+        u64 BuildMicroseconds = 0;
+        u64 Bytes = 0;
+        for(u32 Index = 0; Index < PresetsCount; Index++)
+        {
+            Parameters.MieG = 0.5f + 0.4f * (f32)Index / PresetsCount;
+            
+            u64 Size = 0;
+            u64 Begin = Platform_GetMicroseconds();
+            void* File = LoadCachedAtmosphere(Cache, &Parameters, AtmosphereDefaultLutFormats, &Size);
+            LoadMicroseconds += Platform_GetMicroseconds() - Begin;
+            if(!File)
+            {
+                Begin = Platform_GetMicroseconds();
+                File = BuildAtmosphereFile(&Parameters, &Transmittance, &Irradiance, &Scattering,
+                                           AtmosphereDefaultLutFormats, &Size);
+                BuildMicroseconds += Platform_GetMicroseconds() - Begin;
+                
+                char Name[32];
+                snprintf(Name, sizeof(Name), "preset_%u", Index);
+                Errors += !StoreCachedAtmosphere(Cache, &Parameters, AtmosphereDefaultLutFormats, Name, File, Size);
+            }
+            
+            atmosphere_file Parsed;
+            Errors += !ParseAtmosphereFile(File, Size, &Parsed) || Parsed.Parameters.MieG != Parameters.MieG;
+            Bytes += Size;
+            Free(File);
+        }
+        printf("pass %u: %u presets, %u hits, %u misses, %.2f ms loading, %.2f ms building, %.1f MB, %u errors\n",
+               Pass, PresetsCount, Cache->HitsCount, Cache->MissesCount, (f64)LoadMicroseconds / 1000.0,
+               (f64)BuildMicroseconds / 1000.0, (f64)Bytes / Megabytes(1), Errors);
+    }
+    
+    //A file cut short is a miss and leaves the cache
+    u64 Key = GetAtmosphereCacheKey(&Parameters, AtmosphereDefaultLutFormats);
+    if(FindAtmosphereCacheEntry(Cache, Key))
+    {
+        char Path[1024];
+        GetAtmosphereCachePath(Cache, Key, Path, sizeof(Path));
+        FILE* File = fopen(Path, "r+b");
+        if(File)
+        {
+            ftruncate(fileno(File), 1024);
+            fclose(File);
+        }
+        
+        u64 Size = 0;
+        void* Data = LoadCachedAtmosphere(Cache, &Parameters, AtmosphereDefaultLutFormats, &Size);
+        printf("damaged file: %s, %s\n", Data ? "hit" : "miss", FindAtmosphereCacheEntry(Cache, Key) ? "kept" : "removed");
+        Free(Data);
+    }
+    
+    //A version 1 file like res/earth.atmo seeds the entry of its own parameters only
+    char SeedPath[1024];
+    snprintf(SeedPath, sizeof(SeedPath), "%s/seed.atmo", Directory);
+    FILE* SeedFile = fopen(SeedPath, "wb");
+    if(SeedFile)
+    {
+        atmosphere_parameters Seed = GetEarthAtmosphereParameters();
+        Seed.MieG = 0.95f;
+        u8 Header[ALIGN_UP(sizeof(atmosphere_parameters), 16)] = {};
+        memcpy(Header, &Seed, sizeof(Seed));
+        fwrite(Header, 1, sizeof(Header), SeedFile);
+        fwrite(Texels, sizeof(f32) * 4, TransmittanceCount + IrradianceCount + ScatteringCount, SeedFile);
+        fclose(SeedFile);
+        
+        u64 Size = 0;
+        atmosphere_parameters Other = Seed;
+        Other.MieG = 0.9f;
+        void* Mismatch = SeedCachedAtmosphere(Cache, &Other, AtmosphereDefaultLutFormats, SeedPath, "seed", &Size);
+        void* Seeded = SeedCachedAtmosphere(Cache, &Seed, AtmosphereDefaultLutFormats, SeedPath, "seed", &Size);
+        void* Cached = LoadCachedAtmosphere(Cache, &Seed, AtmosphereDefaultLutFormats, &Size);
+        atmosphere_file Parsed;
+        b32 Valid = Cached && ParseAtmosphereFile(Cached, Size, &Parsed) && Parsed.Version == ATMOSPHERE_FILE_VERSION &&
+            Parsed.Luts[ATMOSPHERE_SCATTERING].Format == AtmosphereDefaultLutFormats[ATMOSPHERE_SCATTERING];
+        printf("seed file: other parameters %s, same parameters %s, then %s\n", Mismatch ? "used" : "skipped",
+               Seeded ? "used" : "skipped", Valid ? "hit" : "miss");
+        Free(Mismatch);
+        Free(Seeded);
+        Free(Cached);
+        remove(SeedPath);
+    }
+    
+    Free(Cache);
+    Free(Texels);
+}
+
+//Parametric grid of Columns x Rows quads as an indexed list, wrapped around a torus so that
+//it's closed and every cluster faces a different direction
+internal mesh_data
+AllocBenchmarkGridMesh(u32 Columns, u32 Rows, b32 Shuffled)
+{
+    mesh_data Result = {};
+    Result.VerticesCount = (Columns + 1) * (Rows + 1);
+    Result.IndicesCount = Columns * Rows * 6;
+    Result.Positions = (vec3*)ZeroAlloc(sizeof(vec3) * Result.VerticesCount);
+    Result.Normals = (vec3*)ZeroAlloc(sizeof(vec3) * Result.VerticesCount);
+    Result.Tangents = (vec3*)ZeroAlloc(sizeof(vec3) * Result.VerticesCount);
+    Result.UVs = (vec2*)ZeroAlloc(sizeof(vec2) * Result.VerticesCount);
+    Result.Indices = (u32*)ZeroAlloc(sizeof(u32) * Result.IndicesCount);
+    
+    for(u32 Y = 0; Y <= Rows; Y++)
+    {
+        for(u32 X = 0; X <= Columns; X++)
+        {
+            f32 U = (f32)X / Columns;
+            f32 V = (f32)Y / Rows;
+            f32 Ring = 1.0f + 0.3f * cosf(2.0f * PI * V);
+            u32 Vertex = Y * (Columns + 1) + X;
+            Result.Positions[Vertex] = vec3(Ring * cosf(2.0f * PI * U), 0.3f * sinf(2.0f * PI * V), Ring * sinf(2.0f * PI * U));
+            Result.UVs[Vertex] = vec2(U, V);
+        }
+    }
+    
+    u32* Index = Result.Indices;
+    for(u32 Y = 0; Y < Rows; Y++)
+    {
+        for(u32 X = 0; X < Columns; X++)
+        {
+            u32 Vertex = Y * (Columns + 1) + X;
+            *Index++ = Vertex;
+            *Index++ = Vertex + Columns + 1;
+            *Index++ = Vertex + 1;
+            *Index++ = Vertex + 1;
+            *Index++ = Vertex + Columns + 1;
+            *Index++ = Vertex + Columns + 2;
+        }
+    }
+    
+    //Worst case input, triangles in random order
+    u32 Seed = 12345;
+    u32 TrianglesCount = Result.IndicesCount / 3;
+    for(u32 Triangle = TrianglesCount - 1; Shuffled && Triangle > 0; Triangle--)
+    {
+        Seed = Seed * 1664525 + 1013904223;
+        u32 Other = (Seed >> 8) % (Triangle + 1);
+        for(u32 Corner = 0; Corner < 3; Corner++)
+        {
+            u32 Temp = Result.Indices[Triangle * 3 + Corner];
+            Result.Indices[Triangle * 3 + Corner] = Result.Indices[Other * 3 + Corner];
+            Result.Indices[Other * 3 + Corner] = Temp;
+        }
+    }
+    
+    return Result;
+}
+
+internal void
+PrintVertexCacheStats(char* Step, mesh_data* Mesh, u32 CacheSize, u64 Microseconds)
+{
+    vertex_cache_stats Stats = AnalyzeVertexCache(Mesh->Indices, Mesh->IndicesCount, Mesh->VerticesCount, CacheSize);
+    printf("  %-12s ACMR %.3f ATVR %.3f %9.2f ms\n", Step, Stats.ACMR, Stats.ATVR, (f64)Microseconds / 1000.0);
+}
+
+//Runs the passes of OptimizeMesh one at a time, the mesh is changed in place
+internal void
+BenchmarkMeshOptimization(char* Name, mesh_data* Mesh, u32 CacheSize)
+{
+    printf("%s: %u vertices, %u triangles\n", Name, Mesh->VerticesCount, Mesh->IndicesCount / 3);
+    PrintVertexCacheStats("input", Mesh, CacheSize, 0);
+    
+    u64 Begin = Platform_GetMicroseconds();
+    OptimizeVertexCache(Mesh->Indices, Mesh->IndicesCount, Mesh->VerticesCount);
+    PrintVertexCacheStats("vertex cache", Mesh, CacheSize, Platform_GetMicroseconds() - Begin);
+    
+    Begin = Platform_GetMicroseconds();
+    OptimizeOverdraw(Mesh->Indices, Mesh->IndicesCount, Mesh->Positions, Mesh->VerticesCount, MESH_OVERDRAW_THRESHOLD);
+    PrintVertexCacheStats("overdraw", Mesh, CacheSize, Platform_GetMicroseconds() - Begin);
+    
+    Begin = Platform_GetMicroseconds();
+    OptimizeVertexFetch(Mesh);
+    PrintVertexCacheStats("fetch", Mesh, CacheSize, Platform_GetMicroseconds() - Begin);
+}
+
+//Generated grids first, then every mesh of the archive if there is one. The stats are for
+//a FIFO cache of CacheSize vertices
+internal void
+BenchmarkMeshes(char* ArchivePath, u32 CacheSize)
+{
+    u32 Sizes[] = { 32, 256 };
+    for(u32 Size = 0; Size < ArrayCount(Sizes); Size++)
+    {
+        for(u32 Shuffled = 0; Shuffled < 2; Shuffled++)
+        {
+            char Name[64];
+            snprintf(Name, sizeof(Name), "grid %ux%u%s", Sizes[Size], Sizes[Size], Shuffled ? " shuffled" : "");
+            mesh_data Mesh = AllocBenchmarkGridMesh(Sizes[Size], Sizes[Size], Shuffled);
+            BenchmarkMeshOptimization(Name, &Mesh, CacheSize);
+            FreeMesh(&Mesh);
+        }
+    }
+    
+    asset_archive Archive = {};
+    if(!ArchivePath) return;
+    if(!OpenAssetArchive(&Archive, ArchivePath, false))
+    {
+        fprintf(stderr, "Cannot open %s\n", ArchivePath);
+        return;
+    }
+    
+    //Writable so the passes can work in place
+    for(u64 Index = 0; Index < Archive.Table.Count; Index++)
+    {
+        asset_table_entry* Entry = &Archive.Table.Entries[Index];
+        if(Entry->Type != ASSET_MESH) continue;
+        
+        void* Data = ReadAssetData(&Archive, Entry, true);
+        if(!Data) continue;
+        mesh_data Mesh = LoadMeshAsset(Data, Entry->Size, Archive.Table.Version);
+        char Name[ASSET_NAME_LENGTH + ASSET_TAG_LENGTH + 4];
+        snprintf(Name, sizeof(Name), "%s - %s", Entry->Name, Entry->Tag);
+        BenchmarkMeshOptimization(Name, &Mesh, CacheSize);
+        ReleaseAssetData(&Archive, Data);
+    }
+}
+
+//Times InterleaveMeshVertices and checks every vertex against the source attributes
+internal void
+BenchmarkInterleave(u32 VerticesCount, u32 RunsCount)
+{
+    mesh_data Mesh = {};
+    Mesh.VerticesCount = VerticesCount;
+    Mesh.Normals = (vec3*)ZeroAlloc(sizeof(vec3) * VerticesCount);
+    Mesh.Tangents = (vec3*)ZeroAlloc(sizeof(vec3) * VerticesCount);
+    Mesh.UVs = (vec2*)ZeroAlloc(sizeof(vec2) * VerticesCount);
+    for(u32 Index = 0; Index < VerticesCount * 3; Index++)
+    {
+        ((f32*)Mesh.Normals)[Index] = (f32)rand() / RAND_MAX;
+        ((f32*)Mesh.Tangents)[Index] = -(f32)rand() / RAND_MAX;
+    }
+    for(u32 Index = 0; Index < VerticesCount * 2; Index++)
+    {
+        ((f32*)Mesh.UVs)[Index] = (f32)Index;
+    }
+    
+    mesh_shading_vertex* Interleaved = (mesh_shading_vertex*)ZeroAlloc(sizeof(mesh_shading_vertex) * MAX(VerticesCount, 1));
+    u64 Microseconds = 0;
+    for(u32 Run = 0; Run < RunsCount; Run++)
+    {
+        u64 Begin = Platform_GetMicroseconds();
+        InterleaveMeshVertices(&Mesh, Interleaved);
+        Microseconds += Platform_GetMicroseconds() - Begin;
+    }
+    
+    u32 Mismatches = 0;
+    for(u32 Vertex = 0; Vertex < VerticesCount; Vertex++)
+    {
+        Mismatches += (memcmp(&Interleaved[Vertex].Normal, &Mesh.Normals[Vertex], sizeof(vec3)) != 0 ||
+                       memcmp(&Interleaved[Vertex].Tangent, &Mesh.Tangents[Vertex], sizeof(vec3)) != 0 ||
+                       memcmp(&Interleaved[Vertex].UV, &Mesh.UVs[Vertex], sizeof(vec2)) != 0);
+    }
+    
+    f64 Bytes = (f64)sizeof(mesh_shading_vertex) * VerticesCount * RunsCount;
+    printf("%u vertices, %u runs: %.1f MB/s, %u mismatches\n", VerticesCount, RunsCount,
+           Bytes / Megabytes(1) / MAX(Microseconds, 1) * 1000000.0, Mismatches);
+    
+    Free(Interleaved);
+    Free(Mesh.UVs);
+    Free(Mesh.Tangents);
+    Free(Mesh.Normals);
+}
+
+//Round trips the vertices of the mesh through QuantizeMeshVertices, or decodes its stored
+//streams if it's MESH_QUANTIZED, and compares them with the float data. Position error is
+//also given relative to the largest side of the bounds
+internal void
+BenchmarkMeshQuantization(char* Name, mesh_data* Mesh)
+{
+    u32 Count = Mesh->VerticesCount;
+    mesh_data Decoded = {};
+    Decoded.VerticesCount = Count;
+    Decoded.Positions = (vec3*)ZeroAlloc(sizeof(vec3) * MAX(Count, 1));
+    Decoded.Normals = (vec3*)ZeroAlloc(sizeof(vec3) * MAX(Count, 1));
+    Decoded.Tangents = (vec3*)ZeroAlloc(sizeof(vec3) * MAX(Count, 1));
+    Decoded.UVs = (vec2*)ZeroAlloc(sizeof(vec2) * MAX(Count, 1));
+    
+    b32 Stored = Mesh->Flags & MESH_QUANTIZED;
+    quantized_mesh_vertices Quantized = Mesh->Quantized;
+    u64 EncodeMicroseconds = 0;
+    if(!Stored)
+    {
+        Quantized.Positions = (quantized_position*)ZeroAlloc(sizeof(quantized_position) * MAX(Count, 1));
+        Quantized.Shading = (quantized_shading_vertex*)ZeroAlloc(sizeof(quantized_shading_vertex) * MAX(Count, 1));
+        u64 Begin = Platform_GetMicroseconds();
+        QuantizeMeshVertices(Mesh, &Quantized);
+        EncodeMicroseconds = Platform_GetMicroseconds() - Begin;
+    }
+    
+    u64 Begin = Platform_GetMicroseconds();
+    DequantizeMeshVertices(&Quantized, &Decoded);
+    u64 DecodeMicroseconds = Platform_GetMicroseconds() - Begin;
+    
+    vertex_quantization_error Error = MeasureVertexQuantizationError(Mesh, &Decoded);
+    vec3 Extent = Quantized.Max - Quantized.Min;
+    f32 Size = MAX(MAX(Extent.x, Extent.y), Extent.z);
+    
+    u32 FloatStride = sizeof(vec3) * 3 + sizeof(vec2);
+    u32 QuantizedStride = sizeof(quantized_position) + sizeof(quantized_shading_vertex);
+    
+    char Encode[32] = "stored";
+    if(!Stored)
+    {
+        snprintf(Encode, sizeof(Encode), "%.2f ms", (f64)EncodeMicroseconds / 1000.0);
+    }
+    printf("%s: %u vertices, %u -> %u bytes per vertex, encode %s, decode %.2f ms\n", Name, Count, FloatStride,
+           QuantizedStride, Encode, (f64)DecodeMicroseconds / 1000.0);
+    printf("  position %g (%g of the bounds), normal %.4f deg, tangent %.4f deg, UV %g\n", Error.Position,
+           Size > 0.0f ? Error.Position / Size : 0.0f, Error.NormalDegrees, Error.TangentDegrees, Error.UV);
+    
+    if(!Stored)
+    {
+        Free(Quantized.Shading);
+        Free(Quantized.Positions);
+    }
+    FreeMesh(&Decoded);
+}
+
+internal void
+BenchmarkQuantization(char* ArchivePath)
+{
+    mesh_data Grid = AllocBenchmarkGridMesh(512, 512, false);
+    ComputeMeshNormals(&Grid);
+    ComputeMeshTangents(&Grid);
+    BenchmarkMeshQuantization("grid 512x512", &Grid);
+    FreeMesh(&Grid);
+    
+    asset_archive Archive = {};
+    if(!ArchivePath) return;
+    if(!OpenAssetArchive(&Archive, ArchivePath, false))
+    {
+        fprintf(stderr, "Cannot open %s\n", ArchivePath);
+        return;
+    }
+    
+    for(u64 Index = 0; Index < Archive.Table.Count; Index++)
+    {
+        asset_table_entry* Entry = &Archive.Table.Entries[Index];
+        if(Entry->Type != ASSET_MESH) continue;
+        
+        void* Data = ReadAssetData(&Archive, Entry, false);
+        if(!Data) continue;
+        mesh_data Mesh = LoadMeshAsset(Data, Entry->Size, Archive.Table.Version);
+        char Name[ASSET_NAME_LENGTH + ASSET_TAG_LENGTH + 4];
+        snprintf(Name, sizeof(Name), "%s - %s", Entry->Name, Entry->Tag);
+        BenchmarkMeshQuantization(Name, &Mesh);
+        ReleaseAssetData(&Archive, Data);
+    }
+}
+
+//Size of the index buffer D3D11_LoadMesh creates for the mesh
+internal u64
+GetIndexBufferSize(mesh_data* Mesh)
+{
+    return (u64)Mesh->IndicesCount * (CanUse16BitIndices(Mesh) ? sizeof(u16) : sizeof(u32));
+}
+
+internal void
+BenchmarkIndices(u32 RunsCount)
+{
+    mesh_data Sphere = AllocSphereMesh();
+    u32 StripTriangles = Sphere.IndicesCount - 2;
+    u64 StripSize = GetIndexBufferSize(&Sphere);
+    u64 Begin = Platform_GetMicroseconds();
+    ConvertStripToList(&Sphere);
+    u64 ConvertMicroseconds = Platform_GetMicroseconds() - Begin;
+    printf("sphere strip: %u triangles, %llu bytes, list: %u triangles, %u degenerates dropped, %.2f ms\n",
+           StripTriangles, (unsigned long long)StripSize, Sphere.IndicesCount / 3, StripTriangles - Sphere.IndicesCount / 3,
+           (f64)ConvertMicroseconds / 1000.0);
+    PrintVertexCacheStats("list", &Sphere, MESH_ANALYSIS_CACHE_SIZE, ConvertMicroseconds);
+    Begin = Platform_GetMicroseconds();
+    OptimizeMesh(&Sphere);
+    PrintVertexCacheStats("optimized", &Sphere, MESH_ANALYSIS_CACHE_SIZE, Platform_GetMicroseconds() - Begin);
+    printf("  %llu bytes of indices\n", (unsigned long long)GetIndexBufferSize(&Sphere));
+    FreeMesh(&Sphere);
+    
+    //255x255 has 65536 vertices, 256x256 doesn't fit in 16 bits
+    u32 Sizes[] = { 255, 256 };
+    for(u32 Size = 0; Size < ArrayCount(Sizes); Size++)
+    {
+        mesh_data Grid = AllocBenchmarkGridMesh(Sizes[Size], Sizes[Size], false);
+        b32 Use16Bit = CanUse16BitIndices(&Grid);
+        printf("grid %ux%u: %u vertices, %s indices, %llu bytes instead of %llu\n", Sizes[Size], Sizes[Size],
+               Grid.VerticesCount, Use16Bit ? "16 bit" : "32 bit", (unsigned long long)GetIndexBufferSize(&Grid),
+               (unsigned long long)(sizeof(u32) * Grid.IndicesCount));
+        if(Use16Bit)
+        {
+            u16* Packed = (u16*)ZeroAlloc(sizeof(u16) * Grid.IndicesCount);
+            Begin = Platform_GetMicroseconds();
+            for(u32 Run = 0; Run < RunsCount; Run++)
+            {
+                PackIndices16(Grid.Indices, Grid.IndicesCount, Packed);
+            }
+            u64 Microseconds = Platform_GetMicroseconds() - Begin;
+            
+            u32 Mismatches = 0;
+            for(u32 Index = 0; Index < Grid.IndicesCount; Index++)
+            {
+                Mismatches += Packed[Index] != Grid.Indices[Index];
+            }
+            f64 Bytes = (f64)sizeof(u32) * Grid.IndicesCount * RunsCount;
+            printf("  packed %u times, %.1f MB/s, %u mismatches\n", RunsCount,
+                   Bytes / Megabytes(1) / MAX(Microseconds, 1) * 1000000.0, Mismatches);
+            Free(Packed);
+        }
+        FreeMesh(&Grid);
+    }
+}
+
+struct benchmark_triangle
+{
+    u32 Indices[3];
+};
+
+internal int
+CompareBenchmarkTriangles(const void* A, const void* B)
+{
+    return memcmp(A, B, sizeof(benchmark_triangle));
+}
+
+//Errors in the meshlets of Mesh, Original is the index buffer before BuildMeshlets
+internal u32
+CheckMeshlets(mesh_data* Mesh, u32* Original)
+{
+    u32 Errors = 0;
+    u32 NextIndex = 0;
+    u32* Tags = (u32*)ZeroAlloc(sizeof(u32) * MAX(Mesh->VerticesCount, 1));
+    for(u32 Index = 0; Index < Mesh->MeshletsCount; Index++)
+    {
+        meshlet* Meshlet = &Mesh->Meshlets[Index];
+        u32* Indices = Mesh->Indices + Meshlet->FirstIndex;
+        u32 VerticesCount = 0;
+        f32 Tolerance = 1e-5f * MAX(Meshlet->Radius, 1.0f);
+        for(u32 Corner = 0; Corner < Meshlet->IndicesCount; Corner++)
+        {
+            vec3 P = Mesh->Positions[Indices[Corner]];
+            VerticesCount += Tags[Indices[Corner]] != Index + 1;
+            Tags[Indices[Corner]] = Index + 1;
+            Errors += Length(P - Meshlet->Center) > Meshlet->Radius + Tolerance;
+            Errors += P.x < Meshlet->Min.x || P.y < Meshlet->Min.y || P.z < Meshlet->Min.z;
+            Errors += P.x > Meshlet->Max.x || P.y > Meshlet->Max.y || P.z > Meshlet->Max.z;
+        }
+        for(u32 Corner = 0; Corner < Meshlet->IndicesCount; Corner += 3)
+        {
+            vec3 P0 = Mesh->Positions[Indices[Corner]];
+            vec3 N = Cross(Mesh->Positions[Indices[Corner + 1]] - P0, Mesh->Positions[Indices[Corner + 2]] - P0);
+            f32 Magnitude = Length(N);
+            Errors += Magnitude > 0.0f && Dot(N, Meshlet->ConeAxis) / Magnitude < Meshlet->ConeCos - 1e-5f;
+        }
+        Errors += VerticesCount != Meshlet->VerticesCount || VerticesCount > MESHLET_MAX_VERTICES;
+        Errors += Meshlet->IndicesCount > MESHLET_MAX_TRIANGLES * 3 || Meshlet->FirstIndex != NextIndex;
+        NextIndex += Meshlet->IndicesCount;
+    }
+    Errors += NextIndex != Mesh->IndicesCount;
+    Free(Tags);
+    
+    //Same triangles, corners in the same order
+    u32 TrianglesCount = Mesh->IndicesCount / 3;
+    benchmark_triangle* Before = (benchmark_triangle*)ZeroAlloc(sizeof(benchmark_triangle) * MAX(TrianglesCount, 1));
+    benchmark_triangle* After = (benchmark_triangle*)ZeroAlloc(sizeof(benchmark_triangle) * MAX(TrianglesCount, 1));
+    memcpy(Before, Original, sizeof(benchmark_triangle) * TrianglesCount);
+    memcpy(After, Mesh->Indices, sizeof(benchmark_triangle) * TrianglesCount);
+    qsort(Before, TrianglesCount, sizeof(benchmark_triangle), CompareBenchmarkTriangles);
+    qsort(After, TrianglesCount, sizeof(benchmark_triangle), CompareBenchmarkTriangles);
+    Errors += memcmp(Before, After, sizeof(benchmark_triangle) * TrianglesCount) != 0;
+    Free(After);
+    Free(Before);
+    
+    return Errors;
+}
+
+//Culls the meshlets from cameras on a circle around the bounds, then from cameras close to
+//the surface. A triangle is visible if some corner is inside every plane of the frustum and
+//it faces the eye, which is checked in world space against the object space culling
+internal void
+BenchmarkMeshletCulling(mesh_data* Mesh)
+{
+    vec3 Min = vec3(FLT_MAX);
+    vec3 Max = vec3(-FLT_MAX);
+    for(u32 Vertex = 0; Vertex < Mesh->VerticesCount; Vertex++)
+    {
+        vec3 P = Mesh->Positions[Vertex];
+        Min = vec3(MIN(Min.x, P.x), MIN(Min.y, P.y), MIN(Min.z, P.z));
+        Max = vec3(MAX(Max.x, P.x), MAX(Max.y, P.y), MAX(Max.z, P.z));
+    }
+    vec3 Center = (Min + Max) * 0.5f;
+    f32 Size = Length(Max - Min);
+    mat4 Model = Mat4FromMat3AndTranslation(Mat3FromEulerXYZ(vec3(20.0f, 30.0f, 0.0f)) * Mat3Scale(vec3(1.0f, 2.0f, 1.0f)),
+                                            vec3(0.5f, 0.0f, 0.0f));
+    vec3 WorldCenter = vec3(Model * vec4(Center, 1.0f));
+    meshlet_range* Ranges = (meshlet_range*)ZeroAlloc(sizeof(meshlet_range) * MAX(Mesh->MeshletsCount, 1));
+    vec3* World = (vec3*)ZeroAlloc(sizeof(vec3) * MAX(Mesh->VerticesCount, 1));
+    for(u32 Vertex = 0; Vertex < Mesh->VerticesCount; Vertex++)
+    {
+        World[Vertex] = vec3(Model * vec4(Mesh->Positions[Vertex], 1.0f));
+    }
+    
+    for(u32 Camera = 0; Camera < 16; Camera++)
+    {
+        //The first 8 views cull the triangles facing away from the eye, the others the ones
+        //facing it like the renderer does
+        b32 CullFacingEye = Camera >= 8;
+        f32 Angle = 2.0f * PI * (Camera % 8) / 6.0f;
+        vec3 Eye = WorldCenter + vec3(cosf(Angle), 0.3f, sinf(Angle)) * (Size * 1.5f);
+        vec3 Target = WorldCenter;
+        if(Camera % 8 >= 6)
+        {
+            //From a vertex out along its normal, looking along the surface. The normal points
+            //to the side of the counter clockwise faces
+            u32 Vertex = (Camera % 8 == 6 ? Mesh->VerticesCount / 3 : Mesh->VerticesCount / 2);
+            vec3 Normal = Mesh->Normals ? Mesh->Normals[Vertex] : vec3(0.0f, 1.0f, 0.0f);
+            Normal = CullFacingEye ? -Normal : Normal;
+            Eye = vec3(Model * vec4(Mesh->Positions[Vertex] + Normal * (Size * 0.02f), 1.0f));
+            Target = vec3(Model * vec4(Mesh->Positions[Vertex] + Cross(Normal, vec3(0.0f, 1.0f, 0.0f)), 1.0f));
+        }
+        mat4 ViewProjection = Mat4Perspective(60.0f, Size * 0.001f, Size * 10.0f) * Mat4LookAt(Eye, Target);
+        
+        u64 Begin = Platform_GetMicroseconds();
+        meshlet_cull_view View = GetMeshletCullView(ViewProjection, Model, Eye, CullFacingEye);
+        u32 RangesCount = CullMeshlets(Mesh, &View, Ranges);
+        u64 Microseconds = Platform_GetMicroseconds() - Begin;
+        
+        u32 Kept = 0;
+        for(u32 Index = 0; Index < RangesCount; Index++)
+        {
+            Kept += Ranges[Index].IndicesCount / 3;
+        }
+        
+        meshlet_cull_view WorldView = GetMeshletCullView(ViewProjection, Mat4Identity(), Eye, CullFacingEye);
+        u32 Visible = 0;
+        u32 FalseCulls = 0;
+        for(u32 Index = 0; Index < Mesh->MeshletsCount; Index++)
+        {
+            meshlet* Meshlet = &Mesh->Meshlets[Index];
+            b32 Culled = !IsMeshletVisible(Meshlet, &View);
+            for(u32 Corner = Meshlet->FirstIndex; Corner < Meshlet->FirstIndex + Meshlet->IndicesCount; Corner += 3)
+            {
+                vec3 P[3] = { World[Mesh->Indices[Corner]], World[Mesh->Indices[Corner + 1]], World[Mesh->Indices[Corner + 2]] };
+                f32 Facing = Dot(Cross(P[1] - P[0], P[2] - P[0]), Eye - P[0]);
+                b32 Inside = CullFacingEye ? Facing < 0.0f : Facing > 0.0f;
+                for(u32 Plane = 0; Inside && Plane < 6; Plane++)
+                {
+                    vec4 Equation = WorldView.Planes[Plane];
+                    b32 AnyInside = false;
+                    for(u32 Point = 0; Point < 3; Point++)
+                    {
+                        AnyInside |= Dot(vec3(Equation), P[Point]) + Equation.w >= 0.0f;
+                    }
+                    Inside = AnyInside;
+                }
+                Visible += Inside;
+                FalseCulls += Inside && Culled;
+            }
+        }
+        
+        u32 TrianglesCount = Mesh->IndicesCount / 3;
+        printf("  camera %u%s: %u ranges, %5.1f%% of triangles kept, %5.1f%% visible, %.3f ms, %u false culls\n",
+               Camera % 8, CullFacingEye ? " facing eye culled" : "", RangesCount, 100.0 * Kept / MAX(TrianglesCount, 1), 100.0 * Visible / MAX(TrianglesCount, 1),
+               (f64)Microseconds / 1000.0, FalseCulls);
+    }
+    
+    Free(World);
+    Free(Ranges);
+}
+
+internal void
+BenchmarkMeshletMesh(char* Name, mesh_data* Mesh)
+{
+    u32* Original = (u32*)ZeroAlloc(sizeof(u32) * MAX(Mesh->IndicesCount, 1));
+    memcpy(Original, Mesh->Indices, sizeof(u32) * Mesh->IndicesCount);
+    
+    //The second build starts from the same indices and must give the same meshlets
+    u64 Begin = Platform_GetMicroseconds();
+    BuildMeshlets(Mesh);
+    u64 Microseconds = Platform_GetMicroseconds() - Begin;
+    u32 Errors = CheckMeshlets(Mesh, Original);
+    
+    mesh_data Again = *Mesh;
+    Again.Indices = (u32*)ZeroAlloc(sizeof(u32) * MAX(Mesh->IndicesCount, 1));
+    Again.Meshlets = 0;
+    memcpy(Again.Indices, Original, sizeof(u32) * Mesh->IndicesCount);
+    BuildMeshlets(&Again);
+    b32 Deterministic = Again.MeshletsCount == Mesh->MeshletsCount &&
+        memcmp(Again.Meshlets, Mesh->Meshlets, sizeof(meshlet) * Mesh->MeshletsCount) == 0 &&
+        memcmp(Again.Indices, Mesh->Indices, sizeof(u32) * Mesh->IndicesCount) == 0;
+    Free(Again.Meshlets);
+    Free(Again.Indices);
+    
+    u64 Vertices = 0;
+    u32 Cullable = 0;
+    for(u32 Index = 0; Index < Mesh->MeshletsCount; Index++)
+    {
+        Vertices += Mesh->Meshlets[Index].VerticesCount;
+        Cullable += Mesh->Meshlets[Index].ConeCos > 0.0f;
+    }
+    u32 MeshletsCount = MAX(Mesh->MeshletsCount, 1);
+    printf("%s: %u triangles, %u meshlets, %.1f vertices and %.1f triangles each, %u with a cone, %.2f ms\n",
+           Name, Mesh->IndicesCount / 3, Mesh->MeshletsCount, (f64)Vertices / MeshletsCount,
+           (f64)Mesh->IndicesCount / 3 / MeshletsCount, Cullable, (f64)Microseconds / 1000.0);
+    printf("  %u errors, %s\n", Errors, Deterministic ? "deterministic" : "NOT deterministic");
+    BenchmarkMeshletCulling(Mesh);
+    
+    Free(Original);
+}
+
+internal void
+BenchmarkMeshlets(char* ArchivePath, u32 Size)
+{
+    char Name[64];
+    snprintf(Name, sizeof(Name), "grid %ux%u", Size, Size);
+    mesh_data Grid = AllocBenchmarkGridMesh(Size, Size, true);
+    ComputeMeshNormals(&Grid);
+    OptimizeMesh(&Grid);
+    BenchmarkMeshletMesh(Name, &Grid);
+    FreeMesh(&Grid);
+    
+    asset_archive Archive = {};
+    if(!ArchivePath) return;
+    if(!OpenAssetArchive(&Archive, ArchivePath, false))
+    {
+        fprintf(stderr, "Cannot open %s\n", ArchivePath);
+        return;
+    }
+    
+    //Writable, the indices are reordered in place
+    for(u64 Index = 0; Index < Archive.Table.Count; Index++)
+    {
+        asset_table_entry* Entry = &Archive.Table.Entries[Index];
+        if(Entry->Type != ASSET_MESH) continue;
+        
+        void* Data = ReadAssetData(&Archive, Entry, true);
+        if(!Data) continue;
+        mesh_data Mesh = LoadMeshAsset(Data, Entry->Size, Archive.Table.Version);
+        if(!(Mesh.Flags & (MESH_IS_STRIP | MESH_NO_INDICES)))
+        {
+            char MeshName[ASSET_NAME_LENGTH + ASSET_TAG_LENGTH + 4];
+            snprintf(MeshName, sizeof(MeshName), "%s - %s", Entry->Name, Entry->Tag);
+            BenchmarkMeshletMesh(MeshName, &Mesh);
+        }
+        Free(Mesh.Meshlets);
+        ReleaseAssetData(&Archive, Data);
+    }
+}
+
+int
+main(int ArgumentsCount, char** Arguments)
+{
+    if(ArgumentsCount >= 3 && strcmp(Arguments[1], "reads") == 0)
+    {
+        u64 TotalSize = Gigabytes(6);
+        u64 BatchSize = Megabytes(512);
+        for(s32 Index = 3; Index < ArgumentsCount; Index++)
+        {
+            if(strcmp(Arguments[Index], "-size") == 0 && Index + 1 < ArgumentsCount)
+            {
+                TotalSize = (u64)(atof(Arguments[++Index]) * Gigabytes(1));
+            }
+            else if(strcmp(Arguments[Index], "-batch") == 0 && Index + 1 < ArgumentsCount)
+            {
+                BatchSize = (u64)atoi(Arguments[++Index]) * Megabytes(1);
+            }
+        }
+        BenchmarkReads(Arguments[2], TotalSize, BatchSize);
+        return 0;
+    }
+    
+    if(ArgumentsCount >= 2 && strcmp(Arguments[1], "residency") == 0)
+    {
+        u32 TexturesCount = 256;
+        u64 Budget = Megabytes(64);
+        u32 FramesCount = 10000;
+        for(s32 Index = 2; Index < ArgumentsCount; Index++)
+        {
+            if(strcmp(Arguments[Index], "-textures") == 0 && Index + 1 < ArgumentsCount)
+            {
+                TexturesCount = (u32)atoi(Arguments[++Index]);
+            }
+            else if(strcmp(Arguments[Index], "-budget") == 0 && Index + 1 < ArgumentsCount)
+            {
+                Budget = (u64)atoi(Arguments[++Index]) * Megabytes(1);
+            }
+            else if(strcmp(Arguments[Index], "-frames") == 0 && Index + 1 < ArgumentsCount)
+            {
+                FramesCount = (u32)atoi(Arguments[++Index]);
+            }
+        }
+        return BenchmarkResidency(TexturesCount, Budget, FramesCount) ? 0 : 1;
+    }
+    
+    if(ArgumentsCount >= 2 && strcmp(Arguments[1], "atmosphere") == 0)
+    {
+        char* Directory = "atmosphere_cache";
+        u32 PresetsCount = 8;
+        for(s32 Index = 2; Index < ArgumentsCount; Index++)
+        {
+            if(strcmp(Arguments[Index], "-dir") == 0 && Index + 1 < ArgumentsCount)
+            {
+                Directory = Arguments[++Index];
+            }
+            else if(strcmp(Arguments[Index], "-presets") == 0 && Index + 1 < ArgumentsCount)
+            {
+                PresetsCount = (u32)atoi(Arguments[++Index]);
+            }
+        }
+        BenchmarkAtmosphereCache(Directory, PresetsCount);
+        return 0;
+    }
+    
+    if(ArgumentsCount >= 2 && strcmp(Arguments[1], "meshes") == 0)
+    {
+        char* ArchivePath = 0;
+        u32 CacheSize = MESH_ANALYSIS_CACHE_SIZE;
+        for(s32 Index = 2; Index < ArgumentsCount; Index++)
+        {
+            if(strcmp(Arguments[Index], "-archive") == 0 && Index + 1 < ArgumentsCount)
+            {
+                ArchivePath = Arguments[++Index];
+            }
+            else if(strcmp(Arguments[Index], "-cache") == 0 && Index + 1 < ArgumentsCount)
+            {
+                CacheSize = (u32)atoi(Arguments[++Index]);
+            }
+        }
+        CacheSize = MAX(CacheSize, 1);
+        BenchmarkMeshes(ArchivePath, CacheSize);
+        return 0;
+    }
+    
+    if(ArgumentsCount >= 2 && strcmp(Arguments[1], "interleave") == 0)
+    {
+        u32 VerticesCount = 1000001;
+        u32 RunsCount = 20;
+        for(s32 Index = 2; Index < ArgumentsCount; Index++)
+        {
+            if(strcmp(Arguments[Index], "-vertices") == 0 && Index + 1 < ArgumentsCount)
+            {
+                VerticesCount = (u32)atoi(Arguments[++Index]);
+            }
+            else if(strcmp(Arguments[Index], "-runs") == 0 && Index + 1 < ArgumentsCount)
+            {
+                RunsCount = (u32)atoi(Arguments[++Index]);
+            }
+        }
+        RunsCount = MAX(RunsCount, 1);
+        BenchmarkInterleave(VerticesCount, RunsCount);
+        return 0;
+    }
+    
+    if(ArgumentsCount >= 2 && strcmp(Arguments[1], "quantize") == 0)
+    {
+        char* ArchivePath = 0;
+        for(s32 Index = 2; Index < ArgumentsCount; Index++)
+        {
+            if(strcmp(Arguments[Index], "-archive") == 0 && Index + 1 < ArgumentsCount)
+            {
+                ArchivePath = Arguments[++Index];
+            }
+        }
+        BenchmarkQuantization(ArchivePath);
+        return 0;
+    }
+    
+    if(ArgumentsCount >= 2 && strcmp(Arguments[1], "indices") == 0)
+    {
+        u32 RunsCount = 100;
+        for(s32 Index = 2; Index < ArgumentsCount; Index++)
+        {
+            if(strcmp(Arguments[Index], "-runs") == 0 && Index + 1 < ArgumentsCount)
+            {
+                RunsCount = (u32)atoi(Arguments[++Index]);
+            }
+        }
+        RunsCount = MAX(RunsCount, 1);
+        BenchmarkIndices(RunsCount);
+        return 0;
+    }
+    
+    if(ArgumentsCount >= 2 && strcmp(Arguments[1], "meshlets") == 0)
+    {
+        char* ArchivePath = 0;
+        u32 Size = 1024;
+        for(s32 Index = 2; Index < ArgumentsCount; Index++)
+        {
+            if(strcmp(Arguments[Index], "-archive") == 0 && Index + 1 < ArgumentsCount)
+            {
+                ArchivePath = Arguments[++Index];
+            }
+            else if(strcmp(Arguments[Index], "-size") == 0 && Index + 1 < ArgumentsCount)
+            {
+                Size = (u32)atoi(Arguments[++Index]);
+            }
+        }
+        Size = MAX(Size, 1);
+        BenchmarkMeshlets(ArchivePath, Size);
+        return 0;
+    }
+    
+    fprintf(stderr, "Usage: %s reads <archive> [-size GB] [-batch MB]\n", Arguments[0]);
+    fprintf(stderr, "       %s residency [-textures N] [-budget MB] [-frames N]\n", Arguments[0]);
+    fprintf(stderr, "       %s atmosphere [-dir path] [-presets N]\n", Arguments[0]);
+    fprintf(stderr, "       %s meshes [-archive path] [-cache N]\n", Arguments[0]);
+    fprintf(stderr, "       %s interleave [-vertices N] [-runs N]\n", Arguments[0]);
+    fprintf(stderr, "       %s quantize [-archive path]\n", Arguments[0]);
+    fprintf(stderr, "       %s indices [-runs N]\n", Arguments[0]);
+    fprintf(stderr, "       %s meshlets [-size N] [-archive path]\n", Arguments[0]);
+    return 1;
+}
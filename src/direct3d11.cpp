@@ -538,11 +538,17 @@ D3D11_InitCommonState(ID3D11Device* Device)
     
     ID3D11PixelShader* CubemapPixelShader = D3D11_LoadPixelShader(Device, L"../src/shaders/cubemap.hlsl");
     
-    //Sphere
+    //Sphere, as an optimized list with 16 bit indices
     mesh_data Sphere = AllocSphereMesh(0.5);
+    ConvertStripToList(&Sphere);
+    OptimizeMesh(&Sphere);
+    Assert(CanUse16BitIndices(&Sphere));
+    u16* SphereIndices = (u16*)ZeroAlloc(sizeof(u16) * Sphere.IndicesCount);
+    PackIndices16(Sphere.Indices, Sphere.IndicesCount, SphereIndices);
     ID3D11Buffer* SphereVertexBuffer = D3D11_CreateBuffer(Device, Sphere.Positions, sizeof(vec3) * Sphere.VerticesCount);
-    ID3D11Buffer* SphereIndexBuffer = D3D11_CreateBuffer(Device, Sphere.Indices, sizeof(u32) * Sphere.IndicesCount, true);
+    ID3D11Buffer* SphereIndexBuffer = D3D11_CreateBuffer(Device, SphereIndices, sizeof(u16) * Sphere.IndicesCount, true);
     u32 SphereIndicesCount = Sphere.IndicesCount;
+    Free(SphereIndices);
     FreeMesh(&Sphere);
     
     //3D texture slice
@@ -687,6 +693,32 @@ D3D11_InitPBRPipeline(d3d11_state* D3D11, u32 Width, u32 Height)
                                                     Buffer->GetBufferPointer(),
                                                     Buffer->GetBufferSize(), &PBR.Layout);
     Assert(HResult == S_OK);
+    
+    //Same attributes with everything but the position in slot 1, see mesh_shading_vertex
+    LayoutDesc[1].InputSlot = 1;
+    LayoutDesc[1].AlignedByteOffset = offsetof(mesh_shading_vertex, Normal);
+    LayoutDesc[2].InputSlot = 1;
+    LayoutDesc[2].AlignedByteOffset = offsetof(mesh_shading_vertex, Tangent);
+    LayoutDesc[3].InputSlot = 1;
+    LayoutDesc[3].AlignedByteOffset = offsetof(mesh_shading_vertex, UV);
+    HResult = Device->CreateInputLayout(LayoutDesc, ArrayCount(LayoutDesc), Buffer->GetBufferPointer(),
+                                        Buffer->GetBufferSize(), &PBR.InterleavedLayout);
+    Assert(HResult == S_OK);
+    
+    //Quantized meshes decode their normals in their own vertex shader
+    ID3D10Blob* QuantizedBuffer;
+    PBR.QuantizedVertexShader = D3D11_LoadVertexShader(Device, L"../src/shaders/pbr_vertex_quantized.hlsl", &QuantizedBuffer);
+    LayoutDesc[0].Format = DXGI_FORMAT_R16G16B16A16_UNORM;
+    LayoutDesc[1].Format = DXGI_FORMAT_R16G16_SNORM;
+    LayoutDesc[1].AlignedByteOffset = offsetof(quantized_shading_vertex, Normal);
+    LayoutDesc[2].Format = DXGI_FORMAT_R16G16_SNORM;
+    LayoutDesc[2].AlignedByteOffset = offsetof(quantized_shading_vertex, Tangent);
+    LayoutDesc[3].Format = DXGI_FORMAT_R16G16_UNORM;
+    LayoutDesc[3].AlignedByteOffset = offsetof(quantized_shading_vertex, UV);
+    HResult = Device->CreateInputLayout(LayoutDesc, ArrayCount(LayoutDesc), QuantizedBuffer->GetBufferPointer(),
+                                        QuantizedBuffer->GetBufferSize(), &PBR.QuantizedLayout);
+    Assert(HResult == S_OK);
+    QuantizedBuffer->Release();
     Buffer->Release();
     
     PBR.VertexConstantsBuffer = D3D11_CreateConstantBuffer(Device, sizeof(d3d11_pbr_vertex_constants));
@@ -739,29 +771,8 @@ D3D11_InitAtmospherePipeline(d3d11_state* D3D11)
     
     d3d11_atmosphere_pipeline Atmosphere = {};
     
-    
-    // We now store the precomputed atmosphere in the .atmo so we don't need to setup the pipeline to compute it
-    /*
-    Atmosphere.LutVertexShader = D3D11_LoadVertexShader(Device, L"../src/shaders/bruneton/atmosphere_lut.hlsl", 0);
-    Atmosphere.LutGeometryShader = D3D11_LoadGeometryShader(Device, L"../src/shaders/bruneton/atmosphere_lut.hlsl");
-    Atmosphere.TransmittanceShader = D3D11_LoadPixelShader(Device, L"../src/shaders/bruneton/atmosphere_transmittance.hlsl");
-    Atmosphere.DirectIrradianceShader = D3D11_LoadPixelShader(Device, L"../src/shaders/bruneton/atmosphere_direct_irradiance.hlsl");
-    Atmosphere.SingleScatterShader = D3D11_LoadPixelShader(Device, L"../src/shaders/bruneton/atmosphere_single_scatter.hlsl");
-    Atmosphere.ScatteringDensityShader = D3D11_LoadPixelShader(Device, L"../src/shaders/bruneton/atmosphere_scattering_density.hlsl");
-    Atmosphere.IndirectIrradianceShader = D3D11_LoadPixelShader(Device, L"../src/shaders/bruneton/atmosphere_indirect_irradiance.hlsl");
-    Atmosphere.MultipleScatteringShader = D3D11_LoadPixelShader(Device, L"../src/shaders/bruneton/atmosphere_multiple_scattering.hlsl");
-    
-    Atmosphere.ScatteringOrderBuffer = D3D11_CreateConstantBuffer(Device, sizeof(s32));
-    
-    Atmosphere.DeltaIrradiance = D3D11_CreateRenderTarget(Device, IRRADIANCE_TEXTURE_WIDTH, IRRADIANCE_TEXTURE_HEIGHT,
-                                                          ATMOSPHERE_LUT_FORMAT);
-    s32 x = SCATTERING_TEXTURE_WIDTH;
-    s32 y = SCATTERING_TEXTURE_HEIGHT;
-    s32 z = SCATTERING_TEXTURE_DEPTH;
-    Atmosphere.DeltaScatteringR = D3D11_CreateRenderTarget3D(Device, x, y, z, ATMOSPHERE_LUT_FORMAT);
-    Atmosphere.DeltaScatteringM = D3D11_CreateRenderTarget3D(Device, x, y, z, ATMOSPHERE_LUT_FORMAT);
-    Atmosphere.DeltaScatteringDensity = D3D11_CreateRenderTarget3D(Device, x, y, z, ATMOSPHERE_LUT_FORMAT);
-    */
+    // The precomputation shaders and targets are only created on a cache miss, see
+    // D3D11_InitAtmospherePrecompute
     
     D3D11_BLEND_DESC BlendDesc = {};
 	BlendDesc.IndependentBlendEnable = true;
@@ -839,6 +850,13 @@ D3D11_InitShadowPipeline(d3d11_state* D3D11)
     Result = D3D11->Device->CreateInputLayout(LayoutDesc, ArrayCount(LayoutDesc),
                                               Buffer->GetBufferPointer(),
                                               Buffer->GetBufferSize(), &Shadow.Layout);
+    Assert(Result == S_OK);
+    
+    //Positions of quantized meshes, the model matrix maps them back to the mesh bounds
+    LayoutDesc[0].Format = DXGI_FORMAT_R16G16B16A16_UNORM;
+    Result = D3D11->Device->CreateInputLayout(LayoutDesc, ArrayCount(LayoutDesc),
+                                              Buffer->GetBufferPointer(),
+                                              Buffer->GetBufferSize(), &Shadow.QuantizedLayout);
     Buffer->Release();
     
     Assert(Result == S_OK);
@@ -1195,12 +1213,36 @@ internal d3d11_mesh
 D3D11_LoadMesh(ID3D11Device* Device, mesh_data* Mesh)
 {
     d3d11_mesh Result = {};
-    Result.VertexBuffers[0] = D3D11_CreateBuffer(Device, Mesh->Positions, sizeof(vec3) * Mesh->VerticesCount);
-    Result.VertexBuffers[1] = D3D11_CreateBuffer(Device, Mesh->Normals,   sizeof(vec3) * Mesh->VerticesCount);
-    Result.VertexBuffers[2] = D3D11_CreateBuffer(Device, Mesh->Tangents,  sizeof(vec3) * Mesh->VerticesCount);
-    Result.VertexBuffers[3] = D3D11_CreateBuffer(Device, Mesh->UVs,       sizeof(vec2) * Mesh->VerticesCount);
+    if(Mesh->Flags & MESH_QUANTIZED)
+    {
+        //Streams stored by the packer, see BuildMeshAsset
+        quantized_mesh_vertices* Quantized = &Mesh->Quantized;
+        Assert(Quantized->Positions && Quantized->VerticesCount == Mesh->VerticesCount);
+        Result.PositionsBuffer = D3D11_CreateBuffer(Device, Quantized->Positions, sizeof(quantized_position) * Mesh->VerticesCount);
+        Result.ShadingBuffer = D3D11_CreateBuffer(Device, Quantized->Shading, sizeof(quantized_shading_vertex) * Mesh->VerticesCount);
+        Result.PositionOffset = Quantized->Min;
+        Result.PositionScale = Quantized->Max - Quantized->Min;
+        Result.UVOffset = Quantized->UVMin;
+        Result.UVScale = Quantized->UVMax - Quantized->UVMin;
+    }
+    else if(Mesh->Flags & MESH_INTERLEAVED)
+    {
+        Result.VertexBuffers[0] = D3D11_CreateBuffer(Device, Mesh->Positions, sizeof(vec3) * Mesh->VerticesCount);
+        u32 ShadingSize = sizeof(mesh_shading_vertex) * Mesh->VerticesCount;
+        mesh_shading_vertex* Shading = (mesh_shading_vertex*)ZeroAlloc(ShadingSize);
+        InterleaveMeshVertices(Mesh, Shading);
+        Result.ShadingBuffer = D3D11_CreateBuffer(Device, Shading, ShadingSize);
+        Free(Shading);
+    }
+    else
+    {
+        Result.VertexBuffers[0] = D3D11_CreateBuffer(Device, Mesh->Positions, sizeof(vec3) * Mesh->VerticesCount);
+        Result.VertexBuffers[1] = D3D11_CreateBuffer(Device, Mesh->Normals,   sizeof(vec3) * Mesh->VerticesCount);
+        Result.VertexBuffers[2] = D3D11_CreateBuffer(Device, Mesh->Tangents,  sizeof(vec3) * Mesh->VerticesCount);
+        Result.VertexBuffers[3] = D3D11_CreateBuffer(Device, Mesh->UVs,       sizeof(vec2) * Mesh->VerticesCount);
+    }
     
-    if(Mesh->Flags & MESH_HAS_ANIMATION)
+    if((Mesh->Flags & MESH_HAS_ANIMATION) && !(Mesh->Flags & MESH_QUANTIZED))
     {
         Result.VertexBuffers[4] = D3D11_CreateBuffer(Device, Mesh->Weights, sizeof(vec4)  * Mesh->VerticesCount);
         Result.VertexBuffers[5] = D3D11_CreateBuffer(Device, Mesh->Joints,  sizeof(ivec4) * Mesh->VerticesCount);
@@ -1208,37 +1250,82 @@ D3D11_LoadMesh(ID3D11Device* Device, mesh_data* Mesh)
     
     Result.VerticesCount = Mesh->VerticesCount;
     
-    if(!(Mesh->Flags & MESH_NO_INDICES))
+    if(CanUse16BitIndices(Mesh))
+    {
+        u16* Indices = (u16*)ZeroAlloc(sizeof(u16) * MAX(Mesh->IndicesCount, 1));
+        PackIndices16(Mesh->Indices, Mesh->IndicesCount, Indices);
+        Result.IndexBuffer = D3D11_CreateBuffer(Device, Indices, sizeof(u16) * Mesh->IndicesCount, true);
+        Result.IndicesCount = Mesh->IndicesCount;
+        Result.IndexFormat = DXGI_FORMAT_R16_UINT;
+        Free(Indices);
+    }
+    else if(!(Mesh->Flags & MESH_NO_INDICES))
     {
         Result.IndexBuffer = D3D11_CreateBuffer(Device, Mesh->Indices, sizeof(u32) * Mesh->IndicesCount, true);
         Result.IndicesCount = Mesh->IndicesCount;
+        Result.IndexFormat = DXGI_FORMAT_R32_UINT;
     }
     Result.Flags = Mesh->Flags;
     
     return Result;
 }
 
+//Format of 8 bit per channel images, with 1 or 4 channels, and of block compressed ones
+internal DXGI_FORMAT
+D3D11_GetImageFormat(image_data* Image, b32 SRGB)
+{
+    switch(Image->BlockFormat)
+    {
+        case IMAGE_BC1: return SRGB ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+        case IMAGE_BC3: return SRGB ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+        case IMAGE_BC4: return DXGI_FORMAT_BC4_UNORM;
+        case IMAGE_BC5: return DXGI_FORMAT_BC5_UNORM;
+        case IMAGE_BC7: return SRGB ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+        default: break;
+    }
+    
+    if(Image->BytesPerPixel == 1)
+    {
+        return DXGI_FORMAT_R8_UNORM;
+    }
+    
+    Assert(Image->BytesPerPixel == 4);
+    return SRGB ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+}
+
 internal d3d11_texture
 D3D11_CreateTexture(ID3D11Device* Device, image_data* Image, DXGI_FORMAT Format)
 {
     d3d11_texture Result = {};
     
+    //All the mips are uploaded at once, they follow the first level tightly packed.
+    //Partially loaded images start at their FirstMip, which becomes the top level
     HRESULT HResult;
-    D3D11_SUBRESOURCE_DATA TextureData = {};
-    TextureData.pSysMem = Image->Data;
-    TextureData.SysMemPitch = Image->Pitch;
+    u32 NumberOfMips = Image->NumberOfMips ? Image->NumberOfMips : 1;
+    D3D11_SUBRESOURCE_DATA TextureData[D3D11_REQ_MIP_LEVELS] = {};
+    Assert(NumberOfMips <= D3D11_REQ_MIP_LEVELS && Image->FirstMip < NumberOfMips);
+    
+    u8* MipData = Image->Data;
+    for(u32 Mip = Image->FirstMip; Mip < NumberOfMips; Mip++)
+    {
+        u32 MipRows = GetImageLevelRows(Image->Height, Image->BlockFormat, Mip);
+        u32 MipPitch = Mip ? GetImageLevelPitch(Image->Width, Image->BytesPerPixel, Image->BlockFormat, Mip) : Image->Pitch;
+        TextureData[Mip - Image->FirstMip].pSysMem = MipData;
+        TextureData[Mip - Image->FirstMip].SysMemPitch = MipPitch;
+        MipData += MipPitch * MipRows;
+    }
     
     D3D11_TEXTURE2D_DESC TextureDesc = {};
-    TextureDesc.Width = Image->Width;
-    TextureDesc.Height = Image->Height;
-    TextureDesc.MipLevels = 1;
+    TextureDesc.Width = MAX(Image->Width >> Image->FirstMip, 1);
+    TextureDesc.Height = MAX(Image->Height >> Image->FirstMip, 1);
+    TextureDesc.MipLevels = NumberOfMips - Image->FirstMip;
     TextureDesc.ArraySize = 1;
     TextureDesc.Format = Format;
     TextureDesc.SampleDesc.Count = 1;
     TextureDesc.Usage = D3D11_USAGE_DEFAULT;
     TextureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
     
-    HResult = Device->CreateTexture2D(&TextureDesc, &TextureData, &Result.Texture);
+    HResult = Device->CreateTexture2D(&TextureDesc, TextureData, &Result.Texture);
     Assert(HResult == S_OK);
     
     D3D11_SHADER_RESOURCE_VIEW_DESC TextureResourceDesc = {};
@@ -1252,6 +1339,66 @@ D3D11_CreateTexture(ID3D11Device* Device, image_data* Image, DXGI_FORMAT Format)
     return Result;
 }
 
+internal void
+D3D11_FreeTexture(d3d11_texture* Texture)
+{
+    Texture->ResourceView->Release();
+    Texture->Texture->Release();
+    *Texture = {};
+}
+
+//Inverse of D3D11_GetImageFormat, for the formats it returns
+internal void
+D3D11_GetFormatLayout(DXGI_FORMAT Format, s32* BytesPerPixel, image_block_format* BlockFormat)
+{
+    *BytesPerPixel = 4;
+    *BlockFormat = IMAGE_UNCOMPRESSED;
+    switch(Format)
+    {
+        case DXGI_FORMAT_BC1_UNORM: case DXGI_FORMAT_BC1_UNORM_SRGB: *BlockFormat = IMAGE_BC1; break;
+        case DXGI_FORMAT_BC3_UNORM: case DXGI_FORMAT_BC3_UNORM_SRGB: *BlockFormat = IMAGE_BC3; break;
+        case DXGI_FORMAT_BC4_UNORM: *BlockFormat = IMAGE_BC4; break;
+        case DXGI_FORMAT_BC5_UNORM: *BlockFormat = IMAGE_BC5; break;
+        case DXGI_FORMAT_BC7_UNORM: case DXGI_FORMAT_BC7_UNORM_SRGB: *BlockFormat = IMAGE_BC7; break;
+        case DXGI_FORMAT_R8_UNORM: *BytesPerPixel = 1; break;
+        default: Assert(Format == DXGI_FORMAT_R8G8B8A8_UNORM || Format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB); break;
+    }
+}
+
+//Replaces the texture with one made of its mips from FirstMip down, copied on the GPU,
+//so the memory of the top mips is released
+internal void
+D3D11_DropTextureMips(ID3D11Device* Device, ID3D11DeviceContext* Context, d3d11_texture* Texture, u32 FirstMip)
+{
+    D3D11_TEXTURE2D_DESC TextureDesc;
+    Texture->Texture->GetDesc(&TextureDesc);
+    Assert(FirstMip < TextureDesc.MipLevels);
+    
+    TextureDesc.Width = MAX(TextureDesc.Width >> FirstMip, 1);
+    TextureDesc.Height = MAX(TextureDesc.Height >> FirstMip, 1);
+    TextureDesc.MipLevels -= FirstMip;
+    
+    d3d11_texture Result = {};
+    HRESULT HResult = Device->CreateTexture2D(&TextureDesc, 0, &Result.Texture);
+    Assert(HResult == S_OK);
+    
+    for(u32 Mip = 0; Mip < TextureDesc.MipLevels; Mip++)
+    {
+        Context->CopySubresourceRegion(Result.Texture, Mip, 0, 0, 0, Texture->Texture, Mip + FirstMip, 0);
+    }
+    
+    D3D11_SHADER_RESOURCE_VIEW_DESC TextureResourceDesc = {};
+    TextureResourceDesc.Format = TextureDesc.Format;
+    TextureResourceDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+    TextureResourceDesc.Texture2D.MipLevels = (u32)-1; //Use all mips
+    
+    HResult = Device->CreateShaderResourceView(Result.Texture, &TextureResourceDesc, &Result.ResourceView);
+    Assert(HResult == S_OK);
+    
+    D3D11_FreeTexture(Texture);
+    *Texture = Result;
+}
+
 internal d3d11_texture_3d
 D3D11_CreateTexture3D(ID3D11Device* Device, image_3d_data* Image, DXGI_FORMAT Format)
 {
@@ -1532,19 +1679,29 @@ D3D11_CreateCubeTextureAndRenderTargetMips(ID3D11Device* Device, u32 Size)
 }
 
 
+DXGI_FORMAT CubemapDXGIFormats[] = {
+    DXGI_FORMAT_R32G32B32A32_FLOAT,
+    DXGI_FORMAT_R16G16B16A16_FLOAT,
+    DXGI_FORMAT_R11G11B10_FLOAT,
+    DXGI_FORMAT_R9G9B9E5_SHAREDEXP,
+    DXGI_FORMAT_BC6H_UF16,
+};
+
+static_assert(ArrayCount(CubemapDXGIFormats) == CUBEMAP_FORMATS_COUNT);
+
 internal d3d11_cubemap
 D3D11_LoadCubemap(ID3D11Device* Device, cubemap_data* CubemapData)
 {
     s32 Size = CubemapData->Size;
     u32 NumberOfMips = CubemapData->NumberOfMips;
-    
+    DXGI_FORMAT Format = CubemapDXGIFormats[CubemapData->Format];
     
     D3D11_TEXTURE2D_DESC CubemapDesc = {};
     CubemapDesc.Width = Size;
     CubemapDesc.Height = Size;
     CubemapDesc.MipLevels = NumberOfMips;
     CubemapDesc.ArraySize = 6;
-    CubemapDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+    CubemapDesc.Format = Format;
     CubemapDesc.SampleDesc.Count = 1;
     CubemapDesc.Usage = D3D11_USAGE_DEFAULT;
     CubemapDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
@@ -1557,17 +1714,15 @@ D3D11_LoadCubemap(ID3D11Device* Device, cubemap_data* CubemapData)
     
     for(u32 FaceIndex = 0; FaceIndex < 6; FaceIndex++)
     {
-        u32 MipSize = Size;
         for(u32 MipIndex = 0; MipIndex < CubemapData->NumberOfMips; MipIndex++)
         {
             D3D11_SUBRESOURCE_DATA* ResourceData = ResourceDataArray + (FaceIndex * NumberOfMips) + MipIndex;
             
+            //Rows of blocks for BC6H
             ResourceData->pSysMem = CurrentData;
-            u32 MipPitch = MipSize * CubemapData->BytesPerPixel;
-            CurrentData += MipSize * MipPitch;
+            u32 MipPitch = GetCubemapLevelPitch(Size, CubemapData->Format, MipIndex);
+            CurrentData += MipPitch * GetCubemapLevelRows(Size, CubemapData->Format, MipIndex);
             ResourceData->SysMemPitch = MipPitch;
-            
-            MipSize /= 2;
         }
     }
     
@@ -1576,7 +1731,7 @@ D3D11_LoadCubemap(ID3D11Device* Device, cubemap_data* CubemapData)
     Assert(HResult == S_OK);
     
     D3D11_SHADER_RESOURCE_VIEW_DESC CubemapResourceDesc = {};
-    CubemapResourceDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+    CubemapResourceDesc.Format = Format;
     CubemapResourceDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
     CubemapResourceDesc.TextureCube.MipLevels = (u32)-1;
     
@@ -1913,11 +2068,42 @@ D3D11_DrawLut(d3d11_state* D3D11, u32 Depth)
     Context->DrawInstanced(3, Depth, 0, 0);
 }
 
+// Atmospheres usually come from the cache, so the precomputation pipeline is created the
+// first time an atmosphere has to be computed and kept afterwards
+internal void
+D3D11_InitAtmospherePrecompute(d3d11_state* D3D11)
+{
+    ID3D11Device* Device = D3D11->Device;
+    d3d11_atmosphere_pipeline* Atmosphere = &D3D11->Atmosphere;
+    if(Atmosphere->TransmittanceShader) return;
+    
+    Atmosphere->LutVertexShader = D3D11_LoadVertexShader(Device, L"../src/shaders/bruneton/atmosphere_lut.hlsl", 0);
+    Atmosphere->LutGeometryShader = D3D11_LoadGeometryShader(Device, L"../src/shaders/bruneton/atmosphere_lut.hlsl");
+    Atmosphere->TransmittanceShader = D3D11_LoadPixelShader(Device, L"../src/shaders/bruneton/atmosphere_transmittance.hlsl");
+    Atmosphere->DirectIrradianceShader = D3D11_LoadPixelShader(Device, L"../src/shaders/bruneton/atmosphere_direct_irradiance.hlsl");
+    Atmosphere->SingleScatterShader = D3D11_LoadPixelShader(Device, L"../src/shaders/bruneton/atmosphere_single_scatter.hlsl");
+    Atmosphere->ScatteringDensityShader = D3D11_LoadPixelShader(Device, L"../src/shaders/bruneton/atmosphere_scattering_density.hlsl");
+    Atmosphere->IndirectIrradianceShader = D3D11_LoadPixelShader(Device, L"../src/shaders/bruneton/atmosphere_indirect_irradiance.hlsl");
+    Atmosphere->MultipleScatteringShader = D3D11_LoadPixelShader(Device, L"../src/shaders/bruneton/atmosphere_multiple_scattering.hlsl");
+    
+    Atmosphere->ScatteringOrderBuffer = D3D11_CreateConstantBuffer(Device, sizeof(s32));
+    
+    Atmosphere->DeltaIrradiance = D3D11_CreateRenderTarget(Device, IRRADIANCE_TEXTURE_WIDTH, IRRADIANCE_TEXTURE_HEIGHT,
+                                                           ATMOSPHERE_LUT_FORMAT);
+    s32 x = SCATTERING_TEXTURE_WIDTH;
+    s32 y = SCATTERING_TEXTURE_HEIGHT;
+    s32 z = SCATTERING_TEXTURE_DEPTH;
+    Atmosphere->DeltaScatteringR = D3D11_CreateRenderTarget3D(Device, x, y, z, ATMOSPHERE_LUT_FORMAT);
+    Atmosphere->DeltaScatteringM = D3D11_CreateRenderTarget3D(Device, x, y, z, ATMOSPHERE_LUT_FORMAT);
+    Atmosphere->DeltaScatteringDensity = D3D11_CreateRenderTarget3D(Device, x, y, z, ATMOSPHERE_LUT_FORMAT);
+}
+
 internal d3d11_atmosphere
 D3D11_PrecomputeAtmosphere(d3d11_state* D3D11, atmosphere_parameters* Atmosphere)
 {
     ID3D11Device* Device = D3D11->Device;
     ID3D11DeviceContext* Context = D3D11->Context;
+    D3D11_InitAtmospherePrecompute(D3D11);
     
     d3d11_atmosphere Result = {};
     Result.Transmittance = D3D11_CreateRenderTarget(Device, TRANSMITTANCE_TEXTURE_WIDTH, TRANSMITTANCE_TEXTURE_HEIGHT, ATMOSPHERE_LUT_FORMAT);
@@ -2114,111 +2300,166 @@ D3D11_ReadTexture3D(d3d11_state* D3D11, ID3D11Texture3D* Texture)
     return Result;
 }
 
+DXGI_FORMAT AtmosphereLutDXGIFormats[] = {
+    DXGI_FORMAT_R32G32B32A32_FLOAT,
+    DXGI_FORMAT_R16G16B16A16_FLOAT,
+    DXGI_FORMAT_R11G11B10_FLOAT,
+    DXGI_FORMAT_R9G9B9E5_SHAREDEXP,
+};
+
+static_assert(ArrayCount(AtmosphereLutDXGIFormats) == ATMOSPHERE_LUT_FORMATS_COUNT);
+
+//Render targets of a precomputed atmosphere are released too
 internal void
-D3D11_PrecompouteAndExportAtmosphere(d3d11_state* D3D11, atmosphere_parameters* Parameters, char* Path)
+D3D11_ReleaseAtmosphere(d3d11_atmosphere* Atmosphere)
+{
+    ID3D11View* Views[] = {
+        Atmosphere->Transmittance.ResourceView, Atmosphere->Transmittance.RenderTarget,
+        Atmosphere->Irradiance.ResourceView, Atmosphere->Irradiance.RenderTarget,
+        Atmosphere->Scattering.ResourceView, Atmosphere->Scattering.RenderTarget,
+    };
+    for(u32 Index = 0; Index < ArrayCount(Views); Index++)
+    {
+        if(Views[Index]) Views[Index]->Release();
+    }
+    
+    Atmosphere->Transmittance.Texture->Release();
+    Atmosphere->Irradiance.Texture->Release();
+    Atmosphere->Scattering.Texture->Release();
+    Atmosphere->ParametersBuffer->Release();
+    *Atmosphere = {};
+}
+
+//Runs the precomputation and returns the LUTs as an atmo file, to release with Free.
+//Formats has one atmosphere_lut_format per LUT
+internal void*
+D3D11_PrecomputeAtmosphereFile(d3d11_state* D3D11, atmosphere_parameters* Parameters, atmosphere_lut_format* Formats,
+                               u64* OutSize)
 {
     d3d11_atmosphere Atmosphere = D3D11_PrecomputeAtmosphere(D3D11, Parameters);
     image_data TransmittanceImage = D3D11_ReadTexture2D(D3D11, Atmosphere.Transmittance.Texture);
     image_data IrradianceImage    = D3D11_ReadTexture2D(D3D11, Atmosphere.Irradiance.Texture);
     image_3d_data ScatteringImage = D3D11_ReadTexture3D(D3D11, Atmosphere.Scattering.Texture);
+    D3D11_ReleaseAtmosphere(&Atmosphere);
     
-    HANDLE FileHandle = CreateFile(Path, GENERIC_WRITE, FILE_SHARE_READ, 0, CREATE_ALWAYS, 0, 0);
-    
-    b32 Success = false;
-    DWORD BytesWriten = 0;
-    
-    u32 ParamsSize = ALIGN_UP(sizeof(atmosphere_parameters), 16);
-    Success = WriteFile(FileHandle, Parameters, ParamsSize, &BytesWriten, 0);
-    Assert(Success && BytesWriten == ParamsSize);
-    
-    u32 TransmittanceSize = TransmittanceImage.Pitch * TransmittanceImage.Height;
-    Assert(TransmittanceSize == TRANSMITTANCE_TEXTURE_WIDTH * TRANSMITTANCE_TEXTURE_HEIGHT * ATMOSPHERE_LUT_FORMAT_SIZE);
-    Success = WriteFile(FileHandle, TransmittanceImage.Data, TransmittanceSize, &BytesWriten, 0);
-    Assert(Success && BytesWriten == TransmittanceSize);
-    
-    u32 IrradianceSize = IrradianceImage.Pitch * IrradianceImage.Height;
-    Assert(IrradianceSize == IRRADIANCE_TEXTURE_WIDTH * IRRADIANCE_TEXTURE_HEIGHT * ATMOSPHERE_LUT_FORMAT_SIZE);
-    Success = WriteFile(FileHandle, IrradianceImage.Data, IrradianceSize, &BytesWriten, 0);
-    Assert(Success && BytesWriten == IrradianceSize);
-    
-    u32 ScatteringSize = ScatteringImage.Width * ScatteringImage.Height * 
-        ScatteringImage.Depth * ScatteringImage.BytesPerPixel;
-    Assert(ScatteringSize == SCATTERING_TEXTURE_WIDTH * SCATTERING_TEXTURE_HEIGHT * SCATTERING_TEXTURE_WIDTH * ATMOSPHERE_LUT_FORMAT_SIZE);
-    Success = WriteFile(FileHandle, ScatteringImage.Data, ScatteringSize, &BytesWriten, 0);
-    Assert(Success && BytesWriten == ScatteringSize);
+    void* Result = BuildAtmosphereFile(Parameters, &TransmittanceImage, &IrradianceImage, &ScatteringImage,
+                                       Formats, OutSize);
     
     Free(TransmittanceImage.Data);
     Free(IrradianceImage.Data);
     Free(ScatteringImage.Data);
+    return Result;
+}
+
+//Formats has one atmosphere_lut_format per LUT, AtmosphereDefaultLutFormats if 0
+internal void
+D3D11_PrecompouteAndExportAtmosphere(d3d11_state* D3D11, atmosphere_parameters* Parameters, char* Path,
+                                     atmosphere_lut_format* Formats = 0)
+{
+    u64 FileSize = 0;
+    void* File = D3D11_PrecomputeAtmosphereFile(D3D11, Parameters, Formats ? Formats : AtmosphereDefaultLutFormats,
+                                                &FileSize);
     
+    HANDLE FileHandle = CreateFile(Path, GENERIC_WRITE, FILE_SHARE_READ, 0, CREATE_ALWAYS, 0, 0);
+    DWORD BytesWriten = 0;
+    b32 Success = WriteFile(FileHandle, File, (DWORD)FileSize, &BytesWriten, 0);
+    Assert(Success && BytesWriten == FileSize);
     CloseHandle(FileHandle);
+    
+    Free(File);
 }
 
 internal void* Win32_ReadEntireFile(char*, u32*);
 internal void Win32_FreeFileMemory(void*);
 
-internal d3d11_atmosphere
-D3D11_LoadAtmosphereFromFile(d3d11_state* D3D11, char* Path)
+//Data is the content of an atmo file of any version, it can be released once this returns.
+//The LUTs are created in the format they are stored in, D3D11 samples all of them.
+//Returns false without creating anything if the file is damaged or its LUT sizes are not
+//the ones of the shaders
+internal b32
+D3D11_LoadAtmosphere(d3d11_state* D3D11, void* Data, u32 Size, d3d11_atmosphere* Atmosphere)
 {
     ID3D11Device* Device = D3D11->Device;
     ID3D11DeviceContext* Context = D3D11->Context;
     
-    u32 Size = 0;
-    u8* Data = (u8*)Win32_ReadEntireFile(Path, &Size);
-    Assert(Data && Size);
-    u8* End = Data + Size;
-    
-    u8* It = Data;
-    u32 ParamsSize = ALIGN_UP(sizeof(atmosphere_parameters), 16);
-    Assert(It + ParamsSize <= End);
+    atmosphere_file File;
+    if(!Data || !ParseAtmosphereFile(Data, Size, &File) || !HasAtmosphereShaderLutSizes(&File))
+    {
+        return false;
+    }
     
     d3d11_atmosphere Result = {};
     Result.ParametersBuffer = D3D11_CreateConstantBuffer(Device, sizeof(atmosphere_parameters));
-    D3D11_FillConstantBuffers(Context, Result.ParametersBuffer, It, sizeof(atmosphere_parameters));
-    
-    It += ParamsSize;
+    D3D11_FillConstantBuffers(Context, Result.ParametersBuffer, &File.Parameters, sizeof(atmosphere_parameters));
     
-    u32 TransmittanceSize = TRANSMITTANCE_TEXTURE_WIDTH * TRANSMITTANCE_TEXTURE_HEIGHT * ATMOSPHERE_LUT_FORMAT_SIZE;
-    Assert(It + TransmittanceSize <= End);
-    
-    image_data TransmittanceImage = CreateImage(It, TRANSMITTANCE_TEXTURE_WIDTH, TRANSMITTANCE_TEXTURE_HEIGHT, 
-                                                ATMOSPHERE_LUT_FORMAT_SIZE * TRANSMITTANCE_TEXTURE_WIDTH, ATMOSPHERE_LUT_FORMAT_SIZE);
-    d3d11_texture Transmittance = D3D11_CreateTexture(Device, &TransmittanceImage, ATMOSPHERE_LUT_FORMAT);
+    atmosphere_lut_header* Info = &File.Luts[ATMOSPHERE_TRANSMITTANCE];
+    u32 BytesPerPixel = AtmosphereLutFormatSizes[Info->Format];
+    image_data TransmittanceImage = CreateImage(File.LutData[ATMOSPHERE_TRANSMITTANCE], Info->Width, Info->Height,
+                                                BytesPerPixel * Info->Width, BytesPerPixel);
+    d3d11_texture Transmittance = D3D11_CreateTexture(Device, &TransmittanceImage, AtmosphereLutDXGIFormats[Info->Format]);
     Result.Transmittance.Texture = Transmittance.Texture;
     Result.Transmittance.ResourceView = Transmittance.ResourceView;
-    Result.Transmittance.Width = TRANSMITTANCE_TEXTURE_WIDTH;
-    Result.Transmittance.Height = TRANSMITTANCE_TEXTURE_HEIGHT;
-
-    It += TransmittanceSize;
-    
-    
-    u32 IrradianceSize = IRRADIANCE_TEXTURE_WIDTH * IRRADIANCE_TEXTURE_HEIGHT * ATMOSPHERE_LUT_FORMAT_SIZE;
-    Assert(It + IrradianceSize <= End);
-    
-    image_data IrradianceImage = CreateImage(It, IRRADIANCE_TEXTURE_WIDTH, IRRADIANCE_TEXTURE_HEIGHT, 
-                                             ATMOSPHERE_LUT_FORMAT_SIZE * IRRADIANCE_TEXTURE_WIDTH, ATMOSPHERE_LUT_FORMAT_SIZE);
-    d3d11_texture Irradiance = D3D11_CreateTexture(Device, &IrradianceImage, ATMOSPHERE_LUT_FORMAT);
+    Result.Transmittance.Width = Info->Width;
+    Result.Transmittance.Height = Info->Height;
+    
+    Info = &File.Luts[ATMOSPHERE_IRRADIANCE];
+    BytesPerPixel = AtmosphereLutFormatSizes[Info->Format];
+    image_data IrradianceImage = CreateImage(File.LutData[ATMOSPHERE_IRRADIANCE], Info->Width, Info->Height,
+                                             BytesPerPixel * Info->Width, BytesPerPixel);
+    d3d11_texture Irradiance = D3D11_CreateTexture(Device, &IrradianceImage, AtmosphereLutDXGIFormats[Info->Format]);
     Result.Irradiance.Texture = Irradiance.Texture;
     Result.Irradiance.ResourceView = Irradiance.ResourceView;
-    Result.Irradiance.Width = IRRADIANCE_TEXTURE_WIDTH;
-    Result.Irradiance.Height = IRRADIANCE_TEXTURE_HEIGHT;
-    
-    It += IrradianceSize;
-    
-    u32 ScatteringSize = SCATTERING_TEXTURE_WIDTH * SCATTERING_TEXTURE_HEIGHT * SCATTERING_TEXTURE_DEPTH * ATMOSPHERE_LUT_FORMAT_SIZE;
-    Assert(It + ScatteringSize <= End);
-    
-    image_3d_data ScatteringImage = CreateImage3D(It, SCATTERING_TEXTURE_WIDTH, SCATTERING_TEXTURE_HEIGHT, 
-                                               SCATTERING_TEXTURE_DEPTH, ATMOSPHERE_LUT_FORMAT_SIZE);
-    d3d11_texture_3d Scattering = D3D11_CreateTexture3D(Device, &ScatteringImage, ATMOSPHERE_LUT_FORMAT);
+    Result.Irradiance.Width = Info->Width;
+    Result.Irradiance.Height = Info->Height;
+    
+    Info = &File.Luts[ATMOSPHERE_SCATTERING];
+    BytesPerPixel = AtmosphereLutFormatSizes[Info->Format];
+    image_3d_data ScatteringImage = CreateImage3D(File.LutData[ATMOSPHERE_SCATTERING], Info->Width, Info->Height,
+                                                  Info->Depth, BytesPerPixel);
+    d3d11_texture_3d Scattering = D3D11_CreateTexture3D(Device, &ScatteringImage, AtmosphereLutDXGIFormats[Info->Format]);
     Result.Scattering.Texture = Scattering.Texture;
     Result.Scattering.ResourceView = Scattering.ResourceView;
-    Result.Scattering.Width = SCATTERING_TEXTURE_WIDTH;
-    Result.Scattering.Height = SCATTERING_TEXTURE_HEIGHT;
-    Result.Scattering.Depth = SCATTERING_TEXTURE_DEPTH;
+    Result.Scattering.Width = Info->Width;
+    Result.Scattering.Height = Info->Height;
+    Result.Scattering.Depth = Info->Depth;
+    
+    *Atmosphere = Result;
+    return true;
+}
+
+internal b32
+D3D11_LoadAtmosphereFromFile(d3d11_state* D3D11, char* Path, d3d11_atmosphere* Atmosphere)
+{
+    u32 Size = 0;
+    void* Data = Win32_ReadEntireFile(Path, &Size);
+    b32 Result = D3D11_LoadAtmosphere(D3D11, Data, Size, Atmosphere);
+    Win32_FreeFileMemory(Data);
+    
+    return Result;
+}
+
+//Data is the atmo file found in the cache for these parameters, if 0 the precomputation
+//runs and its result is added to the cache
+internal d3d11_atmosphere
+D3D11_LoadCachedAtmosphere(d3d11_state* D3D11, atmosphere_cache* Cache, atmosphere_parameters* Parameters,
+                           char* Name, void* Data = 0, u64 Size = 0)
+{
+    if(!Data)
+    {
+        Data = LoadCachedAtmosphere(Cache, Parameters, AtmosphereDefaultLutFormats, &Size);
+    }
     
-    It += ScatteringSize;
-    Assert(It == End);
+    //Files the shaders can't use are computed again like misses
+    d3d11_atmosphere Result = {};
+    if(!D3D11_LoadAtmosphere(D3D11, Data, (u32)Size, &Result))
+    {
+        Free(Data);
+        Data = D3D11_PrecomputeAtmosphereFile(D3D11, Parameters, AtmosphereDefaultLutFormats, &Size);
+        StoreCachedAtmosphere(Cache, Parameters, AtmosphereDefaultLutFormats, Name, Data, Size);
+        b32 Loaded = D3D11_LoadAtmosphere(D3D11, Data, (u32)Size, &Result);
+        Assert(Loaded);
+    }
+    Free(Data);
     
     return Result;
 }
@@ -6,13 +6,9 @@
 #define IRRADIANCE_CUBEMAP_SIZE 32
 #define SPECULAR_CUBEMAP_SIZE 256
 
-#if 1
+//Format of the precomputation render targets, the exported LUTs are converted to the
+//formats stored in the atmo file
 #define ATMOSPHERE_LUT_FORMAT DXGI_FORMAT_R32G32B32A32_FLOAT
-#define ATMOSPHERE_LUT_FORMAT_SIZE 16
-#else
-#define ATMOSPHERE_LUT_FORMAT DXGI_FORMAT_R16G16B16A16_FLOAT
-#define ATMOSPHERE_LUT_FORMAT_SIZE 8
-#endif
 
 struct d3d11_mesh 
 {
@@ -29,8 +25,20 @@ struct d3d11_mesh
     };
     u32 VerticesCount;
     
+    //mesh_shading_vertex stream of MESH_INTERLEAVED meshes, they have no normals, tangents
+    //and UVs buffers
+    ID3D11Buffer* ShadingBuffer;
+    
+    //Quantized positions are in [0, 1] over the bounds of MESH_QUANTIZED meshes, see
+    //GetMeshModelMatrix. UVs are too, the vertex shader maps them back
+    vec3 PositionOffset;
+    vec3 PositionScale;
+    vec2 UVOffset;
+    vec2 UVScale;
+    
     ID3D11Buffer* IndexBuffer;
     u32 IndicesCount;
+    DXGI_FORMAT IndexFormat; //R16_UINT when every index fits, see CanUse16BitIndices
     
     mesh_flag Flags;
 };
@@ -177,6 +185,7 @@ struct d3d11_pbr_vertex_constants
     mat4 Model;
     mat4 NormalMatrix;
     mat4 ShadowMatrix[MAX_DIRECTIONAL_LIGHTS_COUNT];
+    vec4 QuantizedUV; //Offset in xy and scale in zw, for MESH_QUANTIZED meshes
 };
 
 struct d3d11_pbr_pixel_constants
@@ -220,6 +229,9 @@ struct d3d11_pbr_pixel_constants
 struct d3d11_pbr_pipeline
 {
     ID3D11InputLayout* Layout;
+    ID3D11InputLayout* InterleavedLayout; //For MESH_INTERLEAVED meshes
+    ID3D11InputLayout* QuantizedLayout; //For MESH_QUANTIZED meshes, with QuantizedVertexShader
+    ID3D11VertexShader* QuantizedVertexShader;
     ID3D11VertexShader* VertexShader;
     ID3D11PixelShader*  PixelShader;
     
@@ -278,6 +290,7 @@ struct d3d11_shadow_pixel_constants
 struct d3d11_shadow_pipeline
 {
     ID3D11InputLayout* Layout;
+    ID3D11InputLayout* QuantizedLayout; //For MESH_QUANTIZED meshes
     ID3D11RasterizerState* RasterState;
     
     ID3D11VertexShader* VertexShader;
@@ -1,9 +1,21 @@
+//Quantized positions are mapped back to the bounds of the mesh before its transform
+internal mat4
+GetMeshModelMatrix(mesh* Mesh)
+{
+    mesh_gpu* GpuMesh = Mesh->GpuMesh;
+    if(!(GpuMesh->Flags & MESH_QUANTIZED)) return Mesh->DrawTransform;
+    
+    return Mesh->DrawTransform * Mat4FromMat3AndTranslation(Mat3Scale(GpuMesh->PositionScale), GpuMesh->PositionOffset);
+}
+
 internal void
 BindAndDrawMeshForShadows(d3d11_state* D3D11, mesh_gpu* GpuMesh)
 {
     ID3D11DeviceContext* Context = D3D11->Context;
     
-    u32 Strides[] = { sizeof(vec3) };
+    b32 Quantized = GpuMesh->Flags & MESH_QUANTIZED;
+    Context->IASetInputLayout(Quantized ? D3D11->Shadow.QuantizedLayout : D3D11->Shadow.Layout);
+    u32 Strides[] = { Quantized ? (u32)sizeof(quantized_position) : (u32)sizeof(vec3) };
     u32 Offsets[] = { 0 };
     Context->IASetVertexBuffers(0, 1, &GpuMesh->PositionsBuffer, Strides, Offsets);
     Context->IASetPrimitiveTopology(GpuMesh->Flags & MESH_IS_STRIP ? 
@@ -12,7 +24,7 @@ BindAndDrawMeshForShadows(d3d11_state* D3D11, mesh_gpu* GpuMesh)
     //If we have indices we bind em
     if(!(GpuMesh->Flags & MESH_NO_INDICES))
     {
-        Context->IASetIndexBuffer(GpuMesh->IndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+        Context->IASetIndexBuffer(GpuMesh->IndexBuffer, GpuMesh->IndexFormat, 0);
     }
     
     //Draw
@@ -35,7 +47,6 @@ DrawMeshesToShadowMaps(d3d11_state* D3D11, scene* Scene)
     Context->ClearState();
     Context->OMSetDepthStencilState(D3D11->Common.LessDepthStencilState, 0);
     Context->RSSetState(D3D11->Shadow.RasterState);
-    Context->IASetInputLayout(D3D11->Shadow.Layout);
     Context->VSSetShader(D3D11->Shadow.VertexShader, 0, 0);
     Context->VSSetConstantBuffers(0, 1, &D3D11->Shadow.VertexConstantsBuffer);
     Context->PSSetShader(0, 0, 0);
@@ -70,7 +81,7 @@ DrawMeshesToShadowMaps(d3d11_state* D3D11, scene* Scene)
             if(!Mesh->CastsShadows)
                 continue;
             
-            VertexConstants.Model = Mesh->DrawTransform;
+            VertexConstants.Model = GetMeshModelMatrix(Mesh);
             D3D11_FillConstantBuffers(Context, D3D11->Shadow.VertexConstantsBuffer, &VertexConstants, sizeof(VertexConstants));
             
             BindAndDrawMeshForShadows(D3D11, Mesh->GpuMesh);
@@ -91,7 +102,6 @@ DrawMeshesToShadowCubemaps(d3d11_state* D3D11, scene* Scene)
     //the shadowmap, this results in our meshes showing reverse winding. Since we want
     //to capture the backfaces anyways we can use our default rasterizer
     Context->RSSetState(D3D11->Common.SolidRasterState);
-    Context->IASetInputLayout(D3D11->Shadow.Layout);
     Context->VSSetShader(D3D11->Shadow.CubemapVertexShader, 0, 0);
     Context->VSSetConstantBuffers(0, 1, &D3D11->Shadow.VertexConstantsBuffer);
     Context->PSSetShader(D3D11->Shadow.CubemapPixelShader, 0, 0);
@@ -190,7 +200,7 @@ DrawMeshesToShadowCubemaps(d3d11_state* D3D11, scene* Scene)
                 }
                 
                 Counter++;
-                VertexConstants.Model = Mesh->DrawTransform;
+                VertexConstants.Model = GetMeshModelMatrix(Mesh);
                 D3D11_FillConstantBuffers(Context, D3D11->Shadow.VertexConstantsBuffer, &VertexConstants, sizeof(VertexConstants));
                 
                 BindAndDrawMeshForShadows(D3D11, Mesh->GpuMesh);
@@ -201,6 +211,39 @@ DrawMeshesToShadowCubemaps(d3d11_state* D3D11, scene* Scene)
     InspectorData.ObjectsDrawnOnCubemap = Counter;
 }
 
+//Once per frame before the camera passes, so that the depth prepass and the main pass
+//draw the same ranges. The ranges live until the end of D3D11_DrawScene
+internal void
+CullSceneMeshlets(scene* Scene)
+{
+    u32 MeshletIndicesDrawn = 0;
+    u32 MeshletIndicesCount = 0;
+    for(u32 MeshIndex = 0; MeshIndex < Scene->MeshesCount; MeshIndex++)
+    {
+        mesh* Mesh = Scene->Meshes + MeshIndex;
+        mesh_data* MeshData = Mesh->MeshData;
+        Mesh->MeshletRanges = 0;
+        Mesh->MeshletRangesCount = 0;
+        if(!InspectorData.MeshletCulling || !MeshData->MeshletsCount || (Mesh->GpuMesh->Flags & MESH_NO_INDICES))
+            continue;
+        if(InspectorData.FrustumCulling && !IsAABBInsideFrustum(Mesh->AABB, Scene->CameraFrustum.Planes))
+            continue;
+        
+        meshlet_cull_view View = GetMeshletCullView(Scene->Projection * Scene->View, Mesh->DrawTransform,
+                                                    Scene->ViewPosition, !MESH_WINDING_COUNTER_CLOCKWISE);
+        Mesh->MeshletRanges = PushArray(&Scene->ScratchArena, MeshData->MeshletsCount, meshlet_range);
+        Mesh->MeshletRangesCount = CullMeshlets(MeshData, &View, Mesh->MeshletRanges);
+        for(u32 Index = 0; Index < Mesh->MeshletRangesCount; Index++)
+        {
+            MeshletIndicesDrawn += Mesh->MeshletRanges[Index].IndicesCount;
+        }
+        MeshletIndicesCount += MeshData->IndicesCount;
+    }
+    
+    InspectorData.MeshletIndicesDrawn = MeshletIndicesDrawn;
+    InspectorData.MeshletIndicesCount = MeshletIndicesCount;
+}
+
 internal void
 DrawMeshes(d3d11_state* D3D11, scene* Scene, bool DepthOnly)
 {
@@ -226,7 +269,6 @@ DrawMeshes(d3d11_state* D3D11, scene* Scene, bool DepthOnly)
     Context->RSSetViewports(1, &D3D11->Viewport);
     Context->RSSetState(D3D11->Common.SolidRasterState);
     
-    Context->VSSetShader(D3D11->PBR.VertexShader, 0, 0);
     Context->VSSetConstantBuffers(0, 1, &D3D11->PBR.VertexConstantsBuffer);
     
     if(!DepthOnly)
@@ -241,7 +283,9 @@ DrawMeshes(d3d11_state* D3D11, scene* Scene, bool DepthOnly)
         Context->PSSetSamplers(0, ArrayCount(Samplers), Samplers);
     }
     
-    Context->IASetInputLayout(D3D11->PBR.Layout);
+    //Set for every mesh, interleaved and quantized meshes have their own
+    ID3D11InputLayout* Layout = 0;
+    ID3D11VertexShader* VertexShader = 0;
     
     d3d11_pbr_vertex_constants VertexConstants = {};
     VertexConstants.Projection = Scene->Projection;
@@ -286,20 +330,60 @@ DrawMeshes(d3d11_state* D3D11, scene* Scene, bool DepthOnly)
         if(InspectorData.FrustumCulling && !IsAABBInsideFrustum(Mesh->AABB, Scene->CameraFrustum.Planes))
             continue;   
         
-        u32 Strides[] = {sizeof(vec3), sizeof(vec3), sizeof(vec3), sizeof(vec2)};
-        u32 Offsets[] = {0, 0, 0, 0};
-        Context->IASetVertexBuffers(0, 4, GpuMesh->VertexBuffers, Strides, Offsets);
+        ID3D11InputLayout* MeshLayout = D3D11->PBR.Layout;
+        ID3D11VertexShader* MeshVertexShader = D3D11->PBR.VertexShader;
+        if(GpuMesh->Flags & MESH_QUANTIZED)
+        {
+            MeshLayout = D3D11->PBR.QuantizedLayout;
+            MeshVertexShader = D3D11->PBR.QuantizedVertexShader;
+        }
+        else if(GpuMesh->Flags & MESH_INTERLEAVED)
+        {
+            MeshLayout = D3D11->PBR.InterleavedLayout;
+        }
+        if(MeshLayout != Layout)
+        {
+            Context->IASetInputLayout(MeshLayout);
+            Layout = MeshLayout;
+        }
+        if(MeshVertexShader != VertexShader)
+        {
+            Context->VSSetShader(MeshVertexShader, 0, 0);
+            VertexShader = MeshVertexShader;
+        }
+        
+        if(GpuMesh->Flags & MESH_QUANTIZED)
+        {
+            ID3D11Buffer* Buffers[] = {GpuMesh->PositionsBuffer, GpuMesh->ShadingBuffer};
+            u32 Strides[] = {sizeof(quantized_position), sizeof(quantized_shading_vertex)};
+            u32 Offsets[] = {0, 0};
+            Context->IASetVertexBuffers(0, 2, Buffers, Strides, Offsets);
+        }
+        else if(GpuMesh->Flags & MESH_INTERLEAVED)
+        {
+            ID3D11Buffer* Buffers[] = {GpuMesh->PositionsBuffer, GpuMesh->ShadingBuffer};
+            u32 Strides[] = {sizeof(vec3), sizeof(mesh_shading_vertex)};
+            u32 Offsets[] = {0, 0};
+            Context->IASetVertexBuffers(0, 2, Buffers, Strides, Offsets);
+        }
+        else
+        {
+            u32 Strides[] = {sizeof(vec3), sizeof(vec3), sizeof(vec3), sizeof(vec2)};
+            u32 Offsets[] = {0, 0, 0, 0};
+            Context->IASetVertexBuffers(0, 4, GpuMesh->VertexBuffers, Strides, Offsets);
+        }
         Context->IASetPrimitiveTopology(GpuMesh->Flags & MESH_IS_STRIP ? 
                                         D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP: 
                                         D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
         //If we have indices we bind em
         if(!(GpuMesh->Flags & MESH_NO_INDICES))
         {
-            Context->IASetIndexBuffer(GpuMesh->IndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+            Context->IASetIndexBuffer(GpuMesh->IndexBuffer, GpuMesh->IndexFormat, 0);
         }
         
-        VertexConstants.Model = Mesh->DrawTransform;
+        VertexConstants.Model = GetMeshModelMatrix(Mesh);
         VertexConstants.NormalMatrix = Mat4NormalMatrix(Mesh->DrawTransform);
+        VertexConstants.QuantizedUV = vec4(GpuMesh->UVOffset.x, GpuMesh->UVOffset.y, GpuMesh->UVScale.x, GpuMesh->UVScale.y);
         D3D11_FillConstantBuffers(Context, D3D11->PBR.VertexConstantsBuffer, &VertexConstants, sizeof(VertexConstants));
         
         if(!DepthOnly)
@@ -307,6 +391,14 @@ DrawMeshes(d3d11_state* D3D11, scene* Scene, bool DepthOnly)
             //Set material
             Assert(Mesh->MaterialIndex < Scene->MaterialsCount);
             material* Material = Scene->Materials + Mesh->MaterialIndex;
+            f32 ObjectScale = MAX(MAX(Mesh->Scale.x, Mesh->Scale.y), Mesh->Scale.z);
+            f32 UVsPerPixel = GetUVsPerPixel(Mesh->AABB.Min, Mesh->AABB.Max, Scene->ViewPosition, Scene->Projection.e[1][1],
+                                             D3D11->Viewport.Height, Mesh->MeshData->UVDensity, ObjectScale);
+            for(u32 i = 0; i < MATERIAL_TEXTURES_COUNT; i++)
+            {
+                MarkTextureUsed(&Scene->Residency, Material->ResidencyIds[i], UVsPerPixel);
+            }
+            
             PixelConstants.HasAlbedo = Material->HasAlbedo;
             PixelConstants.HasNormal = Material->HasNormal;
             PixelConstants.HasRoughness = Material->HasRoughness;
@@ -348,6 +440,13 @@ DrawMeshes(d3d11_state* D3D11, scene* Scene, bool DepthOnly)
         {
             Context->Draw(GpuMesh->VerticesCount, 0);
         }
+        else if(Mesh->MeshletRanges)
+        {
+            for(u32 Index = 0; Index < Mesh->MeshletRangesCount; Index++)
+            {
+                Context->DrawIndexed(Mesh->MeshletRanges[Index].IndicesCount, Mesh->MeshletRanges[Index].FirstIndex, 0);
+            }
+        }
         else
         {
             Context->DrawIndexed(GpuMesh->IndicesCount, 0, 0);
@@ -432,6 +531,9 @@ D3D11_DrawScene(d3d11_state* D3D11, scene* Scene)
     }
     
     Scene->CameraFrustum = FrustumFromMatrix(Scene->Projection * Scene->View);
+    temporary_memory FrameMemory = BeginTemporaryMemory(&Scene->ScratchArena);
+    CullSceneMeshlets(Scene);
+    
     //Clear intermediate target
     D3D11->Context->ClearRenderTargetView(D3D11->PBR.IntermediateTarget.RenderTarget, vec4(0.0f, 0.0f, 0.0, 0.0f).e);
     
@@ -465,4 +567,6 @@ D3D11_DrawScene(d3d11_state* D3D11, scene* Scene)
         D3D11_PROFILE_BLOCK(D3D11, D3D11_PROFILE_POSTPROCESS);
         DrawPostprocess(D3D11, Scene);
     }    
+    
+    EndTemporaryMemory(FrameMemory);
 }
\ No newline at end of file
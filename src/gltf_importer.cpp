@@ -0,0 +1,832 @@
+// glTF 2.0 importer for the packer, both .gltf (external or data uri buffers) and .glb.
+// All the triangle primitives of the meshes in the default scene are merged in a single
+// mesh. Static meshes are baked with their node transforms, skinned meshes keep the
+// skin space and bring the joints of the first skin and all the animations along.
+
+#define GLTF_BYTE           5120
+#define GLTF_UNSIGNED_BYTE  5121
+#define GLTF_SHORT          5122
+#define GLTF_UNSIGNED_SHORT 5123
+#define GLTF_UNSIGNED_INT   5125
+#define GLTF_FLOAT          5126
+
+#define GLTF_MODE_TRIANGLES 4
+
+#define GLB_MAGIC 0x46546C67 //"glTF"
+#define GLB_CHUNK_JSON 0x4E4F534A
+#define GLB_CHUNK_BIN 0x004E4942
+
+struct gltf_buffer
+{
+    u8* Data;
+    u64 Size;
+    b32 Embedded;
+};
+
+struct gltf_file
+{
+    json_value Root;
+    gltf_buffer* Buffers;
+    u32 BuffersCount;
+    
+    //Whole .glb file, the embedded buffer points into it
+    u8* FileData;
+    u64 FileSize;
+};
+
+struct gltf_accessor
+{
+    u8* Data;
+    u32 Count;
+    u32 Stride;
+    u32 ComponentType;
+    u32 ComponentsCount;
+    b32 Normalized;
+};
+
+internal u8*
+GltfReadEntireFile(char* Path, u64* OutSize)
+{
+    FILE* File = fopen(Path, "rb");
+    if(!File) return 0;
+    
+    fseek(File, 0, SEEK_END);
+    u64 Size = ftell(File);
+    fseek(File, 0, SEEK_SET);
+    
+    //Zero terminated so that the JSON parser can use it directly
+    u8* Result = (u8*)ZeroAlloc(Size + 1);
+    if(fread(Result, 1, Size, File) != Size)
+    {
+        Free(Result);
+        Result = 0;
+    }
+    fclose(File);
+    
+    *OutSize = Size;
+    return Result;
+}
+
+internal u32
+GltfBase64Value(char C)
+{
+    if(C >= 'A' && C <= 'Z') return C - 'A';
+    if(C >= 'a' && C <= 'z') return C - 'a' + 26;
+    if(C >= '0' && C <= '9') return C - '0' + 52;
+    if(C == '+' || C == '-') return 62;
+    if(C == '/' || C == '_') return 63;
+    return 64;
+}
+
+internal u8*
+GltfDecodeBase64(char* Text, u64* OutSize)
+{
+    u64 Length = strlen(Text);
+    u8* Result = (u8*)ZeroAlloc(Length / 4 * 3 + 3);
+    u8* Out = Result;
+    
+    u32 Bits = 0;
+    u32 BitsCount = 0;
+    for(u64 Index = 0; Index < Length; Index++)
+    {
+        u32 Value = GltfBase64Value(Text[Index]);
+        if(Value == 64) break;
+        
+        Bits = (Bits << 6) | Value;
+        BitsCount += 6;
+        if(BitsCount >= 8)
+        {
+            BitsCount -= 8;
+            *Out++ = (u8)(Bits >> BitsCount);
+        }
+    }
+    
+    *OutSize = Out - Result;
+    return Result;
+}
+
+internal b32
+GltfLoad(char* Path, gltf_file* Gltf)
+{
+    *Gltf = {};
+    
+    u64 FileSize = 0;
+    u8* FileData = GltfReadEntireFile(Path, &FileSize);
+    if(!FileData) return false;
+    
+    char* Json = (char*)FileData;
+    u64 JsonLength = FileSize;
+    gltf_buffer EmbeddedBuffer = {};
+    if(FileSize >= 20 && *(u32*)FileData == GLB_MAGIC)
+    {
+        //Header: magic, version, length, then chunks of length, type and data
+        u64 At = 12;
+        while(At + 8 <= FileSize)
+        {
+            u32 ChunkLength = *(u32*)(FileData + At);
+            u32 ChunkType = *(u32*)(FileData + At + 4);
+            u8* ChunkData = FileData + At + 8;
+            if(At + 8 + ChunkLength > FileSize) break;
+            
+            if(ChunkType == GLB_CHUNK_JSON)
+            {
+                //Copy it to have the zero terminator
+                Json = (char*)ZeroAlloc(ChunkLength + 1);
+                memcpy(Json, ChunkData, ChunkLength);
+                JsonLength = ChunkLength;
+            }
+            else if(ChunkType == GLB_CHUNK_BIN)
+            {
+                EmbeddedBuffer.Data = ChunkData;
+                EmbeddedBuffer.Size = ChunkLength;
+                EmbeddedBuffer.Embedded = true;
+            }
+            At += 8 + ALIGN_UP(ChunkLength, 4);
+        }
+    }
+    Gltf->FileData = FileData;
+    Gltf->FileSize = FileSize;
+    
+    b32 Parsed = ParseJson(Json, JsonLength, &Gltf->Root);
+    if(Json != (char*)FileData) Free(Json);
+    if(!Parsed) return false;
+    
+    json_value* Buffers = JsonGet(&Gltf->Root, "buffers");
+    Gltf->BuffersCount = Buffers ? Buffers->Count : 0;
+    Gltf->Buffers = (gltf_buffer*)ZeroAlloc(sizeof(gltf_buffer) * (Gltf->BuffersCount + 1));
+    for(u32 Index = 0; Index < Gltf->BuffersCount; Index++)
+    {
+        json_value* Buffer = JsonAt(Buffers, Index);
+        char* Uri = JsonString(JsonGet(Buffer, "uri"));
+        gltf_buffer* Result = &Gltf->Buffers[Index];
+        if(!Uri)
+        {
+            *Result = EmbeddedBuffer;
+        }
+        else if(strncmp(Uri, "data:", 5) == 0)
+        {
+            char* Comma = strchr(Uri, ',');
+            if(!Comma) return false;
+            Result->Data = GltfDecodeBase64(Comma + 1, &Result->Size);
+        }
+        else
+        {
+            //Relative to the directory of the gltf file
+            char BufferPath[1024];
+            char* Slash = strrchr(Path, '/');
+            s32 DirectoryLength = Slash ? (s32)(Slash - Path + 1) : 0;
+            snprintf(BufferPath, sizeof(BufferPath), "%.*s%s", DirectoryLength, Path, Uri);
+            Result->Data = GltfReadEntireFile(BufferPath, &Result->Size);
+        }
+        
+        if(!Result->Data) return false;
+    }
+    
+    return true;
+}
+
+internal void
+GltfFree(gltf_file* Gltf)
+{
+    for(u32 Index = 0; Index < Gltf->BuffersCount; Index++)
+    {
+        if(!Gltf->Buffers[Index].Embedded) Free(Gltf->Buffers[Index].Data);
+    }
+    Free(Gltf->Buffers);
+    Free(Gltf->FileData);
+    FreeJson(&Gltf->Root);
+    *Gltf = {};
+}
+
+internal u32
+GltfComponentSize(u32 ComponentType)
+{
+    switch(ComponentType)
+    {
+        case GLTF_BYTE: case GLTF_UNSIGNED_BYTE: return 1;
+        case GLTF_SHORT: case GLTF_UNSIGNED_SHORT: return 2;
+        case GLTF_UNSIGNED_INT: case GLTF_FLOAT: return 4;
+    }
+    return 0;
+}
+
+internal u32
+GltfComponentsCount(char* Type)
+{
+    if(strcmp(Type, "SCALAR") == 0) return 1;
+    if(strcmp(Type, "VEC2") == 0) return 2;
+    if(strcmp(Type, "VEC3") == 0) return 3;
+    if(strcmp(Type, "VEC4") == 0) return 4;
+    if(strcmp(Type, "MAT4") == 0) return 16;
+    return 0;
+}
+
+//Sparse accessors are not supported
+internal b32
+GltfGetAccessor(gltf_file* Gltf, s64 AccessorIndex, gltf_accessor* Result)
+{
+    *Result = {};
+    json_value* Accessor = JsonAt(JsonGet(&Gltf->Root, "accessors"), (u32)AccessorIndex);
+    if(AccessorIndex < 0 || !Accessor) return false;
+    
+    Result->Count = (u32)JsonInteger(JsonGet(Accessor, "count"), 0);
+    Result->ComponentType = (u32)JsonInteger(JsonGet(Accessor, "componentType"), 0);
+    Result->ComponentsCount = GltfComponentsCount(JsonString(JsonGet(Accessor, "type"), ""));
+    Result->Normalized = JsonGet(Accessor, "normalized") && JsonGet(Accessor, "normalized")->Type == JSON_TRUE;
+    
+    u32 ElementSize = GltfComponentSize(Result->ComponentType) * Result->ComponentsCount;
+    if(!ElementSize) return false;
+    
+    json_value* View = JsonAt(JsonGet(&Gltf->Root, "bufferViews"), (u32)JsonInteger(JsonGet(Accessor, "bufferView")));
+    if(!View) return false;
+    
+    u32 BufferIndex = (u32)JsonInteger(JsonGet(View, "buffer"), 0);
+    if(BufferIndex >= Gltf->BuffersCount) return false;
+    gltf_buffer* Buffer = &Gltf->Buffers[BufferIndex];
+    
+    u64 Offset = JsonInteger(JsonGet(View, "byteOffset"), 0) + JsonInteger(JsonGet(Accessor, "byteOffset"), 0);
+    Result->Stride = (u32)JsonInteger(JsonGet(View, "byteStride"), ElementSize);
+    Result->Data = Buffer->Data + Offset;
+    
+    if(Result->Count && Offset + (u64)Result->Stride * (Result->Count - 1) + ElementSize > Buffer->Size) return false;
+    return true;
+}
+
+internal f32
+GltfReadFloat(gltf_accessor* Accessor, u32 Element, u32 Component)
+{
+    if(Component >= Accessor->ComponentsCount) return 0.0f;
+    
+    u8* At = Accessor->Data + (u64)Accessor->Stride * Element + GltfComponentSize(Accessor->ComponentType) * Component;
+    b32 Normalized = Accessor->Normalized;
+    switch(Accessor->ComponentType)
+    {
+        case GLTF_FLOAT: { f32 V; memcpy(&V, At, 4); return V; }
+        case GLTF_BYTE: return Normalized ? MAX(*(s8*)At / 127.0f, -1.0f) : *(s8*)At;
+        case GLTF_UNSIGNED_BYTE: return Normalized ? *At / 255.0f : *At;
+        case GLTF_SHORT: { s16 V; memcpy(&V, At, 2); return Normalized ? MAX(V / 32767.0f, -1.0f) : V; }
+        case GLTF_UNSIGNED_SHORT: { u16 V; memcpy(&V, At, 2); return Normalized ? V / 65535.0f : V; }
+        case GLTF_UNSIGNED_INT: { u32 V; memcpy(&V, At, 4); return (f32)V; }
+    }
+    return 0.0f;
+}
+
+internal u32
+GltfReadUInt(gltf_accessor* Accessor, u32 Element, u32 Component)
+{
+    if(Component >= Accessor->ComponentsCount) return 0;
+    
+    u8* At = Accessor->Data + (u64)Accessor->Stride * Element + GltfComponentSize(Accessor->ComponentType) * Component;
+    switch(Accessor->ComponentType)
+    {
+        case GLTF_UNSIGNED_BYTE: return *At;
+        case GLTF_UNSIGNED_SHORT: { u16 V; memcpy(&V, At, 2); return V; }
+        case GLTF_UNSIGNED_INT: { u32 V; memcpy(&V, At, 4); return V; }
+    }
+    return 0;
+}
+
+internal void
+GltfGetNodeTransform(json_value* Node, vec3* Translation, quaternion* Rotation, vec3* Scale)
+{
+    *Translation = vec3(0.0f);
+    *Rotation = Quaternion(0, 0, 0, 1);
+    *Scale = vec3(1.0f);
+    
+    json_value* Matrix = JsonGet(Node, "matrix");
+    if(Matrix && Matrix->Count == 16)
+    {
+        mat4 M;
+        for(u32 Index = 0; Index < 16; Index++)
+        {
+            M.Columns[Index / 4].e[Index % 4] = (f32)JsonNumber(JsonAt(Matrix, Index));
+        }
+        
+        //Remove the scale before extracting the rotation
+        for(u32 Column = 0; Column < 3; Column++)
+        {
+            f32 ColumnScale = Length(vec3(M.Columns[Column]));
+            Scale->e[Column] = ColumnScale;
+            if(ColumnScale > 0.0f) M.Columns[Column] = M.Columns[Column] * (1.0f / ColumnScale);
+        }
+        Mat4ToPositionAndQuaternion(M, Translation, Rotation);
+        return;
+    }
+    
+    json_value* T = JsonGet(Node, "translation");
+    json_value* R = JsonGet(Node, "rotation");
+    json_value* S = JsonGet(Node, "scale");
+    for(u32 Index = 0; Index < 3; Index++)
+    {
+        if(T) Translation->e[Index] = (f32)JsonNumber(JsonAt(T, Index));
+        if(S) Scale->e[Index] = (f32)JsonNumber(JsonAt(S, Index), 1.0);
+    }
+    if(R)
+    {
+        for(u32 Index = 0; Index < 4; Index++)
+        {
+            Rotation->e[Index] = (f32)JsonNumber(JsonAt(R, Index));
+        }
+    }
+}
+
+internal mat4
+GltfGetNodeMatrix(json_value* Node)
+{
+    vec3 Translation, Scale;
+    quaternion Rotation;
+    GltfGetNodeTransform(Node, &Translation, &Rotation, &Scale);
+    return Mat4Translation(Translation) * QuaternionToMat4(Rotation) * Mat4Scale(Scale);
+}
+
+//Parent node index for every node, -1 for roots
+internal s32*
+GltfGetNodeParents(json_value* Nodes)
+{
+    u32 NodesCount = Nodes ? Nodes->Count : 0;
+    s32* Parents = (s32*)ZeroAlloc(sizeof(s32) * (NodesCount + 1));
+    for(u32 Index = 0; Index < NodesCount; Index++)
+    {
+        Parents[Index] = -1;
+    }
+    for(u32 Index = 0; Index < NodesCount; Index++)
+    {
+        json_value* Children = JsonGet(JsonAt(Nodes, Index), "children");
+        for(u32 Child = 0; Children && Child < Children->Count; Child++)
+        {
+            s64 ChildIndex = JsonInteger(JsonAt(Children, Child));
+            if(ChildIndex >= 0 && ChildIndex < NodesCount) Parents[ChildIndex] = Index;
+        }
+    }
+    return Parents;
+}
+
+internal mat4
+GltfGetNodeWorldMatrix(json_value* Nodes, s32* Parents, s32 NodeIndex)
+{
+    mat4 Result = Mat4Identity();
+    for(s32 Index = NodeIndex; Index >= 0; Index = Parents[Index])
+    {
+        Result = GltfGetNodeMatrix(JsonAt(Nodes, Index)) * Result;
+    }
+    return Result;
+}
+
+struct gltf_mesh_builder
+{
+    mesh_data* Mesh;
+    u32 VerticesCapacity;
+    u32 IndicesCapacity;
+    b32 HasNormals;
+    b32 HasTangents;
+    b32 HasSkin;
+};
+
+internal void
+GltfReserve(gltf_mesh_builder* Builder, u32 VerticesCount, u32 IndicesCount)
+{
+    mesh_data* Mesh = Builder->Mesh;
+    if(Mesh->VerticesCount + VerticesCount > Builder->VerticesCapacity)
+    {
+        Builder->VerticesCapacity = MAX(Builder->VerticesCapacity * 2, Mesh->VerticesCount + VerticesCount);
+        u32 Capacity = Builder->VerticesCapacity;
+        Mesh->Positions = (vec3*)realloc(Mesh->Positions, sizeof(vec3) * Capacity);
+        Mesh->Normals = (vec3*)realloc(Mesh->Normals, sizeof(vec3) * Capacity);
+        Mesh->Tangents = (vec3*)realloc(Mesh->Tangents, sizeof(vec3) * Capacity);
+        Mesh->UVs = (vec2*)realloc(Mesh->UVs, sizeof(vec2) * Capacity);
+        Mesh->Weights = (vec4*)realloc(Mesh->Weights, sizeof(vec4) * Capacity);
+        Mesh->Joints = (ivec4*)realloc(Mesh->Joints, sizeof(ivec4) * Capacity);
+    }
+    
+    if(Mesh->IndicesCount + IndicesCount > Builder->IndicesCapacity)
+    {
+        Builder->IndicesCapacity = MAX(Builder->IndicesCapacity * 2, Mesh->IndicesCount + IndicesCount);
+        Mesh->Indices = (u32*)realloc(Mesh->Indices, sizeof(u32) * Builder->IndicesCapacity);
+    }
+}
+
+internal b32
+GltfAppendPrimitive(gltf_file* Gltf, json_value* Primitive, mat4 Transform, gltf_mesh_builder* Builder)
+{
+    if(JsonInteger(JsonGet(Primitive, "mode"), GLTF_MODE_TRIANGLES) != GLTF_MODE_TRIANGLES)
+    {
+        //Lines, points and strips are skipped
+        return true;
+    }
+    
+    json_value* Attributes = JsonGet(Primitive, "attributes");
+    gltf_accessor Positions, Normals, Tangents, UVs, Joints, Weights, Indices;
+    if(!GltfGetAccessor(Gltf, JsonInteger(JsonGet(Attributes, "POSITION")), &Positions)) return false;
+    b32 HasNormals = GltfGetAccessor(Gltf, JsonInteger(JsonGet(Attributes, "NORMAL")), &Normals);
+    b32 HasTangents = GltfGetAccessor(Gltf, JsonInteger(JsonGet(Attributes, "TANGENT")), &Tangents);
+    b32 HasUVs = GltfGetAccessor(Gltf, JsonInteger(JsonGet(Attributes, "TEXCOORD_0")), &UVs);
+    b32 HasJoints = GltfGetAccessor(Gltf, JsonInteger(JsonGet(Attributes, "JOINTS_0")), &Joints);
+    b32 HasWeights = GltfGetAccessor(Gltf, JsonInteger(JsonGet(Attributes, "WEIGHTS_0")), &Weights);
+    b32 HasIndices = GltfGetAccessor(Gltf, JsonInteger(JsonGet(Primitive, "indices")), &Indices);
+    
+    u32 VerticesCount = Positions.Count;
+    u32 IndicesCount = HasIndices ? Indices.Count : VerticesCount;
+    if((HasNormals && Normals.Count != VerticesCount) || (HasTangents && Tangents.Count != VerticesCount) ||
+       (HasUVs && UVs.Count != VerticesCount) || (HasJoints && Joints.Count != VerticesCount) ||
+       (HasWeights && Weights.Count != VerticesCount) || IndicesCount % 3 != 0)
+    {
+        return false;
+    }
+    
+    Builder->HasNormals |= HasNormals;
+    Builder->HasTangents |= HasTangents;
+    GltfReserve(Builder, VerticesCount, IndicesCount);
+    
+    mesh_data* Mesh = Builder->Mesh;
+    mat4 NormalMatrix = Mat4NormalMatrix(Transform);
+    u32 BaseVertex = Mesh->VerticesCount;
+    for(u32 Index = 0; Index < VerticesCount; Index++)
+    {
+        u32 Vertex = BaseVertex + Index;
+        vec4 P = vec4(GltfReadFloat(&Positions, Index, 0), GltfReadFloat(&Positions, Index, 1), GltfReadFloat(&Positions, Index, 2), 1.0f);
+        Mesh->Positions[Vertex] = vec3(Transform * P);
+        
+        Mesh->Normals[Vertex] = vec3(0.0f);
+        if(HasNormals)
+        {
+            vec4 N = vec4(GltfReadFloat(&Normals, Index, 0), GltfReadFloat(&Normals, Index, 1), GltfReadFloat(&Normals, Index, 2), 0.0f);
+            Mesh->Normals[Vertex] = Normalize(vec3(NormalMatrix * N));
+        }
+        
+        Mesh->Tangents[Vertex] = vec3(1.0f, 0.0f, 0.0f);
+        if(HasTangents)
+        {
+            vec4 T = vec4(GltfReadFloat(&Tangents, Index, 0), GltfReadFloat(&Tangents, Index, 1), GltfReadFloat(&Tangents, Index, 2), 0.0f);
+            Mesh->Tangents[Vertex] = Normalize(vec3(Transform * T));
+        }
+        
+        Mesh->UVs[Vertex] = HasUVs ? vec2(GltfReadFloat(&UVs, Index, 0), GltfReadFloat(&UVs, Index, 1)) : vec2(0.0f);
+        
+        Mesh->Joints[Vertex] = {};
+        Mesh->Weights[Vertex] = vec4(0.0f);
+        for(u32 Component = 0; Component < 4; Component++)
+        {
+            if(HasJoints) Mesh->Joints[Vertex].e[Component] = (s32)GltfReadUInt(&Joints, Index, Component);
+            if(HasWeights) Mesh->Weights[Vertex].e[Component] = GltfReadFloat(&Weights, Index, Component);
+        }
+    }
+    
+    for(u32 Index = 0; Index < IndicesCount; Index++)
+    {
+        u32 VertexIndex = HasIndices ? GltfReadUInt(&Indices, Index, 0) : Index;
+        if(VertexIndex >= VerticesCount) return false;
+        Mesh->Indices[Mesh->IndicesCount + Index] = BaseVertex + VertexIndex;
+    }
+    
+    Mesh->VerticesCount += VerticesCount;
+    Mesh->IndicesCount += IndicesCount;
+    return true;
+}
+
+//Samples a channel at Time, Components is 3 for translations and 4 for rotations
+internal void
+GltfSampleChannel(gltf_accessor* Input, gltf_accessor* Output, b32 Step, b32 CubicSpline, u32 Components, f32 Time, f32* Result)
+{
+    u32 Last = Input->Count - 1;
+    u32 Begin = 0;
+    while(Begin < Last && GltfReadFloat(Input, Begin + 1, 0) <= Time)
+    {
+        Begin++;
+    }
+    u32 End = MIN(Begin + 1, Last);
+    
+    f32 BeginTime = GltfReadFloat(Input, Begin, 0);
+    f32 EndTime = GltfReadFloat(Input, End, 0);
+    f32 Mix = EndTime > BeginTime ? Clamp((Time - BeginTime) / (EndTime - BeginTime), 0.0f, 1.0f) : 0.0f;
+    if(Step) Mix = 0.0f;
+    
+    //Cubic splines store in-tangent, value and out-tangent, we just use the values
+    u32 Stride = CubicSpline ? 3 : 1;
+    u32 Offset = CubicSpline ? 1 : 0;
+    f32 A[4], B[4];
+    for(u32 Component = 0; Component < Components; Component++)
+    {
+        A[Component] = GltfReadFloat(Output, Begin * Stride + Offset, Component);
+        B[Component] = GltfReadFloat(Output, End * Stride + Offset, Component);
+    }
+    
+    if(Components == 4)
+    {
+        quaternion Q = Interpolate(Quaternion(A[0], A[1], A[2], A[3]), Quaternion(B[0], B[1], B[2], B[3]), Mix);
+        memcpy(Result, Q.e, sizeof(Q.e));
+    }
+    else
+    {
+        for(u32 Component = 0; Component < Components; Component++)
+        {
+            Result[Component] = A[Component] + (B[Component] - A[Component]) * Mix;
+        }
+    }
+}
+
+internal int
+GltfCompareFloats(const void* A, const void* B)
+{
+    f32 a = *(f32*)A;
+    f32 b = *(f32*)B;
+    return (a > b) - (a < b);
+}
+
+//Joints are laid out breadth first so that the children of every joint are contiguous,
+//RootJoint is the start of the array of all joints as the asset layout requires
+internal b32
+GltfImportSkin(gltf_file* Gltf, json_value* Skin, s32* Parents, mesh_data* Mesh)
+{
+    json_value* Nodes = JsonGet(&Gltf->Root, "nodes");
+    json_value* SkinJoints = JsonGet(Skin, "joints");
+    u32 JointsCount = SkinJoints ? SkinJoints->Count : 0;
+    if(JointsCount == 0 || JointsCount > MAX_MESH_JOINTS) return false;
+    
+    //Joint id for every node, -1 if the node is not a joint
+    u32 NodesCount = Nodes->Count;
+    s32* NodeToJoint = (s32*)ZeroAlloc(sizeof(s32) * NodesCount);
+    for(u32 Index = 0; Index < NodesCount; Index++) NodeToJoint[Index] = -1;
+    s32* JointNodes = (s32*)ZeroAlloc(sizeof(s32) * JointsCount);
+    for(u32 Id = 0; Id < JointsCount; Id++)
+    {
+        s64 Node = JsonInteger(JsonAt(SkinJoints, Id));
+        if(Node < 0 || Node >= NodesCount) return false;
+        JointNodes[Id] = (s32)Node;
+        NodeToJoint[Node] = Id;
+    }
+    
+    //The runtime supports a single root joint
+    s32 RootId = -1;
+    for(u32 Id = 0; Id < JointsCount; Id++)
+    {
+        s32 Parent = Parents[JointNodes[Id]];
+        if(Parent < 0 || NodeToJoint[Parent] < 0)
+        {
+            if(RootId >= 0) return false;
+            RootId = Id;
+        }
+    }
+    if(RootId < 0) return false;
+    
+    gltf_accessor InverseBindMatrices = {};
+    b32 HasInverseBindMatrices = GltfGetAccessor(Gltf, JsonInteger(JsonGet(Skin, "inverseBindMatrices")), &InverseBindMatrices);
+    
+    mesh_joint* Joints = (mesh_joint*)ZeroAlloc(sizeof(mesh_joint) * JointsCount);
+    s32* Order = (s32*)ZeroAlloc(sizeof(s32) * JointsCount);
+    Order[0] = RootId;
+    u32 OrderCount = 1;
+    for(u32 Position = 0; Position < OrderCount; Position++)
+    {
+        u32 Id = Order[Position];
+        mesh_joint* Joint = &Joints[Position];
+        Joint->Id = Id;
+        Joint->InverseBindMatrix = Mat4Identity();
+        if(HasInverseBindMatrices)
+        {
+            for(u32 Index = 0; Index < 16; Index++)
+            {
+                Joint->InverseBindMatrix.Columns[Index / 4].e[Index % 4] = GltfReadFloat(&InverseBindMatrices, Id, Index);
+            }
+        }
+        
+        json_value* ChildNodes = JsonGet(JsonAt(Nodes, JointNodes[Id]), "children");
+        mesh_joint* Children = &Joints[OrderCount];
+        for(u32 Child = 0; ChildNodes && Child < ChildNodes->Count; Child++)
+        {
+            s32 ChildJoint = NodeToJoint[JsonInteger(JsonAt(ChildNodes, Child))];
+            if(ChildJoint >= 0)
+            {
+                Order[OrderCount++] = ChildJoint;
+                Joint->ChildrenCount++;
+            }
+        }
+        SET_RELATIVE_POINTER(Joint->ChildrenOffset, Joint->ChildrenCount ? Children : 0);
+    }
+    
+    Mesh->RootJoint = Joints;
+    Mesh->JointsCount = JointsCount;
+    
+    //Animations, every joint gets keyframes at the union of the times of its translation and
+    //rotation channels, joints without channels hold their rest pose
+    json_value* Animations = JsonGet(&Gltf->Root, "animations");
+    Mesh->AnimationsCount = Animations ? Animations->Count : 0;
+    Mesh->Animations = (mesh_animation*)ZeroAlloc(sizeof(mesh_animation) * (Mesh->AnimationsCount + 1));
+    for(u32 AnimationIndex = 0; AnimationIndex < Mesh->AnimationsCount; AnimationIndex++)
+    {
+        json_value* Animation = JsonAt(Animations, AnimationIndex);
+        json_value* Channels = JsonGet(Animation, "channels");
+        json_value* Samplers = JsonGet(Animation, "samplers");
+        
+        mesh_animation* Result = &Mesh->Animations[AnimationIndex];
+        joint_animation* JointAnimations = (joint_animation*)ZeroAlloc(sizeof(joint_animation) * JointsCount);
+        SET_RELATIVE_POINTER(Result->JointsOffset, JointAnimations);
+        
+        for(u32 Id = 0; Id < JointsCount; Id++)
+        {
+            json_value* ChannelSamplers[2] = {}; //Translation and rotation
+            for(u32 ChannelIndex = 0; Channels && ChannelIndex < Channels->Count; ChannelIndex++)
+            {
+                json_value* Channel = JsonAt(Channels, ChannelIndex);
+                json_value* Target = JsonGet(Channel, "target");
+                if(JsonInteger(JsonGet(Target, "node")) != JointNodes[Id]) continue;
+                
+                char* Path = JsonString(JsonGet(Target, "path"), "");
+                json_value* Sampler = JsonAt(Samplers, (u32)JsonInteger(JsonGet(Channel, "sampler")));
+                if(strcmp(Path, "translation") == 0) ChannelSamplers[0] = Sampler;
+                if(strcmp(Path, "rotation") == 0) ChannelSamplers[1] = Sampler;
+            }
+            
+            gltf_accessor Inputs[2] = {};
+            gltf_accessor Outputs[2] = {};
+            b32 Valid[2] = {};
+            u32 TimesCount = 0;
+            for(u32 Channel = 0; Channel < 2; Channel++)
+            {
+                json_value* Sampler = ChannelSamplers[Channel];
+                Valid[Channel] = Sampler &&
+                    GltfGetAccessor(Gltf, JsonInteger(JsonGet(Sampler, "input")), &Inputs[Channel]) &&
+                    GltfGetAccessor(Gltf, JsonInteger(JsonGet(Sampler, "output")), &Outputs[Channel]) &&
+                    Inputs[Channel].Count > 0;
+                if(Valid[Channel]) TimesCount += Inputs[Channel].Count;
+            }
+            
+            f32* Times = (f32*)ZeroAlloc(sizeof(f32) * (TimesCount + 1));
+            u32 At = 0;
+            for(u32 Channel = 0; Channel < 2; Channel++)
+            {
+                for(u32 Index = 0; Valid[Channel] && Index < Inputs[Channel].Count; Index++)
+                {
+                    Times[At++] = GltfReadFloat(&Inputs[Channel], Index, 0);
+                }
+            }
+            qsort(Times, TimesCount, sizeof(f32), GltfCompareFloats);
+            
+            u32 UniqueCount = 0;
+            for(u32 Index = 0; Index < TimesCount; Index++)
+            {
+                if(UniqueCount == 0 || Times[Index] > Times[UniqueCount - 1]) Times[UniqueCount++] = Times[Index];
+            }
+            if(UniqueCount) Result->Duration = MAX(Result->Duration, Times[UniqueCount - 1]);
+            
+            vec3 RestTranslation, RestScale;
+            quaternion RestRotation;
+            GltfGetNodeTransform(JsonAt(Nodes, JointNodes[Id]), &RestTranslation, &RestRotation, &RestScale);
+            
+            joint_animation* JointAnimation = &JointAnimations[Id];
+            animation_keyframe* Keyframes = (animation_keyframe*)ZeroAlloc(sizeof(animation_keyframe) * (UniqueCount + 2));
+            JointAnimation->KeyframesCount = UniqueCount;
+            SET_RELATIVE_POINTER(JointAnimation->KeyframesOffset, Keyframes);
+            for(u32 Index = 0; Index < UniqueCount; Index++)
+            {
+                animation_keyframe* Keyframe = &Keyframes[Index];
+                Keyframe->Time = Times[Index];
+                Keyframe->Position = RestTranslation;
+                Keyframe->Rotation = RestRotation;
+                for(u32 Channel = 0; Channel < 2; Channel++)
+                {
+                    if(!Valid[Channel]) continue;
+                    
+                    char* Interpolation = JsonString(JsonGet(ChannelSamplers[Channel], "interpolation"), "LINEAR");
+                    b32 Step = strcmp(Interpolation, "STEP") == 0;
+                    b32 CubicSpline = strcmp(Interpolation, "CUBICSPLINE") == 0;
+                    f32* Value = Channel == 0 ? Keyframe->Position.e : Keyframe->Rotation.e;
+                    GltfSampleChannel(&Inputs[Channel], &Outputs[Channel], Step, CubicSpline, Channel == 0 ? 3 : 4, Times[Index], Value);
+                }
+            }
+            Free(Times);
+        }
+        
+        //Every joint must cover [0, Duration] because the animator interpolates between
+        //the keyframes around the current time of the whole animation
+        for(u32 Id = 0; Id < JointsCount; Id++)
+        {
+            joint_animation* JointAnimation = &JointAnimations[Id];
+            animation_keyframe* Keyframes = GetJointKeyframes(JointAnimation);
+            if(JointAnimation->KeyframesCount == 0)
+            {
+                vec3 RestTranslation, RestScale;
+                quaternion RestRotation;
+                GltfGetNodeTransform(JsonAt(Nodes, JointNodes[Id]), &RestTranslation, &RestRotation, &RestScale);
+                Keyframes[0].Position = RestTranslation;
+                Keyframes[0].Rotation = RestRotation;
+                JointAnimation->KeyframesCount = 1;
+            }
+            
+            if(Keyframes[0].Time > 0.0f)
+            {
+                memmove(Keyframes + 1, Keyframes, sizeof(animation_keyframe) * JointAnimation->KeyframesCount);
+                Keyframes[0].Time = 0.0f;
+                JointAnimation->KeyframesCount++;
+            }
+            
+            animation_keyframe* Last = &Keyframes[JointAnimation->KeyframesCount - 1];
+            if(JointAnimation->KeyframesCount == 1 || Last->Time < Result->Duration)
+            {
+                Keyframes[JointAnimation->KeyframesCount] = *Last;
+                Keyframes[JointAnimation->KeyframesCount].Time = MAX(Result->Duration, Last->Time + 1.0f / 30.0f);
+                JointAnimation->KeyframesCount++;
+            }
+        }
+        Result->Duration = MAX(Result->Duration, GetJointKeyframes(&JointAnimations[0])[JointAnimations[0].KeyframesCount - 1].Time);
+    }
+    
+    Free(Order);
+    Free(JointNodes);
+    Free(NodeToJoint);
+    return true;
+}
+
+internal void
+GltfCollectMeshNodes(json_value* Nodes, s32 NodeIndex, s32* MeshNodes, u32* MeshNodesCount, u32 Depth = 0)
+{
+    json_value* Node = JsonAt(Nodes, NodeIndex);
+    if(!Node || Depth > 256) return;
+    
+    if(JsonGet(Node, "mesh")) MeshNodes[(*MeshNodesCount)++] = NodeIndex;
+    
+    json_value* Children = JsonGet(Node, "children");
+    for(u32 Child = 0; Children && Child < Children->Count && *MeshNodesCount < Nodes->Count; Child++)
+    {
+        GltfCollectMeshNodes(Nodes, (s32)JsonInteger(JsonAt(Children, Child)), MeshNodes, MeshNodesCount, Depth + 1);
+    }
+}
+
+internal b32
+ImportGltfMesh(char* Path, mesh_data* Result)
+{
+    *Result = {};
+    gltf_file Gltf;
+    if(!GltfLoad(Path, &Gltf))
+    {
+        GltfFree(&Gltf);
+        return false;
+    }
+    
+    json_value* Nodes = JsonGet(&Gltf.Root, "nodes");
+    json_value* Meshes = JsonGet(&Gltf.Root, "meshes");
+    u32 NodesCount = Nodes ? Nodes->Count : 0;
+    s32* Parents = GltfGetNodeParents(Nodes);
+    
+    //Mesh nodes of the default scene, or of all the root nodes if there are no scenes
+    s32* MeshNodes = (s32*)ZeroAlloc(sizeof(s32) * (NodesCount + 1));
+    u32 MeshNodesCount = 0;
+    json_value* Scene = JsonAt(JsonGet(&Gltf.Root, "scenes"), (u32)JsonInteger(JsonGet(&Gltf.Root, "scene"), 0));
+    json_value* SceneNodes = JsonGet(Scene, "nodes");
+    for(u32 Index = 0; Index < NodesCount; Index++)
+    {
+        b32 IsRoot = SceneNodes ? false : Parents[Index] < 0;
+        for(u32 SceneNode = 0; SceneNodes && SceneNode < SceneNodes->Count; SceneNode++)
+        {
+            IsRoot |= JsonInteger(JsonAt(SceneNodes, SceneNode)) == Index;
+        }
+        if(IsRoot) GltfCollectMeshNodes(Nodes, Index, MeshNodes, &MeshNodesCount);
+    }
+    
+    gltf_mesh_builder Builder = {};
+    Builder.Mesh = Result;
+    json_value* Skin = 0;
+    b32 Success = true;
+    for(u32 Index = 0; Index < MeshNodesCount && Success; Index++)
+    {
+        json_value* Node = JsonAt(Nodes, MeshNodes[Index]);
+        json_value* Mesh = JsonAt(Meshes, (u32)JsonInteger(JsonGet(Node, "mesh")));
+        json_value* NodeSkin = JsonAt(JsonGet(&Gltf.Root, "skins"), (u32)JsonInteger(JsonGet(Node, "skin")));
+        if(NodeSkin && !Skin) Skin = NodeSkin;
+        
+        //Skinned vertices are already in the space of the skeleton
+        mat4 Transform = NodeSkin ? Mat4Identity() : GltfGetNodeWorldMatrix(Nodes, Parents, MeshNodes[Index]);
+        json_value* Primitives = JsonGet(Mesh, "primitives");
+        for(u32 Primitive = 0; Primitives && Primitive < Primitives->Count && Success; Primitive++)
+        {
+            Success = GltfAppendPrimitive(&Gltf, JsonAt(Primitives, Primitive), Transform, &Builder);
+        }
+    }
+    
+    Success = Success && Result->IndicesCount > 0;
+    if(Success && Skin)
+    {
+        Success = GltfImportSkin(&Gltf, Skin, Parents, Result);
+        if(Success && Result->AnimationsCount)
+        {
+            Result->Flags = (mesh_flag)(Result->Flags | MESH_HAS_ANIMATION);
+        }
+    }
+    
+    if(Success)
+    {
+        if(!(Result->Flags & MESH_HAS_ANIMATION))
+        {
+            Free(Result->Weights);
+            Free(Result->Joints);
+            Result->Weights = 0;
+            Result->Joints = 0;
+        }
+        if(!Builder.HasNormals) ComputeMeshNormals(Result);
+        if(!Builder.HasTangents) ComputeMeshTangents(Result);
+    }
+    
+    Free(MeshNodes);
+    Free(Parents);
+    GltfFree(&Gltf);
+    return Success;
+}
@@ -72,8 +72,8 @@ DrawCubemapToTexture(d3d11_state* D3D11, ID3D11ShaderResourceView* Cubemap, u32
     else
     {
         Context->IASetVertexBuffers(0, 1, &D3D11->Common.SphereVertexBuffer, Strides, Offsets);
-        Context->IASetIndexBuffer(D3D11->Common.SphereIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
-        Context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+        Context->IASetIndexBuffer(D3D11->Common.SphereIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
+        Context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
     }
     Context->IASetInputLayout(D3D11->Common.CubemapLayout);
     
@@ -150,8 +150,8 @@ DrawSHToTexture(d3d11_state* D3D11, d3d11_render_target* Target, d3d11_depth_buf
     u32 Strides[] = {sizeof(vec3)};
     u32 Offsets[] = {0};
     Context->IASetVertexBuffers(0, 1, &D3D11->Common.SphereVertexBuffer, Strides, Offsets);
-    Context->IASetIndexBuffer(D3D11->Common.SphereIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
-    Context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+    Context->IASetIndexBuffer(D3D11->Common.SphereIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
+    Context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
     Context->IASetInputLayout(D3D11->Common.CubemapLayout);
     
     if(Basis)
@@ -538,6 +538,46 @@ DrawSceneInspector(scene* Scene)
         
         Scene->SunDirection = DirectionFromThetaPhiDeg(SunTheta, SunPhi);
         
+        if(ImGui::TreeNode("Parameters"))
+        {
+            //Loaded from the atmosphere cache, changes that were never applied before are precomputed
+            atmosphere_parameters* Parameters = &InspectorData.AtmosphereParameters;
+            ImGui::DragFloat("Ground radius", &Parameters->Rg, 1.0f, 100.0f, Parameters->Rt - 1.0f);
+            ImGui::DragFloat("Top radius", &Parameters->Rt, 1.0f, Parameters->Rg + 1.0f, 100000.0f);
+            if(ImGui::DragFloat("Rayleigh height", &Parameters->Hr, 0.01f, 0.1f, 100.0f))
+            {
+                Parameters->RLayer.ExpScale = -1.0f / Parameters->Hr;
+            }
+            if(ImGui::DragFloat("Mie height", &Parameters->Hm, 0.01f, 0.1f, 100.0f))
+            {
+                Parameters->MLayer.ExpScale = -1.0f / Parameters->Hm;
+            }
+            //Rayleigh scattering doesn't absorb, the extinction is the scattering
+            if(ImGui::DragFloat3("Rayleigh scattering", Parameters->Bsr.e, 0.0001f, 0.0f, 1.0f, "%.5f"))
+            {
+                Parameters->Ber = Parameters->Bsr;
+            }
+            ImGui::DragFloat3("Mie scattering", Parameters->Bsm.e, 0.0001f, 0.0f, 1.0f, "%.5f");
+            ImGui::DragFloat3("Mie extinction", Parameters->Bem.e, 0.0001f, 0.0f, 1.0f, "%.5f");
+            ImGui::DragFloat("Mie g", &Parameters->MieG, 0.01f, -0.99f, 0.99f);
+            ImGui::DragFloat3("Ozone extinction", Parameters->Beo.e, 0.0001f, 0.0f, 1.0f, "%.5f");
+            ImGui::DragFloat("Sun angular radius", &Parameters->SunAngularRadius, 0.0001f, 0.0001f, 0.1f, "%.5f");
+            ImGui::ColorEdit3("Ground albedo", Parameters->GroundAlbedo.e);
+            
+            if(ImGui::Button("Apply"))
+            {
+                InspectorData.ReloadAtmosphere = true;
+            }
+            ImGui::SameLine();
+            if(ImGui::Button("Earth"))
+            {
+                *Parameters = GetEarthAtmosphereParameters();
+                InspectorData.ReloadAtmosphere = true;
+            }
+            
+            ImGui::TreePop();
+        }
+        
         s32 TransmittanceTextureSize = TRANSMITTANCE_TEXTURE_WIDTH * TRANSMITTANCE_TEXTURE_HEIGHT * 16;
         s32 IrradianceTextureSize = IRRADIANCE_TEXTURE_WIDTH * IRRADIANCE_TEXTURE_HEIGHT * 16;
         s32 ScatteringTextureSize = SCATTERING_TEXTURE_WIDTH * SCATTERING_TEXTURE_HEIGHT * SCATTERING_TEXTURE_DEPTH * 16;
@@ -677,7 +717,7 @@ DrawProfiler(d3d11_profiler* Profiler)
 }
 
 internal void
-DrawRenderSettings()
+DrawRenderSettings(scene* Scene)
 {
     ImGui::Checkbox("VSync", &InspectorData.VSyncEnabled);
     
@@ -685,6 +725,9 @@ DrawRenderSettings()
     
     ImGui::Checkbox("Camera frustum culling", &InspectorData.FrustumCulling);
     ImGui::Text("Objects drawn: %d", InspectorData.ObjectsDrawn);
+    ImGui::Checkbox("Meshlet culling", &InspectorData.MeshletCulling);
+    ImGui::Text("Meshlet triangles drawn: %d / %d", InspectorData.MeshletIndicesDrawn / 3,
+                InspectorData.MeshletIndicesCount / 3);
     
     ImGui::Checkbox("Shadow cubemap frustum culling", &InspectorData.ShadowCubemapFrustum);
     ImGui::Checkbox("Frustum frustum culling", &InspectorData.FrustumFrustumCulling);
@@ -695,6 +738,16 @@ DrawRenderSettings()
     
     ImGui::DragFloat("Aerial perspective scale", &InspectorData.AerialPerspectiveScale, 0.1f, 1.0f, 1000.0f);
     
+    texture_residency* Residency = &Scene->Residency;
+    s32 BudgetMB = (s32)(Residency->Budget / Megabytes(1));
+    if(ImGui::DragInt("Texture budget (MB)", &BudgetMB, 1.0f, 1, 16384))
+    {
+        Residency->Budget = Megabytes((u64)MAX(BudgetMB, 1));
+    }
+    ImGui::Text("Textures resident: %.1f MB, dropped %.1f MB, restored %.1f MB",
+                (f64)Residency->ResidentBytes / Megabytes(1), (f64)Residency->DroppedBytes / Megabytes(1),
+                (f64)Residency->RestoredBytes / Megabytes(1));
+    
     for(u32 i = 0; i < ArrayCount(InspectorData.L); i++)
     {
         ImGui::PushID(i);
@@ -703,18 +756,35 @@ DrawRenderSettings()
     }
 }
 
+//Newest mount first, entries shadowed by a later mount are grayed out
 internal void
-DrawAssets(asset_table Table)
+DrawAssets(asset_library* Library)
 {
-    for(u32 Index = 0; Index < Table.Count; Index++)
+    for(u32 Mount = Library->MountsCount; Mount-- > 0;)
     {
-        asset_table_entry* Entry = &Table.Entries[Index];
-        ImGui::Text("%s - %s | %s", Entry->Name, Entry->Tag, AssetTypeToName[Entry->Type]);
+        asset_table Table = Library->Mounts[Mount]->Table;
+        ImGui::Separator();
+        ImGui::Text("Mount %u", Mount);
+        for(u32 Index = 0; Index < Table.Count; Index++)
+        {
+            asset_table_entry* Entry = &Table.Entries[Index];
+            b32 Shadowed = FindAsset(Entry->Name, Library, Entry->Type, Entry->Tag) != Entry;
+            if(Shadowed) ImGui::PushStyleColor(ImGuiCol_Text, ImGui::GetStyle().Colors[ImGuiCol_TextDisabled]);
+            
+            ImGui::Text("%s - %s | %s", Entry->Name, Entry->Tag, AssetTypeToName[Entry->Type]);
+            if(Entry->Codec != ASSET_CODEC_NONE)
+            {
+                ImGui::SameLine();
+                ImGui::Text("| %.1f%% saved", 100.0f * (1.0f - (f32)Entry->StoredSize / Entry->Size));
+            }
+            
+            if(Shadowed) ImGui::PopStyleColor();
+        }
     }
 }
 
 internal void
-DrawEditor(d3d11_state* D3D11, scene* Scene, asset_table AssetTable, float SecondsElapsed)
+DrawEditor(d3d11_state* D3D11, scene* Scene, asset_library* Assets, float SecondsElapsed)
 {
     //DockSpace
     ImGuiWindowFlags DockSpaceWindowFlags = ImGuiWindowFlags_MenuBar | ImGuiWindowFlags_NoDocking;
@@ -758,7 +828,7 @@ DrawEditor(d3d11_state* D3D11, scene* Scene, asset_table AssetTable, float Secon
     ImGuiWindowFlags WindowFlags = ImGuiWindowFlags_NoCollapse;
     if(ImGui::Begin("Render Settings", 0, WindowFlags))
     {
-        DrawRenderSettings();
+        DrawRenderSettings(Scene);
     }
     ImGui::End();
     
@@ -776,17 +846,47 @@ DrawEditor(d3d11_state* D3D11, scene* Scene, asset_table AssetTable, float Secon
     
     if(ImGui::Begin("Startup Timings", 0, WindowFlags))
     {
-        u64 Begin = StartupTimestamps.Begin;
+        u64 StartupEnd = StartupTimestamps.Begin;
         for(u32 i = 0; i < STARTUP_ACTIONS_COUNT; i++)
         {
+            u64 Begin = GetStartupActionBegin(i);
             u64 End = StartupTimestamps.Timestamps[i];
-            f32 ms = Win32_GetSecondsElapsed(Begin, End) * 1000.0f;
-            ImGui::Text("%s: %.3fms", StartupActionNames[i], ms);
-            Begin = End;
+            f32 ms = (End - Begin) / 1000.0f;
+            f32 Start = (Begin - StartupTimestamps.Begin) / 1000.0f;
+            ImGui::Text("%s: %.3fms (at %.3fms)", StartupActionNames[i], ms, Start);
+            StartupEnd = MAX(StartupEnd, End);
         }
         ImGui::Separator();
-        ImGui::Text("Total startup time: %.3fs", Win32_GetSecondsElapsed(StartupTimestamps.Begin, Begin));
+        ImGui::Text("Total startup time: %.3fs", (StartupEnd - StartupTimestamps.Begin) / 1000000.0f);
         
+        //Waiting is the time between the end of the previous task and the start of this one
+        ImGui::Separator();
+        ImGui::Text("Critical path:");
+        u64 PreviousEnd = StartupTimestamps.Begin;
+        for(u32 i = 0; i < StartupTimestamps.CriticalPathCount; i++)
+        {
+            startup_span* Span = StartupTimestamps.CriticalPath + i;
+            f32 ms = (Span->End - Span->Begin) / 1000.0f;
+            f32 Wait = (Span->Begin - PreviousEnd) / 1000.0f;
+            if(Span->First == Span->Last)
+            {
+                ImGui::Text("%s: %.3fms, waited %.3fms", StartupActionNames[Span->First], ms, Wait);
+            }
+            else
+            {
+                ImGui::Text("%s .. %s: %.3fms, waited %.3fms", StartupActionNames[Span->First],
+                            StartupActionNames[Span->Last], ms, Wait);
+            }
+            PreviousEnd = Span->End;
+        }
+        
+        ImGui::Separator();
+        if(ImGui::Button("Write trace"))
+        {
+            WriteStartupTrace(STARTUP_TRACE_DEFAULT_PATH);
+        }
+        ImGui::SameLine();
+        ImGui::Text("%s", STARTUP_TRACE_DEFAULT_PATH);
     }
     ImGui::End();
     
@@ -801,7 +901,7 @@ DrawEditor(d3d11_state* D3D11, scene* Scene, asset_table AssetTable, float Secon
     
     if(ImGui::Begin("Assets", 0, WindowFlags))
     {
-        DrawAssets(AssetTable);
+        DrawAssets(Assets);
     }
     ImGui::End();
     
@@ -88,3 +88,576 @@ WriteImageToFile(image_data* Image, char* FileName)
     stbi_flip_vertically_on_write(true); // flag is non-zero to flip data vertically
     stbi_write_bmp(FileName, Image->Width, Image->Height, Image->BytesPerPixel, Image->Data);
 }
+
+internal u32
+GetImageMipsCount(s32 Width, s32 Height)
+{
+    u32 Result = 1;
+    for(s32 Size = MAX(Width, Height); Size > 1; Size /= 2)
+    {
+        Result++;
+    }
+    return Result;
+}
+
+internal u32
+GetImageBlockSize(image_block_format BlockFormat)
+{
+    switch(BlockFormat)
+    {
+        case IMAGE_BC1: case IMAGE_BC4: return 8;
+        case IMAGE_BC3: case IMAGE_BC5: case IMAGE_BC7: return 16;
+        default: return 0;
+    }
+}
+
+//Bytes in a row of pixels, or in a row of blocks for compressed images
+internal u32
+GetImageLevelPitch(s32 Width, s32 BytesPerPixel, image_block_format BlockFormat, u32 Mip)
+{
+    u32 LevelWidth = MAX(Width >> Mip, 1);
+    if(BlockFormat != IMAGE_UNCOMPRESSED)
+    {
+        return ((LevelWidth + 3) / 4) * GetImageBlockSize(BlockFormat);
+    }
+    return LevelWidth * BytesPerPixel;
+}
+
+//Rows of pixels, or rows of blocks for compressed images
+internal u32
+GetImageLevelRows(s32 Height, image_block_format BlockFormat, u32 Mip)
+{
+    u32 LevelHeight = MAX(Height >> Mip, 1);
+    return BlockFormat != IMAGE_UNCOMPRESSED ? (LevelHeight + 3) / 4 : LevelHeight;
+}
+
+internal u64
+GetImageMipChainSize(s32 Width, s32 Height, s32 BytesPerPixel, u32 NumberOfMips, image_block_format BlockFormat = IMAGE_UNCOMPRESSED)
+{
+    u64 Result = 0;
+    for(u32 Mip = 0; Mip < MAX(NumberOfMips, 1); Mip++)
+    {
+        Result += (u64)GetImageLevelPitch(Width, BytesPerPixel, BlockFormat, Mip) * GetImageLevelRows(Height, BlockFormat, Mip);
+    }
+    return Result;
+}
+
+//Where Mip starts in a tightly packed chain
+internal u64
+GetImageMipOffset(s32 Width, s32 Height, s32 BytesPerPixel, u32 Mip, image_block_format BlockFormat = IMAGE_UNCOMPRESSED)
+{
+    return Mip ? GetImageMipChainSize(Width, Height, BytesPerPixel, Mip, BlockFormat) : 0;
+}
+
+//Most detailed mip with no side bigger than MaxSize. Block compressed textures need a
+//first level made of whole blocks, so a more detailed one is returned if it isn't
+internal u32
+GetImageFirstMipForSize(s32 Width, s32 Height, u32 NumberOfMips, image_block_format BlockFormat, u32 MaxSize)
+{
+    u32 Result = 0;
+    while(Result + 1 < NumberOfMips && (u32)MAX(Width >> Result, Height >> Result) > MaxSize)
+    {
+        Result++;
+    }
+    
+    while(Result && BlockFormat != IMAGE_UNCOMPRESSED && ((Width >> Result) % 4 || (Height >> Result) % 4))
+    {
+        Result--;
+    }
+    return Result;
+}
+
+#define IMAGE_SRGB_TABLE_SIZE 16384
+
+struct image_srgb_tables
+{
+    f32 ToLinear[256];
+    u8 FromLinear[IMAGE_SRGB_TABLE_SIZE];
+};
+
+internal image_srgb_tables
+BuildSRGBTables()
+{
+    image_srgb_tables Result;
+    for(u32 Index = 0; Index < 256; Index++)
+    {
+        Result.ToLinear[Index] = ExactSRGBToLinear(Index / 255.0f);
+    }
+    for(u32 Index = 0; Index < IMAGE_SRGB_TABLE_SIZE; Index++)
+    {
+        f32 Value = ExactLinearToSRGB(Index / (f32)(IMAGE_SRGB_TABLE_SIZE - 1));
+        Result.FromLinear[Index] = (u8)(Value * 255.0f + 0.5f);
+    }
+    return Result;
+}
+
+internal image_srgb_tables*
+GetSRGBTables()
+{
+    //Initialized once, safe to call from multiple threads
+    local_persist image_srgb_tables Tables = BuildSRGBTables();
+    return &Tables;
+}
+
+//2x2 box filter of RGBA f32 pixels, odd sizes repeat the last row and column
+internal void
+DownsampleLinearImage(f32* Source, s32 Width, s32 Height, f32* Dest, s32 DestWidth, s32 DestHeight)
+{
+    __m128 Quarter = _mm_set1_ps(0.25f);
+    for(s32 y = 0; y < DestHeight; y++)
+    {
+        f32* Row0 = Source + (u64)MIN(2 * y, Height - 1) * Width * 4;
+        f32* Row1 = Source + (u64)MIN(2 * y + 1, Height - 1) * Width * 4;
+        f32* Out = Dest + (u64)y * DestWidth * 4;
+        for(s32 x = 0; x < DestWidth; x++)
+        {
+            s32 x0 = MIN(2 * x, Width - 1) * 4;
+            s32 x1 = MIN(2 * x + 1, Width - 1) * 4;
+            __m128 Top = _mm_add_ps(_mm_loadu_ps(Row0 + x0), _mm_loadu_ps(Row0 + x1));
+            __m128 Bottom = _mm_add_ps(_mm_loadu_ps(Row1 + x0), _mm_loadu_ps(Row1 + x1));
+            _mm_storeu_ps(Out + x * 4, _mm_mul_ps(_mm_add_ps(Top, Bottom), Quarter));
+        }
+    }
+}
+
+//Quantizes RGBA f32 linear pixels to Channels 8 bit channels, the first 3 are sRGB encoded if SRGB
+internal void
+StoreLinearImage(f32* Source, u64 PixelsCount, u8* Dest, s32 Channels, b32 SRGB)
+{
+    image_srgb_tables* Tables = GetSRGBTables();
+    __m128 Zero = _mm_setzero_ps();
+    __m128 One = _mm_set1_ps(1.0f);
+    __m128 Half = _mm_set1_ps(0.5f);
+    __m128 LinearScale = _mm_set1_ps(255.0f);
+    __m128 TableScale = _mm_set1_ps((f32)(IMAGE_SRGB_TABLE_SIZE - 1));
+    
+    for(u64 Pixel = 0; Pixel < PixelsCount; Pixel++)
+    {
+        __m128 Value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(Source + Pixel * 4), Zero), One);
+        
+        alignas(16) s32 Linear[4];
+        alignas(16) s32 TableIndex[4];
+        _mm_store_si128((__m128i*)Linear, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(Value, LinearScale), Half)));
+        _mm_store_si128((__m128i*)TableIndex, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(Value, TableScale), Half)));
+        
+        u8* Out = Dest + Pixel * Channels;
+        for(s32 Channel = 0; Channel < Channels; Channel++)
+        {
+            Out[Channel] = (SRGB && Channel < 3) ? Tables->FromLinear[TableIndex[Channel]] : (u8)Linear[Channel];
+        }
+    }
+}
+
+//Returns a copy of the image followed by its full mip chain, down to 1x1, in a single
+//allocation. Filtering happens in linear space, SRGB images are decoded before and encoded
+//after. Supports 8 bit images with 1 to 4 channels and RGBA f32 images
+internal image_data
+GenerateImageMips(image_data* Image, b32 SRGB)
+{
+    s32 Width = Image->Width;
+    s32 Height = Image->Height;
+    s32 BytesPerPixel = Image->BytesPerPixel;
+    b32 IsFloat = BytesPerPixel == 4 * sizeof(f32);
+    Assert(IsFloat || (BytesPerPixel >= 1 && BytesPerPixel <= 4));
+    
+    image_data Result = {};
+    Result.Width = Width;
+    Result.Height = Height;
+    Result.BytesPerPixel = BytesPerPixel;
+    Result.Pitch = Width * BytesPerPixel;
+    Result.NumberOfMips = GetImageMipsCount(Width, Height);
+    Result.Data = (u8*)ZeroAlloc(GetImageMipChainSize(Width, Height, BytesPerPixel, Result.NumberOfMips));
+    
+    //Level 0 is copied as is, also converted to linear RGBA f32 to filter the next levels
+    f32* Level = (f32*)ZeroAlloc(sizeof(f32) * 4 * Width * Height);
+    f32* NextLevel = (f32*)ZeroAlloc(sizeof(f32) * 4 * MAX(Width / 2, 1) * MAX(Height / 2, 1));
+    image_srgb_tables* Tables = GetSRGBTables();
+    for(s32 y = 0; y < Height; y++)
+    {
+        u8* Row = Image->Data + (u64)y * Image->Pitch;
+        memcpy(Result.Data + (u64)y * Result.Pitch, Row, Result.Pitch);
+        
+        f32* Out = Level + (u64)y * Width * 4;
+        if(IsFloat)
+        {
+            memcpy(Out, Row, sizeof(f32) * 4 * Width);
+            continue;
+        }
+        for(s32 x = 0; x < Width; x++)
+        {
+            for(s32 Channel = 0; Channel < BytesPerPixel; Channel++)
+            {
+                u8 Value = Row[x * BytesPerPixel + Channel];
+                Out[x * 4 + Channel] = (SRGB && Channel < 3) ? Tables->ToLinear[Value] : Value / 255.0f;
+            }
+        }
+    }
+    
+    u8* At = Result.Data + (u64)Result.Pitch * Height;
+    s32 LevelWidth = Width;
+    s32 LevelHeight = Height;
+    for(u32 Mip = 1; Mip < Result.NumberOfMips; Mip++)
+    {
+        s32 MipWidth = MAX(LevelWidth / 2, 1);
+        s32 MipHeight = MAX(LevelHeight / 2, 1);
+        DownsampleLinearImage(Level, LevelWidth, LevelHeight, NextLevel, MipWidth, MipHeight);
+        
+        u64 PixelsCount = (u64)MipWidth * MipHeight;
+        if(IsFloat)
+        {
+            memcpy(At, NextLevel, sizeof(f32) * 4 * PixelsCount);
+        }
+        else
+        {
+            StoreLinearImage(NextLevel, PixelsCount, At, BytesPerPixel, SRGB);
+        }
+        At += PixelsCount * BytesPerPixel;
+        
+        f32* Swap = Level;
+        Level = NextLevel;
+        NextLevel = Swap;
+        LevelWidth = MipWidth;
+        LevelHeight = MipHeight;
+    }
+    
+    Free(Level);
+    Free(NextLevel);
+    return Result;
+}
+
+//HDR formats
+
+//Round to nearest even, overflows go to infinity. 4 floats at a time with SSE2 only, the
+//results are in the low 16 bits of each lane
+internal __m128i
+ConvertF32ToF16x4(__m128 Value)
+{
+    __m128 Sign = _mm_and_ps(Value, _mm_castsi128_ps(_mm_set1_epi32(0x80000000)));
+    __m128 Abs = _mm_xor_ps(Value, Sign);
+    __m128i AbsBits = _mm_castps_si128(Abs);
+    
+    //Infinity and NaN, NaNs keep a mantissa bit
+    __m128 IsNaN = _mm_cmpunord_ps(Abs, Abs);
+    __m128i IsRegular = _mm_cmpgt_epi32(_mm_set1_epi32((127 + 16) << 23), AbsBits);
+    __m128i Special = _mm_or_si128(_mm_and_si128(_mm_castps_si128(IsNaN), _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7C00));
+    
+    //Denormals, adding the magic number rounds the mantissa in place
+    __m128i IsDenormal = _mm_cmpgt_epi32(_mm_set1_epi32((127 - 14) << 23), AbsBits);
+    __m128i DenormalMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+    __m128i Denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(Abs, _mm_castsi128_ps(DenormalMagic))), DenormalMagic);
+    
+    //Normals, rebias the exponent and round, odd mantissas round up on ties
+    __m128i MantissaOdd = _mm_srai_epi32(_mm_slli_epi32(AbsBits, 31 - 13), 31);
+    __m128i Rounded = _mm_sub_epi32(_mm_add_epi32(AbsBits, _mm_set1_epi32(0xFFF - ((127 - 15) << 23))), MantissaOdd);
+    __m128i Normal = _mm_srli_epi32(Rounded, 13);
+    
+    __m128i Finite = _mm_or_si128(_mm_and_si128(IsDenormal, Denormal), _mm_andnot_si128(IsDenormal, Normal));
+    __m128i Result = _mm_or_si128(_mm_and_si128(IsRegular, Finite), _mm_andnot_si128(IsRegular, Special));
+    return _mm_or_si128(Result, _mm_srli_epi32(_mm_castps_si128(Sign), 16));
+}
+
+internal u16
+ConvertF32ToF16(f32 Value)
+{
+    return (u16)_mm_cvtsi128_si32(ConvertF32ToF16x4(_mm_set1_ps(Value)));
+}
+
+//Unsigned float with 5 bits of exponent and MantissaBits of mantissa (6 or 5), negative
+//values go to 0. Rounded through half precision
+internal u32
+ConvertF32ToPackedFloat(f32 Value, u32 MantissaBits)
+{
+    u32 Half = ConvertF32ToF16(MAX(Value, 0.0f));
+    u32 Shift = 10 - MantissaBits;
+    if((Half & 0x7C00) == 0x7C00)
+    {
+        return (Half & 0x3FF) ? 0x7C00 >> Shift | 1 : 0x7C00 >> Shift;
+    }
+    
+    //Round to nearest even, a carry into the exponent is still the correct result
+    u32 Odd = (Half >> Shift) & 1;
+    return (Half + (1 << (Shift - 1)) - 1 + Odd) >> Shift;
+}
+
+internal u32
+ConvertF32ToR11G11B10F(f32 r, f32 g, f32 b)
+{
+    return ConvertF32ToPackedFloat(r, 6) | ConvertF32ToPackedFloat(g, 6) << 11 | ConvertF32ToPackedFloat(b, 5) << 22;
+}
+
+//Shared exponent encoding from the D3D specification
+internal u32
+ConvertF32ToRGB9E5(f32 r, f32 g, f32 b)
+{
+    const f32 MaxValue = (f32)(0x1FF) / 512.0f * 65536.0f;
+    r = Clamp(r, 0.0f, MaxValue);
+    g = Clamp(g, 0.0f, MaxValue);
+    b = Clamp(b, 0.0f, MaxValue);
+    f32 MaxChannel = MAX(MAX(r, g), b);
+    
+    s32 Exponent = MAX(-16, (s32)floorf(log2f(MAX(MaxChannel, 1e-30f)))) + 1 + 15;
+    f32 Denominator = exp2f((f32)(Exponent - 15 - 9));
+    if((s32)floorf(MaxChannel / Denominator + 0.5f) == 512)
+    {
+        Denominator *= 2.0f;
+        Exponent++;
+    }
+    
+    u32 Red = (u32)floorf(r / Denominator + 0.5f);
+    u32 Green = (u32)floorf(g / Denominator + 0.5f);
+    u32 Blue = (u32)floorf(b / Denominator + 0.5f);
+    return Red | Green << 9 | Blue << 18 | (u32)Exponent << 27;
+}
+
+//8 values at a time, then the remaining ones
+internal void
+ConvertF32ToF16Array(f32* Source, u64 Count, u16* Dest)
+{
+    u64 Index = 0;
+    for(; Index + 8 <= Count; Index += 8)
+    {
+        __m128i Low = ConvertF32ToF16x4(_mm_loadu_ps(Source + Index));
+        __m128i High = ConvertF32ToF16x4(_mm_loadu_ps(Source + Index + 4));
+        _mm_storeu_si128((__m128i*)(Dest + Index), _mm_packus_epi32(Low, High));
+    }
+    for(; Index < Count; Index++)
+    {
+        Dest[Index] = ConvertF32ToF16(Source[Index]);
+    }
+}
+
+internal f32
+ConvertF16ToF32(u16 Value)
+{
+    u32 Sign = (u32)(Value & 0x8000) << 16;
+    u32 Exponent = (Value >> 10) & 0x1F;
+    u32 Mantissa = Value & 0x3FF;
+    
+    u32 Bits;
+    if(Exponent == 0x1F)
+    {
+        Bits = Sign | 0x7F800000 | Mantissa << 13;
+    }
+    else if(Exponent == 0)
+    {
+        //Denormals and zero
+        f32 Result = Mantissa * (1.0f / 16777216.0f);
+        return Sign ? -Result : Result;
+    }
+    else
+    {
+        Bits = Sign | (Exponent + 127 - 15) << 23 | Mantissa << 13;
+    }
+    
+    f32 Result;
+    memcpy(&Result, &Bits, sizeof(Result));
+    return Result;
+}
+
+//The packed floats are halves without the sign and the lowest mantissa bits
+internal f32
+ConvertPackedFloatToF32(u32 Value, u32 MantissaBits)
+{
+    return ConvertF16ToF32((u16)(Value << (10 - MantissaBits)));
+}
+
+internal void
+ConvertRGB9E5ToF32(u32 Value, f32* Result)
+{
+    f32 Scale = exp2f((f32)((s32)(Value >> 27) - 15 - 9));
+    Result[0] = (Value & 0x1FF) * Scale;
+    Result[1] = ((Value >> 9) & 0x1FF) * Scale;
+    Result[2] = ((Value >> 18) & 0x1FF) * Scale;
+}
+
+//BC6H, only mode 11 is read: one region, 10 bit endpoints that are not transformed and
+//4 bit indices. The weights are the same as the 4 bit ones of BC7
+global_variable u8 BC6HWeights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+#define BC6H_MODE_11 0x03
+
+internal u32
+UnquantizeBC6HEndpoint(u32 Value)
+{
+    if(Value == 0) return 0;
+    if(Value == 0x3FF) return 0xFFFF;
+    return ((Value << 16) + 0x8000) >> 10;
+}
+
+//Unsigned halves of the 16 entries
+internal void
+GetBC6HMode11Palette(u32* Endpoint0, u32* Endpoint1, u16 Palette[16][3])
+{
+    for(u32 Channel = 0; Channel < 3; Channel++)
+    {
+        u32 Value0 = UnquantizeBC6HEndpoint(Endpoint0[Channel]);
+        u32 Value1 = UnquantizeBC6HEndpoint(Endpoint1[Channel]);
+        for(u32 Index = 0; Index < 16; Index++)
+        {
+            u32 w = BC6HWeights4[Index];
+            u32 Value = ((64 - w) * Value0 + w * Value1 + 32) >> 6;
+            Palette[Index][Channel] = (u16)((Value * 31) >> 6);
+        }
+    }
+}
+
+internal u32
+ReadBlockBits(u8* Block, u32* Position, u32 BitsCount)
+{
+    u32 Result = 0;
+    for(u32 Bit = 0; Bit < BitsCount; Bit++, (*Position)++)
+    {
+        Result |= (u32)((Block[*Position >> 3] >> (*Position & 7)) & 1) << Bit;
+    }
+    return Result;
+}
+
+//Decodes to RGBA with alpha 1, returns false for modes other than 11 which are decoded as magenta
+internal b32
+DecodeBC6HBlock(u8* Block, f32 Pixels[16][4])
+{
+    if((Block[0] & 0x1F) != BC6H_MODE_11)
+    {
+        for(u32 Pixel = 0; Pixel < 16; Pixel++)
+        {
+            Pixels[Pixel][0] = 1.0f;
+            Pixels[Pixel][1] = 0.0f;
+            Pixels[Pixel][2] = 1.0f;
+            Pixels[Pixel][3] = 1.0f;
+        }
+        return false;
+    }
+    
+    u32 Position = 5;
+    u32 Endpoint0[3], Endpoint1[3];
+    for(u32 Channel = 0; Channel < 3; Channel++) Endpoint0[Channel] = ReadBlockBits(Block, &Position, 10);
+    for(u32 Channel = 0; Channel < 3; Channel++) Endpoint1[Channel] = ReadBlockBits(Block, &Position, 10);
+    
+    u16 Palette[16][3];
+    GetBC6HMode11Palette(Endpoint0, Endpoint1, Palette);
+    for(u32 Pixel = 0; Pixel < 16; Pixel++)
+    {
+        u32 Index = ReadBlockBits(Block, &Position, Pixel == 0 ? 3 : 4);
+        for(u32 Channel = 0; Channel < 3; Channel++)
+        {
+            Pixels[Pixel][Channel] = ConvertF16ToF32(Palette[Index][Channel]);
+        }
+        Pixels[Pixel][3] = 1.0f;
+    }
+    return true;
+}
+
+//Cubemaps
+
+s32 CubemapFormatBytesPerPixel[] = {
+    16, //CUBEMAP_RGBA32F
+    8,  //CUBEMAP_RGBA16F
+    4,  //CUBEMAP_R11G11B10F
+    4,  //CUBEMAP_RGB9E5
+    0,  //CUBEMAP_BC6H
+};
+
+static_assert(ArrayCount(CubemapFormatBytesPerPixel) == CUBEMAP_FORMATS_COUNT);
+
+//Bytes in a row of pixels of a face, or in a row of blocks for BC6H
+internal u32
+GetCubemapLevelPitch(s32 Size, cubemap_format Format, u32 Mip)
+{
+    u32 LevelSize = MAX(Size >> Mip, 1);
+    if(Format == CUBEMAP_BC6H)
+    {
+        return ((LevelSize + 3) / 4) * 16;
+    }
+    return LevelSize * CubemapFormatBytesPerPixel[Format];
+}
+
+//Rows of pixels of a face, or rows of blocks for BC6H
+internal u32
+GetCubemapLevelRows(s32 Size, cubemap_format Format, u32 Mip)
+{
+    u32 LevelSize = MAX(Size >> Mip, 1);
+    return Format == CUBEMAP_BC6H ? (LevelSize + 3) / 4 : LevelSize;
+}
+
+//Bytes of a face and its mips, the whole cubemap is 6 times this
+internal u64
+GetCubemapFaceSize(s32 Size, cubemap_format Format, u32 NumberOfMips)
+{
+    u64 Result = 0;
+    for(u32 Mip = 0; Mip < MAX(NumberOfMips, 1); Mip++)
+    {
+        Result += (u64)GetCubemapLevelPitch(Size, Format, Mip) * GetCubemapLevelRows(Size, Format, Mip);
+    }
+    return Result;
+}
+
+//Decodes the first level of the face to Size * Size RGBA f32 pixels, alpha is 1 for the
+//formats without it
+internal void
+DecodeCubemapFace(cubemap_data* Cubemap, u32 Face, f32* Dest)
+{
+    s32 Size = Cubemap->Size;
+    u32 Pitch = GetCubemapLevelPitch(Size, Cubemap->Format, 0);
+    u8* Source = Cubemap->Data + Face * GetCubemapFaceSize(Size, Cubemap->Format, Cubemap->NumberOfMips);
+    
+    if(Cubemap->Format == CUBEMAP_BC6H)
+    {
+        u32 Blocks = GetCubemapLevelRows(Size, CUBEMAP_BC6H, 0);
+        for(u32 Row = 0; Row < Blocks; Row++)
+        {
+            for(u32 Column = 0; Column < Blocks; Column++)
+            {
+                f32 Pixels[16][4];
+                DecodeBC6HBlock(Source + (u64)Row * Pitch + Column * 16, Pixels);
+                for(u32 Pixel = 0; Pixel < 16; Pixel++)
+                {
+                    s32 x = Column * 4 + (Pixel & 3);
+                    s32 y = Row * 4 + (Pixel >> 2);
+                    if(x < Size && y < Size)
+                    {
+                        memcpy(Dest + ((u64)y * Size + x) * 4, Pixels[Pixel], sizeof(Pixels[Pixel]));
+                    }
+                }
+            }
+        }
+        return;
+    }
+    
+    for(s32 y = 0; y < Size; y++)
+    {
+        u8* Row = Source + (u64)y * Pitch;
+        for(s32 x = 0; x < Size; x++)
+        {
+            f32* Out = Dest + ((u64)y * Size + x) * 4;
+            Out[3] = 1.0f;
+            switch(Cubemap->Format)
+            {
+                case CUBEMAP_RGBA32F:
+                {
+                    memcpy(Out, Row + x * 16, 16);
+                } break;
+                
+                case CUBEMAP_RGBA16F:
+                {
+                    u16* Texel = (u16*)(Row + x * 8);
+                    for(u32 Channel = 0; Channel < 4; Channel++) Out[Channel] = ConvertF16ToF32(Texel[Channel]);
+                } break;
+                
+                case CUBEMAP_R11G11B10F:
+                {
+                    u32 Texel = *(u32*)(Row + x * 4);
+                    Out[0] = ConvertPackedFloatToF32(Texel & 0x7FF, 6);
+                    Out[1] = ConvertPackedFloatToF32((Texel >> 11) & 0x7FF, 6);
+                    Out[2] = ConvertPackedFloatToF32(Texel >> 22, 5);
+                } break;
+                
+                case CUBEMAP_RGB9E5:
+                {
+                    ConvertRGB9E5ToF32(*(u32*)(Row + x * 4), Out);
+                } break;
+                
+                default: Assert(0);
+            }
+        }
+    }
+}
@@ -4,22 +4,53 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb_image_write.h>
 
+//HDR formats of cubemaps, all but RGBA32F and RGBA16F drop alpha
+enum cubemap_format
+{
+    CUBEMAP_RGBA32F,
+    CUBEMAP_RGBA16F,
+    CUBEMAP_R11G11B10F, //Unsigned, 6 bits of mantissa for red and green and 5 for blue
+    CUBEMAP_RGB9E5,     //Unsigned, 9 bits of mantissa per channel and a shared exponent
+    CUBEMAP_BC6H,       //Unsigned half floats, 16 bytes per block of 4x4 pixels
+    
+    CUBEMAP_FORMATS_COUNT,
+};
+
 struct cubemap_data
 {
     s32 Size;
-    s32 Pitch;
-    s32 BytesPerPixel;
+    s32 Pitch; //Of the first level, if compressed the size of a row of blocks
+    s32 BytesPerPixel; //0 if compressed
     u32 NumberOfMips;
+    cubemap_format Format;
     
+    //Faces one after the other, each followed by its mips
     u8* Data;
 };
 
+//Block compressed formats, every block encodes 4x4 pixels
+enum image_block_format
+{
+    IMAGE_UNCOMPRESSED,
+    IMAGE_BC1, //RGB, 8 bytes per block
+    IMAGE_BC3, //RGBA, BC1 color and BC4 alpha, 16 bytes per block
+    IMAGE_BC4, //R, 8 bytes per block
+    IMAGE_BC5, //RG, two BC4 blocks, 16 bytes per block
+    IMAGE_BC7, //RGBA, 16 bytes per block
+};
+
 struct image_data
 {
     s32 Width;
     s32 Height;
     s32 Pitch;
     s32 BytesPerPixel;
+    u32 NumberOfMips; //0 is the same as 1, mips are tightly packed after the first level
+    image_block_format BlockFormat; //If compressed Pitch is the size of a row of blocks
+    
+    //Mips above it were not loaded, Data starts with this level. The size and Pitch
+    //are still the ones of the first level
+    u32 FirstMip;
     
     u8* Data;
 };
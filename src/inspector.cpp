@@ -1,4 +1,5 @@
 #define MAX_TRACKED_TEXTURES 64
+#define MAX_TRACKED_TEXTURE_NAME_LENGTH 128
 #define MAX_TRACKED_SHADERS_COUNT 64
 
 enum tracked_texture_kind
@@ -14,7 +15,7 @@ struct tracked_texture
     void* Texture;
     ivec2 Size; // TODO: Can we query this from the api so we don't need to update it
     s32 Depth;  // Only used for 3D textures
-    char* Name;
+    char Name[MAX_TRACKED_TEXTURE_NAME_LENGTH];
     tracked_texture_kind Kind;
     // TODO: Filter type / color channels info
 };
@@ -51,6 +52,7 @@ struct inspector_data
     bool DepthPrepass = true;
     bool ShadowCubemapFrustum = true;
     bool FrustumCulling = true;
+    bool MeshletCulling = true;
     bool FrustumFrustumCulling = true;
     s32 PlaneIndex = 0;
     float AerialPerspectiveScale = 1.0f;
@@ -61,9 +63,15 @@ struct inspector_data
         vec4(0.18f), vec4(-0.23f), vec4(-0.14f), vec4(-0.07f)
     };
     
+    //Atmosphere, the parameters are applied at the beginning of the next frame
+    atmosphere_parameters AtmosphereParameters;
+    bool ReloadAtmosphere = false;
+    
     //Data
     s32 ObjectsDrawnOnCubemap = 0;
     s32 ObjectsDrawn = 0;
+    s32 MeshletIndicesDrawn = 0;
+    s32 MeshletIndicesCount = 0; //Of the meshes drawn that have meshlets
     
     
     //Tracked textures
@@ -77,6 +85,7 @@ struct inspector_data
 global_variable inspector_data InspectorData;
 
 
+//The name is copied, it can be a temporary buffer
 internal void
 PushTrackedTexture(void* Texture, ivec2 Size, char* Name, tracked_texture_kind Kind, s32 Depth = 0)
 {
@@ -85,10 +94,25 @@ PushTrackedTexture(void* Texture, ivec2 Size, char* Name, tracked_texture_kind K
     Track->Size = Size;
     Track->Depth = Depth;
     Track->Texture = Texture;
-    Track->Name = Name;
+    snprintf(Track->Name, sizeof(Track->Name), "%s", Name);
     Track->Kind = Kind;
 }
 
+//For textures that get recreated, returns 0 if no texture was pushed with this name
+internal tracked_texture*
+FindTrackedTexture(char* Name)
+{
+    for(u32 i = 0; i < InspectorData.TrackedTexturesCount; i++)
+    {
+        tracked_texture* Track = InspectorData.TrackedTextures + i;
+        if(strcmp(Track->Name, Name) == 0)
+        {
+            return Track;
+        }
+    }
+    return 0;
+}
+
 internal u64
 Win32_FindLastWriteTime(wchar_t* FileName)
 {
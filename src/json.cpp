@@ -0,0 +1,313 @@
+// Minimal JSON reader used by the packer to parse glTF files.
+// Parses the whole document into a tree of json_values, strings are unescaped into
+// their own allocations. Only what glTF needs, no streaming and no writer.
+
+enum json_type
+{
+    JSON_NULL,
+    JSON_FALSE,
+    JSON_TRUE,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT,
+};
+
+struct json_value
+{
+    json_type Type;
+    f64 Number;
+    char* String;
+    
+    //Arrays and objects, objects also have one key per element
+    json_value* Elements;
+    char** Keys;
+    u32 Count;
+};
+
+struct json_parser
+{
+    char* At;
+    char* End;
+    b32 Error;
+};
+
+internal void
+JsonSkipWhitespace(json_parser* Parser)
+{
+    while(Parser->At < Parser->End &&
+          (*Parser->At == ' ' || *Parser->At == '\t' || *Parser->At == '\n' || *Parser->At == '\r'))
+    {
+        Parser->At++;
+    }
+}
+
+internal b32
+JsonExpect(json_parser* Parser, char C)
+{
+    JsonSkipWhitespace(Parser);
+    if(Parser->At < Parser->End && *Parser->At == C)
+    {
+        Parser->At++;
+        return true;
+    }
+    
+    Parser->Error = true;
+    return false;
+}
+
+internal u32
+JsonParseHex4(json_parser* Parser)
+{
+    u32 Result = 0;
+    for(u32 i = 0; i < 4; i++)
+    {
+        char C = Parser->At < Parser->End ? *Parser->At++ : 0;
+        Result <<= 4;
+        if(C >= '0' && C <= '9') Result |= C - '0';
+        else if(C >= 'a' && C <= 'f') Result |= C - 'a' + 10;
+        else if(C >= 'A' && C <= 'F') Result |= C - 'A' + 10;
+        else Parser->Error = true;
+    }
+    return Result;
+}
+
+internal char*
+JsonParseString(json_parser* Parser)
+{
+    if(!JsonExpect(Parser, '"')) return 0;
+    
+    //The unescaped string is never longer than the escaped one
+    char* Begin = Parser->At;
+    while(Parser->At < Parser->End && *Parser->At != '"')
+    {
+        if(*Parser->At == '\\') Parser->At++;
+        Parser->At++;
+    }
+    if(Parser->At >= Parser->End)
+    {
+        Parser->Error = true;
+        return 0;
+    }
+    
+    char* Result = (char*)ZeroAlloc(Parser->At - Begin + 1);
+    char* Out = Result;
+    char* End = Parser->At;
+    Parser->At = Begin;
+    while(Parser->At < End)
+    {
+        char C = *Parser->At++;
+        if(C != '\\')
+        {
+            *Out++ = C;
+            continue;
+        }
+        
+        C = *Parser->At++;
+        switch(C)
+        {
+            case 'b': *Out++ = '\b'; break;
+            case 'f': *Out++ = '\f'; break;
+            case 'n': *Out++ = '\n'; break;
+            case 'r': *Out++ = '\r'; break;
+            case 't': *Out++ = '\t'; break;
+            case 'u':
+            {
+                //Encode the code point as UTF-8, surrogate pairs are not combined
+                u32 CodePoint = JsonParseHex4(Parser);
+                if(CodePoint < 0x80)
+                {
+                    *Out++ = (char)CodePoint;
+                }
+                else if(CodePoint < 0x800)
+                {
+                    *Out++ = (char)(0xC0 | (CodePoint >> 6));
+                    *Out++ = (char)(0x80 | (CodePoint & 0x3F));
+                }
+                else
+                {
+                    *Out++ = (char)(0xE0 | (CodePoint >> 12));
+                    *Out++ = (char)(0x80 | ((CodePoint >> 6) & 0x3F));
+                    *Out++ = (char)(0x80 | (CodePoint & 0x3F));
+                }
+            } break;
+            default: *Out++ = C; break;
+        }
+    }
+    
+    Parser->At = End + 1;
+    return Result;
+}
+
+internal void JsonParseValue(json_parser* Parser, json_value* Value);
+
+internal void
+JsonPushElement(json_value* Value, json_value* Element, char* Key, u32* Capacity)
+{
+    if(Value->Count == *Capacity)
+    {
+        *Capacity = *Capacity ? *Capacity * 2 : 8;
+        Value->Elements = (json_value*)realloc(Value->Elements, sizeof(json_value) * *Capacity);
+        if(Value->Type == JSON_OBJECT)
+        {
+            Value->Keys = (char**)realloc(Value->Keys, sizeof(char*) * *Capacity);
+        }
+    }
+    
+    Value->Elements[Value->Count] = *Element;
+    if(Value->Type == JSON_OBJECT)
+    {
+        Value->Keys[Value->Count] = Key;
+    }
+    Value->Count++;
+}
+
+internal void
+JsonParseValue(json_parser* Parser, json_value* Value)
+{
+    *Value = {};
+    JsonSkipWhitespace(Parser);
+    if(Parser->At >= Parser->End)
+    {
+        Parser->Error = true;
+        return;
+    }
+    
+    char C = *Parser->At;
+    if(C == '{' || C == '[')
+    {
+        Parser->At++;
+        Value->Type = C == '{' ? JSON_OBJECT : JSON_ARRAY;
+        char Close = C == '{' ? '}' : ']';
+        
+        u32 Capacity = 0;
+        JsonSkipWhitespace(Parser);
+        if(Parser->At < Parser->End && *Parser->At == Close)
+        {
+            Parser->At++;
+            return;
+        }
+        
+        while(!Parser->Error)
+        {
+            char* Key = 0;
+            if(Value->Type == JSON_OBJECT)
+            {
+                Key = JsonParseString(Parser);
+                JsonExpect(Parser, ':');
+            }
+            
+            json_value Element;
+            JsonParseValue(Parser, &Element);
+            JsonPushElement(Value, &Element, Key, &Capacity);
+            
+            JsonSkipWhitespace(Parser);
+            if(Parser->At < Parser->End && *Parser->At == ',')
+            {
+                Parser->At++;
+                continue;
+            }
+            
+            JsonExpect(Parser, Close);
+            break;
+        }
+    }
+    else if(C == '"')
+    {
+        Value->Type = JSON_STRING;
+        Value->String = JsonParseString(Parser);
+    }
+    else if(C == '-' || (C >= '0' && C <= '9'))
+    {
+        //The document is zero terminated so strtod can't run past the end
+        char* NumberEnd = 0;
+        Value->Type = JSON_NUMBER;
+        Value->Number = strtod(Parser->At, &NumberEnd);
+        if(NumberEnd == Parser->At) Parser->Error = true;
+        Parser->At = NumberEnd;
+    }
+    else if(Parser->End - Parser->At >= 4 && strncmp(Parser->At, "true", 4) == 0)
+    {
+        Value->Type = JSON_TRUE;
+        Parser->At += 4;
+    }
+    else if(Parser->End - Parser->At >= 5 && strncmp(Parser->At, "false", 5) == 0)
+    {
+        Value->Type = JSON_FALSE;
+        Parser->At += 5;
+    }
+    else if(Parser->End - Parser->At >= 4 && strncmp(Parser->At, "null", 4) == 0)
+    {
+        Value->Type = JSON_NULL;
+        Parser->At += 4;
+    }
+    else
+    {
+        Parser->Error = true;
+    }
+}
+
+//Text must be zero terminated, returns false on malformed documents
+internal b32
+ParseJson(char* Text, u64 Length, json_value* Result)
+{
+    json_parser Parser = {};
+    Parser.At = Text;
+    Parser.End = Text + Length;
+    JsonParseValue(&Parser, Result);
+    return !Parser.Error;
+}
+
+internal json_value*
+JsonGet(json_value* Object, char* Key)
+{
+    if(!Object || Object->Type != JSON_OBJECT) return 0;
+    
+    for(u32 Index = 0; Index < Object->Count; Index++)
+    {
+        if(strcmp(Object->Keys[Index], Key) == 0)
+        {
+            return &Object->Elements[Index];
+        }
+    }
+    return 0;
+}
+
+internal json_value*
+JsonAt(json_value* Array, u32 Index)
+{
+    if(!Array || (Array->Type != JSON_ARRAY && Array->Type != JSON_OBJECT) || Index >= Array->Count) return 0;
+    return &Array->Elements[Index];
+}
+
+internal f64
+JsonNumber(json_value* Value, f64 Default = 0.0)
+{
+    return Value && Value->Type == JSON_NUMBER ? Value->Number : Default;
+}
+
+internal s64
+JsonInteger(json_value* Value, s64 Default = -1)
+{
+    return Value && Value->Type == JSON_NUMBER ? (s64)Value->Number : Default;
+}
+
+internal char*
+JsonString(json_value* Value, char* Default = 0)
+{
+    return Value && Value->Type == JSON_STRING ? Value->String : Default;
+}
+
+internal void
+FreeJson(json_value* Value)
+{
+    Free(Value->String);
+    for(u32 Index = 0; Index < Value->Count; Index++)
+    {
+        FreeJson(&Value->Elements[Index]);
+        if(Value->Keys) Free(Value->Keys[Index]);
+    }
+    Free(Value->Elements);
+    Free(Value->Keys);
+    *Value = {};
+}
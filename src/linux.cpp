@@ -0,0 +1,387 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+internal platform_file
+Platform_OpenFileForReading(char* Path)
+{
+    return open(Path, O_RDONLY);
+}
+
+internal platform_file
+Platform_OpenFileForDirectReading(char* Path)
+{
+    return open(Path, O_RDONLY | O_DIRECT);
+}
+
+internal void
+Platform_CloseFile(platform_file File)
+{
+    close(File);
+}
+
+internal u64
+Platform_GetFileSize(platform_file File)
+{
+    struct stat Stat = {};
+    if(fstat(File, &Stat) != 0) return 0;
+    return (u64)Stat.st_size;
+}
+
+internal b32
+Platform_ReadAtOffset(platform_file File, void* Data, u64 Size, u64 Offset)
+{
+    //pread can return less than requested (and at most ~2GB per call), loop until done
+    u8* At = (u8*)Data;
+    while(Size)
+    {
+        ssize_t BytesRead = pread(File, At, Size, (off_t)Offset);
+        if(BytesRead <= 0) return false;
+        
+        At += BytesRead;
+        Offset += BytesRead;
+        Size -= BytesRead;
+    }
+    
+    return true;
+}
+
+internal b32
+Platform_CreateDirectory(char* Path)
+{
+    return mkdir(Path, 0755) == 0 || errno == EEXIST;
+}
+
+internal b32
+Platform_MoveFile(char* From, char* To)
+{
+    return rename(From, To) == 0;
+}
+
+//Batched reads go through an io_uring, set up with the raw syscalls. Every batch gets its
+//own ring so that batches can be issued from any thread
+#define LINUX_IO_RING_ENTRIES 64
+//Reads are split in pieces of at most this size, the kernel caps a single read under 2GB
+#define LINUX_MAX_READ_SIZE Gigabytes(1)
+
+struct linux_io_ring
+{
+    s32 Fd;
+    
+    u32* SqTail;
+    u32 SqMask;
+    u32* SqArray;
+    io_uring_sqe* Sqes;
+    
+    u32* CqHead;
+    u32* CqTail;
+    u32 CqMask;
+    io_uring_cqe* Cqes;
+    
+    u8* SqRing;
+    u64 SqRingSize;
+    u8* CqRing;
+    u64 CqRingSize;
+    u64 SqesSize;
+};
+
+internal void
+Linux_DestroyIoRing(linux_io_ring* Ring)
+{
+    if(Ring->Sqes) munmap(Ring->Sqes, Ring->SqesSize);
+    if(Ring->CqRing && Ring->CqRing != Ring->SqRing) munmap(Ring->CqRing, Ring->CqRingSize);
+    if(Ring->SqRing) munmap(Ring->SqRing, Ring->SqRingSize);
+    close(Ring->Fd);
+    *Ring = {};
+}
+
+//Fails on kernels without io_uring or where it's disabled, like some containers
+internal b32
+Linux_CreateIoRing(linux_io_ring* Ring, u32 EntriesCount)
+{
+    *Ring = {};
+    io_uring_params Params = {};
+    Ring->Fd = (s32)syscall(__NR_io_uring_setup, EntriesCount, &Params);
+    if(Ring->Fd < 0) return false;
+    
+    Ring->SqRingSize = Params.sq_off.array + Params.sq_entries * sizeof(u32);
+    Ring->CqRingSize = Params.cq_off.cqes + Params.cq_entries * sizeof(io_uring_cqe);
+    Ring->SqesSize = Params.sq_entries * sizeof(io_uring_sqe);
+    
+    //With IORING_FEAT_SINGLE_MMAP both rings live in the same mapping
+    b32 SingleMapping = (Params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if(SingleMapping)
+    {
+        Ring->SqRingSize = Ring->CqRingSize = MAX(Ring->SqRingSize, Ring->CqRingSize);
+    }
+    
+    s32 Protection = PROT_READ | PROT_WRITE;
+    void* SqRing = mmap(0, Ring->SqRingSize, Protection, MAP_SHARED | MAP_POPULATE, Ring->Fd, IORING_OFF_SQ_RING);
+    void* CqRing = SingleMapping ? SqRing : mmap(0, Ring->CqRingSize, Protection, MAP_SHARED | MAP_POPULATE, Ring->Fd, IORING_OFF_CQ_RING);
+    void* Sqes = mmap(0, Ring->SqesSize, Protection, MAP_SHARED | MAP_POPULATE, Ring->Fd, IORING_OFF_SQES);
+    Ring->SqRing = SqRing == MAP_FAILED ? 0 : (u8*)SqRing;
+    Ring->CqRing = CqRing == MAP_FAILED ? 0 : (u8*)CqRing;
+    Ring->Sqes = Sqes == MAP_FAILED ? 0 : (io_uring_sqe*)Sqes;
+    if(!Ring->SqRing || !Ring->CqRing || !Ring->Sqes)
+    {
+        Linux_DestroyIoRing(Ring);
+        return false;
+    }
+    
+    Ring->SqTail = (u32*)(Ring->SqRing + Params.sq_off.tail);
+    Ring->SqMask = *(u32*)(Ring->SqRing + Params.sq_off.ring_mask);
+    Ring->SqArray = (u32*)(Ring->SqRing + Params.sq_off.array);
+    Ring->CqHead = (u32*)(Ring->CqRing + Params.cq_off.head);
+    Ring->CqTail = (u32*)(Ring->CqRing + Params.cq_off.tail);
+    Ring->CqMask = *(u32*)(Ring->CqRing + Params.cq_off.ring_mask);
+    Ring->Cqes = (io_uring_cqe*)(Ring->CqRing + Params.cq_off.cqes);
+    return true;
+}
+
+//Only this thread produces submissions, the kernel consumes them on io_uring_enter
+internal void
+Linux_PushRead(linux_io_ring* Ring, platform_read* Piece, u64 UserData)
+{
+    u32 Tail = *Ring->SqTail;
+    u32 Index = Tail & Ring->SqMask;
+    
+    io_uring_sqe* Sqe = &Ring->Sqes[Index];
+    memset(Sqe, 0, sizeof(io_uring_sqe));
+    Sqe->opcode = IORING_OP_READ;
+    Sqe->fd = Piece->File;
+    Sqe->addr = (u64)Piece->Data;
+    Sqe->len = (u32)MIN(Piece->Size, LINUX_MAX_READ_SIZE);
+    Sqe->off = Piece->Offset;
+    Sqe->user_data = UserData;
+    
+    Ring->SqArray[Index] = Index;
+    __atomic_store_n(Ring->SqTail, Tail + 1, __ATOMIC_RELEASE);
+}
+
+internal b32
+Platform_ReadBatch(platform_read* Reads, u32 Count)
+{
+    linux_io_ring Ring;
+    if(!Linux_CreateIoRing(&Ring, LINUX_IO_RING_ENTRIES))
+    {
+        b32 Success = true;
+        for(u32 Index = 0; Index < Count; Index++)
+        {
+            platform_read* Read = &Reads[Index];
+            Success = Platform_ReadAtOffset(Read->File, Read->Data, Read->Size, Read->Offset) && Success;
+        }
+        return Success;
+    }
+    
+    //Every read in flight has a slot with what is left of it, pieces of the same read
+    //go one after the other so that a short read can be resumed where it stopped
+    platform_read Slots[LINUX_IO_RING_ENTRIES];
+    u32 FreeSlots[LINUX_IO_RING_ENTRIES];
+    u32 FreeCount = LINUX_IO_RING_ENTRIES;
+    for(u32 Index = 0; Index < LINUX_IO_RING_ENTRIES; Index++)
+    {
+        FreeSlots[Index] = LINUX_IO_RING_ENTRIES - 1 - Index;
+    }
+    
+    b32 Success = true;
+    u32 NextRead = 0;
+    u32 InFlight = 0;
+    u32 ToSubmit = 0;
+    for(;;)
+    {
+        while(Success && FreeCount && NextRead < Count)
+        {
+            u32 Slot = FreeSlots[--FreeCount];
+            Slots[Slot] = Reads[NextRead++];
+            Linux_PushRead(&Ring, &Slots[Slot], Slot);
+            ToSubmit++;
+        }
+        
+        if(!InFlight && !ToSubmit) break;
+        
+        s32 Result = (s32)syscall(__NR_io_uring_enter, Ring.Fd, ToSubmit, 1, IORING_ENTER_GETEVENTS, 0, 0);
+        if(Result < 0)
+        {
+            if(errno == EINTR || errno == EAGAIN) continue;
+            
+            //Nothing was submitted, but reads that were already in flight must finish
+            //before the buffers can be given back to the caller
+            Success = false;
+            if(!InFlight) break;
+            ToSubmit = 0;
+            continue;
+        }
+        InFlight += (u32)Result;
+        ToSubmit -= (u32)Result;
+        
+        u32 Head = *Ring.CqHead;
+        u32 Tail = __atomic_load_n(Ring.CqTail, __ATOMIC_ACQUIRE);
+        for(; Head != Tail; Head++)
+        {
+            io_uring_cqe* Cqe = &Ring.Cqes[Head & Ring.CqMask];
+            u32 Slot = (u32)Cqe->user_data;
+            platform_read* Piece = &Slots[Slot];
+            InFlight--;
+            
+            if(Cqe->res > 0)
+            {
+                Piece->Data = (u8*)Piece->Data + Cqe->res;
+                Piece->Offset += Cqe->res;
+                Piece->Size -= Cqe->res;
+            }
+            else if(Cqe->res != -EINTR && Cqe->res != -EAGAIN)
+            {
+                //0 is the end of the file before the end of the read
+                Success = false;
+                Piece->Size = 0;
+            }
+            
+            if(Piece->Size && Success)
+            {
+                Linux_PushRead(&Ring, Piece, Slot);
+                ToSubmit++;
+            }
+            else
+            {
+                FreeSlots[FreeCount++] = Slot;
+            }
+        }
+        __atomic_store_n(Ring.CqHead, Head, __ATOMIC_RELEASE);
+    }
+    
+    Linux_DestroyIoRing(&Ring);
+    return Success;
+}
+
+internal platform_file_mapping
+Platform_MapFile(platform_file File, b32 CopyOnWrite)
+{
+    platform_file_mapping Result = {};
+    
+    u64 Size = Platform_GetFileSize(File);
+    if(!Size) return Result;
+    
+    //MAP_PRIVATE: written pages become private copies, the file is never modified
+    s32 Protection = CopyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* Data = mmap(0, Size, Protection, MAP_PRIVATE, File, 0);
+    if(Data == MAP_FAILED) return Result;
+    
+    Result.Data = (u8*)Data;
+    Result.Size = Size;
+    return Result;
+}
+
+internal void
+Platform_UnmapFile(platform_file_mapping* Mapping)
+{
+    if(Mapping->Data)
+    {
+        munmap(Mapping->Data, Mapping->Size);
+    }
+    *Mapping = {};
+}
+
+internal void*
+Platform_AllocateMemory(u64 Size)
+{
+    void* Result = mmap(0, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return Result == MAP_FAILED ? 0 : Result;
+}
+
+internal void
+Platform_FreeMemory(void* Memory, u64 Size)
+{
+    if(Memory)
+    {
+        munmap(Memory, Size);
+    }
+}
+
+internal u64
+Platform_GetMicroseconds()
+{
+    struct timespec Time = {};
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return (u64)Time.tv_sec * 1000000 + (u64)Time.tv_nsec / 1000;
+}
+
+internal u32
+Platform_GetProcessorCount()
+{
+    long Count = sysconf(_SC_NPROCESSORS_ONLN);
+    return Count > 0 ? (u32)Count : 1;
+}
+
+struct linux_thread_startup
+{
+    platform_thread_proc* Proc;
+    void* Param;
+};
+
+internal void*
+Linux_ThreadProc(void* Parameter)
+{
+    linux_thread_startup Startup = *(linux_thread_startup*)Parameter;
+    Free(Parameter);
+    
+    Startup.Proc(Startup.Param);
+    return 0;
+}
+
+internal void
+Platform_CreateThread(platform_thread_proc* Proc, void* Param)
+{
+    linux_thread_startup* Startup = (linux_thread_startup*)ZeroAlloc(sizeof(linux_thread_startup));
+    Startup->Proc = Proc;
+    Startup->Param = Param;
+    
+    pthread_t Thread;
+    int Error = pthread_create(&Thread, 0, Linux_ThreadProc, Startup);
+    Assert(Error == 0);
+    pthread_detach(Thread);
+}
+
+internal u32
+Platform_GetThreadId()
+{
+    return (u32)syscall(SYS_gettid);
+}
+
+internal platform_semaphore
+Platform_CreateSemaphore(u32 InitialCount)
+{
+    sem_t* Semaphore = (sem_t*)ZeroAlloc(sizeof(sem_t));
+    sem_init(Semaphore, 0, InitialCount);
+    return Semaphore;
+}
+
+internal void
+Platform_SignalSemaphore(platform_semaphore Semaphore)
+{
+    sem_post((sem_t*)Semaphore);
+}
+
+internal void
+Platform_WaitSemaphore(platform_semaphore Semaphore)
+{
+    while(sem_wait((sem_t*)Semaphore) != 0 && errno == EINTR);
+}
+
+internal u32
+Platform_AtomicAdd(volatile u32* Value, u32 Addend)
+{
+    return __atomic_fetch_add(Value, Addend, __ATOMIC_SEQ_CST);
+}
+
+internal b32
+Platform_AtomicCompareExchange(volatile u32* Value, u32 Expected, u32 New)
+{
+    return __atomic_compare_exchange_n(Value, &Expected, New, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
@@ -217,6 +217,20 @@ ExactLinearToSRGB(f32 v)
     }
 }
 
+inline f32
+ExactSRGBToLinear(f32 v)
+{
+    v = Clamp(v, 0.0f, 1.0f);
+    if(v > 0.04045f)
+    {
+        return (f32)pow((v + 0.055f) / 1.055f, 2.4f);
+    } 
+    else 
+    {
+        return v / 12.92f;
+    }
+}
+
 inline f32
 LinearToSRGB(f32 v)
 {
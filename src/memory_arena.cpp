@@ -0,0 +1,116 @@
+//Linear allocators. Memory is pushed at the end of the arena and only released all
+//together, either by resetting the arena or by ending a temporary memory block which
+//pops everything pushed since it began. Arenas are not thread safe.
+
+struct memory_arena
+{
+    u8* Base;
+    u64 Size;
+    u64 Used;
+    
+    u32 TemporaryCount;
+};
+
+struct temporary_memory
+{
+    memory_arena* Arena;
+    u64 Used;
+};
+
+internal void
+InitArena(memory_arena* Arena, void* Base, u64 Size)
+{
+    Arena->Base = (u8*)Base;
+    Arena->Size = Size;
+    Arena->Used = 0;
+    Arena->TemporaryCount = 0;
+}
+
+//Backed by its own system allocation, released with FreeArena
+internal void
+AllocateArena(memory_arena* Arena, u64 Size)
+{
+    void* Base = Platform_AllocateMemory(Size);
+    Assert(Base);
+    InitArena(Arena, Base, Size);
+}
+
+internal void
+FreeArena(memory_arena* Arena)
+{
+    Platform_FreeMemory(Arena->Base, Arena->Size);
+    *Arena = {};
+}
+
+//Pushed memory is always zeroed
+internal void*
+PushSize(memory_arena* Arena, u64 Size, u64 Alignment = 16)
+{
+    Assert(IS_POW2(Alignment));
+    u64 Offset = ALIGN_UP((u64)(Arena->Base + Arena->Used), Alignment) - (u64)Arena->Base;
+    Assert(Offset + Size <= Arena->Size);
+    
+    void* Result = Arena->Base + Offset;
+    Arena->Used = Offset + Size;
+    memset(Result, 0, Size);
+    return Result;
+}
+
+//Bytes that can still be pushed with the given alignment
+internal u64
+GetArenaSizeRemaining(memory_arena* Arena, u64 Alignment = 16)
+{
+    u64 Offset = ALIGN_UP((u64)(Arena->Base + Arena->Used), Alignment) - (u64)Arena->Base;
+    return Offset < Arena->Size ? Arena->Size - Offset : 0;
+}
+
+#define PushStruct(Arena, type) (type*)PushSize(Arena, sizeof(type))
+#define PushArray(Arena, Count, type) (type*)PushSize(Arena, sizeof(type) * (Count))
+
+internal char*
+PushString(memory_arena* Arena, char* Format, ...)
+{
+    va_list Args;
+    va_start(Args, Format);
+    s32 Length = vsnprintf(0, 0, Format, Args);
+    va_end(Args);
+    
+    char* Result = (char*)PushSize(Arena, Length + 1, 1);
+    va_start(Args, Format);
+    vsnprintf(Result, Length + 1, Format, Args);
+    va_end(Args);
+    return Result;
+}
+
+//Carves a child arena out of Parent, used to get several arenas out of one allocation
+internal void
+SubArena(memory_arena* Result, memory_arena* Parent, u64 Size)
+{
+    InitArena(Result, PushSize(Parent, Size), Size);
+}
+
+internal void
+ResetArena(memory_arena* Arena)
+{
+    Assert(Arena->TemporaryCount == 0);
+    Arena->Used = 0;
+}
+
+internal temporary_memory
+BeginTemporaryMemory(memory_arena* Arena)
+{
+    temporary_memory Result = {};
+    Result.Arena = Arena;
+    Result.Used = Arena->Used;
+    Arena->TemporaryCount++;
+    return Result;
+}
+
+internal void
+EndTemporaryMemory(temporary_memory Temp)
+{
+    memory_arena* Arena = Temp.Arena;
+    Assert(Arena->Used >= Temp.Used && Arena->TemporaryCount > 0);
+    Arena->Used = Temp.Used;
+    Arena->TemporaryCount--;
+}
@@ -1,5 +1,23 @@
 #include "mesh.h"
 
+inline mesh_joint*
+GetJointChildren(mesh_joint* Joint)
+{
+    return RELATIVE_POINTER(mesh_joint, Joint->ChildrenOffset);
+}
+
+inline joint_animation*
+GetAnimationJoints(mesh_animation* Animation)
+{
+    return RELATIVE_POINTER(joint_animation, Animation->JointsOffset);
+}
+
+inline animation_keyframe*
+GetJointKeyframes(joint_animation* JointAnimation)
+{
+    return RELATIVE_POINTER(animation_keyframe, JointAnimation->KeyframesOffset);
+}
+
 internal void
 ReverseTriangleWinding(u32* Indices, u32 Count)
 {
@@ -18,6 +36,71 @@ ReverseTriangleWinding(mesh_data* Mesh)
     ReverseTriangleWinding(Mesh->Indices, Mesh->IndicesCount);
 }
 
+//Smooth normals weighted by triangle area, indexed triangle lists only
+internal void
+ComputeMeshNormals(mesh_data* Mesh)
+{
+    Assert(!(Mesh->Flags & (MESH_IS_STRIP | MESH_NO_INDICES)));
+    if(!Mesh->Normals) {
+        Mesh->Normals = (vec3*)ZeroAlloc(sizeof(vec3) * Mesh->VerticesCount);
+    }
+    
+    vec3* Normals = Mesh->Normals;
+    for(u32 Index = 0; Index < Mesh->VerticesCount; Index++)
+    {
+        Normals[Index] = vec3(0.0f);
+    }
+    
+    for(u32 Index = 0; Index + 2 < Mesh->IndicesCount; Index += 3)
+    {
+        u32 i0 = Mesh->Indices[Index + 0];
+        u32 i1 = Mesh->Indices[Index + 1];
+        u32 i2 = Mesh->Indices[Index + 2];
+        
+        //Not normalized, the length is twice the area of the triangle
+        vec3 N = Cross(Mesh->Positions[i1] - Mesh->Positions[i0], Mesh->Positions[i2] - Mesh->Positions[i0]);
+        Normals[i0] = Normals[i0] + N;
+        Normals[i1] = Normals[i1] + N;
+        Normals[i2] = Normals[i2] + N;
+    }
+    
+    for(u32 Index = 0; Index < Mesh->VerticesCount; Index++)
+    {
+        f32 Magnitude = Length(Normals[Index]);
+        Normals[Index] = Magnitude > 0.0f ? Normals[Index] * (1.0f / Magnitude) : vec3(0.0f, 0.0f, 1.0f);
+    }
+}
+
+//Square root of the ratio between the UV area and the object space area of the triangles,
+//the UV distance covered by a unit of length on the surface, on average. Multiplied by the
+//size of a texture it gives its texels per unit, which is what mip selection needs.
+//0 for meshes without area
+internal f32
+ComputeMeshUVDensity(mesh_data* Mesh)
+{
+    b32 IsStrip = Mesh->Flags & MESH_IS_STRIP;
+    b32 HasIndices = !(Mesh->Flags & MESH_NO_INDICES);
+    u32 IndicesCount = HasIndices ? Mesh->IndicesCount : Mesh->VerticesCount;
+    u32 TrianglesCount = IsStrip ? (IndicesCount >= 3 ? IndicesCount - 2 : 0) : IndicesCount / 3;
+    
+    f64 Area = 0.0;
+    f64 UVArea = 0.0;
+    for(u32 Triangle = 0; Mesh->UVs && Triangle < TrianglesCount; Triangle++)
+    {
+        u32 First = IsStrip ? Triangle : Triangle * 3;
+        u32 i0 = HasIndices ? Mesh->Indices[First + 0] : First + 0;
+        u32 i1 = HasIndices ? Mesh->Indices[First + 1] : First + 1;
+        u32 i2 = HasIndices ? Mesh->Indices[First + 2] : First + 2;
+        
+        Area += Length(Cross(Mesh->Positions[i1] - Mesh->Positions[i0], Mesh->Positions[i2] - Mesh->Positions[i0]));
+        vec2 UV1 = Mesh->UVs[i1] - Mesh->UVs[i0];
+        vec2 UV2 = Mesh->UVs[i2] - Mesh->UVs[i0];
+        UVArea += fabs(UV1.x * UV2.y - UV1.y * UV2.x);
+    }
+    
+    return Area > 0.0 ? (f32)sqrt(UVArea / Area) : 0.0f;
+}
+
 internal void
 ComputeMeshTangents(mesh_data* Mesh)
 {
@@ -159,6 +242,21 @@ ComputeMeshTangents(mesh_data* Mesh)
     Free(Tan1);
 }
 
+//Writes the normal, tangent and UV of every vertex to Dest, the shading stream of
+//MESH_INTERLEAVED meshes
+internal void
+InterleaveMeshVertices(mesh_data* Mesh, mesh_shading_vertex* Dest)
+{
+    Assert(Mesh->Normals && Mesh->Tangents && Mesh->UVs);
+    
+    for(u32 Vertex = 0; Vertex < Mesh->VerticesCount; Vertex++)
+    {
+        Dest[Vertex].Normal = Mesh->Normals[Vertex];
+        Dest[Vertex].Tangent = Mesh->Tangents[Vertex];
+        Dest[Vertex].UV = Mesh->UVs[Vertex];
+    }
+}
+
 
 internal mesh_data
 AllocCubeMesh(vec3 Size = vec3(1.0f, 1.0f, 1.0f))
@@ -268,15 +366,16 @@ internal void
 UpdateJointStateRecursively(mesh_joint* Joint, mesh_animation* Animation, mat4 ParentTransform,
                             mat4* Joints, u32 Count, float Time)
 {
-    joint_animation* JointAnimation = &Animation->Joints[Joint->Id];
+    joint_animation* JointAnimation = &GetAnimationJoints(Animation)[Joint->Id];
     if(JointAnimation->KeyframesCount == 0) return;
     
-    Assert(Time >= 0.0f && Time <= JointAnimation->Keyframes[JointAnimation->KeyframesCount - 1].Time);
+    animation_keyframe* Keyframes = GetJointKeyframes(JointAnimation);
+    Assert(Time >= 0.0f && Time <= Keyframes[JointAnimation->KeyframesCount - 1].Time);
     u32 BeginIndex = 0;
     u32 EndIndex = 0;
     for(u32 Index = 1; Index < JointAnimation->KeyframesCount; Index++)
     {
-        if(JointAnimation->Keyframes[Index].Time > Time)
+        if(Keyframes[Index].Time > Time)
         {
             EndIndex = Index;
             BeginIndex = Index - 1;
@@ -284,8 +383,8 @@ UpdateJointStateRecursively(mesh_joint* Joint, mesh_animation* Animation, mat4 P
         }
     }
     
-    animation_keyframe BeginKeyframe = JointAnimation->Keyframes[BeginIndex];
-    animation_keyframe EndKeyframe = JointAnimation->Keyframes[EndIndex];
+    animation_keyframe BeginKeyframe = Keyframes[BeginIndex];
+    animation_keyframe EndKeyframe = Keyframes[EndIndex];
     
     float Progress = (Time - BeginKeyframe.Time) / (EndKeyframe.Time - BeginKeyframe.Time);
     vec3 Position = Lerp(BeginKeyframe.Position, EndKeyframe.Position, Progress);
@@ -294,9 +393,10 @@ UpdateJointStateRecursively(mesh_joint* Joint, mesh_animation* Animation, mat4 P
     mat4 LocalTransform = Mat4Translation(Position) * QuaternionToMat4(Rotation);
     mat4 JointTransform = ParentTransform * LocalTransform;
     
+    mesh_joint* Children = GetJointChildren(Joint);
     for(u32 Index = 0; Index < Joint->ChildrenCount; Index++)
     {
-        UpdateJointStateRecursively(&Joint->Children[Index], Animation, JointTransform,
+        UpdateJointStateRecursively(&Children[Index], Animation, JointTransform,
                                     Joints, Count, Time);
     }
     
@@ -333,7 +433,821 @@ FreeMesh(mesh_data* Mesh)
         Free(Mesh->VertexData[i]);
     }
     Free(Mesh->Indices);
+    Free(Mesh->Meshlets);
     // TODO: Free animation data
     
     *Mesh = {};
-}
\ No newline at end of file
+}
+
+// Mesh optimization for indexed triangle lists. Triangles are ordered for the post transform
+// vertex cache with Forsyth's linear speed optimizer, then that order is split in clusters
+// which are sorted to draw the ones facing away from the center of the mesh first, so that
+// they occlude the others from most views (view independent overdraw, Sander et al.).
+// Vertices are then stored in the order the indices first use them, for fetch locality.
+
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_MAX_VALENCE 32
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRIANGLE_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+//Cache of the overdraw clustering and of the reported stats, a FIFO like the hardware ones
+#define MESH_ANALYSIS_CACHE_SIZE 16
+//Clusters are split while their misses per triangle stay within this factor of the unsplit one
+#define MESH_OVERDRAW_THRESHOLD 1.05f
+
+struct vertex_cache_stats
+{
+    f32 ACMR; //Misses per triangle, 3 at worst and about 0.5 for a large regular grid
+    f32 ATVR; //Misses per vertex used by the indices, 1 at best
+};
+
+//Simulates a FIFO cache of CacheSize vertices
+internal vertex_cache_stats
+AnalyzeVertexCache(u32* Indices, u32 IndicesCount, u32 VerticesCount, u32 CacheSize)
+{
+    //A vertex is in the cache while less than CacheSize misses happened after its own
+    u32* Timestamps = (u32*)ZeroAlloc(sizeof(u32) * MAX(VerticesCount, 1));
+    u32 Time = CacheSize + 1;
+    u32 MissesCount = 0;
+    u32 UsedCount = 0;
+    for(u32 Index = 0; Index < IndicesCount; Index++)
+    {
+        u32 Vertex = Indices[Index];
+        Assert(Vertex < VerticesCount);
+        if(Time - Timestamps[Vertex] > CacheSize)
+        {
+            UsedCount += Timestamps[Vertex] == 0;
+            Timestamps[Vertex] = Time++;
+            MissesCount++;
+        }
+    }
+    Free(Timestamps);
+    
+    vertex_cache_stats Result = {};
+    Result.ACMR = IndicesCount >= 3 ? (f32)MissesCount / (IndicesCount / 3) : 0.0f;
+    Result.ATVR = UsedCount ? (f32)MissesCount / UsedCount : 0.0f;
+    return Result;
+}
+
+struct forsyth_tables
+{
+    f32 Cache[FORSYTH_CACHE_SIZE];
+    f32 Valence[FORSYTH_MAX_VALENCE + 1];
+};
+
+internal forsyth_tables
+BuildForsythTables()
+{
+    forsyth_tables Result = {};
+    for(u32 Position = 0; Position < FORSYTH_CACHE_SIZE; Position++)
+    {
+        //The last triangle gets a fixed score, so that it isn't favored over the ones next to it
+        f32 Scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+        Result.Cache[Position] = Position < 3 ? FORSYTH_LAST_TRIANGLE_SCORE :
+            powf(1.0f - (Position - 3) * Scale, FORSYTH_CACHE_DECAY_POWER);
+    }
+    for(u32 Valence = 1; Valence <= FORSYTH_MAX_VALENCE; Valence++)
+    {
+        Result.Valence[Valence] = FORSYTH_VALENCE_BOOST_SCALE * powf((f32)Valence, -FORSYTH_VALENCE_BOOST_POWER);
+    }
+    return Result;
+}
+
+//Vertices with few triangles left are favored so that they leave the cache for good
+internal f32
+GetForsythVertexScore(forsyth_tables* Tables, s32 CachePosition, u32 RemainingCount)
+{
+    if(RemainingCount == 0) return -1.0f;
+    
+    f32 Score = CachePosition >= 0 ? Tables->Cache[CachePosition] : 0.0f;
+    return Score + Tables->Valence[MIN(RemainingCount, FORSYTH_MAX_VALENCE)];
+}
+
+//Reorders the triangles in place
+internal void
+OptimizeVertexCache(u32* Indices, u32 IndicesCount, u32 VerticesCount)
+{
+    //Initialized once, safe to call from multiple threads
+    local_persist forsyth_tables Tables = BuildForsythTables();
+    
+    u32 TrianglesCount = IndicesCount / 3;
+    Assert(IndicesCount % 3 == 0);
+    if(TrianglesCount < 2) return;
+    
+    //Triangles of every vertex, the ones not emitted yet come first
+    u32* Offsets = (u32*)ZeroAlloc(sizeof(u32) * (VerticesCount + 1));
+    u32* RemainingCounts = (u32*)ZeroAlloc(sizeof(u32) * VerticesCount);
+    u32* Adjacency = (u32*)ZeroAlloc(sizeof(u32) * IndicesCount);
+    for(u32 Index = 0; Index < IndicesCount; Index++)
+    {
+        Assert(Indices[Index] < VerticesCount);
+        RemainingCounts[Indices[Index]]++;
+    }
+    for(u32 Vertex = 0; Vertex < VerticesCount; Vertex++)
+    {
+        Offsets[Vertex + 1] = Offsets[Vertex] + RemainingCounts[Vertex];
+        RemainingCounts[Vertex] = 0;
+    }
+    for(u32 Index = 0; Index < IndicesCount; Index++)
+    {
+        u32 Vertex = Indices[Index];
+        Adjacency[Offsets[Vertex] + RemainingCounts[Vertex]++] = Index / 3;
+    }
+    
+    s32* CachePositions = (s32*)ZeroAlloc(sizeof(s32) * VerticesCount);
+    f32* VertexScores = (f32*)ZeroAlloc(sizeof(f32) * VerticesCount);
+    for(u32 Vertex = 0; Vertex < VerticesCount; Vertex++)
+    {
+        CachePositions[Vertex] = -1;
+        VertexScores[Vertex] = GetForsythVertexScore(&Tables, -1, RemainingCounts[Vertex]);
+    }
+    
+    f32* TriangleScores = (f32*)ZeroAlloc(sizeof(f32) * TrianglesCount);
+    b32* Emitted = (b32*)ZeroAlloc(sizeof(b32) * TrianglesCount);
+    s32 Best = -1;
+    for(u32 Triangle = 0; Triangle < TrianglesCount; Triangle++)
+    {
+        u32* Vertices = Indices + Triangle * 3;
+        TriangleScores[Triangle] = VertexScores[Vertices[0]] + VertexScores[Vertices[1]] + VertexScores[Vertices[2]];
+        if(Best < 0 || TriangleScores[Triangle] > TriangleScores[Best])
+        {
+            Best = Triangle;
+        }
+    }
+    
+    u32* Result = (u32*)ZeroAlloc(sizeof(u32) * IndicesCount);
+    u32 Cache[FORSYTH_CACHE_SIZE + 3];
+    u32 CacheCount = 0;
+    u32 Cursor = 0;
+    for(u32 Output = 0; Output < TrianglesCount; Output++)
+    {
+        //When no triangle in the cache is left continue from the first one not emitted
+        if(Best < 0)
+        {
+            while(Emitted[Cursor]) Cursor++;
+            Best = Cursor;
+        }
+        
+        u32* Vertices = Indices + Best * 3;
+        memcpy(Result + Output * 3, Vertices, sizeof(u32) * 3);
+        Emitted[Best] = true;
+        
+        u32 NewCache[FORSYTH_CACHE_SIZE + 3];
+        u32 NewCacheCount = 0;
+        for(u32 Corner = 0; Corner < 3; Corner++)
+        {
+            u32 Vertex = Vertices[Corner];
+            u32* Triangles = Adjacency + Offsets[Vertex];
+            for(u32 Index = 0; Index < RemainingCounts[Vertex]; Index++)
+            {
+                if(Triangles[Index] == (u32)Best)
+                {
+                    Triangles[Index] = Triangles[--RemainingCounts[Vertex]];
+                    Triangles[RemainingCounts[Vertex]] = Best;
+                    break;
+                }
+            }
+            
+            //Degenerate triangles repeat vertices
+            if(CachePositions[Vertex] != -2)
+            {
+                NewCache[NewCacheCount++] = Vertex;
+                CachePositions[Vertex] = -2;
+            }
+        }
+        for(u32 Index = 0; Index < CacheCount; Index++)
+        {
+            if(CachePositions[Cache[Index]] != -2)
+            {
+                NewCache[NewCacheCount++] = Cache[Index];
+            }
+        }
+        
+        //Vertices past the cache size were evicted, their score changes too
+        for(u32 Index = 0; Index < NewCacheCount; Index++)
+        {
+            u32 Vertex = NewCache[Index];
+            CachePositions[Vertex] = Index < FORSYTH_CACHE_SIZE ? (s32)Index : -1;
+            VertexScores[Vertex] = GetForsythVertexScore(&Tables, CachePositions[Vertex], RemainingCounts[Vertex]);
+        }
+        
+        Best = -1;
+        for(u32 Index = 0; Index < NewCacheCount; Index++)
+        {
+            u32 Vertex = NewCache[Index];
+            u32* Triangles = Adjacency + Offsets[Vertex];
+            for(u32 TriangleIndex = 0; TriangleIndex < RemainingCounts[Vertex]; TriangleIndex++)
+            {
+                u32 Triangle = Triangles[TriangleIndex];
+                u32* Corners = Indices + Triangle * 3;
+                TriangleScores[Triangle] = VertexScores[Corners[0]] + VertexScores[Corners[1]] + VertexScores[Corners[2]];
+                if(Best < 0 || TriangleScores[Triangle] > TriangleScores[Best])
+                {
+                    Best = Triangle;
+                }
+            }
+        }
+        
+        CacheCount = MIN(NewCacheCount, FORSYTH_CACHE_SIZE);
+        memcpy(Cache, NewCache, sizeof(u32) * CacheCount);
+    }
+    
+    memcpy(Indices, Result, sizeof(u32) * IndicesCount);
+    Free(Result);
+    Free(Emitted);
+    Free(TriangleScores);
+    Free(VertexScores);
+    Free(CachePositions);
+    Free(Adjacency);
+    Free(RemainingCounts);
+    Free(Offsets);
+}
+
+struct overdraw_cluster
+{
+    u32 First; //Triangle
+    u32 Count;
+    f32 SortKey;
+};
+
+internal int
+CompareOverdrawClusters(const void* A, const void* B)
+{
+    overdraw_cluster* ClusterA = (overdraw_cluster*)A;
+    overdraw_cluster* ClusterB = (overdraw_cluster*)B;
+    if(ClusterA->SortKey != ClusterB->SortKey) return ClusterA->SortKey > ClusterB->SortKey ? -1 : 1;
+    return ClusterA->First < ClusterB->First ? -1 : ClusterA->First > ClusterB->First;
+}
+
+//Misses of a FIFO cache for the triangles [First, First + Count), with the cache flushed
+//before. MissesCount[Triangle] gets the misses of every triangle if given
+internal u32
+CountClusterMisses(u32* Indices, u32 First, u32 Count, u32* Timestamps, u32* Time, u32* MissesCount)
+{
+    *Time += MESH_ANALYSIS_CACHE_SIZE + 1;
+    u32 Result = 0;
+    for(u32 Triangle = First; Triangle < First + Count; Triangle++)
+    {
+        u32 Misses = 0;
+        for(u32 Corner = 0; Corner < 3; Corner++)
+        {
+            u32 Vertex = Indices[Triangle * 3 + Corner];
+            if(*Time - Timestamps[Vertex] > MESH_ANALYSIS_CACHE_SIZE)
+            {
+                Timestamps[Vertex] = (*Time)++;
+                Misses++;
+            }
+        }
+        if(MissesCount) MissesCount[Triangle] = Misses;
+        Result += Misses;
+    }
+    return Result;
+}
+
+//Reorders clusters of triangles in place, the triangles should already be in vertex cache
+//order. A cluster ends where the cache order restarts, a triangle that misses on all of
+//its vertices, or earlier if it doesn't cost more than Threshold times the misses per
+//triangle of the whole run
+internal void
+OptimizeOverdraw(u32* Indices, u32 IndicesCount, vec3* Positions, u32 VerticesCount, f32 Threshold)
+{
+    u32 TrianglesCount = IndicesCount / 3;
+    Assert(IndicesCount % 3 == 0);
+    if(TrianglesCount < 2) return;
+    
+    u32* Timestamps = (u32*)ZeroAlloc(sizeof(u32) * VerticesCount);
+    u32* MissesCount = (u32*)ZeroAlloc(sizeof(u32) * TrianglesCount);
+    u32 Time = 0;
+    CountClusterMisses(Indices, 0, TrianglesCount, Timestamps, &Time, MissesCount);
+    
+    overdraw_cluster* Clusters = (overdraw_cluster*)ZeroAlloc(sizeof(overdraw_cluster) * TrianglesCount);
+    u32 ClustersCount = 0;
+    for(u32 Start = 0; Start < TrianglesCount;)
+    {
+        u32 End = Start + 1;
+        while(End < TrianglesCount && MissesCount[End] < 3) End++;
+        
+        f32 RunACMR = (f32)CountClusterMisses(Indices, Start, End - Start, Timestamps, &Time, 0) / (End - Start);
+        u32 First = Start;
+        u32 Misses = 0;
+        Time += MESH_ANALYSIS_CACHE_SIZE + 1;
+        for(u32 Triangle = Start; Triangle < End; Triangle++)
+        {
+            for(u32 Corner = 0; Corner < 3; Corner++)
+            {
+                u32 Vertex = Indices[Triangle * 3 + Corner];
+                if(Time - Timestamps[Vertex] > MESH_ANALYSIS_CACHE_SIZE)
+                {
+                    Timestamps[Vertex] = Time++;
+                    Misses++;
+                }
+            }
+            
+            if(Triangle + 1 == End || (f32)Misses / (Triangle + 1 - First) <= RunACMR * Threshold)
+            {
+                overdraw_cluster* Cluster = &Clusters[ClustersCount++];
+                Cluster->First = First;
+                Cluster->Count = Triangle + 1 - First;
+                First = Triangle + 1;
+                Misses = 0;
+                Time += MESH_ANALYSIS_CACHE_SIZE + 1;
+            }
+        }
+        Start = End;
+    }
+    
+    //Area weighted centroid and normal of every cluster
+    vec3* Centroids = (vec3*)ZeroAlloc(sizeof(vec3) * ClustersCount);
+    vec3* Normals = (vec3*)ZeroAlloc(sizeof(vec3) * ClustersCount);
+    vec3 MeshCentroid = vec3(0.0f);
+    f32 MeshArea = 0.0f;
+    for(u32 ClusterIndex = 0; ClusterIndex < ClustersCount; ClusterIndex++)
+    {
+        overdraw_cluster* Cluster = &Clusters[ClusterIndex];
+        vec3 Centroid = vec3(0.0f);
+        vec3 Normal = vec3(0.0f);
+        f32 Area = 0.0f;
+        for(u32 Triangle = Cluster->First; Triangle < Cluster->First + Cluster->Count; Triangle++)
+        {
+            vec3 P0 = Positions[Indices[Triangle * 3 + 0]];
+            vec3 P1 = Positions[Indices[Triangle * 3 + 1]];
+            vec3 P2 = Positions[Indices[Triangle * 3 + 2]];
+            vec3 N = Cross(P1 - P0, P2 - P0);
+            f32 TriangleArea = Length(N);
+            Centroid = Centroid + (P0 + P1 + P2) * (TriangleArea / 3.0f);
+            Normal = Normal + N;
+            Area += TriangleArea;
+        }
+        Centroids[ClusterIndex] = Area > 0.0f ? Centroid * (1.0f / Area) : Positions[Indices[Cluster->First * 3]];
+        Normals[ClusterIndex] = Normal;
+        MeshCentroid = MeshCentroid + Centroid;
+        MeshArea += Area;
+    }
+    MeshCentroid = MeshArea > 0.0f ? MeshCentroid * (1.0f / MeshArea) : vec3(0.0f);
+    
+    for(u32 ClusterIndex = 0; ClusterIndex < ClustersCount; ClusterIndex++)
+    {
+        f32 NormalLength = Length(Normals[ClusterIndex]);
+        vec3 Normal = NormalLength > 0.0f ? Normals[ClusterIndex] * (1.0f / NormalLength) : vec3(0.0f);
+        Clusters[ClusterIndex].SortKey = Dot(Centroids[ClusterIndex] - MeshCentroid, Normal);
+    }
+    qsort(Clusters, ClustersCount, sizeof(overdraw_cluster), CompareOverdrawClusters);
+    
+    u32* Result = (u32*)ZeroAlloc(sizeof(u32) * IndicesCount);
+    u32 At = 0;
+    for(u32 ClusterIndex = 0; ClusterIndex < ClustersCount; ClusterIndex++)
+    {
+        overdraw_cluster* Cluster = &Clusters[ClusterIndex];
+        memcpy(Result + At, Indices + Cluster->First * 3, sizeof(u32) * 3 * Cluster->Count);
+        At += 3 * Cluster->Count;
+    }
+    Assert(At == IndicesCount);
+    memcpy(Indices, Result, sizeof(u32) * IndicesCount);
+    
+    Free(Result);
+    Free(Normals);
+    Free(Centroids);
+    Free(Clusters);
+    Free(MissesCount);
+    Free(Timestamps);
+}
+
+//Renumbers the vertices in the order the indices first use them, the unused ones go last
+internal void
+OptimizeVertexFetch(mesh_data* Mesh)
+{
+    u32 VerticesCount = Mesh->VerticesCount;
+    u32* Remap = (u32*)ZeroAlloc(sizeof(u32) * VerticesCount);
+    memset(Remap, 0xFF, sizeof(u32) * VerticesCount);
+    
+    u32 NextVertex = 0;
+    for(u32 Index = 0; Index < Mesh->IndicesCount; Index++)
+    {
+        u32* Vertex = &Mesh->Indices[Index];
+        if(Remap[*Vertex] == 0xFFFFFFFF)
+        {
+            Remap[*Vertex] = NextVertex++;
+        }
+        *Vertex = Remap[*Vertex];
+    }
+    for(u32 Vertex = 0; Vertex < VerticesCount; Vertex++)
+    {
+        if(Remap[Vertex] == 0xFFFFFFFF)
+        {
+            Remap[Vertex] = NextVertex++;
+        }
+    }
+    
+    //Same order as VertexData
+    u32 AttributeSizes[] = { sizeof(vec3), sizeof(vec3), sizeof(vec3), sizeof(vec2), sizeof(vec4), sizeof(ivec4) };
+    static_assert(ArrayCount(AttributeSizes) == ArrayCount(Mesh->VertexData));
+    u32 AttributesCount = (Mesh->Flags & MESH_HAS_ANIMATION) ? 6 : 4;
+    u8* Scratch = (u8*)ZeroAlloc(sizeof(vec4) * VerticesCount);
+    for(u32 Attribute = 0; Attribute < AttributesCount; Attribute++)
+    {
+        u8* Data = (u8*)Mesh->VertexData[Attribute];
+        u32 Size = AttributeSizes[Attribute];
+        if(!Data) continue;
+        
+        for(u32 Vertex = 0; Vertex < VerticesCount; Vertex++)
+        {
+            memcpy(Scratch + (u64)Remap[Vertex] * Size, Data + (u64)Vertex * Size, Size);
+        }
+        memcpy(Data, Scratch, (u64)Size * VerticesCount);
+    }
+    
+    Free(Scratch);
+    Free(Remap);
+}
+
+//Vertex cache, overdraw and vertex fetch optimizations, in that order. The mesh arrays are
+//changed in place, strips and meshes without indices are left as they are
+internal void
+OptimizeMesh(mesh_data* Mesh)
+{
+    if(Mesh->Flags & (MESH_IS_STRIP | MESH_NO_INDICES)) return;
+    
+    OptimizeVertexCache(Mesh->Indices, Mesh->IndicesCount, Mesh->VerticesCount);
+    OptimizeOverdraw(Mesh->Indices, Mesh->IndicesCount, Mesh->Positions, Mesh->VerticesCount, MESH_OVERDRAW_THRESHOLD);
+    OptimizeVertexFetch(Mesh);
+}
+
+//Strips, indexed or not, become indexed lists that keep the winding of every triangle.
+//Triangles that repeat a vertex, like the ones joining strips, or with two corners at the
+//same position, like the poles of AllocSphereMesh, are dropped. The indices must be owned
+//by the mesh, lists are left as they are
+internal void
+ConvertStripToList(mesh_data* Mesh)
+{
+    if(!(Mesh->Flags & MESH_IS_STRIP)) return;
+    
+    b32 HasIndices = !(Mesh->Flags & MESH_NO_INDICES);
+    u32 StripCount = HasIndices ? Mesh->IndicesCount : Mesh->VerticesCount;
+    u32 TrianglesCount = StripCount >= 3 ? StripCount - 2 : 0;
+    u32* Indices = (u32*)ZeroAlloc(sizeof(u32) * 3 * MAX(TrianglesCount, 1));
+    
+    u32 IndicesCount = 0;
+    for(u32 Triangle = 0; Triangle < TrianglesCount; Triangle++)
+    {
+        //Odd triangles of a strip are wound the other way
+        u32 Odd = Triangle & 1;
+        u32 i0 = HasIndices ? Mesh->Indices[Triangle + Odd] : Triangle + Odd;
+        u32 i1 = HasIndices ? Mesh->Indices[Triangle + 1 - Odd] : Triangle + 1 - Odd;
+        u32 i2 = HasIndices ? Mesh->Indices[Triangle + 2] : Triangle + 2;
+        if(i0 == i1 || i1 == i2 || i0 == i2) continue;
+        
+        vec3 P0 = Mesh->Positions[i0];
+        vec3 P1 = Mesh->Positions[i1];
+        vec3 P2 = Mesh->Positions[i2];
+        if(P0 == P1 || P1 == P2 || P0 == P2) continue;
+        
+        Indices[IndicesCount++] = i0;
+        Indices[IndicesCount++] = i1;
+        Indices[IndicesCount++] = i2;
+    }
+    
+    if(HasIndices) Free(Mesh->Indices);
+    Mesh->Indices = Indices;
+    Mesh->IndicesCount = IndicesCount;
+    Mesh->Flags = (mesh_flag)(Mesh->Flags & ~(MESH_IS_STRIP | MESH_NO_INDICES));
+}
+
+//Strips keep 0xFFFF free, it's the strip cut value of 16 bit indices
+internal b32
+CanUse16BitIndices(mesh_data* Mesh)
+{
+    if(Mesh->Flags & MESH_NO_INDICES) return false;
+    return (Mesh->Flags & MESH_IS_STRIP) ? Mesh->VerticesCount < 0xFFFF : Mesh->VerticesCount <= 0x10000;
+}
+
+//Every index must fit in 16 bits, see CanUse16BitIndices
+internal void
+PackIndices16(u32* Indices, u32 Count, u16* Dest)
+{
+    u32 Index = 0;
+    for(; Index + 8 <= Count; Index += 8)
+    {
+        __m128i Low = _mm_loadu_si128((__m128i*)(Indices + Index));
+        __m128i High = _mm_loadu_si128((__m128i*)(Indices + Index + 4));
+        _mm_storeu_si128((__m128i*)(Dest + Index), _mm_packus_epi32(Low, High));
+    }
+    for(; Index < Count; Index++)
+    {
+        Assert(Indices[Index] <= 0xFFFF);
+        Dest[Index] = (u16)Indices[Index];
+    }
+}
+
+// Meshlets, clusters of triangles with their own bounds so that the parts of a mesh out of
+// the view or facing away from it are not drawn. A meshlet starts next to the last one, or
+// from the first unused triangle, and grows by taking the neighbour that adds the fewest
+// vertices, then the closest to the meshlet, then the lowest, so the result only depends on
+// the mesh. Without mesh shaders a meshlet is drawn as a
+// range of the index buffer, the indices are stored in meshlet order for that.
+
+//Bounding sphere around the center of the AABB and the cone of the unit face normals
+internal void
+ComputeMeshletBounds(meshlet* Meshlet, u32* Indices, vec3* Positions)
+{
+    u32* MeshletIndices = Indices + Meshlet->FirstIndex;
+    Meshlet->Min = vec3(FLT_MAX);
+    Meshlet->Max = vec3(-FLT_MAX);
+    for(u32 Index = 0; Index < Meshlet->IndicesCount; Index++)
+    {
+        vec3 P = Positions[MeshletIndices[Index]];
+        Meshlet->Min = vec3(MIN(Meshlet->Min.x, P.x), MIN(Meshlet->Min.y, P.y), MIN(Meshlet->Min.z, P.z));
+        Meshlet->Max = vec3(MAX(Meshlet->Max.x, P.x), MAX(Meshlet->Max.y, P.y), MAX(Meshlet->Max.z, P.z));
+    }
+    
+    Meshlet->Center = (Meshlet->Min + Meshlet->Max) * 0.5f;
+    Meshlet->Radius = 0.0f;
+    for(u32 Index = 0; Index < Meshlet->IndicesCount; Index++)
+    {
+        f32 Distance = Length(Positions[MeshletIndices[Index]] - Meshlet->Center);
+        Meshlet->Radius = MAX(Meshlet->Radius, Distance);
+    }
+    
+    //The axis is the average normal, degenerate triangles have no normal and don't count
+    vec3 Sum = vec3(0.0f);
+    for(u32 Index = 0; Index < Meshlet->IndicesCount; Index += 3)
+    {
+        vec3 P0 = Positions[MeshletIndices[Index + 0]];
+        vec3 N = Cross(Positions[MeshletIndices[Index + 1]] - P0, Positions[MeshletIndices[Index + 2]] - P0);
+        f32 Magnitude = Length(N);
+        if(Magnitude > 0.0f) Sum = Sum + N * (1.0f / Magnitude);
+    }
+    
+    f32 SumLength = Length(Sum);
+    Meshlet->ConeAxis = SumLength > 0.0f ? Sum * (1.0f / SumLength) : vec3(0.0f, 0.0f, 1.0f);
+    Meshlet->ConeCos = SumLength > 0.0f ? 1.0f : -1.0f;
+    for(u32 Index = 0; SumLength > 0.0f && Index < Meshlet->IndicesCount; Index += 3)
+    {
+        vec3 P0 = Positions[MeshletIndices[Index + 0]];
+        vec3 N = Cross(Positions[MeshletIndices[Index + 1]] - P0, Positions[MeshletIndices[Index + 2]] - P0);
+        f32 Magnitude = Length(N);
+        if(Magnitude == 0.0f) continue;
+        
+        f32 Cos = Dot(N, Meshlet->ConeAxis) / Magnitude;
+        Meshlet->ConeCos = MIN(Meshlet->ConeCos, Cos);
+    }
+    Meshlet->ConeSin = sqrtf(MAX(1.0f - Meshlet->ConeCos * Meshlet->ConeCos, 0.0f));
+}
+
+//Indexed triangle lists only. The indices are reordered in place, so the index buffer must
+//be created after this, and any pass that reorders them again drops the meshlets
+internal void
+BuildMeshlets(mesh_data* Mesh)
+{
+    Assert(!(Mesh->Flags & (MESH_IS_STRIP | MESH_NO_INDICES)));
+    Free(Mesh->Meshlets);
+    Mesh->Meshlets = 0;
+    Mesh->MeshletsCount = 0;
+    
+    u32 VerticesCount = Mesh->VerticesCount;
+    u32 IndicesCount = Mesh->IndicesCount - Mesh->IndicesCount % 3;
+    u32 TrianglesCount = IndicesCount / 3;
+    u32* Indices = Mesh->Indices;
+    
+    //Triangles using every vertex, a triangle that uses a vertex twice is listed twice
+    u32* TriangleOffsets = (u32*)ZeroAlloc(sizeof(u32) * (VerticesCount + 1));
+    u32* VertexTriangles = (u32*)ZeroAlloc(sizeof(u32) * MAX(IndicesCount, 1));
+    u32* Filled = (u32*)ZeroAlloc(sizeof(u32) * MAX(VerticesCount, 1));
+    for(u32 Index = 0; Index < IndicesCount; Index++)
+    {
+        TriangleOffsets[Indices[Index] + 1]++;
+    }
+    u32 MaxValence = 0;
+    for(u32 Vertex = 0; Vertex < VerticesCount; Vertex++)
+    {
+        MaxValence = MAX(MaxValence, TriangleOffsets[Vertex + 1]);
+        TriangleOffsets[Vertex + 1] += TriangleOffsets[Vertex];
+    }
+    for(u32 Index = 0; Index < IndicesCount; Index++)
+    {
+        u32 Vertex = Indices[Index];
+        VertexTriangles[TriangleOffsets[Vertex] + Filled[Vertex]++] = Index / 3;
+    }
+    
+    //Tags are the meshlet index + 1, they never need to be cleared. Shared is the number of
+    //corners of a candidate already in the meshlet
+    u32* VertexTags = Filled;
+    memset(VertexTags, 0, sizeof(u32) * VerticesCount);
+    u32* CandidateTags = (u32*)ZeroAlloc(sizeof(u32) * MAX(TrianglesCount, 1));
+    u8* Shared = (u8*)ZeroAlloc(MAX(TrianglesCount, 1));
+    u8* Used = (u8*)ZeroAlloc(MAX(TrianglesCount, 1));
+    u32* Candidates = (u32*)ZeroAlloc(sizeof(u32) * MESHLET_MAX_VERTICES * MAX(MaxValence, 1));
+    u32* Sorted = (u32*)ZeroAlloc(sizeof(u32) * MAX(IndicesCount, 1));
+    vec3* Centroids = (vec3*)ZeroAlloc(sizeof(vec3) * MAX(TrianglesCount, 1));
+    for(u32 Triangle = 0; Triangle < TrianglesCount; Triangle++)
+    {
+        vec3* Positions = Mesh->Positions;
+        u32* Corners = Indices + Triangle * 3;
+        Centroids[Triangle] = (Positions[Corners[0]] + Positions[Corners[1]] + Positions[Corners[2]]) * (1.0f / 3.0f);
+    }
+    
+    u32 Capacity = TrianglesCount / MESHLET_MAX_TRIANGLES + 16;
+    meshlet* Meshlets = (meshlet*)ZeroAlloc(sizeof(meshlet) * Capacity);
+    u32 MeshletsCount = 0;
+    u32 Written = 0;
+    u32 Seed = 0;
+    u32 Next = 0xFFFFFFFF;
+    for(;;)
+    {
+        u32 Triangle = Next;
+        if(Triangle == 0xFFFFFFFF)
+        {
+            while(Seed < TrianglesCount && Used[Seed]) Seed++;
+            if(Seed == TrianglesCount) break;
+            Triangle = Seed;
+        }
+        
+        if(MeshletsCount == Capacity)
+        {
+            Capacity *= 2;
+            Meshlets = (meshlet*)realloc(Meshlets, sizeof(meshlet) * Capacity);
+        }
+        meshlet* Meshlet = &Meshlets[MeshletsCount++];
+        *Meshlet = {};
+        Meshlet->FirstIndex = Written;
+        u32 Tag = MeshletsCount;
+        u32 CandidatesCount = 0;
+        vec3 VerticesSum = vec3(0.0f);
+        
+        while(Triangle != 0xFFFFFFFF)
+        {
+            Used[Triangle] = true;
+            for(u32 Corner = 0; Corner < 3; Corner++)
+            {
+                u32 Vertex = Indices[Triangle * 3 + Corner];
+                Sorted[Written++] = Vertex;
+                if(VertexTags[Vertex] == Tag) continue;
+                
+                VertexTags[Vertex] = Tag;
+                Meshlet->VerticesCount++;
+                VerticesSum = VerticesSum + Mesh->Positions[Vertex];
+                for(u32 Index = TriangleOffsets[Vertex]; Index < TriangleOffsets[Vertex + 1]; Index++)
+                {
+                    u32 Neighbour = VertexTriangles[Index];
+                    if(Used[Neighbour]) continue;
+                    if(CandidateTags[Neighbour] != Tag)
+                    {
+                        CandidateTags[Neighbour] = Tag;
+                        Shared[Neighbour] = 0;
+                        Candidates[CandidatesCount++] = Neighbour;
+                    }
+                    Shared[Neighbour]++;
+                }
+            }
+            Meshlet->IndicesCount += 3;
+            if(Meshlet->IndicesCount == MESHLET_MAX_TRIANGLES * 3) break;
+            
+            //Corners of a triangle using a vertex twice count twice, which only overestimates
+            Triangle = 0xFFFFFFFF;
+            u32 BestNew = 4;
+            f32 BestDistance = FLT_MAX;
+            vec3 Center = VerticesSum * (1.0f / Meshlet->VerticesCount);
+            u32 Kept = 0;
+            for(u32 Index = 0; Index < CandidatesCount; Index++)
+            {
+                u32 Candidate = Candidates[Index];
+                if(Used[Candidate]) continue;
+                Candidates[Kept++] = Candidate;
+                
+                u32 New = 3 - Shared[Candidate];
+                if(Meshlet->VerticesCount + New > MESHLET_MAX_VERTICES || New > BestNew) continue;
+                
+                vec3 Offset = Centroids[Candidate] - Center;
+                f32 Distance = Dot(Offset, Offset);
+                if(New < BestNew || Distance < BestDistance || (Distance == BestDistance && Candidate < Triangle))
+                {
+                    BestNew = New;
+                    BestDistance = Distance;
+                    Triangle = Candidate;
+                }
+            }
+            CandidatesCount = Kept;
+        }
+        
+        //The next meshlet starts from the neighbour sharing the most with this one, so that
+        //it stays close even when the triangles are in no particular order
+        Next = 0xFFFFFFFF;
+        u32 BestShared = 0;
+        for(u32 Index = 0; Index < CandidatesCount; Index++)
+        {
+            u32 Candidate = Candidates[Index];
+            if(Used[Candidate]) continue;
+            if(Shared[Candidate] > BestShared || (Shared[Candidate] == BestShared && Candidate < Next))
+            {
+                BestShared = Shared[Candidate];
+                Next = Candidate;
+            }
+        }
+    }
+    
+    memcpy(Indices, Sorted, sizeof(u32) * IndicesCount);
+    for(u32 Index = 0; Index < MeshletsCount; Index++)
+    {
+        ComputeMeshletBounds(&Meshlets[Index], Indices, Mesh->Positions);
+    }
+    Mesh->Meshlets = Meshlets;
+    Mesh->MeshletsCount = MeshletsCount;
+    
+    Free(Centroids);
+    Free(Sorted);
+    Free(Candidates);
+    Free(Used);
+    Free(Shared);
+    Free(CandidateTags);
+    Free(Filled);
+    Free(VertexTriangles);
+    Free(TriangleOffsets);
+}
+
+//The frustum planes are extracted like ComputeFrustumPlanes does, from ViewProjection * Model
+//so that they are in object space. Eye is in world space. CullFacingEye is for meshes whose
+//front faces are wound clockwise in a right handed space
+internal meshlet_cull_view
+GetMeshletCullView(mat4 ViewProjection, mat4 Model, vec3 Eye, b32 CullFacingEye)
+{
+    meshlet_cull_view Result = {};
+    
+    //Left, right, top, bottom, near and far
+    mat4 M = Mat4Transpose(ViewProjection * Model);
+    Result.Planes[0] = M.Columns[3] + M.Columns[0];
+    Result.Planes[1] = M.Columns[3] - M.Columns[0];
+    Result.Planes[2] = M.Columns[3] - M.Columns[1];
+    Result.Planes[3] = M.Columns[3] + M.Columns[1];
+    Result.Planes[4] = M.Columns[3] + M.Columns[2];
+    Result.Planes[5] = M.Columns[3] - M.Columns[2];
+    for(u32 Index = 0; Index < 6; Index++)
+    {
+        Result.Planes[Index] = Result.Planes[Index] / Length(vec3(Result.Planes[Index]));
+    }
+    Result.Eye = vec3(Mat4Inverse(Model) * vec4(Eye, 1.0f));
+    
+    //Mirroring transforms flip the winding
+    vec3 X = vec3(Model.Columns[0]);
+    vec3 Y = vec3(Model.Columns[1]);
+    vec3 Z = vec3(Model.Columns[2]);
+    b32 Mirrored = Dot(Cross(X, Y), Z) < 0.0f;
+    Result.CullFacingEye = Mirrored ? !CullFacingEye : CullFacingEye;
+    
+    return Result;
+}
+
+//Conservative, a meshlet that is culled has no triangle inside the frustum that faces the
+//eye. The cone test needs every point of the bounding sphere to see the back of every face
+//in the cone: the angle between the direction to the center and the farthest normal must
+//have a cosine above Radius / Distance
+internal b32
+IsMeshletVisible(meshlet* Meshlet, meshlet_cull_view* View)
+{
+    for(u32 Index = 0; Index < 6; Index++)
+    {
+        vec4 Plane = View->Planes[Index];
+        if(Dot(vec3(Plane), Meshlet->Center) + Plane.w < -Meshlet->Radius) return false;
+    }
+    
+    if(Meshlet->ConeCos > 0.0f)
+    {
+        vec3 ToCenter = Meshlet->Center - View->Eye;
+        f32 Distance = Length(ToCenter);
+        if(Distance > Meshlet->Radius)
+        {
+            vec3 Axis = View->CullFacingEye ? -Meshlet->ConeAxis : Meshlet->ConeAxis;
+            f32 Cos = Dot(ToCenter, Axis) / Distance;
+            f32 Sin = sqrtf(MAX(1.0f - Cos * Cos, 0.0f));
+            if(Cos * Meshlet->ConeCos - Sin * Meshlet->ConeSin > Meshlet->Radius / Distance) return false;
+        }
+    }
+    
+    return true;
+}
+
+//Writes the index ranges of the visible meshlets to Ranges, which must have room for one
+//per meshlet, merging the ones next to each other. Returns the number of ranges
+internal u32
+CullMeshlets(mesh_data* Mesh, meshlet_cull_view* View, meshlet_range* Ranges)
+{
+    u32 RangesCount = 0;
+    for(u32 Index = 0; Index < Mesh->MeshletsCount; Index++)
+    {
+        meshlet* Meshlet = &Mesh->Meshlets[Index];
+        if(!IsMeshletVisible(Meshlet, View)) continue;
+        
+        meshlet_range* Last = RangesCount ? &Ranges[RangesCount - 1] : 0;
+        if(Last && Last->FirstIndex + Last->IndicesCount == Meshlet->FirstIndex)
+        {
+            Last->IndicesCount += Meshlet->IndicesCount;
+        }
+        else
+        {
+            Ranges[RangesCount].FirstIndex = Meshlet->FirstIndex;
+            Ranges[RangesCount].IndicesCount = Meshlet->IndicesCount;
+            RangesCount++;
+        }
+    }
+    return RangesCount;
+}
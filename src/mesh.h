@@ -1,12 +1,21 @@
 #define MAX_MESH_JOINTS 64
 
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+//Joints, animations and keyframes refer to each other with self relative offsets, the
+//distance in bytes from the offset field to the target or 0 for none. The same data works
+//from the heap, from a buffer or from a read only mapping of an asset file without patching
+#define RELATIVE_POINTER(Type, Offset) ((Type*)((Offset) ? (u8*)&(Offset) + (Offset) : 0))
+#define SET_RELATIVE_POINTER(Offset, Pointer) ((Offset) = (Pointer) ? (s64)((u8*)(Pointer) - (u8*)&(Offset)) : 0)
+
 struct mesh_joint
 {
-    char* Name;
+    s64 NameOffset; //char*, not stored in assets
     u64 Id;
     mat4 InverseBindMatrix;
     
-    mesh_joint* Children;
+    s64 ChildrenOffset; //mesh_joint*, the children are contiguous
     u32 ChildrenCount;
 };
 
@@ -19,7 +28,7 @@ struct animation_keyframe
 
 struct joint_animation
 {
-    animation_keyframe* Keyframes;
+    s64 KeyframesOffset; //animation_keyframe*
     u32 KeyframesCount;
 };
 
@@ -27,7 +36,7 @@ struct mesh_animation
 {
     //One for each joint, joints refer to this by their Id element
     //there are Mesh.JointsCount elements in here
-    joint_animation* Joints;
+    s64 JointsOffset; //joint_animation*
     float Duration; //Total duration of animation
 };
 
@@ -36,6 +45,89 @@ enum mesh_flag
     MESH_HAS_ANIMATION = 1 << 0,
     MESH_IS_STRIP      = 1 << 1,
     MESH_NO_INDICES    = 1 << 2,
+    
+    //Uploaded as a stream of positions and one of mesh_shading_vertex instead of one
+    //buffer per attribute, the CPU data keeps its arrays
+    MESH_INTERLEAVED   = 1 << 3,
+    
+    //Uploaded from the quantized streams the packer stores next to the float arrays, see
+    //vertex_quantization.cpp. Changes to the float arrays are not uploaded unless
+    //QuantizeMeshVertices encodes the streams again. Takes precedence over MESH_INTERLEAVED
+    MESH_QUANTIZED     = 1 << 4,
+};
+
+//Everything the shading passes read besides the position, 32 bytes per vertex
+struct mesh_shading_vertex
+{
+    vec3 Normal;
+    vec3 Tangent;
+    vec2 UV;
+};
+static_assert(sizeof(mesh_shading_vertex) == 32);
+
+//Vertex streams of MESH_QUANTIZED meshes, see vertex_quantization.cpp
+struct quantized_position
+{
+    u16 x, y, z, w; //w is 0
+};
+static_assert(sizeof(quantized_position) == 8);
+
+struct quantized_shading_vertex
+{
+    s16 Normal[2];
+    s16 Tangent[2];
+    u16 UV[2];
+};
+static_assert(sizeof(quantized_shading_vertex) == 12);
+
+struct quantized_mesh_vertices
+{
+    u32 VerticesCount;
+    
+    //Positions decode to Min + Value / 65535 * (Max - Min), UVs the same over UVMin and UVMax
+    vec3 Min;
+    vec3 Max;
+    vec2 UVMin;
+    vec2 UVMax;
+    quantized_position* Positions;
+    quantized_shading_vertex* Shading;
+};
+
+//Cluster of up to MESHLET_MAX_TRIANGLES triangles using up to MESHLET_MAX_VERTICES
+//vertices, drawn as a range of the index buffer. Bounds are in object space
+struct meshlet
+{
+    u32 FirstIndex;
+    u32 IndicesCount;
+    u32 VerticesCount;
+    
+    vec3 Center;
+    f32 Radius;
+    vec3 Min;
+    vec3 Max;
+    
+    //Every face normal, Cross(P1 - P0, P2 - P0), is within the angle of ConeCos and ConeSin
+    //from ConeAxis. ConeCos is 0 or less when the normals are too spread out to cull
+    vec3 ConeAxis;
+    f32 ConeCos;
+    f32 ConeSin;
+};
+
+//View a mesh is culled against, in the object space of the mesh. See GetMeshletCullView
+struct meshlet_cull_view
+{
+    vec4 Planes[6]; //Normal and distance, the normals point inside
+    vec3 Eye;
+    
+    //Meshlets are culled when all their faces point away from the eye, or toward it if set
+    b32 CullFacingEye;
+};
+
+//Indices of meshlets that are next to each other in the index buffer, drawn at once
+struct meshlet_range
+{
+    u32 FirstIndex;
+    u32 IndicesCount;
 };
 
 struct mesh_data
@@ -69,6 +161,16 @@ struct mesh_data
     u32 JointsCount;
     mesh_animation* Animations; //Animation data
     u32 AnimationsCount;
+    
+    //UV units per object space unit, 0 if unknown. See ComputeMeshUVDensity
+    f32 UVDensity;
+    
+    //Available only after BuildMeshlets, which stores the indices in meshlet order
+    meshlet* Meshlets;
+    u32 MeshletsCount;
+    
+    //Available only if MESH_QUANTIZED
+    quantized_mesh_vertices Quantized;
 };
 
 struct mesh_animator
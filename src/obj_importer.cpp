@@ -0,0 +1,243 @@
+// Wavefront OBJ importer for the packer.
+// Reads positions, UVs and normals, triangulates polygons as fans and merges all the
+// groups and objects in the file into a single indexed mesh. Materials are ignored.
+
+struct obj_vertex_key
+{
+    s32 Position;
+    s32 UV;
+    s32 Normal;
+};
+
+struct obj_vertex_slot
+{
+    obj_vertex_key Key;
+    u32 VertexIndex; //Index + 1, 0 if the slot is empty
+};
+
+struct obj_importer
+{
+    vec3* Positions;
+    u32 PositionsCount;
+    u32 PositionsCapacity;
+    
+    vec2* UVs;
+    u32 UVsCount;
+    u32 UVsCapacity;
+    
+    vec3* Normals;
+    u32 NormalsCount;
+    u32 NormalsCapacity;
+    
+    //Unique position/uv/normal triplets become the vertices of the mesh
+    obj_vertex_key* Vertices;
+    u32 VerticesCount;
+    u32 VerticesCapacity;
+    
+    obj_vertex_slot* Slots;
+    u32 SlotsCount;
+    
+    u32* Indices;
+    u32 IndicesCount;
+    u32 IndicesCapacity;
+};
+
+#define OBJ_PUSH(Array, Count, Capacity, Value) \
+if((Count) == (Capacity)) \
+{ \
+    (Capacity) = (Capacity) ? (Capacity) * 2 : 1024; \
+    *(void**)&(Array) = realloc((Array), sizeof(*(Array)) * (Capacity)); \
+} \
+(Array)[(Count)++] = (Value);
+
+internal u32
+ObjHashKey(obj_vertex_key Key)
+{
+    u32 Hash = (u32)Key.Position * 73856093U;
+    Hash ^= (u32)Key.UV * 19349663U;
+    Hash ^= (u32)Key.Normal * 83492791U;
+    return Hash;
+}
+
+internal void
+ObjGrowVertexSlots(obj_importer* Importer)
+{
+    u32 SlotsCount = Importer->SlotsCount ? Importer->SlotsCount * 2 : 4096;
+    Free(Importer->Slots);
+    Importer->Slots = (obj_vertex_slot*)ZeroAlloc(sizeof(obj_vertex_slot) * SlotsCount);
+    Importer->SlotsCount = SlotsCount;
+    
+    for(u32 Index = 0; Index < Importer->VerticesCount; Index++)
+    {
+        u32 Slot = ObjHashKey(Importer->Vertices[Index]) & (SlotsCount - 1);
+        while(Importer->Slots[Slot].VertexIndex)
+        {
+            Slot = (Slot + 1) & (SlotsCount - 1);
+        }
+        Importer->Slots[Slot].Key = Importer->Vertices[Index];
+        Importer->Slots[Slot].VertexIndex = Index + 1;
+    }
+}
+
+internal u32
+ObjGetVertex(obj_importer* Importer, obj_vertex_key Key)
+{
+    if(Importer->VerticesCount * 2 >= Importer->SlotsCount)
+    {
+        ObjGrowVertexSlots(Importer);
+    }
+    
+    u32 Mask = Importer->SlotsCount - 1;
+    for(u32 Slot = ObjHashKey(Key) & Mask;; Slot = (Slot + 1) & Mask)
+    {
+        obj_vertex_slot* VertexSlot = &Importer->Slots[Slot];
+        if(!VertexSlot->VertexIndex)
+        {
+            VertexSlot->Key = Key;
+            VertexSlot->VertexIndex = Importer->VerticesCount + 1;
+            OBJ_PUSH(Importer->Vertices, Importer->VerticesCount, Importer->VerticesCapacity, Key);
+            return VertexSlot->VertexIndex - 1;
+        }
+        
+        obj_vertex_key Other = VertexSlot->Key;
+        if(Other.Position == Key.Position && Other.UV == Key.UV && Other.Normal == Key.Normal)
+        {
+            return VertexSlot->VertexIndex - 1;
+        }
+    }
+}
+
+//OBJ indices are 1 based, negative ones are relative to the end of the list so far.
+//Returns the 0 based index or -1 if missing
+internal s32
+ObjResolveIndex(char** At, u32 Count)
+{
+    char* End = 0;
+    long Index = strtol(*At, &End, 10);
+    if(End == *At) return -1;
+    *At = End;
+    
+    s32 Result = Index > 0 ? (s32)Index - 1 : (s32)Count + (s32)Index;
+    return (Result >= 0 && (u32)Result < Count) ? Result : -1;
+}
+
+internal char*
+ObjSkipSpaces(char* At)
+{
+    while(*At == ' ' || *At == '\t') At++;
+    return At;
+}
+
+internal b32
+ImportObjMesh(char* Path, mesh_data* Result)
+{
+    FILE* File = fopen(Path, "rb");
+    if(!File) return false;
+    
+    obj_importer Importer = {};
+    b32 HasNormals = false;
+    
+    char Line[4096];
+    while(fgets(Line, sizeof(Line), File))
+    {
+        char* At = ObjSkipSpaces(Line);
+        if(At[0] == 'v' && At[1] == ' ')
+        {
+            vec3 P = vec3(0.0f);
+            sscanf(At + 2, "%f %f %f", &P.x, &P.y, &P.z);
+            OBJ_PUSH(Importer.Positions, Importer.PositionsCount, Importer.PositionsCapacity, P);
+        }
+        else if(At[0] == 'v' && At[1] == 't')
+        {
+            vec2 UV = vec2(0.0f);
+            sscanf(At + 2, "%f %f", &UV.x, &UV.y);
+            OBJ_PUSH(Importer.UVs, Importer.UVsCount, Importer.UVsCapacity, UV);
+        }
+        else if(At[0] == 'v' && At[1] == 'n')
+        {
+            vec3 N = vec3(0.0f);
+            sscanf(At + 2, "%f %f %f", &N.x, &N.y, &N.z);
+            OBJ_PUSH(Importer.Normals, Importer.NormalsCount, Importer.NormalsCapacity, N);
+        }
+        else if(At[0] == 'f' && At[1] == ' ')
+        {
+            At += 2;
+            u32 FirstVertex = 0;
+            u32 PreviousVertex = 0;
+            for(u32 Corner = 0;; Corner++)
+            {
+                At = ObjSkipSpaces(At);
+                if(*At == 0 || *At == '\n' || *At == '\r') break;
+                
+                obj_vertex_key Key = { -1, -1, -1 };
+                Key.Position = ObjResolveIndex(&At, Importer.PositionsCount);
+                if(*At == '/')
+                {
+                    At++;
+                    if(*At != '/') Key.UV = ObjResolveIndex(&At, Importer.UVsCount);
+                    if(*At == '/')
+                    {
+                        At++;
+                        Key.Normal = ObjResolveIndex(&At, Importer.NormalsCount);
+                    }
+                }
+                while(*At && *At != ' ' && *At != '\t' && *At != '\n' && *At != '\r') At++;
+                
+                if(Key.Position < 0)
+                {
+                    fclose(File);
+                    return false;
+                }
+                HasNormals |= Key.Normal >= 0;
+                
+                //Triangle fan around the first corner
+                u32 Vertex = ObjGetVertex(&Importer, Key);
+                if(Corner == 0)
+                {
+                    FirstVertex = Vertex;
+                }
+                else if(Corner >= 2)
+                {
+                    OBJ_PUSH(Importer.Indices, Importer.IndicesCount, Importer.IndicesCapacity, FirstVertex);
+                    OBJ_PUSH(Importer.Indices, Importer.IndicesCount, Importer.IndicesCapacity, PreviousVertex);
+                    OBJ_PUSH(Importer.Indices, Importer.IndicesCount, Importer.IndicesCapacity, Vertex);
+                }
+                PreviousVertex = Vertex;
+            }
+        }
+    }
+    fclose(File);
+    
+    *Result = {};
+    if(!Importer.IndicesCount) return false;
+    
+    u32 VerticesCount = Importer.VerticesCount;
+    Result->VerticesCount = VerticesCount;
+    Result->Positions = (vec3*)ZeroAlloc(sizeof(vec3) * VerticesCount);
+    Result->Normals = (vec3*)ZeroAlloc(sizeof(vec3) * VerticesCount);
+    Result->UVs = (vec2*)ZeroAlloc(sizeof(vec2) * VerticesCount);
+    for(u32 Index = 0; Index < VerticesCount; Index++)
+    {
+        obj_vertex_key Key = Importer.Vertices[Index];
+        Result->Positions[Index] = Importer.Positions[Key.Position];
+        if(Key.UV >= 0) Result->UVs[Index] = Importer.UVs[Key.UV];
+        if(Key.Normal >= 0) Result->Normals[Index] = Importer.Normals[Key.Normal];
+    }
+    
+    Result->Indices = Importer.Indices;
+    Result->IndicesCount = Importer.IndicesCount;
+    
+    Free(Importer.Positions);
+    Free(Importer.UVs);
+    Free(Importer.Normals);
+    Free(Importer.Vertices);
+    Free(Importer.Slots);
+    
+    if(!HasNormals)
+    {
+        ComputeMeshNormals(Result);
+    }
+    ComputeMeshTangents(Result);
+    
+    return true;
+}
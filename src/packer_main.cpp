@@ -0,0 +1,1008 @@
+// Headless asset packer, builds data.asset files without the editor or a GPU.
+//
+// Usage: packer <manifest> <output> [-compress] [-bc] [-psnr] [-order <trace>] [-full] [-threads N]
+//   -bc    block compresses LDR images without an explicit format: BC7 for _albedo,
+//          _emissive and other 4 channel images, BC5 for _normal, BC4 for 1 channel
+//   -psnr  decodes every block compressed image and prints the PSNR of its first level
+//   -order lays out the payloads of the entries read in a trace written by the editor
+//          with -trace at the start of the file, in the order they were first read, and
+//          marks them ASSET_ENTRY_PREFETCH. The others follow in manifest order
+//   -full  ignores the cache and rebuilds every entry
+//
+// Builds are incremental: <output>.cache keeps a key for every mesh and image entry,
+// a hash of its source files and of its import settings. When the key of an entry
+// didn't change since the last build its payload is copied from the previous <output>
+// instead of being imported and encoded again. Identical payloads are stored once.
+//
+// Every line of the manifest adds entries to the archive, paths are relative to the
+// directory of the manifest and '-' is an empty tag:
+//   mesh <name> <tag> <path.obj|path.gltf|path.glb> [noopt] [interleaved]
+//                                                   [quantized]
+//                         triangles are reordered for the vertex cache and overdraw and
+//                         vertices for fetch locality, unless noopt is given. Interleaved
+//                         meshes are drawn from a position and a shading vertex buffer,
+//                         quantized meshes also store 16 bit positions and UVs and
+//                         octahedral normals, which are drawn instead
+//   image <name> <tag> <path.png|path.jpg|path.hdr> [channels] [srgb|linear] [nomips]
+//                                                   [bc1|bc3|bc4|bc5|bc7|raw]
+//                         images get a full mip chain unless nomips is given, names
+//                         ending in _albedo or _emissive are filtered as sRGB by default.
+//                         Block compressed images must be a multiple of 4 in size
+//   import <path.asset> [rgba16f|r11g11b10|rgb9e5|bc6h]
+//                         copies every entry of an existing archive of any version,
+//                         used for data baked on the GPU like cubemaps and LUTs. With a
+//                         format its float cubemaps are encoded to it, BC6H cubemaps
+//                         must be a multiple of 4 in size or they use RGB9E5 instead
+// Lines starting with '#' are comments.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+#include <float.h>
+#include <limits.h>
+#include <immintrin.h>
+
+#include "defines.h"
+#include "platform.h"
+
+#include "math/math.cpp"
+#include "math/math_vec.cpp"
+#include "math/math_mat.cpp"
+#include "math/math_quaternion.cpp"
+
+#include "geometry.cpp"
+#include "mesh.cpp"
+#include "image.cpp"
+#include "vertex_quantization.cpp"
+#include "memory_arena.cpp"
+#include "work_queue.cpp"
+#include "texture_compression.cpp"
+
+#include "asset_file.h"
+#include "asset_compression.cpp"
+#include "asset_loader.cpp"
+#include "linux.cpp"
+
+#include "json.cpp"
+#include "obj_importer.cpp"
+#include "gltf_importer.cpp"
+#include "asset_builder.cpp"
+
+//Big payloads are aligned to PLATFORM_DIRECT_READ_ALIGNMENT instead, see ReadAssetEntries
+#define PACKER_PAYLOAD_ALIGNMENT 64
+
+//Part of every cache key, bump it when importers or encoders change their output
+#define PACKER_CACHE_VERSION 3
+
+struct packer_cache_entry
+{
+    u64 Hash; //AssetHash(Name, Tag)
+    asset_type Type;
+    u64 SourceKey;
+    u64 ContentHash; //Of the stored payload in the previous archive
+};
+
+struct packer_entry
+{
+    asset_type Type;
+    char Name[ASSET_NAME_LENGTH];
+    char Tag[ASSET_TAG_LENGTH];
+    char Path[1024];
+    u32 Channels;
+    b32 IsHDR;
+    b32 IsSRGB;
+    b32 NoMips;
+    b32 NoOptimize;
+    b32 Interleaved;
+    b32 Quantized;
+    image_block_format BlockFormat;
+    b32 EncodeCubemap;
+    cubemap_format CubemapFormat;
+    b32 Compress;
+    b32 ReportPSNR;
+    work_queue* Queue;
+    
+    //Entries copied from another archive
+    asset_archive* Source;
+    asset_table_entry* SourceEntry;
+    
+    u32 ManifestIndex;
+    u32 FirstRead; //Index of the first read in the -order trace, UINT_MAX if never read
+    
+    //Incremental builds, Cached is the entry of the last build with the same name, tag and type
+    asset_archive* Previous;
+    packer_cache_entry* Cached;
+    u64 SourceKey;
+    b32 Reused;
+    
+    //Filled by the job
+    u8* Stored;
+    u64 StoredSize;
+    u64 Size;
+    asset_codec Codec;
+    b32 Failed;
+    u64 Offset;
+    f64 PSNR;
+    u64 ContentHash;
+    packer_entry* DuplicateOf; //Earlier entry with the same stored payload, written only once
+    
+    volatile u32* Counter;
+};
+
+struct packer
+{
+    packer_entry* Entries;
+    u32 EntriesCount;
+    u32 EntriesCapacity;
+    
+    asset_archive* Sources[64];
+    u32 SourcesCount;
+    
+    b32 BlockCompress;
+    
+    //Output and cache of the last build
+    asset_archive* Previous;
+    packer_cache_entry* Cache;
+    u32 CacheCount;
+};
+
+internal b32
+HasExtension(char* Path, char* Extension)
+{
+    char* Dot = strrchr(Path, '.');
+    return Dot && strcasecmp(Dot + 1, Extension) == 0;
+}
+
+internal b32
+ImportMeshFromFile(char* Path, mesh_data* Mesh)
+{
+    if(HasExtension(Path, "obj")) return ImportObjMesh(Path, Mesh);
+    if(HasExtension(Path, "gltf") || HasExtension(Path, "glb")) return ImportGltfMesh(Path, Mesh);
+    return false;
+}
+
+internal u64
+HashFile(u64 Hash, char* Path, b32* Found)
+{
+    u64 Size = 0;
+    u8* Data = GltfReadEntireFile(Path, &Size);
+    *Found = Data != 0;
+    if(Data)
+    {
+        Hash = HashBytes(Hash, Data, Size);
+        Free(Data);
+    }
+    return Hash;
+}
+
+//Hash of everything the payload of the entry is built from: the source file, the
+//buffers of .gltf files and the settings. 0 if the sources can't be read
+internal u64
+GetSourceKey(packer_entry* Entry)
+{
+    struct
+    {
+        u32 CacheVersion;
+        u32 FileVersion;
+        asset_type Type;
+        u32 Channels;
+        b32 IsHDR;
+        b32 IsSRGB;
+        b32 NoMips;
+        b32 NoOptimize;
+        b32 Interleaved;
+        b32 Quantized;
+        image_block_format BlockFormat;
+        b32 Compress;
+    } Settings = {};
+    Settings.CacheVersion = PACKER_CACHE_VERSION;
+    Settings.FileVersion = ASSET_FILE_VERSION;
+    Settings.Type = Entry->Type;
+    Settings.Channels = Entry->Channels;
+    Settings.IsHDR = Entry->IsHDR;
+    Settings.IsSRGB = Entry->IsSRGB;
+    Settings.NoMips = Entry->NoMips;
+    Settings.NoOptimize = Entry->NoOptimize;
+    Settings.Interleaved = Entry->Interleaved;
+    Settings.Quantized = Entry->Quantized;
+    Settings.BlockFormat = Entry->BlockFormat;
+    Settings.Compress = Entry->Compress;
+    
+    u64 Hash = HashBytes(ASSET_HASH_OFFSET_BASIS, &Settings, sizeof(Settings));
+    b32 Found = false;
+    if(Entry->Type == ASSET_MESH && (HasExtension(Entry->Path, "gltf") || HasExtension(Entry->Path, "glb")))
+    {
+        gltf_file Gltf;
+        Found = GltfLoad(Entry->Path, &Gltf);
+        if(Found)
+        {
+            Hash = HashBytes(Hash, Gltf.FileData, Gltf.FileSize);
+            for(u32 Index = 0; Index < Gltf.BuffersCount; Index++)
+            {
+                Hash = HashBytes(Hash, Gltf.Buffers[Index].Data, Gltf.Buffers[Index].Size);
+            }
+        }
+        GltfFree(&Gltf);
+    }
+    else
+    {
+        Hash = HashFile(Hash, Entry->Path, &Found);
+    }
+    
+    return Found && Hash ? Hash : 0;
+}
+
+//Copies the stored payload of the last build, checking it's still the one in the cache
+internal b32
+ReuseCachedEntry(packer_entry* Entry)
+{
+    packer_cache_entry* Cached = Entry->Cached;
+    asset_table_entry* PreviousEntry = FindAssetByHash(Cached->Hash, Entry->Previous->Table);
+    if(!PreviousEntry || PreviousEntry->Type != Entry->Type) return false;
+    
+    u8* Stored = (u8*)ZeroAlloc(MAX(PreviousEntry->StoredSize, 1));
+    if(!Platform_ReadAtOffset(Entry->Previous->File, Stored, PreviousEntry->StoredSize, PreviousEntry->Offset) ||
+       HashBytes(ASSET_HASH_OFFSET_BASIS, Stored, PreviousEntry->StoredSize) != Cached->ContentHash)
+    {
+        Free(Stored);
+        return false;
+    }
+    
+    Entry->Stored = Stored;
+    Entry->StoredSize = PreviousEntry->StoredSize;
+    Entry->Size = PreviousEntry->Size;
+    Entry->Codec = (asset_codec)PreviousEntry->Codec;
+    Entry->ContentHash = Cached->ContentHash;
+    Entry->Reused = true;
+    return true;
+}
+
+//Compresses the image in place, keeping it as is if it can't be block compressed
+internal void
+CompressPackerImage(packer_entry* Entry, image_data* Image)
+{
+    if(Image->Width % 4 || Image->Height % 4)
+    {
+        fprintf(stderr, "%s is %dx%d, not a multiple of 4, stored uncompressed\n", Entry->Path, Image->Width, Image->Height);
+        return;
+    }
+    
+    image_data Compressed = CompressImage(Entry->Queue, Image, Entry->BlockFormat);
+    if(Entry->ReportPSNR)
+    {
+        local_persist u32 ComparedChannels[] = { 0, 3, 4, 1, 2, 4 };
+        image_data Decoded = DecompressImage(&Compressed);
+        Entry->PSNR = ComputeImagePSNR(Image, &Decoded, MIN(ComparedChannels[Entry->BlockFormat], (u32)Image->BytesPerPixel));
+        Free(Decoded.Data);
+    }
+    
+    Free(Image->Data);
+    *Image = Compressed;
+}
+
+//Encodes a float cubemap in place, BC6H needs faces made of whole blocks
+internal void
+EncodePackerCubemap(packer_entry* Entry, cubemap_data* Cubemap)
+{
+    cubemap_format Format = Entry->CubemapFormat;
+    if(Format == CUBEMAP_BC6H && Cubemap->Size % 4)
+    {
+        fprintf(stderr, "%s - %s is %d wide, not a multiple of 4, stored as RGB9E5\n", Entry->Name, Entry->Tag, Cubemap->Size);
+        Format = CUBEMAP_RGB9E5;
+    }
+    
+    cubemap_data Encoded = CompressCubemap(Entry->Queue, Cubemap, Format);
+    if(Entry->ReportPSNR)
+    {
+        Entry->PSNR = ComputeCubemapPSNR(Cubemap, &Encoded);
+    }
+    *Cubemap = Encoded;
+}
+
+//The quantized streams don't hold the skinning data, animated meshes keep their float arrays
+internal void
+QuantizePackerMesh(packer_entry* Entry, mesh_data* Mesh)
+{
+    if(Mesh->Flags & MESH_HAS_ANIMATION)
+    {
+        fprintf(stderr, "%s - %s is animated, stored unquantized\n", Entry->Name, Entry->Tag);
+        return;
+    }
+    
+    Mesh->Flags = (mesh_flag)(Mesh->Flags | MESH_QUANTIZED);
+}
+
+//Entries imported in their current layout are copied as stored, compressed entries stay
+//compressed. They are read up front by ReadImportedEntries instead of by a job
+internal b32
+IsCopiedAsStored(packer_entry* Entry)
+{
+    asset_table_entry* SourceEntry = Entry->SourceEntry;
+    u32 Version = Entry->Source ? Entry->Source->Table.Version : 0;
+    return Entry->Source &&
+        !(SourceEntry->Type == ASSET_IMAGE && Version < ASSET_FILE_VERSION_IMAGE_BLOCKS) &&
+        !(SourceEntry->Type == ASSET_MESH && Version < ASSET_FILE_VERSION_QUANTIZED_MESH) &&
+        !(SourceEntry->Type == ASSET_CUBEMAP && (Version < ASSET_FILE_VERSION_CUBEMAP_FORMAT || Entry->EncodeCubemap));
+}
+
+//One batch of reads per imported archive
+internal void
+ReadImportedEntries(packer* Packer)
+{
+    packer_entry** Entries = (packer_entry**)ZeroAlloc(sizeof(packer_entry*) * Packer->EntriesCount);
+    asset_table_entry** SourceEntries = (asset_table_entry**)ZeroAlloc(sizeof(asset_table_entry*) * Packer->EntriesCount);
+    u8** Stored = (u8**)ZeroAlloc(sizeof(u8*) * Packer->EntriesCount);
+    
+    for(u32 SourceIndex = 0; SourceIndex < Packer->SourcesCount; SourceIndex++)
+    {
+        asset_archive* Source = Packer->Sources[SourceIndex];
+        u32 Count = 0;
+        for(u32 Index = 0; Index < Packer->EntriesCount; Index++)
+        {
+            packer_entry* Entry = &Packer->Entries[Index];
+            if(Entry->Source == Source && IsCopiedAsStored(Entry))
+            {
+                Entries[Count] = Entry;
+                SourceEntries[Count] = Entry->SourceEntry;
+                Count++;
+            }
+        }
+        
+        b32 Success = ReadAssetEntries(Source, SourceEntries, Count, Stored);
+        for(u32 Index = 0; Index < Count; Index++)
+        {
+            packer_entry* Entry = Entries[Index];
+            Entry->Stored = Stored[Index];
+            Entry->StoredSize = Entry->SourceEntry->StoredSize;
+            Entry->Size = Entry->SourceEntry->Size;
+            Entry->Codec = (asset_codec)Entry->SourceEntry->Codec;
+            Entry->Failed = !Success || !Entry->Stored;
+            Entry->ContentHash = Entry->Failed ? 0 : HashBytes(ASSET_HASH_OFFSET_BASIS, Entry->Stored, Entry->StoredSize);
+        }
+    }
+    
+    Free(Stored);
+    Free(SourceEntries);
+    Free(Entries);
+}
+
+internal void
+PackEntryWork(void* Data)
+{
+    packer_entry* Entry = (packer_entry*)Data;
+    
+    if(!Entry->Source)
+    {
+        Entry->SourceKey = GetSourceKey(Entry);
+        if(Entry->Cached && Entry->SourceKey && Entry->Cached->SourceKey == Entry->SourceKey && ReuseCachedEntry(Entry))
+        {
+            Platform_AtomicAdd(Entry->Counter, (u32)-1);
+            return;
+        }
+    }
+    
+    asset_payload Payload = {};
+    u32 FilterStride = 4;
+    asset_table_entry* SourceEntry = Entry->SourceEntry;
+    if(Entry->Source && SourceEntry->Type == ASSET_IMAGE && Entry->Source->Table.Version < ASSET_FILE_VERSION_IMAGE_BLOCKS)
+    {
+        //Older image headers are converted to the current layout, mips are not generated
+        //for images without them because we don't know the color space of the data
+        void* Data = ReadAssetData(Entry->Source, SourceEntry);
+        image_data Image = LoadImageAsset(Data, SourceEntry->Size, Entry->Source->Table.Version);
+        Payload = BuildImageAsset(&Image);
+        FilterStride = Image.BytesPerPixel >= 4 ? 4 : 1;
+        ReleaseAssetData(Entry->Source, Data);
+    }
+    else if(Entry->Source && SourceEntry->Type == ASSET_MESH && Entry->Source->Table.Version < ASSET_FILE_VERSION_QUANTIZED_MESH)
+    {
+        //Rebuilt to compute the UV density and the quantized streams, the loader rewrites the
+        //references of older animated meshes in place. Sources are not mapped so the data is
+        //a private copy. The loader drops the flag of older quantized meshes, which have no
+        //streams, so it's taken from the header
+        void* Data = ReadAssetData(Entry->Source, SourceEntry);
+        mesh_data Mesh = LoadMeshAsset(Data, SourceEntry->Size, Entry->Source->Table.Version);
+        if(((asset_mesh*)Data)->Flags & MESH_QUANTIZED) QuantizePackerMesh(Entry, &Mesh);
+        Payload = BuildMeshAsset(&Mesh);
+        FilterStride = 4;
+        ReleaseAssetData(Entry->Source, Data);
+    }
+    else if(Entry->Source && SourceEntry->Type == ASSET_CUBEMAP)
+    {
+        //Older headers are converted to the current layout, float cubemaps are encoded
+        //to the format of the import line if there is one
+        void* Data = ReadAssetData(Entry->Source, SourceEntry);
+        cubemap_data Cubemap = LoadCubemapAsset(Data, SourceEntry->Size, Entry->Source->Table.Version);
+        if(Entry->EncodeCubemap && Cubemap.Format == CUBEMAP_RGBA32F)
+        {
+            EncodePackerCubemap(Entry, &Cubemap);
+            Payload = BuildCubemapAsset(&Cubemap);
+            Free(Cubemap.Data);
+        }
+        else
+        {
+            Payload = BuildCubemapAsset(&Cubemap);
+        }
+        FilterStride = 4;
+        ReleaseAssetData(Entry->Source, Data);
+    }
+    else if(Entry->Type == ASSET_MESH)
+    {
+        mesh_data Mesh = {};
+        if(ImportMeshFromFile(Entry->Path, &Mesh))
+        {
+            if(!Entry->NoOptimize) OptimizeMesh(&Mesh);
+            if(Entry->Interleaved) Mesh.Flags = (mesh_flag)(Mesh.Flags | MESH_INTERLEAVED);
+            if(Entry->Quantized) QuantizePackerMesh(Entry, &Mesh);
+            Payload = BuildMeshAsset(&Mesh);
+        }
+        FreeImportedMesh(&Mesh);
+    }
+    else if(Entry->Type == ASSET_IMAGE)
+    {
+        image_data Image = Entry->IsHDR ? LoadHDRImageFromFile(Entry->Path) : LoadImageFromFile(Entry->Path, Entry->Channels);
+        if(Image.Data && Entry->NoMips)
+        {
+            image_data Level = Image;
+            if(Entry->BlockFormat != IMAGE_UNCOMPRESSED)
+            {
+                Level.Data = (u8*)ZeroAlloc((u64)Image.Pitch * Image.Height);
+                memcpy(Level.Data, Image.Data, (u64)Image.Pitch * Image.Height);
+                CompressPackerImage(Entry, &Level);
+            }
+            Payload = BuildImageAsset(&Level);
+            if(Level.Data != Image.Data)
+            {
+                Free(Level.Data);
+            }
+        }
+        else if(Image.Data)
+        {
+            image_data Mips = GenerateImageMips(&Image, Entry->IsSRGB);
+            if(Entry->BlockFormat != IMAGE_UNCOMPRESSED)
+            {
+                CompressPackerImage(Entry, &Mips);
+            }
+            Payload = BuildImageAsset(&Mips);
+            Free(Mips.Data);
+        }
+        if(Image.Data)
+        {
+            FreeImage(&Image);
+        }
+        FilterStride = Entry->IsHDR ? 4 : 1;
+    }
+    
+    Entry->Failed = Payload.Data == 0;
+    Entry->Stored = Payload.Data;
+    Entry->StoredSize = Payload.Size;
+    Entry->Size = Payload.Size;
+    Entry->Codec = ASSET_CODEC_NONE;
+    
+    if(!Entry->Failed && Entry->Compress)
+    {
+        //Keep the entry uncompressed if it doesn't get smaller
+        u64 StoredSize = 0;
+        u8* Stored = (u8*)CompressAssetPayload(Payload.Data, Payload.Size, ASSET_CODEC_LZ, FilterStride, &StoredSize);
+        if(StoredSize < Payload.Size)
+        {
+            Free(Payload.Data);
+            Entry->Stored = Stored;
+            Entry->StoredSize = StoredSize;
+            Entry->Codec = ASSET_CODEC_LZ;
+        }
+        else
+        {
+            Free(Stored);
+        }
+    }
+    
+    if(!Entry->Failed)
+    {
+        Entry->ContentHash = HashBytes(ASSET_HASH_OFFSET_BASIS, Entry->Stored, Entry->StoredSize);
+    }
+    
+    Platform_AtomicAdd(Entry->Counter, (u32)-1);
+}
+
+internal packer_entry*
+AddPackerEntry(packer* Packer, asset_type Type, char* Name, char* Tag)
+{
+    if(Packer->EntriesCount == Packer->EntriesCapacity)
+    {
+        Packer->EntriesCapacity = Packer->EntriesCapacity ? Packer->EntriesCapacity * 2 : 64;
+        Packer->Entries = (packer_entry*)realloc(Packer->Entries, sizeof(packer_entry) * Packer->EntriesCapacity);
+    }
+    
+    packer_entry* Entry = &Packer->Entries[Packer->EntriesCount++];
+    *Entry = {};
+    Entry->ManifestIndex = Packer->EntriesCount - 1;
+    Entry->FirstRead = UINT_MAX;
+    Entry->Type = Type;
+    strncpy(Entry->Name, Name, ASSET_NAME_LENGTH - 1);
+    strncpy(Entry->Tag, Tag, ASSET_TAG_LENGTH - 1);
+    return Entry;
+}
+
+//Relative paths are relative to the directory of the manifest
+internal void
+GetManifestPath(char* Result, u32 ResultSize, char* ManifestPath, char* Path)
+{
+    char* Slash = strrchr(ManifestPath, '/');
+    s32 DirectoryLength = (Slash && Path[0] != '/') ? (s32)(Slash - ManifestPath + 1) : 0;
+    snprintf(Result, ResultSize, "%.*s%s", DirectoryLength, ManifestPath, Path);
+}
+
+internal b32
+ParseManifest(packer* Packer, char* ManifestPath)
+{
+    FILE* File = fopen(ManifestPath, "rb");
+    if(!File)
+    {
+        fprintf(stderr, "Cannot open manifest %s\n", ManifestPath);
+        return false;
+    }
+    
+    b32 Success = true;
+    char Line[2048];
+    for(u32 LineNumber = 1; fgets(Line, sizeof(Line), File); LineNumber++)
+    {
+        char Command[32] = {}, Name[256] = {}, Tag[256] = {}, Path[1024] = {};
+        s32 OptionsOffset = 0;
+        s32 Count = sscanf(Line, "%31s %255s %255s %1023s%n", Command, Name, Tag, Path, &OptionsOffset);
+        if(Count <= 0 || Command[0] == '#') continue;
+        
+        if(strcmp(Tag, "-") == 0) Tag[0] = 0;
+        
+        char FullPath[1024];
+        if(strcmp(Command, "import") == 0 && Count >= 2)
+        {
+            GetManifestPath(FullPath, sizeof(FullPath), ManifestPath, Name);
+            asset_archive* Source = (asset_archive*)ZeroAlloc(sizeof(asset_archive));
+            if(Packer->SourcesCount == ArrayCount(Packer->Sources) || !OpenAssetArchive(Source, FullPath, false))
+            {
+                fprintf(stderr, "%s:%u: cannot import %s\n", ManifestPath, LineNumber, FullPath);
+                Success = false;
+                continue;
+            }
+            Packer->Sources[Packer->SourcesCount++] = Source;
+            
+            //The format is read where the tag of the other lines is
+            local_persist char* CubemapFormatNames[] = { "rgba32f", "rgba16f", "r11g11b10", "rgb9e5", "bc6h" };
+            static_assert(ArrayCount(CubemapFormatNames) == CUBEMAP_FORMATS_COUNT);
+            u32 CubemapFormat = 0;
+            while(CubemapFormat < ArrayCount(CubemapFormatNames) && strcmp(Tag, CubemapFormatNames[CubemapFormat]) != 0) CubemapFormat++;
+            if(Count >= 3 && CubemapFormat == ArrayCount(CubemapFormatNames))
+            {
+                fprintf(stderr, "%s:%u: unknown cubemap format %s\n", ManifestPath, LineNumber, Tag);
+                Success = false;
+            }
+            
+            for(u64 Index = 0; Index < Source->Table.Count; Index++)
+            {
+                asset_table_entry* SourceEntry = &Source->Table.Entries[Index];
+                packer_entry* Entry = AddPackerEntry(Packer, SourceEntry->Type, SourceEntry->Name, SourceEntry->Tag);
+                Entry->Source = Source;
+                Entry->SourceEntry = SourceEntry;
+                if(SourceEntry->Type == ASSET_CUBEMAP && CubemapFormat < ArrayCount(CubemapFormatNames))
+                {
+                    Entry->EncodeCubemap = true;
+                    Entry->CubemapFormat = (cubemap_format)CubemapFormat;
+                }
+            }
+        }
+        else if((strcmp(Command, "mesh") == 0 || strcmp(Command, "image") == 0) && Count >= 4)
+        {
+            b32 IsMesh = Command[0] == 'm';
+            packer_entry* Entry = AddPackerEntry(Packer, IsMesh ? ASSET_MESH : ASSET_IMAGE, Name, Tag);
+            GetManifestPath(Entry->Path, sizeof(Entry->Path), ManifestPath, Path);
+            Entry->Channels = 4;
+            Entry->IsHDR = !IsMesh && HasExtension(Path, "hdr");
+            
+            //Same textures the runtime creates with an _SRGB format
+            char* Suffix = strrchr(Name, '_');
+            Entry->IsSRGB = !Entry->IsHDR && Suffix && (strcmp(Suffix, "_albedo") == 0 || strcmp(Suffix, "_emissive") == 0);
+            
+            b32 HasBlockFormat = false;
+            char* Options = OptionsOffset ? Line + OptionsOffset : 0;
+            for(char* Option = Options ? strtok(Options, " \t\r\n") : 0; Option; Option = strtok(0, " \t\r\n"))
+            {
+                local_persist char* BlockFormatNames[] = { "raw", "bc1", "bc3", "bc4", "bc5", "bc7" };
+                u32 BlockFormat = 0;
+                while(BlockFormat < ArrayCount(BlockFormatNames) && strcmp(Option, BlockFormatNames[BlockFormat]) != 0) BlockFormat++;
+                
+                if(strcmp(Option, "srgb") == 0) Entry->IsSRGB = true;
+                else if(strcmp(Option, "linear") == 0) Entry->IsSRGB = false;
+                else if(strcmp(Option, "nomips") == 0) Entry->NoMips = true;
+                else if(IsMesh && strcmp(Option, "noopt") == 0) Entry->NoOptimize = true;
+                else if(IsMesh && strcmp(Option, "interleaved") == 0) Entry->Interleaved = true;
+                else if(IsMesh && strcmp(Option, "quantized") == 0) Entry->Quantized = true;
+                else if(BlockFormat < ArrayCount(BlockFormatNames))
+                {
+                    Entry->BlockFormat = (image_block_format)BlockFormat;
+                    HasBlockFormat = true;
+                }
+                else if(atoi(Option) >= 1 && atoi(Option) <= 4) Entry->Channels = atoi(Option);
+                else
+                {
+                    fprintf(stderr, "%s:%u: unknown option %s\n", ManifestPath, LineNumber, Option);
+                    Success = false;
+                }
+            }
+            
+            if(!IsMesh && !HasBlockFormat && Packer->BlockCompress && !Entry->IsHDR)
+            {
+                if(Suffix && strcmp(Suffix, "_normal") == 0) Entry->BlockFormat = IMAGE_BC5;
+                else if(Entry->Channels == 1) Entry->BlockFormat = IMAGE_BC4;
+                else if(Entry->Channels == 4) Entry->BlockFormat = IMAGE_BC7;
+            }
+            if(Entry->BlockFormat != IMAGE_UNCOMPRESSED && (Entry->IsHDR || Entry->Channels == 3))
+            {
+                //The runtime has no 3 channel textures and HDR needs BC6H
+                fprintf(stderr, "%s:%u: %s cannot be block compressed\n", ManifestPath, LineNumber, Path);
+                Success = false;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "%s:%u: invalid line: %s", ManifestPath, LineNumber, Line);
+            Success = false;
+        }
+    }
+    fclose(File);
+    
+    //Entries are found by name and tag, duplicates would shadow each other
+    for(u32 Index = 0; Index < Packer->EntriesCount; Index++)
+    {
+        for(u32 Other = Index + 1; Other < Packer->EntriesCount; Other++)
+        {
+            packer_entry* A = &Packer->Entries[Index];
+            packer_entry* B = &Packer->Entries[Other];
+            if(A->Type == B->Type && strcmp(A->Name, B->Name) == 0 && strcmp(A->Tag, B->Tag) == 0)
+            {
+                fprintf(stderr, "Duplicate asset %s - %s\n", A->Name, A->Tag);
+                Success = false;
+            }
+        }
+    }
+    
+    return Success;
+}
+
+//Entries are matched by name and tag, reads of entries that are not in the manifest
+//anymore are skipped
+internal b32
+ParseReadTrace(packer* Packer, char* TracePath)
+{
+    FILE* File = fopen(TracePath, "rb");
+    if(!File)
+    {
+        fprintf(stderr, "Cannot open trace %s\n", TracePath);
+        return false;
+    }
+    
+    u32 ReadsCount = 0;
+    u32 SkippedCount = 0;
+    char Line[1024];
+    while(fgets(Line, sizeof(Line), File))
+    {
+        char Name[256] = {}, Tag[256] = {};
+        if(Line[0] == '#' || sscanf(Line, "%255s %255s", Name, Tag) != 2) continue;
+        if(strcmp(Tag, "-") == 0) Tag[0] = 0;
+        
+        b32 Found = false;
+        for(u32 Index = 0; Index < Packer->EntriesCount; Index++)
+        {
+            packer_entry* Entry = &Packer->Entries[Index];
+            if(strncmp(Entry->Name, Name, ASSET_NAME_LENGTH) == 0 && strncmp(Entry->Tag, Tag, ASSET_TAG_LENGTH) == 0)
+            {
+                Entry->FirstRead = MIN(Entry->FirstRead, ReadsCount);
+                Found = true;
+            }
+        }
+        SkippedCount += !Found;
+        ReadsCount++;
+    }
+    fclose(File);
+    
+    if(SkippedCount)
+    {
+        fprintf(stderr, "%u of %u reads in %s are of entries not in the manifest\n", SkippedCount, ReadsCount, TracePath);
+    }
+    return true;
+}
+
+internal int
+CompareFirstRead(const void* A, const void* B)
+{
+    packer_entry* EntryA = (packer_entry*)A;
+    packer_entry* EntryB = (packer_entry*)B;
+    if(EntryA->FirstRead != EntryB->FirstRead) return EntryA->FirstRead < EntryB->FirstRead ? -1 : 1;
+    return EntryA->ManifestIndex < EntryB->ManifestIndex ? -1 : EntryA->ManifestIndex > EntryB->ManifestIndex;
+}
+
+//The cache is only used together with the archive it was written with, entries that
+//are not in the cache or whose payload changed since are built again
+internal void
+LoadPackerCache(packer* Packer, char* OutputPath)
+{
+    char CachePath[1024];
+    snprintf(CachePath, sizeof(CachePath), "%s.cache", OutputPath);
+    FILE* File = fopen(CachePath, "rb");
+    if(!File) return;
+    
+    asset_archive* Previous = (asset_archive*)ZeroAlloc(sizeof(asset_archive));
+    if(!OpenAssetArchive(Previous, OutputPath, false))
+    {
+        Free(Previous);
+        fclose(File);
+        return;
+    }
+    Packer->Previous = Previous;
+    
+    u32 Capacity = 0;
+    char Line[1024];
+    while(fgets(Line, sizeof(Line), File))
+    {
+        char Name[256] = {}, Tag[256] = {};
+        u32 Type = 0;
+        unsigned long long SourceKey = 0, ContentHash = 0;
+        if(sscanf(Line, "%255s %255s %u %llx %llx", Name, Tag, &Type, &SourceKey, &ContentHash) != 5) continue;
+        if(strcmp(Tag, "-") == 0) Tag[0] = 0;
+        
+        if(Packer->CacheCount == Capacity)
+        {
+            Capacity = Capacity ? Capacity * 2 : 64;
+            Packer->Cache = (packer_cache_entry*)realloc(Packer->Cache, sizeof(packer_cache_entry) * Capacity);
+        }
+        packer_cache_entry* Cached = &Packer->Cache[Packer->CacheCount++];
+        Cached->Hash = AssetHash(Name, Tag);
+        Cached->Type = (asset_type)Type;
+        Cached->SourceKey = SourceKey;
+        Cached->ContentHash = ContentHash;
+    }
+    fclose(File);
+    
+    for(u32 Index = 0; Index < Packer->EntriesCount; Index++)
+    {
+        packer_entry* Entry = &Packer->Entries[Index];
+        u64 Hash = AssetHash(Entry->Name, Entry->Tag);
+        for(u32 CacheIndex = 0; CacheIndex < Packer->CacheCount && !Entry->Source; CacheIndex++)
+        {
+            packer_cache_entry* Cached = &Packer->Cache[CacheIndex];
+            if(Cached->Hash == Hash && Cached->Type == Entry->Type)
+            {
+                Entry->Previous = Previous;
+                Entry->Cached = Cached;
+                break;
+            }
+        }
+    }
+}
+
+internal b32
+WritePackerCache(packer* Packer, char* OutputPath)
+{
+    char CachePath[1024];
+    snprintf(CachePath, sizeof(CachePath), "%s.cache", OutputPath);
+    FILE* File = fopen(CachePath, "wb");
+    if(!File) return false;
+    
+    fprintf(File, "# name tag type source_key content_hash\n");
+    for(u32 Index = 0; Index < Packer->EntriesCount; Index++)
+    {
+        packer_entry* Entry = &Packer->Entries[Index];
+        if(Entry->Source || !Entry->SourceKey) continue;
+        
+        fprintf(File, "%s %s %u %016llx %016llx\n", Entry->Name, Entry->Tag[0] ? Entry->Tag : "-", Entry->Type,
+                (unsigned long long)Entry->SourceKey, (unsigned long long)Entry->ContentHash);
+    }
+    return fclose(File) == 0;
+}
+
+internal void
+RunPackerJobs(work_queue* Queue, packer* Packer, b32 HDRImages, b32 Compress, b32 ReportPSNR)
+{
+    volatile u32 Counter = 0;
+    for(u32 Index = 0; Index < Packer->EntriesCount; Index++)
+    {
+        packer_entry* Entry = &Packer->Entries[Index];
+        if(Entry->IsHDR != HDRImages || IsCopiedAsStored(Entry)) continue;
+        
+        Entry->Compress = Compress;
+        Entry->ReportPSNR = ReportPSNR;
+        Entry->Queue = Queue;
+        Entry->Counter = &Counter;
+        Platform_AtomicAdd(&Counter, 1);
+        AddWorkQueueEntry(Queue, PackEntryWork, Entry);
+    }
+    WaitForWorkCounter(Queue, &Counter);
+}
+
+internal b32
+WriteAssetFile(packer* Packer, char* Path)
+{
+    u64 Count = Packer->EntriesCount;
+    u64 SlotsCount = GetAssetIndexSlotsCount(Count);
+    
+    asset_table_entry* Table = (asset_table_entry*)ZeroAlloc(sizeof(asset_table_entry) * (Count + 1));
+    asset_index_slot* Slots = (asset_index_slot*)ZeroAlloc(sizeof(asset_index_slot) * SlotsCount);
+    
+    u64 Offset = sizeof(asset_file_header) + sizeof(asset_table_entry) * Count +
+        sizeof(asset_index_header) + sizeof(asset_index_slot) * SlotsCount;
+    for(u64 Index = 0; Index < Count; Index++)
+    {
+        packer_entry* Entry = &Packer->Entries[Index];
+        Entry->DuplicateOf = 0;
+        for(u64 Other = 0; Other < Index; Other++)
+        {
+            packer_entry* OtherEntry = &Packer->Entries[Other];
+            if(!OtherEntry->DuplicateOf && OtherEntry->ContentHash == Entry->ContentHash &&
+               OtherEntry->StoredSize == Entry->StoredSize && OtherEntry->Codec == Entry->Codec &&
+               memcmp(OtherEntry->Stored, Entry->Stored, Entry->StoredSize) == 0)
+            {
+                Entry->DuplicateOf = OtherEntry;
+                break;
+            }
+        }
+        
+        if(Entry->DuplicateOf)
+        {
+            Entry->Offset = Entry->DuplicateOf->Offset;
+        }
+        else
+        {
+            b32 DirectRead = Entry->StoredSize >= ASSET_DIRECT_READ_MIN_SIZE;
+            Offset = ALIGN_UP(Offset, DirectRead ? PLATFORM_DIRECT_READ_ALIGNMENT : PACKER_PAYLOAD_ALIGNMENT);
+            Entry->Offset = Offset;
+            Offset += Entry->StoredSize;
+        }
+        
+        asset_table_entry* TableEntry = &Table[Index];
+        memcpy(TableEntry->Name, Entry->Name, ASSET_NAME_LENGTH);
+        memcpy(TableEntry->Tag, Entry->Tag, ASSET_TAG_LENGTH);
+        TableEntry->Type = Entry->Type;
+        TableEntry->Offset = Entry->Offset;
+        TableEntry->Size = Entry->Size;
+        TableEntry->Hash = AssetHash(Entry->Name, Entry->Tag);
+        TableEntry->Codec = Entry->Codec;
+        TableEntry->Flags = Entry->FirstRead != UINT_MAX ? ASSET_ENTRY_PREFETCH : 0;
+        TableEntry->StoredSize = Entry->StoredSize;
+    }
+    BuildAssetIndex(Table, Count, Slots, SlotsCount);
+    
+    FILE* File = fopen(Path, "wb");
+    if(!File)
+    {
+        fprintf(stderr, "Cannot open %s for writing\n", Path);
+        return false;
+    }
+    
+    asset_file_header Header = {};
+    Header.Magic = ASSET_FILE_MAGIC;
+    Header.Version = ASSET_FILE_VERSION;
+    Header.TableEntryCount = Count;
+    
+    asset_index_header IndexHeader = {};
+    IndexHeader.SlotsCount = SlotsCount;
+    
+    b32 Success = fwrite(&Header, sizeof(Header), 1, File) == 1;
+    Success = Success && fwrite(Table, sizeof(asset_table_entry), Count, File) == Count;
+    Success = Success && fwrite(&IndexHeader, sizeof(IndexHeader), 1, File) == 1;
+    Success = Success && fwrite(Slots, sizeof(asset_index_slot), SlotsCount, File) == SlotsCount;
+    
+    u8 Padding[PLATFORM_DIRECT_READ_ALIGNMENT] = {};
+    for(u64 Index = 0; Index < Count && Success; Index++)
+    {
+        packer_entry* Entry = &Packer->Entries[Index];
+        if(Entry->DuplicateOf) continue;
+        
+        u64 PaddingSize = Entry->Offset - (u64)ftell(File);
+        Success = fwrite(Padding, 1, PaddingSize, File) == PaddingSize;
+        Success = Success && fwrite(Entry->Stored, 1, Entry->StoredSize, File) == Entry->StoredSize;
+    }
+    
+    Success = fclose(File) == 0 && Success;
+    Free(Slots);
+    Free(Table);
+    return Success;
+}
+
+int
+main(int ArgumentsCount, char** Arguments)
+{
+    char* ManifestPath = 0;
+    char* OutputPath = 0;
+    b32 Compress = false;
+    b32 BlockCompress = false;
+    b32 ReportPSNR = false;
+    char* TracePath = 0;
+    b32 FullBuild = false;
+    u32 ThreadCount = 0;
+    for(s32 Index = 1; Index < ArgumentsCount; Index++)
+    {
+        char* Argument = Arguments[Index];
+        if(strcmp(Argument, "-compress") == 0) Compress = true;
+        else if(strcmp(Argument, "-bc") == 0) BlockCompress = true;
+        else if(strcmp(Argument, "-psnr") == 0) ReportPSNR = true;
+        else if(strcmp(Argument, "-full") == 0) FullBuild = true;
+        else if(strcmp(Argument, "-order") == 0 && Index + 1 < ArgumentsCount) TracePath = Arguments[++Index];
+        else if(strcmp(Argument, "-threads") == 0 && Index + 1 < ArgumentsCount) ThreadCount = atoi(Arguments[++Index]);
+        else if(!ManifestPath) ManifestPath = Argument;
+        else if(!OutputPath) OutputPath = Argument;
+    }
+    
+    if(!ManifestPath || !OutputPath)
+    {
+        fprintf(stderr, "Usage: %s <manifest> <output> [-compress] [-bc] [-psnr] [-order <trace>] [-full] [-threads N]\n", Arguments[0]);
+        return 1;
+    }
+    
+    packer Packer = {};
+    Packer.BlockCompress = BlockCompress;
+    if(!ParseManifest(&Packer, ManifestPath) || (TracePath && !ParseReadTrace(&Packer, TracePath)))
+    {
+        return 1;
+    }
+    
+    //The calling thread helps, so one worker less than the requested threads
+    work_queue* Queue = CreateWorkQueue(ThreadCount > 1 ? ThreadCount - 1 : ThreadCount);
+    
+    if(!FullBuild)
+    {
+        LoadPackerCache(&Packer, OutputPath);
+    }
+    ReadImportedEntries(&Packer);
+    
+    //stb_image keeps the vertical flip as a global, LDR images are flipped and HDR are
+    //not, so the two kinds never decode at the same time
+    RunPackerJobs(Queue, &Packer, false, Compress, ReportPSNR);
+    RunPackerJobs(Queue, &Packer, true, Compress, ReportPSNR);
+    
+    //Payloads are written in table order, so this is the layout of the file. Without a
+    //trace every entry compares equal on FirstRead and the manifest order is kept
+    qsort(Packer.Entries, Packer.EntriesCount, sizeof(packer_entry), CompareFirstRead);
+    
+    b32 Success = true;
+    u64 TotalSize = 0;
+    u64 TotalStoredSize = 0;
+    for(u32 Index = 0; Index < Packer.EntriesCount; Index++)
+    {
+        packer_entry* Entry = &Packer.Entries[Index];
+        if(Entry->Failed)
+        {
+            fprintf(stderr, "Failed to pack %s - %s from %s\n", Entry->Name, Entry->Tag,
+                    Entry->Source ? "import" : Entry->Path);
+            Success = false;
+        }
+        else if(Entry->PSNR > 0.0)
+        {
+            printf("%s - %s: %.2f dB\n", Entry->Name, Entry->Tag, Entry->PSNR);
+        }
+        TotalSize += Entry->Size;
+        TotalStoredSize += Entry->StoredSize;
+    }
+    
+    if(!Success || !WriteAssetFile(&Packer, OutputPath) || !WritePackerCache(&Packer, OutputPath))
+    {
+        return 1;
+    }
+    
+    u32 ReusedCount = 0;
+    u32 DuplicatesCount = 0;
+    for(u32 Index = 0; Index < Packer.EntriesCount; Index++)
+    {
+        packer_entry* Entry = &Packer.Entries[Index];
+        ReusedCount += Entry->Reused;
+        DuplicatesCount += Entry->DuplicateOf != 0;
+        TotalStoredSize -= Entry->DuplicateOf ? Entry->StoredSize : 0;
+    }
+    
+    printf("Packed %u assets into %s, %llu bytes (%llu uncompressed)\n", Packer.EntriesCount, OutputPath,
+           (unsigned long long)TotalStoredSize, (unsigned long long)TotalSize);
+    printf("%u reused from the last build, %u duplicates stored once\n", ReusedCount, DuplicatesCount);
+    return 0;
+}
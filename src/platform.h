@@ -0,0 +1,74 @@
+// Platform services used by code that has to build both in the Win32 editor
+// and in the Linux tools. Implemented in win32.cpp and linux.cpp.
+
+#ifdef _WIN32
+typedef HANDLE platform_file;
+#define PLATFORM_INVALID_FILE INVALID_HANDLE_VALUE
+#else
+typedef int platform_file;
+#define PLATFORM_INVALID_FILE (-1)
+#endif
+
+struct platform_file_mapping
+{
+    u8* Data;
+    u64 Size;
+
+    void* Handle; //Mapping object on Win32, unused on Linux
+};
+
+internal platform_file Platform_OpenFileForReading(char* Path);
+internal void Platform_CloseFile(platform_file File);
+internal u64 Platform_GetFileSize(platform_file File);
+internal b32 Platform_ReadAtOffset(platform_file File, void* Data, u64 Size, u64 Offset);
+
+//Succeeds if the directory already exists, its parent must exist
+internal b32 Platform_CreateDirectory(char* Path);
+//Replaces To if it exists, in one step when both are on the same volume
+internal b32 Platform_MoveFile(char* From, char* To);
+
+//Reads from a file opened this way bypass the OS cache (O_DIRECT, FILE_FLAG_NO_BUFFERING).
+//Buffers, offsets and sizes must all be multiples of PLATFORM_DIRECT_READ_ALIGNMENT,
+//memory from Platform_AllocateMemory always is. Can fail where the file system doesn't
+//support it, callers fall back to a normal handle
+#define PLATFORM_DIRECT_READ_ALIGNMENT 4096
+internal platform_file Platform_OpenFileForDirectReading(char* Path);
+
+struct platform_read
+{
+    platform_file File;
+    void* Data;
+    u64 Size;
+    u64 Offset;
+};
+
+//Issues all the reads together and returns when they are all done, they complete in any
+//order. Returns false if any of them failed. Sizes are not limited to 32 bits
+internal b32 Platform_ReadBatch(platform_read* Reads, u32 Count);
+
+//Maps the whole file read only, or copy-on-write to allow changes that never reach the
+//file. Pages that are only read stay shared with the page cache and other processes
+internal platform_file_mapping Platform_MapFile(platform_file File, b32 CopyOnWrite);
+internal void Platform_UnmapFile(platform_file_mapping* Mapping);
+
+//Zeroed pages straight from the OS, for the arenas in memory_arena.cpp
+internal void* Platform_AllocateMemory(u64 Size);
+internal void Platform_FreeMemory(void* Memory, u64 Size);
+
+//Monotonic clock, comparable between threads
+internal u64 Platform_GetMicroseconds();
+
+//Threads and synchronization, used by the work queue in work_queue.cpp
+typedef void* platform_semaphore;
+typedef void platform_thread_proc(void* Param);
+
+internal u32 Platform_GetProcessorCount();
+internal void Platform_CreateThread(platform_thread_proc* Proc, void* Param);
+internal u32 Platform_GetThreadId();
+internal platform_semaphore Platform_CreateSemaphore(u32 InitialCount);
+internal void Platform_SignalSemaphore(platform_semaphore Semaphore);
+internal void Platform_WaitSemaphore(platform_semaphore Semaphore);
+
+//Full barriers, AtomicAdd returns the value before the addition
+internal u32 Platform_AtomicAdd(volatile u32* Value, u32 Addend);
+internal b32 Platform_AtomicCompareExchange(volatile u32* Value, u32 Expected, u32 New);
@@ -1,5 +1,21 @@
 #include "scene.h"
 
+//The scene is pushed at the start of its persistent arena, so the scene and both of its
+//arenas come from a single system allocation
+internal scene*
+CreateScene()
+{
+    memory_arena Memory = {};
+    AllocateArena(&Memory, SCENE_PERSISTENT_MEMORY_SIZE + SCENE_SCRATCH_MEMORY_SIZE);
+    
+    scene* Scene = PushStruct(&Memory, scene);
+    SubArena(&Scene->ScratchArena, &Memory, SCENE_SCRATCH_MEMORY_SIZE);
+    Scene->PersistentArena = Memory;
+    InitTextureResidency(&Scene->Residency, SCENE_TEXTURE_BUDGET);
+    
+    return Scene;
+}
+
 internal mesh*
 AddMesh(scene* Scene, char* Name, mesh_data* MeshData,  mesh_gpu* Gpu, u32 MaterialIndex, b32 CastsShadows = true)
 {
@@ -16,12 +32,14 @@ AddMesh(scene* Scene, char* Name, mesh_data* MeshData,  mesh_gpu* Gpu, u32 Mater
     return Mesh;
 }
 
-internal void
+internal material*
 AddMaterial(scene* Scene, material* Material)
 {
     Assert(Scene->MaterialsCount < MAX_MATERIALS_COUNT);
     material* New = Scene->Materials + Scene->MaterialsCount++;
     *New = *Material;
+    
+    return New;
 }
 
 internal directional_light*
@@ -65,101 +83,217 @@ GetShadowMatrix(directional_light* Light)
 }
 
 
-internal texture
-LoadTextureFromAssetFile(ID3D11Device* Device, HANDLE File, asset_table Table, char* Name, DXGI_FORMAT Format)
+// Asset loaders, all streamed. The targets are filled in by the main thread
+// from ProcessCompletedAssetLoads, which must be called with the D3D11 device as context
+
+internal void
+CompleteTextureLoad(asset_load_request* Request, void* Context)
+{
+    ID3D11Device* Device = (ID3D11Device*)Context;
+    if(Request->State == ASSET_LOAD_PARSED)
+    {
+        *(texture*)Request->UserData = D3D11_CreateTexture(Device, &Request->Image, (DXGI_FORMAT)Request->UserIndex);
+    }
+}
+
+internal asset_load_handle
+StreamTextureFromAssetFile(asset_streamer* Streamer, asset_id Id, texture* Texture, DXGI_FORMAT Format)
+{
+    return RequestAssetLoad(Streamer, Id, ASSET_IMAGE, CompleteTextureLoad, Texture, Format);
+}
+
+internal void
+CompleteMaterialTextureLoad(asset_load_request* Request, void* Context)
 {
-    texture Result = {};
+    ID3D11Device* Device = (ID3D11Device*)Context;
+    scene* Scene = (scene*)Request->UserData;
+    material* Material = Scene->Materials + Request->UserIndex / MATERIAL_TEXTURES_COUNT;
+    u32 i = Request->UserIndex % MATERIAL_TEXTURES_COUNT;
     
-    asset_table_entry* Entry = FindAsset(Name, Table, ASSET_IMAGE);
-    if(Entry)
+    if(Request->State != ASSET_LOAD_PARSED)
     {
-        void* Data = ZeroAlloc(Entry->Size);
-        Win32_ReadAtOffset(File, Data, Entry->Size, Entry->Offset);
-        image_data Image = LoadImageAsset(Data, Entry->Size);
-        Result = D3D11_CreateTexture(Device, &Image, Format);
+        // NOTE: We only alow AO and EMISSIVE to be missing for now
+        Assert(i == AO || i == EMISSIVE);
+        return;
     }
     
-    return Result;
+    image_data* Image = &Request->Image;
+    DXGI_FORMAT Format = D3D11_GetImageFormat(Image, i == ALBEDO || i == EMISSIVE);
+    Material->Textures[i] = D3D11_CreateTexture(Device, Image, Format);
+    Material->HasTexture[i] = true;
+    
+    //Only the smallest mips were loaded, the residency streams in the rest when drawn
+    Material->ResidencyIds[i] = AddResidentTexture(&Scene->Residency, Image->Width, Image->Height, Image->BytesPerPixel,
+                                                   Image->BlockFormat, Image->NumberOfMips, Image->FirstMip, Material, i);
+    
+    // NOTE: Debug tracking
+    char TrackedName[MAX_TRACKED_TEXTURE_NAME_LENGTH];
+    snprintf(TrackedName, sizeof(TrackedName), "%s_%s", Material->Name, MaterialTextureNames[i]);
+    ivec2 Size = ivec2(MAX(Image->Width >> Image->FirstMip, 1), MAX(Image->Height >> Image->FirstMip, 1));
+    PushTrackedTexture(Material->Textures[i].ResourceView, Size, TrackedName, TRACKED_TEXTURE_2D);
 }
 
-internal material
-LoadMaterialFromAssetFile(ID3D11Device* Device, HANDLE File, asset_table Table, char* Name)
+//Textures pop in as they complete, until then the material uses its constant values.
+//They are loaded tail first, starting from the mip of RESIDENCY_MIN_MIP_SIZE, and the
+//mips the camera needs follow from UpdateSceneTextureResidency
+internal void
+StreamMaterialFromAssetFile(asset_streamer* Streamer, scene* Scene, material* Material)
 {
-    material Result = {};
-    Result.Name = Name;
-    
+    u32 MaterialIndex = (u32)(Material - Scene->Materials);
     char AssetName[512];
     for(u32 i = 0; i < MATERIAL_TEXTURES_COUNT; i++)
     {
-        snprintf(AssetName, sizeof(AssetName), "%s_%s", Name, MaterialTextureNames[i]);
-        asset_table_entry* Entry = FindAsset(AssetName, Table, ASSET_IMAGE);
-        if(Entry)
-        {
-            void* Data = ZeroAlloc(Entry->Size);
-            Win32_ReadAtOffset(File, Data, Entry->Size, Entry->Offset);
-            image_data Image = LoadImageAsset(Data, Entry->Size);
-            
-            DXGI_FORMAT Format;
-            if(Image.BytesPerPixel == 1)
-            {
-                Format = DXGI_FORMAT_R8_UNORM;
-            } 
-            else 
-            {
-                Assert(Image.BytesPerPixel == 4);
-                Format = (i == ALBEDO || i == EMISSIVE) ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
-            }
-            
-            Result.Textures[i] = D3D11_CreateTexture(Device, &Image, Format); //Only albedo is SRGB
-            Result.HasTexture[i] = true;    
-            
-            // NOTE: Debug tracking
-            char* TrackedName = (char*)ZeroAlloc(strlen(AssetName) + 1);
-            strcpy(TrackedName, AssetName);
-            ivec2 Size = ivec2(Image.Width, Image.Height);
-            PushTrackedTexture(Result.Textures[i].ResourceView, Size, TrackedName, TRACKED_TEXTURE_2D);
-            
-            Free(Data);
-        }
-        else
-        {
-            // NOTE: We only alow AO and EMISSIVE to be missing for now
-            Assert(i == AO || i == EMISSIVE);
-        }
+        snprintf(AssetName, sizeof(AssetName), "%s_%s", Material->Name, MaterialTextureNames[i]);
+        RequestImageMipsLoad(Streamer, AssetName, RESIDENCY_MIN_MIP_SIZE, CompleteMaterialTextureLoad,
+                             Scene, MaterialIndex * MATERIAL_TEXTURES_COUNT + i);
     }
-    
-    return Result;
 }
 
-internal d3d11_cubemap
-LoadCubemap(ID3D11Device* Device, HANDLE File,  asset_table_entry* Entry)
+internal void
+CompleteCubemapLoad(asset_load_request* Request, void* Context)
 {
-    void* Data = ZeroAlloc(Entry->Size);
-    Win32_ReadAtOffset(File, Data, Entry->Size, Entry->Offset);
-    cubemap_data CubemapData = LoadCubemapAsset(Data, Entry->Size);
+    ID3D11Device* Device = (ID3D11Device*)Context;
+    Assert(Request->State == ASSET_LOAD_PARSED);
     
-    d3d11_cubemap Result = D3D11_LoadCubemap(Device, &CubemapData);
-    Free(Data);
+    cubemap* Cubemap = (cubemap*)Request->UserData;
+    *Cubemap = D3D11_LoadCubemap(Device, &Request->Cubemap);
     
-    return Result;
+    // NOTE: Debug tracking
+    asset_table_entry* Entry = Request->Entry;
+    char TrackedName[MAX_TRACKED_TEXTURE_NAME_LENGTH];
+    snprintf(TrackedName, sizeof(TrackedName), "%.*s - %.*s", 
+             ASSET_NAME_LENGTH, Entry->Name, ASSET_TAG_LENGTH, Entry->Tag);
+    PushTrackedTexture(Cubemap->ResourceView, ivec2(Request->Cubemap.Size), TrackedName, TRACKED_TEXTURE_CUBEMAP);
+}
+
+internal void
+StreamLightProbeFromAssetFile(asset_streamer* Streamer, light_probe* Probe, char* Name)
+{
+    RequestAssetLoad(Streamer, Name, ASSET_CUBEMAP, "skybox", CompleteCubemapLoad, &Probe->Base);
+    RequestAssetLoad(Streamer, Name, ASSET_CUBEMAP, "irradiance", CompleteCubemapLoad, &Probe->Irradiance);
+    RequestAssetLoad(Streamer, Name, ASSET_CUBEMAP, "specular", CompleteCubemapLoad, &Probe->Specular);
+}
+
+// Texture residency, material textures are tracked once created by any of the loaders
+// above and UpdateSceneTextureResidency applies the residency actions to them
+
+internal void
+UpdateTrackedMaterialTexture(material* Material, u32 i)
+{
+    char TrackedName[MAX_TRACKED_TEXTURE_NAME_LENGTH];
+    snprintf(TrackedName, sizeof(TrackedName), "%s_%s", Material->Name, MaterialTextureNames[i]);
+    tracked_texture* Track = FindTrackedTexture(TrackedName);
+    if(Track)
+    {
+        ivec2 Size = ivec2(0, 0);
+        if(Material->Textures[i].Texture)
+        {
+            D3D11_TEXTURE2D_DESC TextureDesc;
+            Material->Textures[i].Texture->GetDesc(&TextureDesc);
+            Size = ivec2(TextureDesc.Width, TextureDesc.Height);
+        }
+        Track->Texture = Material->Textures[i].ResourceView;
+        Track->Size = Size;
+    }
 }
 
-internal light_probe
-LoadLightProbeFromAssetFile(ID3D11Device* Device, HANDLE File, asset_table Table,  char* Name)
+internal void
+CompleteResidentTextureLoad(asset_load_request* Request, void* Context)
 {
-    light_probe Result = {};
+    ID3D11Device* Device = (ID3D11Device*)Context;
+    scene* Scene = (scene*)Request->UserData;
+    u32 Id = Request->UserIndex;
+    resident_texture* Resident = &Scene->Residency.Textures[Id];
+    material* Material = (material*)Resident->UserData;
+    u32 i = Resident->UserIndex;
     
-    asset_table_entry* BaseEntry = FindAsset(Name, Table, ASSET_CUBEMAP, "skybox");
-    asset_table_entry* IrradianceEntry = FindAsset(Name, Table, ASSET_CUBEMAP, "irradiance");
-    asset_table_entry* SpecularEntry = FindAsset(Name, Table, ASSET_CUBEMAP, "specular");
+    b32 Loaded = Request->State == ASSET_LOAD_PARSED;
+    if(Loaded)
+    {
+        if(Material->Textures[i].Texture)
+        {
+            D3D11_FreeTexture(&Material->Textures[i]);
+        }
+        
+        image_data* Image = &Request->Image;
+        DXGI_FORMAT Format = D3D11_GetImageFormat(Image, i == ALBEDO || i == EMISSIVE);
+        Material->Textures[i] = D3D11_CreateTexture(Device, Image, Format);
+        Material->HasTexture[i] = true;
+        UpdateTrackedMaterialTexture(Material, i);
+    }
     
-    Result.Base = LoadCubemap(Device, File, BaseEntry);
-    Result.Irradiance = LoadCubemap(Device, File, IrradianceEntry);
-    Result.Specular = LoadCubemap(Device, File, SpecularEntry);
+    CompleteTextureRestore(&Scene->Residency, Id, Loaded, Request->Image.FirstMip);
+}
+
+//Call once per frame after the scene is drawn, DrawMeshes marks the textures it uses.
+//Textures that lose their top mips are copied on the GPU, evicted ones are released
+//and sampled as the material constants until they are streamed back in
+internal void
+UpdateSceneTextureResidency(ID3D11Device* Device, ID3D11DeviceContext* Context, scene* Scene, asset_streamer* Streamer)
+{
+    texture_residency* Residency = &Scene->Residency;
+    for(u32 MaterialIndex = 0; MaterialIndex < Scene->MaterialsCount; MaterialIndex++)
+    {
+        material* Material = Scene->Materials + MaterialIndex;
+        for(u32 i = 0; i < MATERIAL_TEXTURES_COUNT; i++)
+        {
+            if(Material->HasTexture[i] && !Material->ResidencyIds[i])
+            {
+                D3D11_TEXTURE2D_DESC TextureDesc;
+                Material->Textures[i].Texture->GetDesc(&TextureDesc);
+                
+                s32 BytesPerPixel;
+                image_block_format BlockFormat;
+                D3D11_GetFormatLayout(TextureDesc.Format, &BytesPerPixel, &BlockFormat);
+                Material->ResidencyIds[i] = AddResidentTexture(Residency, TextureDesc.Width, TextureDesc.Height, BytesPerPixel,
+                                                               BlockFormat, TextureDesc.MipLevels, 0, Material, i);
+            }
+        }
+    }
     
-    return Result;
+    //Restores are streamed, so they are limited by the free requests
+    residency_action Actions[64];
+    u32 MaxActions = MIN(ArrayCount(Actions), ASSET_STREAMER_MAX_REQUESTS - Streamer->ActiveCount);
+    u32 ActionsCount = UpdateTextureResidency(Residency, Actions, MaxActions);
+    for(u32 ActionIndex = 0; ActionIndex < ActionsCount; ActionIndex++)
+    {
+        residency_action* Action = Actions + ActionIndex;
+        resident_texture* Resident = &Residency->Textures[Action->Texture];
+        material* Material = (material*)Resident->UserData;
+        u32 i = Resident->UserIndex;
+        texture* Texture = &Material->Textures[i];
+        
+        switch(Action->Kind)
+        {
+            case RESIDENCY_DROP_MIPS:
+            {
+                //FirstMip is relative to the full texture, some mips may be gone already
+                D3D11_TEXTURE2D_DESC TextureDesc;
+                Texture->Texture->GetDesc(&TextureDesc);
+                u32 FirstMip = Action->FirstMip - (Resident->MipsCount - TextureDesc.MipLevels);
+                D3D11_DropTextureMips(Device, Context, Texture, FirstMip);
+                UpdateTrackedMaterialTexture(Material, i);
+            } break;
+            
+            case RESIDENCY_EVICT:
+            {
+                D3D11_FreeTexture(Texture);
+                Material->HasTexture[i] = false;
+                UpdateTrackedMaterialTexture(Material, i);
+            } break;
+            
+            case RESIDENCY_RESTORE:
+            {
+                //Only the mips from the one wanted down are read
+                char AssetName[512];
+                snprintf(AssetName, sizeof(AssetName), "%s_%s", Material->Name, MaterialTextureNames[i]);
+                u32 MaxSize = MAX(Resident->Size >> Action->FirstMip, 1);
+                RequestImageMipsLoad(Streamer, AssetName, MaxSize, CompleteResidentTextureLoad, Scene, Action->Texture);
+            } break;
+        }
+    }
 }
-                            
+
 internal material
 LoadMaterial(ID3D11Device* Device, char* Name, char* Extension = ".png")
 {
@@ -175,27 +309,14 @@ LoadMaterial(ID3D11Device* Device, char* Name, char* Extension = ".png")
         //If we have an image
         if(Image.Width != 0)
         {
-            DXGI_FORMAT Format;
-            if(Image.BytesPerPixel == 1)
-            {
-                Format = DXGI_FORMAT_R8_UNORM;
-            } 
-            else 
-            {
-                Assert(Image.BytesPerPixel == 4);
-                Format = (i == ALBEDO || i == EMISSIVE) ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
-            }
-            
-            
+            DXGI_FORMAT Format = D3D11_GetImageFormat(&Image, i == ALBEDO || i == EMISSIVE);
             Result.Textures[i] = D3D11_CreateTexture(Device, &Image, Format);
             Result.HasTexture[i] = true;    
             
             // NOTE: Debug tracking
             sprintf(Path, "%s - %s", Name, MaterialTextureNames[i]);
-            char* TrackedName = (char*)ZeroAlloc(strlen(Path) + 1);
-            strcpy(TrackedName, Path);
             Size = ivec2(Image.Width, Image.Height);
-            PushTrackedTexture(Result.Textures[i].ResourceView, Size, TrackedName, TRACKED_TEXTURE_2D);
+            PushTrackedTexture(Result.Textures[i].ResourceView, Size, Path, TRACKED_TEXTURE_2D);
             
             FreeImage(&Image);
         }
@@ -206,18 +327,5 @@ LoadMaterial(ID3D11Device* Device, char* Name, char* Extension = ".png")
         }
     }    
     Result.Name = Name;
-    return Result;
-}
-
-internal mesh_data
-LoadMeshFromAssetFile(HANDLE File, asset_table Table, char* Name, char* Tag = "")
-{
-    asset_table_entry* Entry = FindAsset(Name, Table, ASSET_MESH, Tag);
-    
-    void* Data = ZeroAlloc(Entry->Size);
-    Win32_ReadAtOffset(File, Data, Entry->Size, Entry->Offset);
-    
-    mesh_data Result = LoadMeshAsset(Data, Entry->Size);
-    
     return Result;
 }
\ No newline at end of file
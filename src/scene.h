@@ -1,6 +1,15 @@
 #define MAX_MATERIALS_COUNT 256
 #define MAX_MESHES_COUNT 256
 
+//The scene struct is under 0.5MB, most of it the residency table, the rest of the
+//persistent arena is the streamer staging and resident meshes. Scratch only holds the
+//meshlet ranges of a frame, 8 bytes per meshlet drawn
+#define SCENE_PERSISTENT_MEMORY_SIZE (Megabytes(8) + ASSET_STREAMER_STAGING_SIZE)
+#define SCENE_SCRATCH_MEMORY_SIZE Megabytes(1)
+
+//Initial budget of Scene->Residency, can be changed from the render settings
+#define SCENE_TEXTURE_BUDGET Megabytes(512)
+
 #define MIN_SHADOW_BIAS 0.001f
 #define MAX_SHADOW_BIAS 0.005f
 
@@ -20,6 +29,11 @@ struct mesh
     mat4 DrawTransform;
     aabb AABB; 
     b32 AABBDirty;
+    
+    //Meshlets left by CullSceneMeshlets for this frame, in the scene scratch arena.
+    //0 if the mesh is drawn whole
+    meshlet_range* MeshletRanges;
+    u32 MeshletRangesCount;
 };
 
 // IMPORTANT: The names, components, kind and order in the material struct MUST match
@@ -82,6 +96,9 @@ struct material
         b32 HasTexture[MATERIAL_TEXTURES_COUNT];
     };
     
+    //Ids of the textures in the scene residency, 0 until UpdateSceneTextureResidency tracks them
+    u32 ResidencyIds[MATERIAL_TEXTURES_COUNT];
+    
     //Values used when no texture
     vec3 Albedo;
     f32 Roughness;
@@ -146,4 +163,12 @@ struct scene
     vec3 SunDirection;
     vec3 SunIlluminanceColor;
     float SunIlluminanceScale;
+    
+    //Mesh data, the asset streamer and everything else that stays resident, and memory
+    //for a single frame. See CreateScene
+    memory_arena PersistentArena;
+    memory_arena ScratchArena;
+    
+    //Material textures are kept under a budget, see UpdateSceneTextureResidency
+    texture_residency Residency;
 };
\ No newline at end of file
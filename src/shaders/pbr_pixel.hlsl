@@ -241,7 +241,13 @@ pixel_output PixelMain(pixel_input In)
     //This matrix transforms from TBN to world space
     mat3 TBN = transpose(mat3(T, B, N));
     
-    vec3 NormalTBN = HasNormal ? NormalTexture.Sample(SampleType, In.TexCoord).xyz * 2.0 - 1.0 : vec3(0.0f, 0.0f, 1.0f);
+    //Z is reconstructed from XY so that normal maps can be stored as two channels (BC5)
+    vec3 NormalTBN = vec3(0.0f, 0.0f, 1.0f);
+    if(HasNormal)
+    {
+        vec2 NormalXY = NormalTexture.Sample(SampleType, In.TexCoord).xy * 2.0 - 1.0;
+        NormalTBN = vec3(NormalXY, sqrt(saturate(1.0f - dot(NormalXY, NormalXY))));
+    }
     N = mul(TBN, NormalTBN);
     
     vec3 V = normalize(ViewPos - In.WorldPos);
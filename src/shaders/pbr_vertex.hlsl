@@ -1,6 +1,26 @@
 #include "defines.hlsl"
 #include "pbr_common.hlsl"
 
+#if QUANTIZED_VERTICES
+//Positions are in [0, 1] over the bounds of the mesh, Model maps them back, and UVs over
+//their bounds, see QuantizedUV. Normals and tangents are octahedral, see
+//vertex_quantization.cpp
+struct vertex_input
+{
+    vec3 Position : POSITION;
+    vec2 Normal : NORMAL;
+    vec2 Tangent : TANGENT;
+    vec2 TexCoord: TEXCOORD0;
+};
+
+vec3 DecodeOctahedral(vec2 Encoded)
+{
+    vec3 Result = vec3(Encoded, 1.0f - abs(Encoded.x) - abs(Encoded.y));
+    float Fold = saturate(-Result.z);
+    Result.xy += Result.xy >= 0.0f ? -Fold : Fold;
+    return normalize(Result);
+}
+#else
 struct vertex_input
 {
     vec3 Position : POSITION;
@@ -8,6 +28,7 @@ struct vertex_input
     vec3 Tangent : TANGENT;
     vec2 TexCoord: TEXCOORD0;
 };
+#endif
 
 //Vertex
 cbuffer vertex_constants
@@ -17,6 +38,7 @@ cbuffer vertex_constants
     mat4 Model;
     mat4 NormalMatrix;
     mat4 ShadowMatrix[MAX_DIRECTIONAL_LIGHTS_COUNT];
+    vec4 QuantizedUV; //Offset in xy and scale in zw
 };
 
 
@@ -27,10 +49,18 @@ pixel_input VertexMain(vertex_input In)
     float4 WorldPos = mul(Model, float4(In.Position, 1.0f));
     Out.Position = mul(Projection, mul(View, WorldPos));
     Out.WorldPos = WorldPos.xyz;
-    Out.TexCoord = In.TexCoord;
     
-    Out.Normal = mul(NormalMatrix, float4(In.Normal, 0.0f)).xyz;
-    Out.Tangent = mul(NormalMatrix, float4(In.Tangent, 0.0f)).xyz;
+#if QUANTIZED_VERTICES
+    Out.TexCoord = QuantizedUV.xy + In.TexCoord * QuantizedUV.zw;
+    vec3 Normal = DecodeOctahedral(In.Normal);
+    vec3 Tangent = DecodeOctahedral(In.Tangent);
+#else
+    Out.TexCoord = In.TexCoord;
+    vec3 Normal = In.Normal;
+    vec3 Tangent = In.Tangent;
+#endif
+    Out.Normal = mul(NormalMatrix, float4(Normal, 0.0f)).xyz;
+    Out.Tangent = mul(NormalMatrix, float4(Tangent, 0.0f)).xyz;
     for(int i = 0; i < MAX_DIRECTIONAL_LIGHTS_COUNT; i++)
     {
         Out.ShadowPos[i] = mul(ShadowMatrix[i], float4(WorldPos.xyz, 1.0f));
@@ -0,0 +1,3 @@
+//Vertex shader of MESH_QUANTIZED meshes
+#define QUANTIZED_VERTICES 1
+#include "pbr_vertex.hlsl"
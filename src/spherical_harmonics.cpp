@@ -57,19 +57,17 @@ SumWeightedSphericalHarmonics(f64* SH, vec3 n, f64 domega, float L)
     SH[4] += L*(c*(x*x-y*y))*domega;
 }
 
+//Projects the first mip of the cubemap on the first 9 SH coefficients, faces that are
+//not RGBA32F are decoded to it first
 internal void
-ComputeSphericalHarmonics(HANDLE File, asset_table Table, char* Name)
+ComputeSphericalHarmonics(cubemap_data CubemapData, vec4* L)
 {
-    asset_table_entry* Entry = FindAsset(Name, Table, ASSET_CUBEMAP, "environment");
-    
-    void* Data = ZeroAlloc(Entry->Size);
-    Win32_ReadAtOffset(File, Data, Entry->Size, Entry->Offset);
-    cubemap_data CubemapData = LoadCubemapAsset(Data, Entry->Size);
-    
     //All sizes in bytes
-    s32 FaceSize = CubemapData.Pitch * CubemapData.Size;
-    s32 RowSize = CubemapData.Pitch;
-    s32 PixelSize = CubemapData.BytesPerPixel;
+    u64 FaceSize = GetCubemapFaceSize(CubemapData.Size, CubemapData.Format, CubemapData.NumberOfMips);
+    s32 RowSize = CubemapData.Size * 16;
+    s32 PixelSize = 16;
+    b32 IsDecoded = CubemapData.Format != CUBEMAP_RGBA32F;
+    u8* Decoded = IsDecoded ? (u8*)ZeroAlloc((u64)RowSize * CubemapData.Size) : 0;
     
     vec3 Vz[6] = {
         vec3( 1,  0,  0),
@@ -108,6 +106,11 @@ ComputeSphericalHarmonics(HANDLE File, asset_table Table, char* Name)
     for(s32 FaceIndex = 0; FaceIndex < 6; FaceIndex++)
     {
         u8* FaceBegin = CubemapData.Data + FaceSize * FaceIndex;
+        if(IsDecoded)
+        {
+            DecodeCubemapFace(&CubemapData, FaceIndex, (f32*)Decoded);
+            FaceBegin = Decoded;
+        }
         
         for(s32 y = 0; y < CubemapData.Size; y++)
         {
@@ -136,10 +139,12 @@ ComputeSphericalHarmonics(HANDLE File, asset_table Table, char* Name)
         }
     }
     
+    Free(Decoded);
+    
     f64 InvTotalW = 1.0 / TotalW;
     for(int i = 0; i < 9; i++)
     {
-        InspectorData.L[i] = 
+        L[i] = 
             vec4(
                  (f32)(SH_R[i] * InvTotalW), 
                  (f32)(SH_G[i] * InvTotalW), 
@@ -147,3 +152,30 @@ ComputeSphericalHarmonics(HANDLE File, asset_table Table, char* Name)
                  1.0f);
     }
 }
+
+// Streaming version, the projection runs on the worker and the main thread only
+// publishes the coefficients to the inspector
+
+internal void
+ProcessSphericalHarmonicsLoad(asset_load_request* Request)
+{
+    ComputeSphericalHarmonics(Request->Cubemap, (vec4*)Request->UserData);
+}
+
+internal void
+CompleteSphericalHarmonicsLoad(asset_load_request* Request, void* Context)
+{
+    vec4* L = (vec4*)Request->UserData;
+    if(Request->State == ASSET_LOAD_PARSED)
+    {
+        memcpy(InspectorData.L, L, sizeof(InspectorData.L));
+    }
+    Free(L);
+}
+
+internal asset_load_handle
+StreamSphericalHarmonics(asset_streamer* Streamer, asset_id Id)
+{
+    vec4* L = (vec4*)ZeroAlloc(sizeof(InspectorData.L));
+    return RequestAssetLoad(Streamer, Id, ASSET_CUBEMAP, CompleteSphericalHarmonicsLoad, L, 0, ProcessSphericalHarmonicsLoad);
+}
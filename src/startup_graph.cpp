@@ -0,0 +1,217 @@
+// Startup task graph, startup is split in tasks that each cover one or more STARTUP_*
+// actions and only wait for the tasks they depend on. Tasks run on the work queue, except
+// the ones that touch the window, the D3D11 immediate context, the inspector or the asset
+// streamer, which must stay on the main thread.
+// Every task records its begin and end in StartupTimestamps, and once the graph completes
+// the chain of tasks that gated the end of startup is stored as the critical path.
+
+#define MAX_STARTUP_TASKS 32
+#define MAX_STARTUP_DEPENDENCIES 8
+
+typedef void startup_task_callback(void* Data);
+
+struct startup_graph;
+
+struct startup_task
+{
+    startup_action First;
+    startup_action Last;
+    startup_task_callback* Callback;
+    void* Data;
+    b32 MainThread;
+    
+    u32 Dependencies[MAX_STARTUP_DEPENDENCIES];
+    u32 DependenciesCount;
+    u32 Dependents[MAX_STARTUP_TASKS];
+    u32 DependentsCount;
+    
+    //Dependencies not completed yet, the task is ready at zero
+    volatile u32 WaitCount;
+    b32 Started;
+    
+    startup_graph* Graph;
+    u64 Begin;
+    u64 End;
+};
+
+struct startup_graph
+{
+    startup_task Tasks[MAX_STARTUP_TASKS];
+    u32 TasksCount;
+    
+    work_queue* Queue;
+    volatile u32 RemainingCount;
+};
+
+//Returns the id of the task, to be used for AddStartupDependency
+internal u32
+AddStartupTask(startup_graph* Graph, startup_action First, startup_action Last, startup_task_callback* Callback,
+               void* Data, b32 MainThread)
+{
+    Assert(Graph->TasksCount < MAX_STARTUP_TASKS);
+    Assert(First <= Last);
+    
+    u32 Id = Graph->TasksCount++;
+    startup_task* Task = &Graph->Tasks[Id];
+    *Task = {};
+    Task->First = First;
+    Task->Last = Last;
+    Task->Callback = Callback;
+    Task->Data = Data;
+    Task->MainThread = MainThread;
+    Task->Graph = Graph;
+    return Id;
+}
+
+internal void
+AddStartupDependency(startup_graph* Graph, u32 Id, u32 DependsOn)
+{
+    Assert(Id < Graph->TasksCount && DependsOn < Graph->TasksCount && Id != DependsOn);
+    startup_task* Task = &Graph->Tasks[Id];
+    startup_task* Dependency = &Graph->Tasks[DependsOn];
+    Assert(Task->DependenciesCount < MAX_STARTUP_DEPENDENCIES);
+    
+    Task->Dependencies[Task->DependenciesCount++] = DependsOn;
+    Dependency->Dependents[Dependency->DependentsCount++] = Id;
+    Task->WaitCount++;
+}
+
+internal void
+StartupTaskWork(void* Param);
+
+//Main thread tasks are picked up by RunStartupGraph once their WaitCount reaches zero
+internal void
+SubmitStartupTask(startup_task* Task)
+{
+    if(!Task->MainThread)
+    {
+        Task->Started = true;
+        AddWorkQueueEntry(Task->Graph->Queue, StartupTaskWork, Task);
+    }
+}
+
+internal void
+RunStartupTask(startup_task* Task)
+{
+    startup_graph* Graph = Task->Graph;
+    
+    Task->Begin = Platform_GetMicroseconds();
+    Task->Callback(Task->Data);
+    Task->End = Platform_GetMicroseconds();
+    
+    //Actions are only written by the task running them
+    StartupTimestamps.Begins[Task->First] = Task->Begin;
+    StartupTimestamps.Timestamps[Task->Last] = Task->End;
+    StartupTimestamps.Threads[Task->Last] = Platform_GetThreadId();
+    
+    for(u32 Index = 0; Index < Task->DependentsCount; Index++)
+    {
+        startup_task* Dependent = &Graph->Tasks[Task->Dependents[Index]];
+        if(Platform_AtomicAdd(&Dependent->WaitCount, (u32)-1) == 1)
+        {
+            SubmitStartupTask(Dependent);
+        }
+    }
+    
+    Platform_AtomicAdd(&Graph->RemainingCount, (u32)-1);
+}
+
+internal void
+StartupTaskWork(void* Param)
+{
+    RunStartupTask((startup_task*)Param);
+}
+
+//Walks back from the task that ended last, through the dependency that ended last each time
+internal void
+ComputeStartupCriticalPath(startup_graph* Graph)
+{
+    startup_task* Task = 0;
+    for(u32 Id = 0; Id < Graph->TasksCount; Id++)
+    {
+        if(!Task || Graph->Tasks[Id].End > Task->End)
+        {
+            Task = &Graph->Tasks[Id];
+        }
+    }
+    
+    startup_span Path[MAX_STARTUP_TASKS];
+    u32 PathCount = 0;
+    while(Task)
+    {
+        startup_span* Span = &Path[PathCount++];
+        Span->First = Task->First;
+        Span->Last = Task->Last;
+        Span->Begin = Task->Begin;
+        Span->End = Task->End;
+        
+        startup_task* Gate = 0;
+        for(u32 Index = 0; Index < Task->DependenciesCount; Index++)
+        {
+            startup_task* Dependency = &Graph->Tasks[Task->Dependencies[Index]];
+            if(!Gate || Dependency->End > Gate->End)
+            {
+                Gate = Dependency;
+            }
+        }
+        Task = Gate;
+    }
+    
+    //Stored from the first task to the last
+    u32 Count = MIN(PathCount, ArrayCount(StartupTimestamps.CriticalPath));
+    for(u32 Index = 0; Index < Count; Index++)
+    {
+        StartupTimestamps.CriticalPath[Index] = Path[PathCount - 1 - Index];
+    }
+    StartupTimestamps.CriticalPathCount = Count;
+}
+
+//Runs the whole graph, returns once every task completed. The calling thread runs the
+//main thread tasks and doesn't help with the queue, so that it never sits in a long
+//asset load while a main thread task is ready
+internal void
+RunStartupGraph(startup_graph* Graph, work_queue* Queue)
+{
+    Graph->Queue = Queue;
+    Graph->RemainingCount = Graph->TasksCount;
+    
+    //Tasks submitted here can complete and submit their dependents before the loop ends
+    u32 Roots[MAX_STARTUP_TASKS];
+    u32 RootsCount = 0;
+    for(u32 Id = 0; Id < Graph->TasksCount; Id++)
+    {
+        if(Graph->Tasks[Id].WaitCount == 0)
+        {
+            Roots[RootsCount++] = Id;
+        }
+    }
+    for(u32 Index = 0; Index < RootsCount; Index++)
+    {
+        SubmitStartupTask(&Graph->Tasks[Roots[Index]]);
+    }
+    
+    while(Graph->RemainingCount)
+    {
+        startup_task* Ready = 0;
+        for(u32 Id = 0; Id < Graph->TasksCount && !Ready; Id++)
+        {
+            startup_task* Task = &Graph->Tasks[Id];
+            if(Task->MainThread && !Task->Started && Task->WaitCount == 0)
+            {
+                Ready = Task;
+            }
+        }
+        
+        if(Ready)
+        {
+            Ready->Started = true;
+            RunStartupTask(Ready);
+        }
+        else
+        {
+            _mm_pause();
+        }
+    }
+    
+    ComputeStartupCriticalPath(Graph);
+}
@@ -17,6 +17,7 @@ enum startup_action
     STARTUP_MATERIALS,
     STARTUP_SHADOW_MAPS,
     STARTUP_LIGHT_PROBE,
+    STARTUP_ATMOSPHERE_FILE,
     STARTUP_ATMOSPHERE,
     STARTUP_SCENE,
     
@@ -27,8 +28,8 @@ char* StartupActionNames[] = {
     "Window",
     "Asset File",
     "D3D11 - Device and Swapchain",
-    "D3D11 - Common state",
     "D3D11 - Default render targets and depth",
+    "D3D11 - Common state",
     "D3D11 - PBR pipeline",
     "D3D11 - Light probe precomputation",
     "D3D11 - Shadow maps pipeline",
@@ -39,23 +40,149 @@ char* StartupActionNames[] = {
     "Imgui",
     "Meshes",
     "Materials",
+    "Shadow Maps",
     "Light probe",
+    "Atmosphere file",
     "Atmosphere",
-    "Shadow Maps",
     "Scene setup",
 };
 
+//Task of the startup graph, which runs the actions from First to Last
+struct startup_span
+{
+    startup_action First;
+    startup_action Last;
+    u64 Begin;
+    u64 End;
+};
+
+#define MAX_STARTUP_TRACE_EVENTS 4096
+#define STARTUP_TRACE_DEFAULT_PATH "../startup_trace.json"
+#define STARTUP_TRACE_NAME_LENGTH 64
+
+//Span of work besides the startup actions, like the read and the upload of an asset
+struct startup_trace_event
+{
+    char Name[STARTUP_TRACE_NAME_LENGTH];
+    char* Category;
+    u64 Begin;
+    u64 End;
+    u32 Thread;
+    u64 BytesRead;
+    u64 BytesUploaded;
+    
+    //Set last, WriteStartupTrace skips events still being recorded
+    volatile b32 Recorded;
+};
+
+//All the times are from Platform_GetMicroseconds
 struct startup_timestamps
 {
     u64 Begin;
+    u32 MainThread;
+    
+    //End of every action and the thread that ran it
     u64 Timestamps[STARTUP_ACTIONS_COUNT];
+    u32 Threads[STARTUP_ACTIONS_COUNT];
+    
+    //Set for the first action of every startup task, the other actions of a task start
+    //when the previous one ends
+    u64 Begins[STARTUP_ACTIONS_COUNT];
+    
+    //Chain of tasks that gated the end of startup, each one waited for the previous one
+    startup_span CriticalPath[STARTUP_ACTIONS_COUNT];
+    u32 CriticalPathCount;
+    
+    //Recorded from any thread, events past MAX_STARTUP_TRACE_EVENTS are dropped
+    startup_trace_event Events[MAX_STARTUP_TRACE_EVENTS];
+    volatile u32 EventsCount;
 };
 
 static_assert(ArrayCount(StartupActionNames) == STARTUP_ACTIONS_COUNT);
 
 global_variable startup_timestamps StartupTimestamps;
 
-internal s64 Win32_GetCurrentCounter();
+#define STARTUP_BEGIN do { StartupTimestamps.Begin = Platform_GetMicroseconds(); StartupTimestamps.MainThread = Platform_GetThreadId(); } while(0)
+#define STARTUP_TIMESTAMP(x) do { StartupTimestamps.Timestamps[STARTUP_##x] = Platform_GetMicroseconds(); StartupTimestamps.Threads[STARTUP_##x] = Platform_GetThreadId(); } while(0)
+
+//Begin of the action, the actions without one start when the previous action ends
+internal u64
+GetStartupActionBegin(u32 Action)
+{
+    if(StartupTimestamps.Begins[Action])
+    {
+        return StartupTimestamps.Begins[Action];
+    }
+    return Action ? StartupTimestamps.Timestamps[Action - 1] : StartupTimestamps.Begin;
+}
+
+//The name is copied, it can be a temporary buffer. Category must be a string literal
+internal void
+AddStartupTraceEvent(char* Category, char* Name, u64 Begin, u64 End, u64 BytesRead = 0, u64 BytesUploaded = 0)
+{
+    u32 Index = Platform_AtomicAdd(&StartupTimestamps.EventsCount, 1);
+    if(Index >= MAX_STARTUP_TRACE_EVENTS) return;
+    
+    startup_trace_event* Event = &StartupTimestamps.Events[Index];
+    snprintf(Event->Name, sizeof(Event->Name), "%s", Name);
+    Event->Category = Category;
+    Event->Begin = Begin;
+    Event->End = End;
+    Event->Thread = Platform_GetThreadId();
+    Event->BytesRead = BytesRead;
+    Event->BytesUploaded = BytesUploaded;
+    Event->Recorded = true;
+}
 
-#define STARTUP_BEGIN StartupTimestamps.Begin = Win32_GetCurrentCounter()
-#define STARTUP_TIMESTAMP(x) StartupTimestamps.Timestamps[STARTUP_##x] = Win32_GetCurrentCounter()
+internal void
+WriteStartupTraceEvent(FILE* File, char* Category, char* Name, u64 Begin, u64 End, u32 Thread,
+                       u64 BytesRead, u64 BytesUploaded)
+{
+    //Names are asset and action names, they only need quotes and backslashes escaped
+    char Escaped[2 * STARTUP_TRACE_NAME_LENGTH];
+    u32 Length = 0;
+    for(char* c = Name; *c && Length + 2 < sizeof(Escaped); c++)
+    {
+        if(*c == '"' || *c == '\\') Escaped[Length++] = '\\';
+        Escaped[Length++] = *c;
+    }
+    Escaped[Length] = 0;
+    
+    fprintf(File, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":1,\"tid\":%u,"
+            "\"args\":{\"bytes_read\":%llu,\"bytes_uploaded\":%llu}}", Escaped, Category,
+            (unsigned long long)(Begin - StartupTimestamps.Begin), (unsigned long long)(End - Begin), Thread,
+            (unsigned long long)BytesRead, (unsigned long long)BytesUploaded);
+}
+
+//Writes the actions and the events recorded so far in the Chrome trace event format, it
+//can be opened in chrome://tracing or Perfetto. Times are from STARTUP_BEGIN
+internal b32
+WriteStartupTrace(char* Path)
+{
+    FILE* File = fopen(Path, "wb");
+    if(!File) return false;
+    
+    fprintf(File, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    fprintf(File, "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"Main\"}}",
+            StartupTimestamps.MainThread);
+    
+    for(u32 Action = 0; Action < STARTUP_ACTIONS_COUNT; Action++)
+    {
+        u64 End = StartupTimestamps.Timestamps[Action];
+        if(!End) continue;
+        WriteStartupTraceEvent(File, "startup", StartupActionNames[Action], GetStartupActionBegin(Action), End,
+                               StartupTimestamps.Threads[Action], 0, 0);
+    }
+    
+    u32 Count = MIN(StartupTimestamps.EventsCount, MAX_STARTUP_TRACE_EVENTS);
+    for(u32 Index = 0; Index < Count; Index++)
+    {
+        startup_trace_event* Event = &StartupTimestamps.Events[Index];
+        if(!Event->Recorded) continue;
+        WriteStartupTraceEvent(File, Event->Category, Event->Name, Event->Begin, Event->End, Event->Thread,
+                               Event->BytesRead, Event->BytesUploaded);
+    }
+    
+    fprintf(File, "\n]}\n");
+    return fclose(File) == 0;
+}
@@ -0,0 +1,1173 @@
+// Block compression of 8 bit images for the packer, BC1, BC3, BC4, BC5 and BC7, and of
+// float cubemaps to BC6H.
+// Every encoder fits the endpoints along the principal axis of the block, picks the
+// indices with an SSE search over the palette and refines the endpoints with a least
+// squares fit on those indices. BC7 only uses mode 6 (one subset, RGBA endpoints with
+// p-bits, 4 bit indices), which is a good quality/speed tradeoff for a single subset.
+// BC6H only uses mode 11 (one region, 10 bit RGB endpoints, 4 bit indices) for the same
+// reason, fitted on the bits of the halves so that the error is relative to the value.
+// The decoders are here to measure the quality of the encoders, the BC7 one only
+// understands mode 6 blocks. The BC6H one is in image.cpp, the runtime needs it too.
+
+struct bc_block
+{
+    //Structure of arrays of the 16 pixels, values are in the 0-255 range
+    alignas(16) f32 Channels[4][16];
+};
+
+//Palette entries past the used ones are set to this so that they are never picked
+#define BC_PALETTE_UNUSED 1.0e15f
+
+global_variable u8 BC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+//Pixels outside of the image repeat the last row and column
+internal void
+LoadBlock(u8* Data, s32 Width, s32 Height, s32 BytesPerPixel, s32 BlockX, s32 BlockY, bc_block* Block)
+{
+    for(s32 Pixel = 0; Pixel < 16; Pixel++)
+    {
+        s32 x = MIN(BlockX * 4 + (Pixel & 3), Width - 1);
+        s32 y = MIN(BlockY * 4 + (Pixel >> 2), Height - 1);
+        u8* Source = Data + ((u64)y * Width + x) * BytesPerPixel;
+        
+        Block->Channels[0][Pixel] = Source[0];
+        Block->Channels[1][Pixel] = BytesPerPixel > 1 ? Source[1] : 0.0f;
+        Block->Channels[2][Pixel] = BytesPerPixel > 2 ? Source[2] : 0.0f;
+        Block->Channels[3][Pixel] = BytesPerPixel > 3 ? Source[3] : 255.0f;
+    }
+}
+
+//Finds the closest palette entry to each pixel using channels [FirstChannel, FirstChannel + ChannelsCount),
+//returns the total squared error
+internal f32
+FindClosestPaletteEntries(bc_block* Block, f32 Palette[4][16], u32 PaletteCount, u32 FirstChannel, u32 ChannelsCount, u8* Indices)
+{
+    u32 VectorsCount = (PaletteCount + 3) / 4;
+    __m128 LaneIndices = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    
+    f32 TotalError = 0.0f;
+    for(u32 Pixel = 0; Pixel < 16; Pixel++)
+    {
+        __m128 BestError = _mm_set1_ps(FLT_MAX);
+        __m128 BestIndex = _mm_setzero_ps();
+        for(u32 Vector = 0; Vector < VectorsCount; Vector++)
+        {
+            __m128 Error = _mm_setzero_ps();
+            for(u32 Channel = FirstChannel; Channel < FirstChannel + ChannelsCount; Channel++)
+            {
+                __m128 Difference = _mm_sub_ps(_mm_load_ps(&Palette[Channel][Vector * 4]), _mm_set1_ps(Block->Channels[Channel][Pixel]));
+                Error = _mm_add_ps(Error, _mm_mul_ps(Difference, Difference));
+            }
+            
+            __m128 Index = _mm_add_ps(_mm_set1_ps((f32)(Vector * 4)), LaneIndices);
+            __m128 Better = _mm_cmplt_ps(Error, BestError);
+            BestError = _mm_or_ps(_mm_and_ps(Better, Error), _mm_andnot_ps(Better, BestError));
+            BestIndex = _mm_or_ps(_mm_and_ps(Better, Index), _mm_andnot_ps(Better, BestIndex));
+        }
+        
+        alignas(16) f32 Errors[4];
+        alignas(16) f32 LaneBest[4];
+        _mm_store_ps(Errors, BestError);
+        _mm_store_ps(LaneBest, BestIndex);
+        
+        u32 Best = 0;
+        for(u32 Lane = 1; Lane < 4; Lane++)
+        {
+            if(Errors[Lane] < Errors[Best] || (Errors[Lane] == Errors[Best] && LaneBest[Lane] < LaneBest[Best]))
+            {
+                Best = Lane;
+            }
+        }
+        Indices[Pixel] = (u8)LaneBest[Best];
+        TotalError += Errors[Best];
+    }
+    
+    return TotalError;
+}
+
+//Mean and direction of largest variance of the block, by power iteration on the covariance
+internal void
+ComputePrincipalAxis(bc_block* Block, u32 FirstChannel, u32 ChannelsCount, f32* Mean, f32* Axis)
+{
+    f32 Covariance[4][4] = {};
+    for(u32 i = 0; i < ChannelsCount; i++)
+    {
+        f32 Sum = 0.0f;
+        for(u32 Pixel = 0; Pixel < 16; Pixel++)
+        {
+            Sum += Block->Channels[FirstChannel + i][Pixel];
+        }
+        Mean[i] = Sum / 16.0f;
+    }
+    
+    for(u32 Pixel = 0; Pixel < 16; Pixel++)
+    {
+        for(u32 i = 0; i < ChannelsCount; i++)
+        {
+            for(u32 j = 0; j < ChannelsCount; j++)
+            {
+                Covariance[i][j] += (Block->Channels[FirstChannel + i][Pixel] - Mean[i]) *
+                    (Block->Channels[FirstChannel + j][Pixel] - Mean[j]);
+            }
+        }
+    }
+    
+    for(u32 i = 0; i < ChannelsCount; i++)
+    {
+        Axis[i] = 1.0f;
+    }
+    for(u32 Iteration = 0; Iteration < 8; Iteration++)
+    {
+        f32 Next[4] = {};
+        f32 LengthSquared = 0.0f;
+        for(u32 i = 0; i < ChannelsCount; i++)
+        {
+            for(u32 j = 0; j < ChannelsCount; j++)
+            {
+                Next[i] += Covariance[i][j] * Axis[j];
+            }
+            LengthSquared += Next[i] * Next[i];
+        }
+        
+        if(LengthSquared < 1.0e-12f)
+        {
+            //Flat block
+            for(u32 i = 0; i < ChannelsCount; i++) Axis[i] = 0.0f;
+            return;
+        }
+        
+        f32 InverseLength = 1.0f / sqrtf(LengthSquared);
+        for(u32 i = 0; i < ChannelsCount; i++)
+        {
+            Axis[i] = Next[i] * InverseLength;
+        }
+    }
+}
+
+//Endpoints at the extremes of the projection of the pixels on the principal axis
+internal void
+ComputeAxisEndpoints(bc_block* Block, u32 FirstChannel, u32 ChannelsCount, f32* E0, f32* E1)
+{
+    f32 Mean[4], Axis[4];
+    ComputePrincipalAxis(Block, FirstChannel, ChannelsCount, Mean, Axis);
+    
+    f32 Min = FLT_MAX;
+    f32 Max = -FLT_MAX;
+    for(u32 Pixel = 0; Pixel < 16; Pixel++)
+    {
+        f32 Projection = 0.0f;
+        for(u32 i = 0; i < ChannelsCount; i++)
+        {
+            Projection += (Block->Channels[FirstChannel + i][Pixel] - Mean[i]) * Axis[i];
+        }
+        Min = MIN(Min, Projection);
+        Max = MAX(Max, Projection);
+    }
+    
+    for(u32 i = 0; i < ChannelsCount; i++)
+    {
+        E0[i] = Clamp(Mean[i] + Axis[i] * Min, 0.0f, 255.0f);
+        E1[i] = Clamp(Mean[i] + Axis[i] * Max, 0.0f, 255.0f);
+    }
+}
+
+//Least squares endpoints given the weight of E1 for every pixel, returns false if the
+//weights don't determine both endpoints
+internal b32
+FitEndpoints(bc_block* Block, u32 FirstChannel, u32 ChannelsCount, f32* Weights, f32* E0, f32* E1)
+{
+    f32 A = 0.0f, B = 0.0f, C = 0.0f;
+    for(u32 Pixel = 0; Pixel < 16; Pixel++)
+    {
+        f32 w = Weights[Pixel];
+        A += (1.0f - w) * (1.0f - w);
+        B += (1.0f - w) * w;
+        C += w * w;
+    }
+    
+    f32 Determinant = A * C - B * B;
+    if(fabsf(Determinant) < 1.0e-6f)
+    {
+        return false;
+    }
+    
+    for(u32 i = 0; i < ChannelsCount; i++)
+    {
+        f32 X = 0.0f, Y = 0.0f;
+        for(u32 Pixel = 0; Pixel < 16; Pixel++)
+        {
+            f32 Value = Block->Channels[FirstChannel + i][Pixel];
+            X += (1.0f - Weights[Pixel]) * Value;
+            Y += Weights[Pixel] * Value;
+        }
+        E0[i] = Clamp((C * X - B * Y) / Determinant, 0.0f, 255.0f);
+        E1[i] = Clamp((A * Y - B * X) / Determinant, 0.0f, 255.0f);
+    }
+    return true;
+}
+
+internal void
+ClearPalette(f32 Palette[4][16])
+{
+    for(u32 Channel = 0; Channel < 4; Channel++)
+    {
+        for(u32 Entry = 0; Entry < 16; Entry++)
+        {
+            Palette[Channel][Entry] = BC_PALETTE_UNUSED;
+        }
+    }
+}
+
+//BC1
+
+internal u16
+PackRGB565(f32* Color)
+{
+    u32 R = (u32)(Clamp(Color[0], 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+    u32 G = (u32)(Clamp(Color[1], 0.0f, 255.0f) * 63.0f / 255.0f + 0.5f);
+    u32 B = (u32)(Clamp(Color[2], 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+    return (u16)((R << 11) | (G << 5) | B);
+}
+
+internal void
+UnpackRGB565(u16 Color, u8* Result)
+{
+    u32 R = (Color >> 11) & 31;
+    u32 G = (Color >> 5) & 63;
+    u32 B = Color & 31;
+    Result[0] = (u8)((R << 3) | (R >> 2));
+    Result[1] = (u8)((G << 2) | (G >> 4));
+    Result[2] = (u8)((B << 3) | (B >> 2));
+}
+
+//Always the 4 color mode, Color0 must be greater than Color1 for BC1 to decode it as such
+internal void
+GetBC1Palette(u16 Color0, u16 Color1, u8 Palette[4][4])
+{
+    UnpackRGB565(Color0, Palette[0]);
+    UnpackRGB565(Color1, Palette[1]);
+    for(u32 Channel = 0; Channel < 3; Channel++)
+    {
+        Palette[2][Channel] = (u8)((2 * Palette[0][Channel] + Palette[1][Channel] + 1) / 3);
+        Palette[3][Channel] = (u8)((Palette[0][Channel] + 2 * Palette[1][Channel] + 1) / 3);
+    }
+    for(u32 Entry = 0; Entry < 4; Entry++)
+    {
+        Palette[Entry][3] = 255;
+    }
+}
+
+internal void
+EncodeBC1Block(bc_block* Block, u8* Out)
+{
+    f32 E0[3], E1[3];
+    ComputeAxisEndpoints(Block, 0, 3, E0, E1);
+    
+    alignas(16) f32 Palette[4][16];
+    ClearPalette(Palette);
+    
+    f32 BestError = FLT_MAX;
+    u16 BestColor0 = 0, BestColor1 = 0;
+    u8 BestIndices[16] = {};
+    for(u32 Iteration = 0; Iteration < 3; Iteration++)
+    {
+        u16 Color0 = PackRGB565(E1);
+        u16 Color1 = PackRGB565(E0);
+        if(Color0 < Color1)
+        {
+            u16 Swap = Color0;
+            Color0 = Color1;
+            Color1 = Swap;
+        }
+        
+        u8 Colors[4][4];
+        GetBC1Palette(Color0, Color1, Colors);
+        for(u32 Entry = 0; Entry < 4; Entry++)
+        {
+            for(u32 Channel = 0; Channel < 3; Channel++)
+            {
+                Palette[Channel][Entry] = Colors[Entry][Channel];
+            }
+        }
+        
+        u8 Indices[16];
+        f32 Error = FindClosestPaletteEntries(Block, Palette, 4, 0, 3, Indices);
+        if(Color0 == Color1)
+        {
+            //The block would decode in 3 color mode, use only the first color
+            memset(Indices, 0, sizeof(Indices));
+        }
+        
+        if(Error < BestError)
+        {
+            BestError = Error;
+            BestColor0 = Color0;
+            BestColor1 = Color1;
+            memcpy(BestIndices, Indices, sizeof(Indices));
+        }
+        
+        //Weights of Color1 for each index
+        local_persist f32 IndexWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+        f32 Weights[16];
+        for(u32 Pixel = 0; Pixel < 16; Pixel++)
+        {
+            Weights[Pixel] = IndexWeights[Indices[Pixel]];
+        }
+        if(!FitEndpoints(Block, 0, 3, Weights, E1, E0))
+        {
+            break;
+        }
+    }
+    
+    u32 IndexBits = 0;
+    for(u32 Pixel = 0; Pixel < 16; Pixel++)
+    {
+        IndexBits |= (u32)BestIndices[Pixel] << (2 * Pixel);
+    }
+    memcpy(Out, &BestColor0, 2);
+    memcpy(Out + 2, &BestColor1, 2);
+    memcpy(Out + 4, &IndexBits, 4);
+}
+
+internal void
+DecodeBC1Block(u8* Block, u8 Pixels[16][4], b32 AlwaysFourColors = false)
+{
+    u16 Color0, Color1;
+    u32 IndexBits;
+    memcpy(&Color0, Block, 2);
+    memcpy(&Color1, Block + 2, 2);
+    memcpy(&IndexBits, Block + 4, 4);
+    
+    u8 Palette[4][4];
+    GetBC1Palette(Color0, Color1, Palette);
+    if(Color0 <= Color1 && !AlwaysFourColors)
+    {
+        //3 color mode with transparent black
+        for(u32 Channel = 0; Channel < 3; Channel++)
+        {
+            Palette[2][Channel] = (u8)((Palette[0][Channel] + Palette[1][Channel]) / 2);
+        }
+        memset(Palette[3], 0, 4);
+    }
+    
+    for(u32 Pixel = 0; Pixel < 16; Pixel++)
+    {
+        memcpy(Pixels[Pixel], Palette[(IndexBits >> (2 * Pixel)) & 3], 4);
+    }
+}
+
+//BC4
+
+//8 values mode, Value0 must be greater than Value1
+internal void
+GetBC4Palette(u8 Value0, u8 Value1, u8* Palette)
+{
+    Palette[0] = Value0;
+    Palette[1] = Value1;
+    if(Value0 > Value1)
+    {
+        for(u32 Index = 1; Index < 7; Index++)
+        {
+            Palette[Index + 1] = (u8)(((7 - Index) * Value0 + Index * Value1 + 3) / 7);
+        }
+    }
+    else
+    {
+        for(u32 Index = 1; Index < 5; Index++)
+        {
+            Palette[Index + 1] = (u8)(((5 - Index) * Value0 + Index * Value1 + 2) / 5);
+        }
+        Palette[6] = 0;
+        Palette[7] = 255;
+    }
+}
+
+internal void
+EncodeBC4Block(bc_block* Block, u32 Channel, u8* Out)
+{
+    f32 Min = 255.0f;
+    f32 Max = 0.0f;
+    for(u32 Pixel = 0; Pixel < 16; Pixel++)
+    {
+        Min = MIN(Min, Block->Channels[Channel][Pixel]);
+        Max = MAX(Max, Block->Channels[Channel][Pixel]);
+    }
+    
+    alignas(16) f32 Palette[4][16];
+    ClearPalette(Palette);
+    
+    f32 E0 = Max;
+    f32 E1 = Min;
+    f32 BestError = FLT_MAX;
+    u8 BestValue0 = 0, BestValue1 = 0;
+    u8 BestIndices[16] = {};
+    for(u32 Iteration = 0; Iteration < 2; Iteration++)
+    {
+        u8 Value0 = (u8)(E0 + 0.5f);
+        u8 Value1 = (u8)(E1 + 0.5f);
+        if(Value0 < Value1)
+        {
+            u8 Swap = Value0;
+            Value0 = Value1;
+            Value1 = Swap;
+        }
+        
+        u8 Values[8];
+        GetBC4Palette(Value0, Value1, Values);
+        u32 PaletteCount = Value0 > Value1 ? 8 : 1;
+        for(u32 Entry = 0; Entry < PaletteCount; Entry++)
+        {
+            Palette[Channel][Entry] = Values[Entry];
+        }
+        
+        u8 Indices[16];
+        f32 Error = FindClosestPaletteEntries(Block, Palette, PaletteCount, Channel, 1, Indices);
+        if(Error < BestError)
+        {
+            BestError = Error;
+            BestValue0 = Value0;
+            BestValue1 = Value1;
+            memcpy(BestIndices, Indices, sizeof(Indices));
+        }
+        if(Value0 == Value1)
+        {
+            break;
+        }
+        
+        //Weights of Value1 for each index
+        f32 Weights[16];
+        for(u32 Pixel = 0; Pixel < 16; Pixel++)
+        {
+            u32 Index = Indices[Pixel];
+            Weights[Pixel] = Index == 0 ? 0.0f : Index == 1 ? 1.0f : (Index - 1) / 7.0f;
+        }
+        if(!FitEndpoints(Block, Channel, 1, Weights, &E0, &E1))
+        {
+            break;
+        }
+    }
+    
+    u64 IndexBits = 0;
+    for(u32 Pixel = 0; Pixel < 16; Pixel++)
+    {
+        IndexBits |= (u64)BestIndices[Pixel] << (3 * Pixel);
+    }
+    Out[0] = BestValue0;
+    Out[1] = BestValue1;
+    memcpy(Out + 2, &IndexBits, 6);
+}
+
+internal void
+DecodeBC4Block(u8* Block, u8 Pixels[16][4], u32 Channel)
+{
+    u8 Palette[8];
+    GetBC4Palette(Block[0], Block[1], Palette);
+    
+    u64 IndexBits = 0;
+    memcpy(&IndexBits, Block + 2, 6);
+    for(u32 Pixel = 0; Pixel < 16; Pixel++)
+    {
+        Pixels[Pixel][Channel] = Palette[(IndexBits >> (3 * Pixel)) & 7];
+    }
+}
+
+//BC7 mode 6
+
+struct bc7_bit_stream
+{
+    u8* Data;
+    u32 Position;
+};
+
+internal void
+WriteBits(bc7_bit_stream* Stream, u32 Value, u32 BitsCount)
+{
+    for(u32 Bit = 0; Bit < BitsCount; Bit++, Stream->Position++)
+    {
+        Stream->Data[Stream->Position >> 3] |= (u8)(((Value >> Bit) & 1) << (Stream->Position & 7));
+    }
+}
+
+internal u32
+ReadBits(bc7_bit_stream* Stream, u32 BitsCount)
+{
+    u32 Result = 0;
+    for(u32 Bit = 0; Bit < BitsCount; Bit++, Stream->Position++)
+    {
+        Result |= (u32)((Stream->Data[Stream->Position >> 3] >> (Stream->Position & 7)) & 1) << Bit;
+    }
+    return Result;
+}
+
+internal void
+GetBC7Mode6Palette(u8* Endpoint0, u8* Endpoint1, u8 Palette[16][4])
+{
+    for(u32 Index = 0; Index < 16; Index++)
+    {
+        u32 w = BC7Weights4[Index];
+        for(u32 Channel = 0; Channel < 4; Channel++)
+        {
+            Palette[Index][Channel] = (u8)(((64 - w) * Endpoint0[Channel] + w * Endpoint1[Channel] + 32) >> 6);
+        }
+    }
+}
+
+internal void
+EncodeBC7Block(bc_block* Block, u8* Out)
+{
+    f32 E0[4], E1[4];
+    ComputeAxisEndpoints(Block, 0, 4, E0, E1);
+    
+    alignas(16) f32 Palette[4][16];
+    f32 BestError = FLT_MAX;
+    u8 BestQuantized[2][4] = {};
+    u8 BestPBits[2] = {};
+    u8 BestIndices[16] = {};
+    for(u32 Iteration = 0; Iteration < 3; Iteration++)
+    {
+        //Endpoints are 7 bits per channel plus a shared lowest bit per endpoint
+        b32 Improved = false;
+        u8 Indices[16];
+        for(u32 PBits = 0; PBits < 4; PBits++)
+        {
+            u8 P0 = PBits & 1;
+            u8 P1 = PBits >> 1;
+            u8 Quantized[2][4];
+            u8 Endpoint0[4], Endpoint1[4];
+            for(u32 Channel = 0; Channel < 4; Channel++)
+            {
+                Quantized[0][Channel] = (u8)Clamp((E0[Channel] - P0) * 0.5f + 0.5f, 0.0f, 127.0f);
+                Quantized[1][Channel] = (u8)Clamp((E1[Channel] - P1) * 0.5f + 0.5f, 0.0f, 127.0f);
+                Endpoint0[Channel] = (u8)((Quantized[0][Channel] << 1) | P0);
+                Endpoint1[Channel] = (u8)((Quantized[1][Channel] << 1) | P1);
+            }
+            
+            u8 Colors[16][4];
+            GetBC7Mode6Palette(Endpoint0, Endpoint1, Colors);
+            for(u32 Entry = 0; Entry < 16; Entry++)
+            {
+                for(u32 Channel = 0; Channel < 4; Channel++)
+                {
+                    Palette[Channel][Entry] = Colors[Entry][Channel];
+                }
+            }
+            
+            f32 Error = FindClosestPaletteEntries(Block, Palette, 16, 0, 4, Indices);
+            if(Error < BestError)
+            {
+                BestError = Error;
+                memcpy(BestQuantized, Quantized, sizeof(Quantized));
+                BestPBits[0] = P0;
+                BestPBits[1] = P1;
+                memcpy(BestIndices, Indices, sizeof(Indices));
+                Improved = true;
+            }
+        }
+        
+        if(!Improved || BestError == 0.0f)
+        {
+            break;
+        }
+        
+        f32 Weights[16];
+        for(u32 Pixel = 0; Pixel < 16; Pixel++)
+        {
+            Weights[Pixel] = BC7Weights4[BestIndices[Pixel]] / 64.0f;
+        }
+        if(!FitEndpoints(Block, 0, 4, Weights, E0, E1))
+        {
+            break;
+        }
+    }
+    
+    //The highest bit of the first index is implicitly 0, swap the endpoints if needed
+    if(BestIndices[0] & 8)
+    {
+        for(u32 Channel = 0; Channel < 4; Channel++)
+        {
+            u8 Swap = BestQuantized[0][Channel];
+            BestQuantized[0][Channel] = BestQuantized[1][Channel];
+            BestQuantized[1][Channel] = Swap;
+        }
+        u8 Swap = BestPBits[0];
+        BestPBits[0] = BestPBits[1];
+        BestPBits[1] = Swap;
+        for(u32 Pixel = 0; Pixel < 16; Pixel++)
+        {
+            BestIndices[Pixel] = 15 - BestIndices[Pixel];
+        }
+    }
+    
+    memset(Out, 0, 16);
+    bc7_bit_stream Stream = { Out, 0 };
+    WriteBits(&Stream, 1 << 6, 7);
+    for(u32 Channel = 0; Channel < 4; Channel++)
+    {
+        WriteBits(&Stream, BestQuantized[0][Channel], 7);
+        WriteBits(&Stream, BestQuantized[1][Channel], 7);
+    }
+    WriteBits(&Stream, BestPBits[0], 1);
+    WriteBits(&Stream, BestPBits[1], 1);
+    for(u32 Pixel = 0; Pixel < 16; Pixel++)
+    {
+        WriteBits(&Stream, BestIndices[Pixel], Pixel == 0 ? 3 : 4);
+    }
+    Assert(Stream.Position == 128);
+}
+
+//Returns false for modes other than 6, the block is decoded as magenta
+internal b32
+DecodeBC7Block(u8* Block, u8 Pixels[16][4])
+{
+    if((Block[0] & 0x7F) != (1 << 6))
+    {
+        for(u32 Pixel = 0; Pixel < 16; Pixel++)
+        {
+            Pixels[Pixel][0] = 255;
+            Pixels[Pixel][1] = 0;
+            Pixels[Pixel][2] = 255;
+            Pixels[Pixel][3] = 255;
+        }
+        return false;
+    }
+    
+    bc7_bit_stream Stream = { Block, 7 };
+    u8 Endpoint0[4], Endpoint1[4];
+    for(u32 Channel = 0; Channel < 4; Channel++)
+    {
+        Endpoint0[Channel] = (u8)(ReadBits(&Stream, 7) << 1);
+        Endpoint1[Channel] = (u8)(ReadBits(&Stream, 7) << 1);
+    }
+    u32 P0 = ReadBits(&Stream, 1);
+    u32 P1 = ReadBits(&Stream, 1);
+    for(u32 Channel = 0; Channel < 4; Channel++)
+    {
+        Endpoint0[Channel] |= P0;
+        Endpoint1[Channel] |= P1;
+    }
+    
+    u8 Palette[16][4];
+    GetBC7Mode6Palette(Endpoint0, Endpoint1, Palette);
+    for(u32 Pixel = 0; Pixel < 16; Pixel++)
+    {
+        memcpy(Pixels[Pixel], Palette[ReadBits(&Stream, Pixel == 0 ? 3 : 4)], 4);
+    }
+    return true;
+}
+
+//BC6H mode 11
+
+//Halves are scaled to the 0-255 range of the helpers above, the same scale as the
+//unquantized endpoints
+#define BC6H_HALF_TO_BLOCK (64.0f / 31.0f / 257.0f)
+
+//Pixels outside of the face repeat the last row and column, negative values go to 0
+internal void
+LoadHDRBlock(f32* Data, s32 Size, s32 BlockX, s32 BlockY, bc_block* Block)
+{
+    for(s32 Pixel = 0; Pixel < 16; Pixel++)
+    {
+        s32 x = MIN(BlockX * 4 + (Pixel & 3), Size - 1);
+        s32 y = MIN(BlockY * 4 + (Pixel >> 2), Size - 1);
+        __m128 Value = _mm_max_ps(_mm_loadu_ps(Data + ((u64)y * Size + x) * 4), _mm_setzero_ps());
+        
+        //The largest half is 0x7BFF, infinities and NaNs are clamped to it
+        alignas(16) s32 Halves[4];
+        _mm_store_si128((__m128i*)Halves, _mm_min_epi32(ConvertF32ToF16x4(Value), _mm_set1_epi32(0x7BFF)));
+        for(u32 Channel = 0; Channel < 3; Channel++)
+        {
+            Block->Channels[Channel][Pixel] = Halves[Channel] * BC6H_HALF_TO_BLOCK;
+        }
+        Block->Channels[3][Pixel] = 0.0f;
+    }
+}
+
+//Inverse of UnquantizeBC6HEndpoint for a value in the block scale
+internal u32
+QuantizeBC6HEndpoint(f32 Value)
+{
+    f32 Unquantized = Value * 257.0f;
+    return (u32)Clamp((Unquantized - 32.0f) / 64.0f + 0.5f, 0.0f, 1023.0f);
+}
+
+internal void
+EncodeBC6HBlock(bc_block* Block, u8* Out)
+{
+    f32 E0[3], E1[3];
+    ComputeAxisEndpoints(Block, 0, 3, E0, E1);
+    
+    alignas(16) f32 Palette[4][16];
+    ClearPalette(Palette);
+    f32 BestError = FLT_MAX;
+    u32 BestQuantized[2][3] = {};
+    u8 BestIndices[16] = {};
+    for(u32 Iteration = 0; Iteration < 3; Iteration++)
+    {
+        u32 Quantized[2][3];
+        for(u32 Channel = 0; Channel < 3; Channel++)
+        {
+            Quantized[0][Channel] = QuantizeBC6HEndpoint(E0[Channel]);
+            Quantized[1][Channel] = QuantizeBC6HEndpoint(E1[Channel]);
+        }
+        
+        u16 Colors[16][3];
+        GetBC6HMode11Palette(Quantized[0], Quantized[1], Colors);
+        for(u32 Entry = 0; Entry < 16; Entry++)
+        {
+            for(u32 Channel = 0; Channel < 3; Channel++)
+            {
+                Palette[Channel][Entry] = Colors[Entry][Channel] * BC6H_HALF_TO_BLOCK;
+            }
+        }
+        
+        u8 Indices[16];
+        f32 Error = FindClosestPaletteEntries(Block, Palette, 16, 0, 3, Indices);
+        if(Error >= BestError)
+        {
+            break;
+        }
+        BestError = Error;
+        memcpy(BestQuantized, Quantized, sizeof(Quantized));
+        memcpy(BestIndices, Indices, sizeof(Indices));
+        if(BestError == 0.0f)
+        {
+            break;
+        }
+        
+        f32 Weights[16];
+        for(u32 Pixel = 0; Pixel < 16; Pixel++)
+        {
+            Weights[Pixel] = BC6HWeights4[BestIndices[Pixel]] / 64.0f;
+        }
+        if(!FitEndpoints(Block, 0, 3, Weights, E0, E1))
+        {
+            break;
+        }
+    }
+    
+    //The highest bit of the first index is implicitly 0, swap the endpoints if needed
+    if(BestIndices[0] & 8)
+    {
+        for(u32 Channel = 0; Channel < 3; Channel++)
+        {
+            u32 Swap = BestQuantized[0][Channel];
+            BestQuantized[0][Channel] = BestQuantized[1][Channel];
+            BestQuantized[1][Channel] = Swap;
+        }
+        for(u32 Pixel = 0; Pixel < 16; Pixel++)
+        {
+            BestIndices[Pixel] = 15 - BestIndices[Pixel];
+        }
+    }
+    
+    memset(Out, 0, 16);
+    bc7_bit_stream Stream = { Out, 0 };
+    WriteBits(&Stream, BC6H_MODE_11, 5);
+    for(u32 Endpoint = 0; Endpoint < 2; Endpoint++)
+    {
+        for(u32 Channel = 0; Channel < 3; Channel++)
+        {
+            WriteBits(&Stream, BestQuantized[Endpoint][Channel], 10);
+        }
+    }
+    for(u32 Pixel = 0; Pixel < 16; Pixel++)
+    {
+        WriteBits(&Stream, BestIndices[Pixel], Pixel == 0 ? 3 : 4);
+    }
+    Assert(Stream.Position == 128);
+}
+
+//Images
+
+internal void
+EncodeBlock(image_block_format Format, bc_block* Block, u8* Out)
+{
+    switch(Format)
+    {
+        case IMAGE_BC1: EncodeBC1Block(Block, Out); break;
+        case IMAGE_BC3: EncodeBC4Block(Block, 3, Out); EncodeBC1Block(Block, Out + 8); break;
+        case IMAGE_BC4: EncodeBC4Block(Block, 0, Out); break;
+        case IMAGE_BC5: EncodeBC4Block(Block, 0, Out); EncodeBC4Block(Block, 1, Out + 8); break;
+        case IMAGE_BC7: EncodeBC7Block(Block, Out); break;
+        default: InvalidCodePath;
+    }
+}
+
+//Decodes to RGBA, channels not in the format are 0 and alpha 255
+internal void
+DecodeBlock(image_block_format Format, u8* Block, u8 Pixels[16][4])
+{
+    for(u32 Pixel = 0; Pixel < 16; Pixel++)
+    {
+        Pixels[Pixel][0] = Pixels[Pixel][1] = Pixels[Pixel][2] = 0;
+        Pixels[Pixel][3] = 255;
+    }
+    
+    switch(Format)
+    {
+        case IMAGE_BC1: DecodeBC1Block(Block, Pixels); break;
+        case IMAGE_BC3: DecodeBC1Block(Block + 8, Pixels, true); DecodeBC4Block(Block, Pixels, 3); break;
+        case IMAGE_BC4: DecodeBC4Block(Block, Pixels, 0); break;
+        case IMAGE_BC5: DecodeBC4Block(Block, Pixels, 0); DecodeBC4Block(Block + 8, Pixels, 1); break;
+        case IMAGE_BC7: DecodeBC7Block(Block, Pixels); break;
+        default: InvalidCodePath;
+    }
+}
+
+struct block_compression_job
+{
+    image_block_format Format;
+    u8* Source;
+    s32 Width;
+    s32 Height;
+    s32 BytesPerPixel;
+    u8* Dest;
+    u32 DestPitch;
+    u32 FirstRow;
+    u32 RowsCount;
+    
+    volatile u32* Counter;
+};
+
+internal void
+CompressBlockRowsWork(void* Data)
+{
+    block_compression_job* Job = (block_compression_job*)Data;
+    u32 BlockSize = GetImageBlockSize(Job->Format);
+    u32 BlocksPerRow = (Job->Width + 3) / 4;
+    
+    bc_block Block;
+    for(u32 Row = Job->FirstRow; Row < Job->FirstRow + Job->RowsCount; Row++)
+    {
+        for(u32 Column = 0; Column < BlocksPerRow; Column++)
+        {
+            LoadBlock(Job->Source, Job->Width, Job->Height, Job->BytesPerPixel, Column, Row, &Block);
+            EncodeBlock(Job->Format, &Block, Job->Dest + (u64)Row * Job->DestPitch + Column * BlockSize);
+        }
+    }
+    
+    if(Job->Counter)
+    {
+        Platform_AtomicAdd(Job->Counter, (u32)-1);
+    }
+}
+
+#define BLOCK_COMPRESSION_ROWS_PER_JOB 8
+
+//Compresses every mip of an 8 bit image, rows of blocks are split in jobs on the queue
+//which the calling thread helps with. Without a queue everything runs on the calling thread
+internal image_data
+CompressImage(work_queue* Queue, image_data* Image, image_block_format Format)
+{
+    Assert(Image->BlockFormat == IMAGE_UNCOMPRESSED && Image->BytesPerPixel <= 4);
+    Assert(Image->Pitch == Image->Width * Image->BytesPerPixel);
+    
+    image_data Result = {};
+    Result.Width = Image->Width;
+    Result.Height = Image->Height;
+    Result.BytesPerPixel = Image->BytesPerPixel;
+    Result.NumberOfMips = Image->NumberOfMips ? Image->NumberOfMips : 1;
+    Result.BlockFormat = Format;
+    Result.Pitch = GetImageLevelPitch(Image->Width, Image->BytesPerPixel, Format, 0);
+    Result.Data = (u8*)ZeroAlloc(GetImageMipChainSize(Result.Width, Result.Height, Result.BytesPerPixel, Result.NumberOfMips, Format));
+    
+    u32 JobsCount = 0;
+    for(u32 Mip = 0; Mip < Result.NumberOfMips; Mip++)
+    {
+        u32 Rows = GetImageLevelRows(Image->Height, Format, Mip);
+        JobsCount += (Rows + BLOCK_COMPRESSION_ROWS_PER_JOB - 1) / BLOCK_COMPRESSION_ROWS_PER_JOB;
+    }
+    block_compression_job* Jobs = (block_compression_job*)ZeroAlloc(sizeof(block_compression_job) * JobsCount);
+    
+    volatile u32 Counter = 0;
+    u32 JobIndex = 0;
+    u8* Source = Image->Data;
+    u8* Dest = Result.Data;
+    for(u32 Mip = 0; Mip < Result.NumberOfMips; Mip++)
+    {
+        s32 Width = MAX(Image->Width >> Mip, 1);
+        s32 Height = MAX(Image->Height >> Mip, 1);
+        u32 DestPitch = GetImageLevelPitch(Image->Width, Image->BytesPerPixel, Format, Mip);
+        u32 Rows = GetImageLevelRows(Image->Height, Format, Mip);
+        
+        for(u32 Row = 0; Row < Rows; Row += BLOCK_COMPRESSION_ROWS_PER_JOB)
+        {
+            block_compression_job* Job = &Jobs[JobIndex++];
+            Job->Format = Format;
+            Job->Source = Source;
+            Job->Width = Width;
+            Job->Height = Height;
+            Job->BytesPerPixel = Image->BytesPerPixel;
+            Job->Dest = Dest;
+            Job->DestPitch = DestPitch;
+            Job->FirstRow = Row;
+            Job->RowsCount = MIN(BLOCK_COMPRESSION_ROWS_PER_JOB, Rows - Row);
+            
+            if(Queue)
+            {
+                Job->Counter = &Counter;
+                Platform_AtomicAdd(&Counter, 1);
+                AddWorkQueueEntry(Queue, CompressBlockRowsWork, Job);
+            }
+            else
+            {
+                CompressBlockRowsWork(Job);
+            }
+        }
+        
+        Source += (u64)Width * Height * Image->BytesPerPixel;
+        Dest += (u64)DestPitch * Rows;
+    }
+    
+    if(Queue)
+    {
+        WaitForWorkCounter(Queue, &Counter);
+    }
+    Free(Jobs);
+    
+    return Result;
+}
+
+//Decodes the first level to an RGBA image
+internal image_data
+DecompressImage(image_data* Image)
+{
+    image_data Result = {};
+    Result.Width = Image->Width;
+    Result.Height = Image->Height;
+    Result.BytesPerPixel = 4;
+    Result.Pitch = Image->Width * 4;
+    Result.NumberOfMips = 1;
+    Result.Data = (u8*)ZeroAlloc((u64)Result.Pitch * Result.Height);
+    
+    u32 BlockSize = GetImageBlockSize(Image->BlockFormat);
+    u32 Rows = GetImageLevelRows(Image->Height, Image->BlockFormat, 0);
+    u32 BlocksPerRow = (Image->Width + 3) / 4;
+    for(u32 Row = 0; Row < Rows; Row++)
+    {
+        for(u32 Column = 0; Column < BlocksPerRow; Column++)
+        {
+            u8 Pixels[16][4];
+            DecodeBlock(Image->BlockFormat, Image->Data + (u64)Row * Image->Pitch + Column * BlockSize, Pixels);
+            for(u32 Pixel = 0; Pixel < 16; Pixel++)
+            {
+                u32 x = Column * 4 + (Pixel & 3);
+                u32 y = Row * 4 + (Pixel >> 2);
+                if(x < (u32)Image->Width && y < (u32)Image->Height)
+                {
+                    memcpy(Result.Data + (u64)y * Result.Pitch + x * 4, Pixels[Pixel], 4);
+                }
+            }
+        }
+    }
+    
+    return Result;
+}
+
+//PSNR in dB over the first level of the original 8 bit image and an RGBA decoded one,
+//comparing the first ChannelsCount channels
+internal f64
+ComputeImagePSNR(image_data* Original, image_data* Decoded, u32 ChannelsCount)
+{
+    Assert(Decoded->BytesPerPixel == 4 && (s32)ChannelsCount <= Original->BytesPerPixel);
+    
+    f64 SquaredError = 0.0;
+    for(s32 y = 0; y < Original->Height; y++)
+    {
+        for(s32 x = 0; x < Original->Width; x++)
+        {
+            u8* A = Original->Data + (u64)y * Original->Pitch + x * Original->BytesPerPixel;
+            u8* B = Decoded->Data + (u64)y * Decoded->Pitch + x * 4;
+            for(u32 Channel = 0; Channel < ChannelsCount; Channel++)
+            {
+                f64 Difference = (f64)A[Channel] - (f64)B[Channel];
+                SquaredError += Difference * Difference;
+            }
+        }
+    }
+    
+    f64 MeanSquaredError = SquaredError / ((f64)Original->Width * Original->Height * ChannelsCount);
+    if(MeanSquaredError == 0.0)
+    {
+        return 99.0;
+    }
+    return 10.0 * log10(255.0 * 255.0 / MeanSquaredError);
+}
+
+//Cubemaps
+
+struct cubemap_compression_job
+{
+    f32* Source;
+    s32 Size;
+    u8* Dest;
+    u32 DestPitch;
+    u32 FirstRow;
+    u32 RowsCount;
+    
+    volatile u32* Counter;
+};
+
+internal void
+CompressCubemapRowsWork(void* Data)
+{
+    cubemap_compression_job* Job = (cubemap_compression_job*)Data;
+    u32 BlocksPerRow = (Job->Size + 3) / 4;
+    
+    bc_block Block;
+    for(u32 Row = Job->FirstRow; Row < Job->FirstRow + Job->RowsCount; Row++)
+    {
+        for(u32 Column = 0; Column < BlocksPerRow; Column++)
+        {
+            LoadHDRBlock(Job->Source, Job->Size, Column, Row, &Block);
+            EncodeBC6HBlock(&Block, Job->Dest + (u64)Row * Job->DestPitch + Column * 16);
+        }
+    }
+    
+    if(Job->Counter)
+    {
+        Platform_AtomicAdd(Job->Counter, (u32)-1);
+    }
+}
+
+//Converts every face and mip of an RGBA32F cubemap to Format. BC6H rows of blocks are split
+//in jobs like in CompressImage, the other formats are converted on the calling thread
+internal cubemap_data
+CompressCubemap(work_queue* Queue, cubemap_data* Cubemap, cubemap_format Format)
+{
+    Assert(Cubemap->Format == CUBEMAP_RGBA32F);
+    Assert(Format != CUBEMAP_BC6H || Cubemap->Size % 4 == 0);
+    
+    cubemap_data Result = {};
+    Result.Size = Cubemap->Size;
+    Result.BytesPerPixel = CubemapFormatBytesPerPixel[Format];
+    Result.Pitch = GetCubemapLevelPitch(Cubemap->Size, Format, 0);
+    Result.NumberOfMips = Cubemap->NumberOfMips ? Cubemap->NumberOfMips : 1;
+    Result.Format = Format;
+    Result.Data = (u8*)ZeroAlloc(6 * GetCubemapFaceSize(Result.Size, Format, Result.NumberOfMips));
+    
+    //Uncompressed formats have the texels in the same order
+    f32* Source = (f32*)Cubemap->Data;
+    u64 TexelsCount = 6 * GetCubemapFaceSize(Result.Size, CUBEMAP_RGBA32F, Result.NumberOfMips) / 16;
+    switch(Format)
+    {
+        case CUBEMAP_RGBA32F:
+        {
+            memcpy(Result.Data, Source, TexelsCount * 16);
+        } break;
+        
+        case CUBEMAP_RGBA16F:
+        {
+            ConvertF32ToF16Array(Source, TexelsCount * 4, (u16*)Result.Data);
+        } break;
+        
+        case CUBEMAP_R11G11B10F:
+        case CUBEMAP_RGB9E5:
+        {
+            u32* Out = (u32*)Result.Data;
+            for(u64 Index = 0; Index < TexelsCount; Index++)
+            {
+                f32* Texel = Source + Index * 4;
+                Out[Index] = Format == CUBEMAP_RGB9E5 ? ConvertF32ToRGB9E5(Texel[0], Texel[1], Texel[2]) :
+                    ConvertF32ToR11G11B10F(Texel[0], Texel[1], Texel[2]);
+            }
+        } break;
+        
+        default: break;
+    }
+    if(Format != CUBEMAP_BC6H)
+    {
+        return Result;
+    }
+    
+    u32 JobsCount = 0;
+    for(u32 Mip = 0; Mip < Result.NumberOfMips; Mip++)
+    {
+        u32 Rows = GetCubemapLevelRows(Result.Size, Format, Mip);
+        JobsCount += 6 * ((Rows + BLOCK_COMPRESSION_ROWS_PER_JOB - 1) / BLOCK_COMPRESSION_ROWS_PER_JOB);
+    }
+    cubemap_compression_job* Jobs = (cubemap_compression_job*)ZeroAlloc(sizeof(cubemap_compression_job) * JobsCount);
+    
+    volatile u32 Counter = 0;
+    u32 JobIndex = 0;
+    u8* Dest = Result.Data;
+    for(u32 Face = 0; Face < 6; Face++)
+    {
+        for(u32 Mip = 0; Mip < Result.NumberOfMips; Mip++)
+        {
+            s32 Size = MAX(Result.Size >> Mip, 1);
+            u32 DestPitch = GetCubemapLevelPitch(Result.Size, Format, Mip);
+            u32 Rows = GetCubemapLevelRows(Result.Size, Format, Mip);
+            
+            for(u32 Row = 0; Row < Rows; Row += BLOCK_COMPRESSION_ROWS_PER_JOB)
+            {
+                cubemap_compression_job* Job = &Jobs[JobIndex++];
+                Job->Source = Source;
+                Job->Size = Size;
+                Job->Dest = Dest;
+                Job->DestPitch = DestPitch;
+                Job->FirstRow = Row;
+                Job->RowsCount = MIN(BLOCK_COMPRESSION_ROWS_PER_JOB, Rows - Row);
+                
+                if(Queue)
+                {
+                    Job->Counter = &Counter;
+                    Platform_AtomicAdd(&Counter, 1);
+                    AddWorkQueueEntry(Queue, CompressCubemapRowsWork, Job);
+                }
+                else
+                {
+                    CompressCubemapRowsWork(Job);
+                }
+            }
+            
+            Source += (u64)Size * Size * 4;
+            Dest += (u64)DestPitch * Rows;
+        }
+    }
+    
+    if(Queue)
+    {
+        WaitForWorkCounter(Queue, &Counter);
+    }
+    Free(Jobs);
+    
+    return Result;
+}
+
+//PSNR in dB over the first level of every face, RGB is tone mapped with x / (1 + x) first
+//so that the error of bright texels doesn't hide the one of the dark ones
+internal f64
+ComputeCubemapPSNR(cubemap_data* Original, cubemap_data* Encoded)
+{
+    Assert(Original->Size == Encoded->Size);
+    u64 PixelsCount = (u64)Original->Size * Original->Size;
+    f32* A = (f32*)ZeroAlloc(PixelsCount * 16);
+    f32* B = (f32*)ZeroAlloc(PixelsCount * 16);
+    
+    f64 SquaredError = 0.0;
+    for(u32 Face = 0; Face < 6; Face++)
+    {
+        DecodeCubemapFace(Original, Face, A);
+        DecodeCubemapFace(Encoded, Face, B);
+        for(u64 Pixel = 0; Pixel < PixelsCount; Pixel++)
+        {
+            for(u32 Channel = 0; Channel < 3; Channel++)
+            {
+                f64 ValueA = MAX(A[Pixel * 4 + Channel], 0.0f);
+                f64 ValueB = MAX(B[Pixel * 4 + Channel], 0.0f);
+                f64 Difference = ValueA / (1.0 + ValueA) - ValueB / (1.0 + ValueB);
+                SquaredError += Difference * Difference;
+            }
+        }
+    }
+    Free(A);
+    Free(B);
+    
+    f64 MeanSquaredError = SquaredError / ((f64)PixelsCount * 6 * 3);
+    if(MeanSquaredError == 0.0)
+    {
+        return 99.0;
+    }
+    return 10.0 * log10(1.0 / MeanSquaredError);
+}
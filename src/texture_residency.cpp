@@ -0,0 +1,311 @@
+// Texture residency, keeps the memory used by material textures under a budget.
+// This is only the bookkeeping: the renderer marks textures as used while drawing and
+// applies the actions returned by UpdateTextureResidency (dropping top mips, evicting
+// or reloading textures), so the policy doesn't depend on the graphics API.
+//
+// Textures stream in progressively, they start with their smallest mips and every frame
+// they are drawn the most detailed mip needed on screen is computed from the UV footprint
+// of a pixel (see GetUVsPerPixel). Missing mips are then loaded as the budget allows.
+
+#define MAX_RESIDENT_TEXTURES 1024
+#define RESIDENCY_MAX_MIPS 16
+
+//Textures not drawn for this many frames are evicted whole, the others only lose top mips
+#define RESIDENCY_EVICT_FRAMES 600
+
+//Top mips are dropped until the largest side is this size, smaller mips always stay resident.
+//This is also the size textures are first loaded at
+#define RESIDENCY_MIN_MIP_SIZE 64
+
+enum residency_action_kind
+{
+    RESIDENCY_DROP_MIPS, //Mips above FirstMip can be released
+    RESIDENCY_EVICT,     //The whole texture can be released
+    RESIDENCY_RESTORE,   //Load the mips from FirstMip down, then call CompleteTextureRestore
+};
+
+struct residency_action
+{
+    residency_action_kind Kind;
+    u32 Texture;
+    u32 FirstMip;
+};
+
+struct resident_texture
+{
+    u64 MipBytes[RESIDENCY_MAX_MIPS];
+    u32 MipsCount;
+    u32 MaxFirstMip; //Highest FirstMip reachable by dropping mips
+    u32 Size; //Largest side of the first mip
+    
+    u32 FirstMip; //Most detailed resident mip, MipsCount if evicted
+    u32 WantedMip; //Most detailed mip needed by the draws of LastUsedFrame
+    u64 LastUsedFrame;
+    
+    b32 Restoring;
+    u32 RestoreMip;
+    
+    //Whatever the renderer needs to find the texture again
+    void* UserData;
+    u32 UserIndex;
+};
+
+struct texture_residency
+{
+    //Ids start at 1 so that 0 can mean untracked, Textures[0] is never used
+    resident_texture Textures[MAX_RESIDENT_TEXTURES];
+    u32 TexturesCount;
+    
+    u64 Budget;
+    u64 ResidentBytes; //Includes the restores in flight
+    u64 Frame;
+    
+    //Totals since InitTextureResidency, for the inspector
+    u64 DroppedBytes;
+    u64 RestoredBytes;
+};
+
+internal void
+InitTextureResidency(texture_residency* Residency, u64 Budget)
+{
+    Residency->TexturesCount = 1;
+    Residency->Budget = Budget;
+    Residency->ResidentBytes = 0;
+    Residency->Frame = 1;
+    Residency->DroppedBytes = 0;
+    Residency->RestoredBytes = 0;
+}
+
+internal u64
+GetResidentTextureBytes(resident_texture* Texture, u32 FirstMip)
+{
+    u64 Result = 0;
+    for(u32 Mip = FirstMip; Mip < Texture->MipsCount; Mip++)
+    {
+        Result += Texture->MipBytes[Mip];
+    }
+    return Result;
+}
+
+//The size is the one of the full texture, of which the mips from FirstMip down are resident.
+//Textures are added as used this frame, returns the id
+internal u32
+AddResidentTexture(texture_residency* Residency, s32 Width, s32 Height, s32 BytesPerPixel, image_block_format BlockFormat,
+                   u32 MipsCount, u32 FirstMip = 0, void* UserData = 0, u32 UserIndex = 0)
+{
+    Assert(Residency->TexturesCount < MAX_RESIDENT_TEXTURES);
+    Assert(MipsCount >= 1 && MipsCount <= RESIDENCY_MAX_MIPS && FirstMip < MipsCount);
+    
+    u32 Id = Residency->TexturesCount++;
+    resident_texture* Texture = &Residency->Textures[Id];
+    *Texture = {};
+    Texture->MipsCount = MipsCount;
+    Texture->Size = (u32)MAX(Width, Height);
+    Texture->FirstMip = FirstMip;
+    Texture->WantedMip = FirstMip;
+    Texture->LastUsedFrame = Residency->Frame;
+    Texture->UserData = UserData;
+    Texture->UserIndex = UserIndex;
+    
+    for(u32 Mip = 0; Mip < MipsCount; Mip++)
+    {
+        Texture->MipBytes[Mip] = (u64)GetImageLevelPitch(Width, BytesPerPixel, BlockFormat, Mip) *
+            GetImageLevelRows(Height, BlockFormat, Mip);
+        
+        //Block compressed textures need a top level made of whole blocks
+        s32 LevelWidth = MAX(Width >> Mip, 1);
+        s32 LevelHeight = MAX(Height >> Mip, 1);
+        b32 WholeBlocks = BlockFormat == IMAGE_UNCOMPRESSED || (LevelWidth % 4 == 0 && LevelHeight % 4 == 0);
+        if(Mip && WholeBlocks && MAX(LevelWidth, LevelHeight) >= RESIDENCY_MIN_MIP_SIZE)
+        {
+            Texture->MaxFirstMip = Mip;
+        }
+    }
+    
+    Residency->ResidentBytes += GetResidentTextureBytes(Texture, FirstMip);
+    return Id;
+}
+
+//UV distance covered by a pixel at the point of the bounds closest to the camera.
+//ProjectionScale is the e[1][1] of the projection, 1 / tan(FOV / 2), UVDensity is in UV
+//units per object space unit, see ComputeMeshUVDensity, and ObjectScale is the largest
+//scale from object to world space. 0 if the camera is inside the bounds or the density
+//is unknown, which asks for the full texture
+internal f32
+GetUVsPerPixel(vec3 BoundsMin, vec3 BoundsMax, vec3 ViewPosition, f32 ProjectionScale, f32 ViewportHeight,
+               f32 UVDensity, f32 ObjectScale)
+{
+    vec3 Closest = Clamp(ViewPosition, BoundsMin, BoundsMax);
+    f32 Distance = Length(ViewPosition - Closest);
+    f32 UnitsPerPixel = 2.0f * Distance / (ProjectionScale * ViewportHeight);
+    return ObjectScale > 0.0f ? UVDensity / ObjectScale * UnitsPerPixel : 0.0f;
+}
+
+//Called for every draw with the texture. The mip needed is the one with about a texel per
+//pixel, the most detailed one over all the draws of the frame is kept
+internal void
+MarkTextureUsed(texture_residency* Residency, u32 Id, f32 UVsPerPixel = 0.0f)
+{
+    if(!Id) return;
+    Assert(Id < Residency->TexturesCount);
+    resident_texture* Texture = &Residency->Textures[Id];
+    
+    f32 TexelsPerPixel = UVsPerPixel * Texture->Size;
+    u32 Mip = TexelsPerPixel > 1.0f ? (u32)log2f(TexelsPerPixel) : 0;
+    Mip = MIN(Mip, Texture->MipsCount - 1);
+    
+    if(Texture->LastUsedFrame != Residency->Frame || Mip < Texture->WantedMip)
+    {
+        Texture->WantedMip = Mip;
+    }
+    Texture->LastUsedFrame = Residency->Frame;
+}
+
+internal b32
+IsTextureRestoreWanted(texture_residency* Residency, resident_texture* Texture)
+{
+    return Texture->FirstMip > Texture->WantedMip && !Texture->Restoring && Texture->LastUsedFrame == Residency->Frame;
+}
+
+//Least recently used texture that can still release memory, 0 if there is none. Textures
+//drawn this frame can only release the mips they don't need, unless IncludeUsed.
+//Limit is the FirstMip the victim can go up to, MipsCount if it can be evicted
+internal u32
+FindResidencyVictim(texture_residency* Residency, b32 IncludeUsed, u32* Limit)
+{
+    u32 Result = 0;
+    for(u32 Id = 1; Id < Residency->TexturesCount; Id++)
+    {
+        resident_texture* Texture = &Residency->Textures[Id];
+        b32 Stale = Residency->Frame - Texture->LastUsedFrame >= RESIDENCY_EVICT_FRAMES;
+        b32 Used = Texture->LastUsedFrame == Residency->Frame;
+        
+        u32 TextureLimit = Texture->MaxFirstMip;
+        if(Stale)
+        {
+            TextureLimit = Texture->MipsCount;
+        }
+        else if(Used && !IncludeUsed)
+        {
+            TextureLimit = MIN(Texture->WantedMip, Texture->MaxFirstMip);
+        }
+        
+        if(!Texture->Restoring && Texture->FirstMip < TextureLimit &&
+           (!Result || Texture->LastUsedFrame < Residency->Textures[Result].LastUsedFrame))
+        {
+            Result = Id;
+            *Limit = TextureLimit;
+        }
+    }
+    return Result;
+}
+
+//Called once per frame after drawing. Textures release memory in LRU order, stale ones
+//whole and the others only the top mips needed, to get under budget and to make room for
+//the mips wanted by the textures drawn this frame, which are then loaded if they fit.
+//Textures drawn this frame only lose mips they need if those don't fit in the budget.
+//Returns the number of actions, the bookkeeping already assumes drops and evictions are
+//applied before the next call
+internal u32
+UpdateTextureResidency(texture_residency* Residency, residency_action* Actions, u32 MaxActions)
+{
+    u64 Wanted = 0;
+    for(u32 Id = 1; Id < Residency->TexturesCount; Id++)
+    {
+        resident_texture* Texture = &Residency->Textures[Id];
+        if(IsTextureRestoreWanted(Residency, Texture))
+        {
+            Wanted += GetResidentTextureBytes(Texture, Texture->WantedMip) - GetResidentTextureBytes(Texture, Texture->FirstMip);
+        }
+    }
+    
+    u32 Count = 0;
+    while(Count < MaxActions)
+    {
+        u64 Target = Residency->Budget;
+        u32 Limit = 0;
+        u32 Id = 0;
+        if(Residency->ResidentBytes + Wanted > Residency->Budget)
+        {
+            Id = FindResidencyVictim(Residency, false, &Limit);
+            Target = Residency->Budget - MIN(Wanted, Residency->Budget);
+        }
+        if(!Id && Residency->ResidentBytes > Residency->Budget)
+        {
+            Id = FindResidencyVictim(Residency, true, &Limit);
+            Target = Residency->Budget;
+        }
+        if(!Id) break;
+        
+        resident_texture* Texture = &Residency->Textures[Id];
+        u64 Before = GetResidentTextureBytes(Texture, Texture->FirstMip);
+        residency_action* Action = &Actions[Count++];
+        Action->Texture = Id;
+        if(Limit == Texture->MipsCount)
+        {
+            Action->Kind = RESIDENCY_EVICT;
+            Texture->FirstMip = Texture->MipsCount;
+        }
+        else
+        {
+            Action->Kind = RESIDENCY_DROP_MIPS;
+            while(Texture->FirstMip < Limit &&
+                  Residency->ResidentBytes - (Before - GetResidentTextureBytes(Texture, Texture->FirstMip)) > Target)
+            {
+                Texture->FirstMip++;
+            }
+        }
+        Action->FirstMip = Texture->FirstMip;
+        
+        u64 Released = Before - GetResidentTextureBytes(Texture, Texture->FirstMip);
+        Residency->ResidentBytes -= Released;
+        Residency->DroppedBytes += Released;
+    }
+    
+    //Restores reserve their memory up front so they can't push us over budget once loaded
+    for(u32 Id = 1; Id < Residency->TexturesCount && Count < MaxActions; Id++)
+    {
+        resident_texture* Texture = &Residency->Textures[Id];
+        if(IsTextureRestoreWanted(Residency, Texture))
+        {
+            u64 Missing = GetResidentTextureBytes(Texture, Texture->WantedMip) - GetResidentTextureBytes(Texture, Texture->FirstMip);
+            if(Residency->ResidentBytes + Missing <= Residency->Budget)
+            {
+                residency_action* Action = &Actions[Count++];
+                Action->Kind = RESIDENCY_RESTORE;
+                Action->Texture = Id;
+                Action->FirstMip = Texture->WantedMip;
+                
+                Texture->Restoring = true;
+                Texture->RestoreMip = Texture->WantedMip;
+                Residency->ResidentBytes += Missing;
+            }
+        }
+    }
+    
+    Residency->Frame++;
+    return Count;
+}
+
+//FirstMip is the mip the texture was actually loaded from, it can be more detailed than
+//the one asked for. If the load failed the texture keeps the mips it had and is tried
+//again when drawn
+internal void
+CompleteTextureRestore(texture_residency* Residency, u32 Id, b32 Loaded, u32 FirstMip)
+{
+    resident_texture* Texture = &Residency->Textures[Id];
+    Assert(Texture->Restoring);
+    
+    //The reservation is replaced by what was actually loaded
+    u64 Before = GetResidentTextureBytes(Texture, Texture->FirstMip);
+    Residency->ResidentBytes -= GetResidentTextureBytes(Texture, Texture->RestoreMip) - Before;
+    if(Loaded)
+    {
+        Assert(FirstMip <= Texture->RestoreMip);
+        u64 LoadedBytes = GetResidentTextureBytes(Texture, FirstMip) - Before;
+        Residency->ResidentBytes += LoadedBytes;
+        Residency->RestoredBytes += LoadedBytes;
+        Texture->FirstMip = FirstMip;
+    }
+    Texture->Restoring = false;
+}
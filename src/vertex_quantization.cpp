@@ -0,0 +1,304 @@
+// Quantized vertex streams of MESH_QUANTIZED meshes. The packer builds them from the
+// float arrays and stores them in the mesh asset next to those, which the CPU keeps for
+// bounds and meshlets, and D3D11_LoadMesh uploads them as they are:
+//   positions  3 x 16 bit unorm over the bounds of the mesh, 8 bytes with the padding
+//   normals    octahedral, 2 x 16 bit snorm
+//   tangents   octahedral, 2 x 16 bit snorm. ComputeMeshTangents already flips them to the
+//              side of the bitangent, so they need no handedness bit
+//   UVs        2 x 16 bit unorm over the UV bounds of the mesh
+// Position and shading take 20 bytes per vertex instead of 44. There are no streams for
+// the skinning weights and joints, the packer keeps animated meshes unquantized. Every
+// kernel works on 4 vertices at a time, the last ones go through a padded copy.
+
+//Largest differences between the float data and the quantized one
+struct vertex_quantization_error
+{
+    f32 Position; //Object space distance
+    f32 NormalDegrees;
+    f32 TangentDegrees;
+    f32 UV;
+};
+
+//Transposes 4 vec3 to one register per component
+internal void
+LoadVec3x4(vec3* Source, __m128* X, __m128* Y, __m128* Z)
+{
+    f32* Floats = &Source->x;
+    __m128 A = _mm_loadu_ps(Floats);     //X0 Y0 Z0 X1
+    __m128 B = _mm_loadu_ps(Floats + 4); //Y1 Z1 X2 Y2
+    __m128 C = _mm_loadu_ps(Floats + 8); //Z2 X3 Y3 Z3
+    *X = _mm_shuffle_ps(A, _mm_shuffle_ps(B, C, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+    *Y = _mm_shuffle_ps(_mm_shuffle_ps(A, B, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(B, C, _MM_SHUFFLE(2, 2, 3, 3)),
+                        _MM_SHUFFLE(2, 0, 2, 0));
+    *Z = _mm_shuffle_ps(_mm_shuffle_ps(A, B, _MM_SHUFFLE(1, 1, 2, 2)), C, _MM_SHUFFLE(3, 0, 2, 0));
+}
+
+internal void
+StoreVec3x4(vec3* Dest, __m128 X, __m128 Y, __m128 Z)
+{
+    f32* Floats = &Dest->x;
+    __m128 XY01 = _mm_unpacklo_ps(X, Y);
+    __m128 XY23 = _mm_unpackhi_ps(X, Y);
+    _mm_storeu_ps(Floats, _mm_shuffle_ps(XY01, _mm_shuffle_ps(Z, X, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0)));
+    _mm_storeu_ps(Floats + 4, _mm_shuffle_ps(_mm_shuffle_ps(Y, Z, _MM_SHUFFLE(1, 1, 1, 1)), XY23, _MM_SHUFFLE(1, 0, 2, 0)));
+    _mm_storeu_ps(Floats + 8, _mm_shuffle_ps(_mm_shuffle_ps(Z, X, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(Y, Z, _MM_SHUFFLE(3, 3, 3, 3)),
+                                             _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+//Returns the snorm pairs of the 4 vectors in the 32 bits of every lane, x in the low half.
+//The vectors don't need to be normalized, zero ones encode to +Z
+internal __m128i
+EncodeOctahedralx4(__m128 X, __m128 Y, __m128 Z)
+{
+    __m128 SignMask = _mm_set1_ps(-0.0f);
+    __m128 One = _mm_set1_ps(1.0f);
+    __m128 AbsX = _mm_andnot_ps(SignMask, X);
+    __m128 AbsY = _mm_andnot_ps(SignMask, Y);
+    __m128 AbsZ = _mm_andnot_ps(SignMask, Z);
+    __m128 L1 = _mm_max_ps(_mm_add_ps(_mm_add_ps(AbsX, AbsY), AbsZ), _mm_set1_ps(FLT_MIN));
+    __m128 U = _mm_div_ps(X, L1);
+    __m128 V = _mm_div_ps(Y, L1);
+    
+    //The lower hemisphere is folded over the diagonals
+    __m128 AbsU = _mm_andnot_ps(SignMask, U);
+    __m128 AbsV = _mm_andnot_ps(SignMask, V);
+    __m128 FoldedU = _mm_or_ps(_mm_and_ps(SignMask, U), _mm_sub_ps(One, AbsV));
+    __m128 FoldedV = _mm_or_ps(_mm_and_ps(SignMask, V), _mm_sub_ps(One, AbsU));
+    __m128 Lower = _mm_cmplt_ps(Z, _mm_setzero_ps());
+    U = _mm_blendv_ps(U, FoldedU, Lower);
+    V = _mm_blendv_ps(V, FoldedV, Lower);
+    
+    __m128 Scale = _mm_set1_ps(32767.0f);
+    __m128i QuantizedU = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(U, _mm_sub_ps(_mm_setzero_ps(), One)), One), Scale));
+    __m128i QuantizedV = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(V, _mm_sub_ps(_mm_setzero_ps(), One)), One), Scale));
+    return _mm_or_si128(_mm_and_si128(QuantizedU, _mm_set1_epi32(0xFFFF)), _mm_slli_epi32(QuantizedV, 16));
+}
+
+//Inverse of EncodeOctahedralx4, the vectors are normalized
+internal void
+DecodeOctahedralx4(__m128i Encoded, __m128* X, __m128* Y, __m128* Z)
+{
+    //Snorm -32768 is -1 like -32767
+    __m128 Scale = _mm_set1_ps(1.0f / 32767.0f);
+    __m128 MinusOne = _mm_set1_ps(-1.0f);
+    __m128 U = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(Encoded, 16), 16)), Scale), MinusOne);
+    __m128 V = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(Encoded, 16)), Scale), MinusOne);
+    
+    __m128 SignMask = _mm_set1_ps(-0.0f);
+    __m128 W = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_andnot_ps(SignMask, U)), _mm_andnot_ps(SignMask, V));
+    __m128 Fold = _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), W), _mm_setzero_ps());
+    __m128 NegativeFold = _mm_sub_ps(_mm_setzero_ps(), Fold);
+    U = _mm_add_ps(U, _mm_blendv_ps(Fold, NegativeFold, _mm_cmpge_ps(U, _mm_setzero_ps())));
+    V = _mm_add_ps(V, _mm_blendv_ps(Fold, NegativeFold, _mm_cmpge_ps(V, _mm_setzero_ps())));
+    
+    __m128 Length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(U, U), _mm_mul_ps(V, V)), _mm_mul_ps(W, W)));
+    *X = _mm_div_ps(U, Length);
+    *Y = _mm_div_ps(V, Length);
+    *Z = _mm_div_ps(W, Length);
+}
+
+internal void
+QuantizePositionsx4(vec3* Positions, __m128* Min, __m128* Scale, quantized_position* Dest)
+{
+    __m128 P[3];
+    LoadVec3x4(Positions, &P[0], &P[1], &P[2]);
+    
+    __m128i Quantized[3];
+    for(u32 Axis = 0; Axis < 3; Axis++)
+    {
+        __m128 Unorm = _mm_mul_ps(_mm_sub_ps(P[Axis], Min[Axis]), Scale[Axis]);
+        Quantized[Axis] = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(Unorm, _mm_setzero_ps()), _mm_set1_ps(65535.0f)));
+    }
+    
+    //X Y Z 0 for every vertex
+    __m128i XY01 = _mm_unpacklo_epi32(Quantized[0], Quantized[1]);
+    __m128i XY23 = _mm_unpackhi_epi32(Quantized[0], Quantized[1]);
+    __m128i Z01 = _mm_unpacklo_epi32(Quantized[2], _mm_setzero_si128());
+    __m128i Z23 = _mm_unpackhi_epi32(Quantized[2], _mm_setzero_si128());
+    _mm_storeu_si128((__m128i*)Dest, _mm_packus_epi32(_mm_unpacklo_epi64(XY01, Z01), _mm_unpackhi_epi64(XY01, Z01)));
+    _mm_storeu_si128((__m128i*)(Dest + 2), _mm_packus_epi32(_mm_unpacklo_epi64(XY23, Z23), _mm_unpackhi_epi64(XY23, Z23)));
+}
+
+internal void
+DequantizePositionsx4(quantized_position* Source, __m128* Min, __m128* Step, vec3* Positions)
+{
+    __m128i Low = _mm_loadu_si128((__m128i*)Source);
+    __m128i High = _mm_loadu_si128((__m128i*)(Source + 2));
+    __m128 P0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(Low, _mm_setzero_si128()));
+    __m128 P1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(Low, _mm_setzero_si128()));
+    __m128 P2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(High, _mm_setzero_si128()));
+    __m128 P3 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(High, _mm_setzero_si128()));
+    _MM_TRANSPOSE4_PS(P0, P1, P2, P3);
+    
+    StoreVec3x4(Positions, _mm_add_ps(Min[0], _mm_mul_ps(P0, Step[0])), _mm_add_ps(Min[1], _mm_mul_ps(P1, Step[1])),
+                _mm_add_ps(Min[2], _mm_mul_ps(P2, Step[2])));
+}
+
+//UVMin and UVScale hold U V U V
+internal void
+QuantizeShadingx4(vec3* Normals, vec3* Tangents, vec2* UVs, __m128 UVMin, __m128 UVScale, quantized_shading_vertex* Dest)
+{
+    __m128 X, Y, Z;
+    LoadVec3x4(Normals, &X, &Y, &Z);
+    __m128i Normal = EncodeOctahedralx4(X, Y, Z);
+    LoadVec3x4(Tangents, &X, &Y, &Z);
+    __m128i Tangent = EncodeOctahedralx4(X, Y, Z);
+    
+    //Unorms in 32 bit lanes, then packed to U V pairs
+    __m128 Max = _mm_set1_ps(65535.0f);
+    __m128 UV01 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&UVs[0].x), UVMin), UVScale);
+    __m128 UV23 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&UVs[2].x), UVMin), UVScale);
+    __m128i UV = _mm_packus_epi32(_mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(UV01, _mm_setzero_ps()), Max)),
+                                  _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(UV23, _mm_setzero_ps()), Max)));
+    
+    //Every vertex is 3 words, the same layout as 4 vec3
+    StoreVec3x4((vec3*)Dest, _mm_castsi128_ps(Normal), _mm_castsi128_ps(Tangent), _mm_castsi128_ps(UV));
+}
+
+//UVMin and UVStep hold U V U V
+internal void
+DequantizeShadingx4(quantized_shading_vertex* Source, __m128 UVMin, __m128 UVStep, vec3* Normals, vec3* Tangents, vec2* UVs)
+{
+    __m128 Normal, Tangent, UV;
+    LoadVec3x4((vec3*)Source, &Normal, &Tangent, &UV);
+    
+    __m128 X, Y, Z;
+    DecodeOctahedralx4(_mm_castps_si128(Normal), &X, &Y, &Z);
+    StoreVec3x4(Normals, X, Y, Z);
+    DecodeOctahedralx4(_mm_castps_si128(Tangent), &X, &Y, &Z);
+    StoreVec3x4(Tangents, X, Y, Z);
+    
+    __m128 U = _mm_cvtepi32_ps(_mm_and_si128(_mm_castps_si128(UV), _mm_set1_epi32(0xFFFF)));
+    __m128 V = _mm_cvtepi32_ps(_mm_srli_epi32(_mm_castps_si128(UV), 16));
+    _mm_storeu_ps(&UVs[0].x, _mm_add_ps(UVMin, _mm_mul_ps(_mm_unpacklo_ps(U, V), UVStep)));
+    _mm_storeu_ps(&UVs[2].x, _mm_add_ps(UVMin, _mm_mul_ps(_mm_unpackhi_ps(U, V), UVStep)));
+}
+
+//Fills the streams of Dest, which must have VerticesCount elements, and their bounds
+internal void
+QuantizeMeshVertices(mesh_data* Mesh, quantized_mesh_vertices* Dest)
+{
+    Assert(Mesh->Positions && Mesh->Normals && Mesh->Tangents && Mesh->UVs);
+    
+    u32 Count = Mesh->VerticesCount;
+    Dest->VerticesCount = Count;
+    Dest->Min = Count ? Mesh->Positions[0] : vec3(0.0f);
+    Dest->Max = Dest->Min;
+    Dest->UVMin = Count ? Mesh->UVs[0] : vec2(0.0f);
+    Dest->UVMax = Dest->UVMin;
+    for(u32 Vertex = 1; Vertex < Count; Vertex++)
+    {
+        vec3 P = Mesh->Positions[Vertex];
+        vec2 UV = Mesh->UVs[Vertex];
+        Dest->Min = vec3(MIN(Dest->Min.x, P.x), MIN(Dest->Min.y, P.y), MIN(Dest->Min.z, P.z));
+        Dest->Max = vec3(MAX(Dest->Max.x, P.x), MAX(Dest->Max.y, P.y), MAX(Dest->Max.z, P.z));
+        Dest->UVMin = vec2(MIN(Dest->UVMin.x, UV.x), MIN(Dest->UVMin.y, UV.y));
+        Dest->UVMax = vec2(MAX(Dest->UVMax.x, UV.x), MAX(Dest->UVMax.y, UV.y));
+    }
+    
+    //Flat axes quantize to 0
+    __m128 Min[3], Scale[3];
+    for(u32 Axis = 0; Axis < 3; Axis++)
+    {
+        f32 Extent = Dest->Max.e[Axis] - Dest->Min.e[Axis];
+        Min[Axis] = _mm_set1_ps(Dest->Min.e[Axis]);
+        Scale[Axis] = _mm_set1_ps(Extent > 0.0f ? 65535.0f / Extent : 0.0f);
+    }
+    vec2 UVExtent = Dest->UVMax - Dest->UVMin;
+    f32 ScaleU = UVExtent.x > 0.0f ? 65535.0f / UVExtent.x : 0.0f;
+    f32 ScaleV = UVExtent.y > 0.0f ? 65535.0f / UVExtent.y : 0.0f;
+    __m128 UVMin = _mm_setr_ps(Dest->UVMin.x, Dest->UVMin.y, Dest->UVMin.x, Dest->UVMin.y);
+    __m128 UVScale = _mm_setr_ps(ScaleU, ScaleV, ScaleU, ScaleV);
+    
+    u32 Vertex = 0;
+    for(; Vertex + 4 <= Count; Vertex += 4)
+    {
+        QuantizePositionsx4(Mesh->Positions + Vertex, Min, Scale, Dest->Positions + Vertex);
+        QuantizeShadingx4(Mesh->Normals + Vertex, Mesh->Tangents + Vertex, Mesh->UVs + Vertex, UVMin, UVScale, Dest->Shading + Vertex);
+    }
+    if(Vertex < Count)
+    {
+        vec3 Positions[4] = {}, Normals[4] = {}, Tangents[4] = {};
+        vec2 UVs[4] = {};
+        quantized_position QuantizedPositions[4];
+        quantized_shading_vertex QuantizedShading[4];
+        u32 Remaining = Count - Vertex;
+        memcpy(Positions, Mesh->Positions + Vertex, sizeof(vec3) * Remaining);
+        memcpy(Normals, Mesh->Normals + Vertex, sizeof(vec3) * Remaining);
+        memcpy(Tangents, Mesh->Tangents + Vertex, sizeof(vec3) * Remaining);
+        memcpy(UVs, Mesh->UVs + Vertex, sizeof(vec2) * Remaining);
+        QuantizePositionsx4(Positions, Min, Scale, QuantizedPositions);
+        QuantizeShadingx4(Normals, Tangents, UVs, UVMin, UVScale, QuantizedShading);
+        memcpy(Dest->Positions + Vertex, QuantizedPositions, sizeof(quantized_position) * Remaining);
+        memcpy(Dest->Shading + Vertex, QuantizedShading, sizeof(quantized_shading_vertex) * Remaining);
+    }
+}
+
+//Writes the decoded vertices to the arrays of Dest, which must have VerticesCount elements
+internal void
+DequantizeMeshVertices(quantized_mesh_vertices* Quantized, mesh_data* Dest)
+{
+    u32 Count = Quantized->VerticesCount;
+    __m128 Min[3], Step[3];
+    for(u32 Axis = 0; Axis < 3; Axis++)
+    {
+        Min[Axis] = _mm_set1_ps(Quantized->Min.e[Axis]);
+        Step[Axis] = _mm_set1_ps((Quantized->Max.e[Axis] - Quantized->Min.e[Axis]) / 65535.0f);
+    }
+    vec2 UVStep = (Quantized->UVMax - Quantized->UVMin) / 65535.0f;
+    __m128 UVMin = _mm_setr_ps(Quantized->UVMin.x, Quantized->UVMin.y, Quantized->UVMin.x, Quantized->UVMin.y);
+    __m128 UVSteps = _mm_setr_ps(UVStep.x, UVStep.y, UVStep.x, UVStep.y);
+    
+    u32 Vertex = 0;
+    for(; Vertex + 4 <= Count; Vertex += 4)
+    {
+        DequantizePositionsx4(Quantized->Positions + Vertex, Min, Step, Dest->Positions + Vertex);
+        DequantizeShadingx4(Quantized->Shading + Vertex, UVMin, UVSteps, Dest->Normals + Vertex, Dest->Tangents + Vertex,
+                            Dest->UVs + Vertex);
+    }
+    if(Vertex < Count)
+    {
+        vec3 Positions[4], Normals[4], Tangents[4];
+        vec2 UVs[4];
+        quantized_position QuantizedPositions[4] = {};
+        quantized_shading_vertex QuantizedShading[4] = {};
+        u32 Remaining = Count - Vertex;
+        memcpy(QuantizedPositions, Quantized->Positions + Vertex, sizeof(quantized_position) * Remaining);
+        memcpy(QuantizedShading, Quantized->Shading + Vertex, sizeof(quantized_shading_vertex) * Remaining);
+        DequantizePositionsx4(QuantizedPositions, Min, Step, Positions);
+        DequantizeShadingx4(QuantizedShading, UVMin, UVSteps, Normals, Tangents, UVs);
+        memcpy(Dest->Positions + Vertex, Positions, sizeof(vec3) * Remaining);
+        memcpy(Dest->Normals + Vertex, Normals, sizeof(vec3) * Remaining);
+        memcpy(Dest->Tangents + Vertex, Tangents, sizeof(vec3) * Remaining);
+        memcpy(Dest->UVs + Vertex, UVs, sizeof(vec2) * Remaining);
+    }
+}
+
+internal f32
+GetAngleDegrees(vec3 A, vec3 B)
+{
+    return atan2f(Length(Cross(A, B)), Dot(A, B)) * (180.0f / PI);
+}
+
+//Decoded is the mesh after DequantizeMeshVertices. Zero normals and tangents are skipped,
+//they have no direction to keep
+internal vertex_quantization_error
+MeasureVertexQuantizationError(mesh_data* Original, mesh_data* Decoded)
+{
+    vertex_quantization_error Result = {};
+    for(u32 Vertex = 0; Vertex < Original->VerticesCount; Vertex++)
+    {
+        Result.Position = MAX(Result.Position, Length(Original->Positions[Vertex] - Decoded->Positions[Vertex]));
+        if(Length(Original->Normals[Vertex]) > 0.0f)
+        {
+            Result.NormalDegrees = MAX(Result.NormalDegrees, GetAngleDegrees(Original->Normals[Vertex], Decoded->Normals[Vertex]));
+        }
+        if(Length(Original->Tangents[Vertex]) > 0.0f)
+        {
+            Result.TangentDegrees = MAX(Result.TangentDegrees, GetAngleDegrees(Original->Tangents[Vertex], Decoded->Tangents[Vertex]));
+        }
+        vec2 UVError = Original->UVs[Vertex] - Decoded->UVs[Vertex];
+        Result.UV = MAX(Result.UV, MAX(fabsf(UVError.x), fabsf(UVError.y)));
+    }
+    return Result;
+}
@@ -52,21 +52,235 @@ Win32_FreeFileMemory(void* Memory)
     VirtualFree(Memory, 0, MEM_RELEASE);
 }
 
+//ReadFile takes a 32 bit size, bigger reads are split. The chunk size is a multiple
+//of PLATFORM_DIRECT_READ_ALIGNMENT so that unbuffered reads stay aligned
+#define WIN32_MAX_READ_SIZE Gigabytes(1)
+
 internal b32
 Win32_ReadAtOffset(HANDLE File, void* Data, u64 Size, u64 Offset)
 {
-    Assert(Size <= UINT_MAX);
-    
-    OVERLAPPED Overlapped = {};
-    Overlapped.Offset = (u32)((Offset >> 0) & 0xFFFFFFFF);
-    Overlapped.OffsetHigh = (u32)((Offset >> 32) & 0xFFFFFFFF);
+    u8* At = (u8*)Data;
+    while(Size)
+    {
+        u32 ChunkSize = (u32)MIN(Size, WIN32_MAX_READ_SIZE);
+        
+        OVERLAPPED Overlapped = {};
+        Overlapped.Offset = (u32)((Offset >> 0) & 0xFFFFFFFF);
+        Overlapped.OffsetHigh = (u32)((Offset >> 32) & 0xFFFFFFFF);
+        
+        DWORD BytesRead;
+        b32 Success = ReadFile(File, At, ChunkSize, &BytesRead, &Overlapped) &&
+        (ChunkSize == BytesRead);
+        if(!Success) return false;
+        
+        At += ChunkSize;
+        Offset += ChunkSize;
+        Size -= ChunkSize;
+    }
     
-    DWORD BytesRead;
-    b32 Success = ReadFile(File, Data, (u32)Size, &BytesRead, &Overlapped) &&
-    (Size == BytesRead);
+    return true;
+}
+
+internal platform_file
+Platform_OpenFileForReading(char* Path)
+{
+    return CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0);
+}
+
+internal platform_file
+Platform_OpenFileForDirectReading(char* Path)
+{
+    return CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, 0);
+}
+
+internal void
+Platform_CloseFile(platform_file File)
+{
+    CloseHandle(File);
+}
+
+internal u64
+Platform_GetFileSize(platform_file File)
+{
+    LARGE_INTEGER FileSize = {};
+    if(!GetFileSizeEx(File, &FileSize)) return 0;
+    return FileSize.QuadPart;
+}
+
+internal b32
+Platform_ReadAtOffset(platform_file File, void* Data, u64 Size, u64 Offset)
+{
+    return Win32_ReadAtOffset(File, Data, Size, Offset);
+}
+
+internal b32
+Platform_CreateDirectory(char* Path)
+{
+    return CreateDirectoryA(Path, 0) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+internal b32
+Platform_MoveFile(char* From, char* To)
+{
+    return MoveFileExA(From, To, MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+//The reads are issued one after the other, overlapped IO would need every handle to
+//be opened with FILE_FLAG_OVERLAPPED
+internal b32
+Platform_ReadBatch(platform_read* Reads, u32 Count)
+{
+    b32 Success = true;
+    for(u32 Index = 0; Index < Count; Index++)
+    {
+        platform_read* Read = &Reads[Index];
+        Success = Win32_ReadAtOffset(Read->File, Read->Data, Read->Size, Read->Offset) && Success;
+    }
     return Success;
 }
 
+internal platform_file_mapping
+Platform_MapFile(platform_file File, b32 CopyOnWrite)
+{
+    platform_file_mapping Result = {};
+    
+    u64 Size = Platform_GetFileSize(File);
+    if(!Size) return Result;
+    
+    //PAGE_WRITECOPY + FILE_MAP_COPY: written pages become private copies, the file is never modified
+    HANDLE Mapping = CreateFileMappingA(File, 0, CopyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, 0);
+    if(!Mapping) return Result;
+    
+    void* Data = MapViewOfFile(Mapping, CopyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+    if(!Data)
+    {
+        CloseHandle(Mapping);
+        return Result;
+    }
+    
+    Result.Data = (u8*)Data;
+    Result.Size = Size;
+    Result.Handle = Mapping;
+    return Result;
+}
+
+internal void
+Platform_UnmapFile(platform_file_mapping* Mapping)
+{
+    if(Mapping->Data)
+    {
+        UnmapViewOfFile(Mapping->Data);
+        CloseHandle(Mapping->Handle);
+    }
+    *Mapping = {};
+}
+
+internal void*
+Platform_AllocateMemory(u64 Size)
+{
+    return VirtualAlloc(0, Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+internal void
+Platform_FreeMemory(void* Memory, u64 Size)
+{
+    if(Memory)
+    {
+        VirtualFree(Memory, 0, MEM_RELEASE);
+    }
+}
+
+internal u64
+Platform_GetMicroseconds()
+{
+    local_persist s64 PerformanceFrequency;
+    if(!PerformanceFrequency)
+    {
+        LARGE_INTEGER Frequency;
+        QueryPerformanceFrequency(&Frequency);
+        PerformanceFrequency = Frequency.QuadPart;
+    }
+    
+    LARGE_INTEGER Counter;
+    QueryPerformanceCounter(&Counter);
+    s64 Ticks = Counter.QuadPart;
+    return (u64)(Ticks / PerformanceFrequency * 1000000 + Ticks % PerformanceFrequency * 1000000 / PerformanceFrequency);
+}
+
+internal u32
+Platform_GetProcessorCount()
+{
+    SYSTEM_INFO Info = {};
+    GetSystemInfo(&Info);
+    return Info.dwNumberOfProcessors;
+}
+
+struct win32_thread_startup
+{
+    platform_thread_proc* Proc;
+    void* Param;
+};
+
+internal DWORD WINAPI
+Win32_ThreadProc(LPVOID Parameter)
+{
+    win32_thread_startup Startup = *(win32_thread_startup*)Parameter;
+    Free(Parameter);
+    
+    Startup.Proc(Startup.Param);
+    return 0;
+}
+
+internal void
+Platform_CreateThread(platform_thread_proc* Proc, void* Param)
+{
+    win32_thread_startup* Startup = (win32_thread_startup*)ZeroAlloc(sizeof(win32_thread_startup));
+    Startup->Proc = Proc;
+    Startup->Param = Param;
+    
+    HANDLE Thread = CreateThread(0, 0, Win32_ThreadProc, Startup, 0, 0);
+    Assert(Thread);
+    CloseHandle(Thread);
+}
+
+internal u32
+Platform_GetThreadId()
+{
+    return GetCurrentThreadId();
+}
+
+internal platform_semaphore
+Platform_CreateSemaphore(u32 InitialCount)
+{
+    HANDLE Semaphore = CreateSemaphoreEx(0, InitialCount, LONG_MAX, 0, 0, SEMAPHORE_ALL_ACCESS);
+    Assert(Semaphore);
+    return Semaphore;
+}
+
+internal void
+Platform_SignalSemaphore(platform_semaphore Semaphore)
+{
+    ReleaseSemaphore((HANDLE)Semaphore, 1, 0);
+}
+
+internal void
+Platform_WaitSemaphore(platform_semaphore Semaphore)
+{
+    WaitForSingleObjectEx((HANDLE)Semaphore, INFINITE, FALSE);
+}
+
+internal u32
+Platform_AtomicAdd(volatile u32* Value, u32 Addend)
+{
+    return (u32)InterlockedExchangeAdd((volatile LONG*)Value, (LONG)Addend);
+}
+
+internal b32
+Platform_AtomicCompareExchange(volatile u32* Value, u32 Expected, u32 New)
+{
+    return (u32)InterlockedCompareExchange((volatile LONG*)Value, (LONG)New, (LONG)Expected) == Expected;
+}
+
 LRESULT CALLBACK
 Win32_WindowProc(HWND Window, UINT Message, WPARAM WParam, LPARAM LParam)
 {
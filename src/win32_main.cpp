@@ -7,6 +7,7 @@
 #include <math.h>
 
 #include "defines.h"
+#include "platform.h"
 #define ENABLE_GLOBAL_RAND_STATE
 #include "math/math.cpp"
 #include "math/math_vec.cpp"
@@ -23,10 +24,18 @@
 #include "bounding_volumes.cpp"
 #include "mesh.cpp"
 #include "image.cpp"
+#include "vertex_quantization.cpp"
 #include "atmosphere.cpp"
+#include "memory_arena.cpp"
+#include "work_queue.cpp"
+#include "startup_graph.cpp"
+#include "texture_residency.cpp"
 
 #include "asset_file.h"
+#include "asset_compression.cpp"
 #include "asset_loader.cpp"
+#include "asset_streaming.cpp"
+#include "atmosphere_cache.cpp"
 #include "direct3d11.cpp"
 #include "imgui_d3d11.cpp"
 #include "inspector.cpp"
@@ -47,169 +56,427 @@ typedef d3d11_atmosphere atmosphere;
 #include "spherical_harmonics.cpp"
 
 
-int
-WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, LPSTR CmdLine, int ShowCmd)
+internal void
+ProcessHelmetLoad(asset_load_request* Request)
 {
-    STARTUP_BEGIN;
+    // Fixup UVs and triangle winding
+    mesh_data* HelmetMesh = &Request->Mesh;
+    for(u32 i = 0; i < HelmetMesh->VerticesCount; i++) {
+        HelmetMesh->UVs[i].y += 1.0f;
+    }
+    ReverseTriangleWinding(HelmetMesh);
+    BuildMeshlets(HelmetMesh);
 
-    // Create window
-    s32 Width = 1600;
-    s32 Height = 900;
-    HWND Window = Win32_CreateWindow("Editor", Width, Height);
-    Win32.WindowResized = false; //Set resized to false after the first default resize on creation
+    // Quantized streams are uploaded as they are, encode them again with the fixed UVs.
+    // They point into the payload, which is writable
+    if(HelmetMesh->Flags & MESH_QUANTIZED)
+    {
+        QuantizeMeshVertices(HelmetMesh, &HelmetMesh->Quantized);
+    }
+}
 
-    STARTUP_TIMESTAMP(WINDOW);
+internal void
+CompleteHelmetLoad(asset_load_request* Request, void* Context)
+{
+    Assert(Request->State == ASSET_LOAD_PARSED);
+    ID3D11Device* Device = (ID3D11Device*)Context;
+    scene* Scene = (scene*)Request->UserData;
+    
+    // The mesh data points into the payload, which was read into the persistent arena
+    mesh_data* HelmetMesh = PushStruct(&Scene->PersistentArena, mesh_data);
+    *HelmetMesh = Request->Mesh;
+    
+    mesh_gpu* HelmetGpuMesh = PushStruct(&Scene->PersistentArena, mesh_gpu);
+    *HelmetGpuMesh = D3D11_LoadMesh(Device, HelmetMesh);
+    
+    mesh* Helmet = AddMesh(Scene, "Helmet", HelmetMesh, HelmetGpuMesh, 0, true);
+    Helmet->Rotation = vec3(90, 0, 0);
+    Helmet->Position = vec3(0, 0, 5);
+}
 
-    // Load asset file
-    HANDLE AssetFile = CreateFile("../res/data.asset", GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0);
-    Assert(AssetFile != INVALID_HANDLE_VALUE);
-    DWORD BytesRead = 0;
-    asset_file_header AssetHeader = {};
-    ReadFile(AssetFile, &AssetHeader, sizeof(asset_file_header), &BytesRead, 0);
-    Assert(BytesRead == sizeof(asset_file_header));
+// Finds the command line flag Name as a whole token, searching from From, so -trace doesn't
+// match -startup-trace. Returns the end of the flag, where its value starts, or 0
+internal char*
+FindArgument(char* CmdLine, const char* Name, char* From = 0)
+{
+    size_t NameLength = strlen(Name);
+    for(char* Match = strstr(From ? From : CmdLine, Name); Match; Match = strstr(Match + 1, Name))
+    {
+        b32 TokenBegins = Match == CmdLine || Match[-1] == ' ' || Match[-1] == '\t';
+        char Next = Match[NameLength];
+        b32 TokenEnds = Next == 0 || Next == ' ' || Next == '\t';
+        if(TokenBegins && TokenEnds)
+        {
+            return Match + NameLength;
+        }
+    }
+    return 0;
+}
 
-    asset_table AssetTable = {};
-    AssetTable.Count = AssetHeader.TableEntryCount;
-    u64 AssetTableSize = sizeof(asset_table_entry) * AssetTable.Count;
-    AssetTable.Entries = (asset_table_entry*)ZeroAlloc(AssetTableSize);
-    ReadFile(AssetFile, AssetTable.Entries, (u32)AssetTableSize, &BytesRead, 0);
-    Assert(BytesRead == AssetTableSize);
+// Startup, split in tasks of the startup graph. Everything they create lives in the
+// startup state, the main loop uses it once the graph completes
 
-    STARTUP_TIMESTAMP(ASSET_FILE);
+struct startup_state
+{
+    char* CmdLine;
+    HWND Window;
+    s32 Width;
+    s32 Height;
+
+    scene* Scene;
+    work_queue* WorkQueue;
+    asset_archive Assets;
+    asset_library Library;
+    asset_archive* Patches; //One per -mount, opened by StartupAssetFile
+    asset_streamer* Streamer;
+    b32 TraceAssetReads;
+
+    d3d11_state D3D11;
+    shadow_map ShadowMap;
+    shadow_cubemap ShadowCubemap0;
+
+    atmosphere_cache AtmosphereCache;
+    atmosphere_parameters AtmosphereParameters;
+    void* AtmosphereFile; //Found in the cache, 0 on a miss
+    u64 AtmosphereFileSize;
+
+    fp_camera Camera;
+};
+
+internal void
+StartupWindow(void* Data)
+{
+    startup_state* State = (startup_state*)Data;
+    State->Window = Win32_CreateWindow("Editor", State->Width, State->Height);
+    Win32.WindowResized = false; //Set resized to false after the first default resize on creation
+}
 
-    // Initialize D3D11 Renderer
-    d3d11_state D3D11 = D3D11_Init(Window, Width, Height);
+//Runs on a worker while the main thread tasks push to the scene arena, which isn't thread
+//safe, so everything it fills is pushed by WinMain before the graph starts
+internal void
+StartupAssetFile(void* Data)
+{
+    startup_state* State = (startup_state*)Data;
 
-    // Load baked BRDF texture from asset file
-    D3D11.PBR.BRDFTexture = LoadTextureFromAssetFile(D3D11.Device, AssetFile, AssetTable, "brdf", DXGI_FORMAT_R16G16_FLOAT);
+    b32 AssetsOpened = OpenAssetArchive(&State->Assets, "../res/data.asset", true, State->WorkQueue);
+    Assert(AssetsOpened);
+    PrefetchAssetArchive(&State->Assets);
 
-    // Track some shaders
-    PushTrackedShader(L"../src/shaders/pbr_pixel.hlsl", (void**)&D3D11.PBR.PixelShader, TRACKED_SHADER_PIXEL);
-    PushTrackedShader(L"../src/shaders/bruneton/atmosphere_render.hlsl", (void**)&D3D11.Atmosphere.RenderAtmosphereShader, TRACKED_SHADER_PIXEL);
+    // With -trace every asset read is recorded and written to data.trace on exit,
+    // pass it to the packer with -order to lay out the file in startup order
+    State->TraceAssetReads = FindArgument(State->CmdLine, "-trace") != 0;
+    if(State->TraceAssetReads)
+    {
+        BeginAssetReadTrace(&State->Assets, 4096);
+    }
 
-    // Initialize IGUI
-    ImguiInit(Window, &D3D11);
+    // Patch archives given with -mount <path> are mounted over it, their entries
+    // shadow the ones with the same name and tag
+    MountAssetArchive(&State->Library, &State->Assets);
+    asset_archive* Patch = State->Patches;
+    for(char* Mount = FindArgument(State->CmdLine, "-mount"); Mount; Mount = FindArgument(State->CmdLine, "-mount", Mount))
+    {
+        char Path[1024] = {};
+        sscanf(Mount, "%1023s", Path);
+        b32 PatchOpened = OpenAssetArchive(Patch, Path, true, State->WorkQueue);
+        Assert(PatchOpened);
+        MountAssetArchive(&State->Library, Patch++);
+    }
+}
 
-    STARTUP_TIMESTAMP(IMGUI);
+internal void
+StartupD3D11(void* Data)
+{
+    startup_state* State = (startup_state*)Data;
+    State->D3D11 = D3D11_Init(State->Window, State->Width, State->Height);
 
-    // Get refresh rate and init counters
-    f32 SecondsPerFrame = 1.0f / D3D11.MonitorInfo.RefreshRate;
-    f32 SecondsElapsed = SecondsPerFrame; //The first frame we step by the expected frame time
-    s64 CounterBegin = Win32_GetCurrentCounter();
-    s64 CounterEnd = CounterBegin;
+    // Track some shaders
+    PushTrackedShader(L"../src/shaders/pbr_pixel.hlsl", (void**)&State->D3D11.PBR.PixelShader, TRACKED_SHADER_PIXEL);
+    PushTrackedShader(L"../src/shaders/bruneton/atmosphere_render.hlsl", (void**)&State->D3D11.Atmosphere.RenderAtmosphereShader, TRACKED_SHADER_PIXEL);
+}
 
+internal void
+StartupImgui(void* Data)
+{
+    startup_state* State = (startup_state*)Data;
+    ImguiInit(State->Window, &State->D3D11);
+}
 
-    // Load helmet model from asset file
-    mesh_data HelmetMesh = LoadMeshFromAssetFile(AssetFile, AssetTable, "helmet");
+internal void
+StartupMeshes(void* Data)
+{
+    startup_state* State = (startup_state*)Data;
 
-    // Fixup UVs and triangle winding
-    for(u32 i = 0; i < HelmetMesh.VerticesCount; i++) {
-        HelmetMesh.UVs[i].y += 1.0f;
-    }
-    ReverseTriangleWinding(&HelmetMesh);
+    // Stream helmet model from asset file into the persistent arena, it's added to the
+    // scene when it completes
+    RequestAssetLoad(State->Streamer, ASSET_ID("helmet"), ASSET_MESH, CompleteHelmetLoad, State->Scene, 0, ProcessHelmetLoad, true,
+                     &State->Scene->PersistentArena);
+}
 
-    mesh_gpu HelmetGpuMesh = D3D11_LoadMesh(D3D11.Device, &HelmetMesh);
+internal void
+StartupMaterials(void* Data)
+{
+    startup_state* State = (startup_state*)Data;
 
-    STARTUP_TIMESTAMP(MESHES);
+    // Stream baked BRDF texture from asset file, loads complete in the main loop so
+    // it doesn't need D3D11_Init to be done
+    StreamTextureFromAssetFile(State->Streamer, ASSET_ID("brdf"), &State->D3D11.PBR.BRDFTexture, DXGI_FORMAT_R16G16_FLOAT);
 
-    // Load material from asset file
-    material HelmetMaterial = LoadMaterialFromAssetFile(D3D11.Device, AssetFile, AssetTable, "helmet");
-    STARTUP_TIMESTAMP(MATERIALS);
+    // Stream material from asset file
+    material HelmetMaterial = {};
+    HelmetMaterial.Name = "helmet";
+    StreamMaterialFromAssetFile(State->Streamer, State->Scene, AddMaterial(State->Scene, &HelmetMaterial));
+}
+
+internal void
+StartupShadowMaps(void* Data)
+{
+    startup_state* State = (startup_state*)Data;
+    ID3D11Device* Device = State->D3D11.Device;
 
     // Create shadow maps
     ivec2 ShadowMapSize = ivec2(2048, 2048);
-    shadow_map ShadowMap = D3D11_CreateShadowMap(D3D11.Device, ShadowMapSize.x, ShadowMapSize.y);
-    PushTrackedTexture(ShadowMap.ResourceView, ShadowMapSize, "Shadow map", TRACKED_TEXTURE_2D);
+    State->ShadowMap = D3D11_CreateShadowMap(Device, ShadowMapSize.x, ShadowMapSize.y);
+    PushTrackedTexture(State->ShadowMap.ResourceView, ShadowMapSize, "Shadow map", TRACKED_TEXTURE_2D);
 
     s32 ShadowCubemapSize = 1024;
-    shadow_cubemap ShadowCubemap0 = D3D11_CreateShadowCubemap(D3D11.Device, ShadowCubemapSize);
-    PushTrackedTexture(ShadowCubemap0.ResourceView, ivec2(ShadowCubemapSize), "Shadow cubemap", TRACKED_TEXTURE_CUBEMAP);
+    State->ShadowCubemap0 = D3D11_CreateShadowCubemap(Device, ShadowCubemapSize);
+    PushTrackedTexture(State->ShadowCubemap0.ResourceView, ivec2(ShadowCubemapSize), "Shadow cubemap", TRACKED_TEXTURE_CUBEMAP);
+}
 
-    STARTUP_TIMESTAMP(SHADOW_MAPS);
+internal void
+StartupLightProbe(void* Data)
+{
+    startup_state* State = (startup_state*)Data;
 
-    // Load baked light probe from asset file
-    light_probe LightProbe = LoadLightProbeFromAssetFile(D3D11.Device, AssetFile, AssetTable, "harbor");
-    PushTrackedTexture(LightProbe.Base.ResourceView, ivec2(HDR_CUBEMAP_SIZE), "Environment - base", TRACKED_TEXTURE_CUBEMAP);
-    PushTrackedTexture(LightProbe.Irradiance.ResourceView, ivec2(IRRADIANCE_CUBEMAP_SIZE), "Environment - irradiance", TRACKED_TEXTURE_CUBEMAP);
-    PushTrackedTexture(LightProbe.Specular.ResourceView, ivec2(SPECULAR_CUBEMAP_SIZE), "Environment - specular", TRACKED_TEXTURE_CUBEMAP);
+    // Stream baked light probe from asset file
+    StreamLightProbeFromAssetFile(State->Streamer, &State->Scene->Probe, "harbor");
 
-    STARTUP_TIMESTAMP(LIGHT_PROBE);
+    // Spherical harmonics tests, they are computed on the workers from the same environment
+    PushTrackedShader(L"../src/shaders/sh_test.hlsl", (void**)&State->D3D11.SH.TestPixelShader, TRACKED_SHADER_PIXEL);
+    PushTrackedTexture(0, ivec2(0), "SH Test", TRACKED_SH_MAP);
+    StreamSphericalHarmonics(State->Streamer, ASSET_ID("harbor", "environment"));
+}
 
-    // Load atmosphere from atmo file
-    atmosphere_parameters EarthAtmosphereParameters = GetEarthAtmosphereParameters();
-    atmosphere EarthAtmosphere = {};
-    EarthAtmosphere = D3D11_LoadAtmosphereFromFile(&D3D11, "../res/earth.atmo");
+// The atmosphere is looked up in the cache on a worker, on a miss it's seeded from the
+// shipped earth.atmo. If that doesn't match it's precomputed on the main thread once the
+// device exists and added to the cache
+internal void
+StartupAtmosphereFile(void* Data)
+{
+    startup_state* State = (startup_state*)Data;
+    State->AtmosphereParameters = GetEarthAtmosphereParameters();
+    OpenAtmosphereCache(&State->AtmosphereCache);
+    State->AtmosphereFile = LoadCachedAtmosphere(&State->AtmosphereCache, &State->AtmosphereParameters,
+                                                 AtmosphereDefaultLutFormats, &State->AtmosphereFileSize);
+    if(!State->AtmosphereFile)
+    {
+        State->AtmosphereFile = SeedCachedAtmosphere(&State->AtmosphereCache, &State->AtmosphereParameters,
+                                                     AtmosphereDefaultLutFormats, "../res/earth.atmo", "earth",
+                                                     &State->AtmosphereFileSize);
+    }
+}
 
-    STARTUP_TIMESTAMP(ATMOSPHERE);
+// Pushed the first time, updated when the atmosphere is loaded again
+internal void
+TrackAtmosphereTexture(void* Texture, ivec2 Size, char* Name, tracked_texture_kind Kind, s32 Depth = 0)
+{
+    tracked_texture* Track = FindTrackedTexture(Name);
+    if(Track)
+    {
+        Track->Texture = Texture;
+        Track->Size = Size;
+        Track->Depth = Depth;
+    }
+    else
+    {
+        PushTrackedTexture(Texture, Size, Name, Kind, Depth);
+    }
+}
 
-    // Track atmosphere textures
-    ivec2 TransmittanceSize = ivec2(EarthAtmosphere.Transmittance.Width, EarthAtmosphere.Transmittance.Height);
-    PushTrackedTexture(EarthAtmosphere.Transmittance.ResourceView, TransmittanceSize, "Earth - Transmittance", TRACKED_TEXTURE_2D);
+internal void
+TrackAtmosphereTextures(atmosphere* Atmosphere)
+{
+    ivec2 TransmittanceSize = ivec2(Atmosphere->Transmittance.Width, Atmosphere->Transmittance.Height);
+    TrackAtmosphereTexture(Atmosphere->Transmittance.ResourceView, TransmittanceSize, "Earth - Transmittance", TRACKED_TEXTURE_2D);
 
-    d3d11_render_target DeltaIrradiance = D3D11.Atmosphere.DeltaIrradiance;
-    ivec2 DeltaIrradianceSize = ivec2(DeltaIrradiance.Width, DeltaIrradiance.Height);
-    PushTrackedTexture(EarthAtmosphere.Irradiance.ResourceView, DeltaIrradianceSize, "Earth - Irradiance", TRACKED_TEXTURE_2D);
+    ivec2 IrradianceSize = ivec2(Atmosphere->Irradiance.Width, Atmosphere->Irradiance.Height);
+    TrackAtmosphereTexture(Atmosphere->Irradiance.ResourceView, IrradianceSize, "Earth - Irradiance", TRACKED_TEXTURE_2D);
 
-    d3d11_render_target_3d Scattering = EarthAtmosphere.Scattering;
+    d3d11_render_target_3d Scattering = Atmosphere->Scattering;
     ivec2 ScatteringSize = ivec2(Scattering.Width, Scattering.Height);
-    PushTrackedTexture(Scattering.ResourceView, ScatteringSize, "Earth - Scattering", TRACKED_TEXTURE_3D, Scattering.Depth);
+    TrackAtmosphereTexture(Scattering.ResourceView, ScatteringSize, "Earth - Scattering", TRACKED_TEXTURE_3D, Scattering.Depth);
+}
+
+internal void
+StartupAtmosphere(void* Data)
+{
+    startup_state* State = (startup_state*)Data;
+    d3d11_state* D3D11 = &State->D3D11;
+
+    // Load atmosphere from the cache, the file is released by D3D11_LoadCachedAtmosphere
+    State->Scene->Atmosphere = D3D11_LoadCachedAtmosphere(D3D11, &State->AtmosphereCache, &State->AtmosphereParameters,
+                                                          "earth", State->AtmosphereFile, State->AtmosphereFileSize);
+    State->AtmosphereFile = 0;
+    InspectorData.AtmosphereParameters = State->AtmosphereParameters;
+
+    // Track atmosphere textures
+    TrackAtmosphereTextures(&State->Scene->Atmosphere);
+}
 
-    // Initialize scene
-    scene* Scene = (scene*)ZeroAlloc(sizeof(scene));
-    Scene->Probe = LightProbe;
-    Scene->Atmosphere = EarthAtmosphere;
+internal void
+StartupScene(void* Data)
+{
+    startup_state* State = (startup_state*)Data;
+    scene* Scene = State->Scene;
+
+    // Setup scene
     Scene->SunDirection = Normalize(vec3(-1, 1, 1));
     Scene->SunIlluminanceColor = vec3(1.0f);
     Scene->SunIlluminanceScale = 10.0f;
-    AddMaterial(Scene, &HelmetMaterial);
 
-
-    mesh* Helmet = AddMesh(Scene, "Helmet", &HelmetMesh, &HelmetGpuMesh, 0, true);
-    Helmet->Rotation = vec3(90, 0, 0);
-    Helmet->Position = vec3(0, 0, 5);
-
-    AddPointLight(Scene, vec3(-2, -2, 5), 30.0f, vec3(100, 100, 100), ShadowCubemap0);
+    AddPointLight(Scene, vec3(-2, -2, 5), 30.0f, vec3(100, 100, 100), State->ShadowCubemap0);
 
     // Initialize camera
-    fp_camera Camera = {};
-    Camera.Position = vec3(0, -2, 5);
-    Camera.Pitch = 0.0f;
-    Camera.Yaw = 90.0f;
-    Camera.MoveVelocity = 5.0f;
-    Camera.PitchVelocity = 0.1f;
-    Camera.YawVelocity = 0.1f;
-    Camera.FOV = 60.0f;
-    Camera.AspectRatio = 16.0f/9.0f;
+    fp_camera* Camera = &State->Camera;
+    Camera->Position = vec3(0, -2, 5);
+    Camera->Pitch = 0.0f;
+    Camera->Yaw = 90.0f;
+    Camera->MoveVelocity = 5.0f;
+    Camera->PitchVelocity = 0.1f;
+    Camera->YawVelocity = 0.1f;
+    Camera->FOV = 60.0f;
+    Camera->AspectRatio = 16.0f/9.0f;
 
 #if NEAR_FAR_PLANE_INVERSION
-    Camera.NearPlane = 1000.0f;
-    Camera.FarPlane = 0.1f;
+    Camera->NearPlane = 1000.0f;
+    Camera->FarPlane = 0.1f;
 #else
-    Camera.NearPlane = 0.1f;
-    Camera.FarPlane = 1000.0f;
+    Camera->NearPlane = 0.1f;
+    Camera->FarPlane = 1000.0f;
 #endif
 
-    FpCameraUpdateAnglesAndVectors(&Camera, 0, 0);
-    mat4 CameraBegin = Camera.Projection * Camera.View;
+    FpCameraUpdateAnglesAndVectors(Camera, 0, 0);
+}
+
+int
+WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, LPSTR CmdLine, int ShowCmd)
+{
+    STARTUP_BEGIN;
+
+    startup_state Startup = {};
+    Startup.CmdLine = CmdLine;
+    Startup.Width = 1600;
+    Startup.Height = 900;
+
+    // Initialize scene, its arenas back everything that lives as long as it does
+    Startup.Scene = CreateScene();
+    Startup.WorkQueue = CreateWorkQueue();
 
-    STARTUP_TIMESTAMP(SCENE);
+    // The patch archives and the streamer live in the scene arena, they are pushed here
+    // because the asset file task that opens them runs on a worker. Requests of the tasks
+    // below are loaded on the workers and pop into the scene as they complete
+    u32 PatchesCount = 0;
+    for(char* Mount = FindArgument(CmdLine, "-mount"); Mount; Mount = FindArgument(CmdLine, "-mount", Mount))
+    {
+        PatchesCount++;
+    }
+    Startup.Patches = PushArray(&Startup.Scene->PersistentArena, PatchesCount, asset_archive);
+    Startup.Streamer = PushStruct(&Startup.Scene->PersistentArena, asset_streamer);
+    InitAssetStreamer(Startup.Streamer, &Startup.Library, Startup.WorkQueue, &Startup.Scene->PersistentArena);
+
+    // Only the tasks that use the window, the D3D11 immediate context, the inspector or
+    // the streamer run on the main thread, the asset file and the cached atmosphere are
+    // read on the workers while the device is created and asset decoding starts as
+    // soon as the asset file is open
+    startup_graph* Graph = (startup_graph*)ZeroAlloc(sizeof(startup_graph));
+    u32 WindowTask = AddStartupTask(Graph, STARTUP_WINDOW, STARTUP_WINDOW, StartupWindow, &Startup, true);
+    u32 AssetFileTask = AddStartupTask(Graph, STARTUP_ASSET_FILE, STARTUP_ASSET_FILE, StartupAssetFile, &Startup, false);
+    u32 D3D11Task = AddStartupTask(Graph, STARTUP_D3D11_DEVICE, STARTUP_D3D11_PROFILER, StartupD3D11, &Startup, true);
+    u32 ImguiTask = AddStartupTask(Graph, STARTUP_IMGUI, STARTUP_IMGUI, StartupImgui, &Startup, true);
+    u32 MeshesTask = AddStartupTask(Graph, STARTUP_MESHES, STARTUP_MESHES, StartupMeshes, &Startup, true);
+    u32 MaterialsTask = AddStartupTask(Graph, STARTUP_MATERIALS, STARTUP_MATERIALS, StartupMaterials, &Startup, true);
+    u32 ShadowMapsTask = AddStartupTask(Graph, STARTUP_SHADOW_MAPS, STARTUP_SHADOW_MAPS, StartupShadowMaps, &Startup, true);
+    u32 LightProbeTask = AddStartupTask(Graph, STARTUP_LIGHT_PROBE, STARTUP_LIGHT_PROBE, StartupLightProbe, &Startup, true);
+    u32 AtmosphereFileTask = AddStartupTask(Graph, STARTUP_ATMOSPHERE_FILE, STARTUP_ATMOSPHERE_FILE, StartupAtmosphereFile, &Startup, false);
+    u32 AtmosphereTask = AddStartupTask(Graph, STARTUP_ATMOSPHERE, STARTUP_ATMOSPHERE, StartupAtmosphere, &Startup, true);
+    u32 SceneTask = AddStartupTask(Graph, STARTUP_SCENE, STARTUP_SCENE, StartupScene, &Startup, true);
+
+    AddStartupDependency(Graph, D3D11Task, WindowTask);
+    AddStartupDependency(Graph, ImguiTask, D3D11Task);
+    AddStartupDependency(Graph, MeshesTask, AssetFileTask);
+    AddStartupDependency(Graph, MaterialsTask, AssetFileTask);
+    AddStartupDependency(Graph, ShadowMapsTask, D3D11Task);
+    AddStartupDependency(Graph, LightProbeTask, AssetFileTask);
+    AddStartupDependency(Graph, AtmosphereTask, D3D11Task);
+    AddStartupDependency(Graph, AtmosphereTask, AtmosphereFileTask);
+    AddStartupDependency(Graph, SceneTask, ShadowMapsTask);
+    AddStartupDependency(Graph, SceneTask, AtmosphereTask);
+
+    RunStartupGraph(Graph, Startup.WorkQueue);
+    Free(Graph);
+
+    HWND Window = Startup.Window;
+    scene* Scene = Startup.Scene;
+    asset_streamer* Streamer = Startup.Streamer;
+    d3d11_state* D3D11 = &Startup.D3D11;
+    fp_camera Camera = Startup.Camera;
+
+    // Get refresh rate and init counters
+    f32 SecondsPerFrame = 1.0f / D3D11->MonitorInfo.RefreshRate;
+    f32 SecondsElapsed = SecondsPerFrame; //The first frame we step by the expected frame time
+    s64 CounterBegin = Win32_GetCurrentCounter();
+    s64 CounterEnd = CounterBegin;
 
     // Initialize mouse position
     vec2 LastMousePos = Win32_GetMousePosition(Window);
     vec2 MousePos;
 
-    // Spherical harmonics tests
-    PushTrackedShader(L"../src/shaders/sh_test.hlsl", (void**)&D3D11.SH.TestPixelShader, TRACKED_SHADER_PIXEL);
-    PushTrackedTexture(0, ivec2(0), "SH Test", TRACKED_SH_MAP);
-    ComputeSphericalHarmonics(AssetFile, AssetTable, "harbor");
-
+    // With -startup-trace <path> the startup timeline is written as a Chrome trace once the
+    // loads started during startup complete and again on exit, -exit-after-startup quits
+    // right after for headless runs. The inspector can also write it at any time
+    char StartupTracePath[1024] = {};
+    char* StartupTraceArgument = FindArgument(CmdLine, "-startup-trace");
+    if(StartupTraceArgument)
+    {
+        sscanf(StartupTraceArgument, "%1023s", StartupTracePath);
+    }
+    b32 ExitAfterStartup = FindArgument(CmdLine, "-exit-after-startup") != 0;
+    b32 StartupLoadsDone = false;
+    u64 StartupLoadsBegin = Platform_GetMicroseconds();
 
     // Main loop
     while(!Win32.WindowQuit)
     {
         // Debug
         BeginDebugFrame();
-        CheckShadersForUpdate(D3D11.Device);
+        CheckShadersForUpdate(D3D11->Device);
+
+        // Create GPU resources for assets that finished loading
+        u32 LoadsInFlight = ProcessCompletedAssetLoads(Streamer, D3D11->Device);
+        if(!StartupLoadsDone && !LoadsInFlight)
+        {
+            StartupLoadsDone = true;
+            AddStartupTraceEvent("startup", "Startup loads", StartupLoadsBegin, Platform_GetMicroseconds());
+            if(StartupTracePath[0])
+            {
+                WriteStartupTrace(StartupTracePath);
+            }
+            if(ExitAfterStartup)
+            {
+                Win32.WindowQuit = true;
+            }
+        }
+
+        // Atmosphere parameters applied in the inspector, precomputed only on a cache miss
+        if(InspectorData.ReloadAtmosphere)
+        {
+            InspectorData.ReloadAtmosphere = false;
+            D3D11_ReleaseAtmosphere(&Scene->Atmosphere);
+            Scene->Atmosphere = D3D11_LoadCachedAtmosphere(D3D11, &Startup.AtmosphereCache, &InspectorData.AtmosphereParameters,
+                                                           "inspector");
+            TrackAtmosphereTextures(&Scene->Atmosphere);
+        }
 
         // Process window events
         MSG Message;
@@ -222,7 +489,7 @@ WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, LPSTR CmdLine, int ShowCmd)
         // Resize D3D11 buffers
         if(Win32.WindowResized)
         {
-            D3D11_ResizeBackbuffer(&D3D11, Win32.WindowSize);
+            D3D11_ResizeBackbuffer(D3D11, Win32.WindowSize);
             Win32.WindowResized = false;
         }
 
@@ -281,55 +548,58 @@ WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, LPSTR CmdLine, int ShowCmd)
         ivec2 ViewportSize = Win32.WindowSize;
         if(InspectorData.ShowEditor)
         {
-            DrawEditor(&D3D11, Scene, AssetTable, SecondsElapsed);
+            DrawEditor(D3D11, Scene, &Startup.Library, SecondsElapsed);
         }
         else
         {
-            if(Win32.WindowSize != ivec2(D3D11.DefaultRenderTarget.Width, D3D11.DefaultRenderTarget.Height))
+            if(Win32.WindowSize != ivec2(D3D11->DefaultRenderTarget.Width, D3D11->DefaultRenderTarget.Height))
             {
-                D3D11_ResizeDefaultRenderTargets(&D3D11, Win32.WindowSize);
+                D3D11_ResizeDefaultRenderTargets(D3D11, Win32.WindowSize);
             }
-            DrawStats(vec2(10, 10), SecondsElapsed, D3D11.Profiler.FrameTime);
+            DrawStats(vec2(10, 10), SecondsElapsed, D3D11->Profiler.FrameTime);
         }
 
         // Clear the back buffer
-        D3D11_Clear(&D3D11, vec4(0.8f, 0.8f, 0.8f, 1.0f));
+        D3D11_Clear(D3D11, vec4(0.8f, 0.8f, 0.8f, 1.0f));
 
         // We start profiling right after the clear because the clear on the backbuffer
         // stalls if vsync is enabled, it appears that our driver does 2 frames of buffering
         // and doesn't let us clear the 3rd frame (which is frame number 0 for the second time)
         // if it hasn't been displayed yet
-        D3D11_ProfilerBeginFrame(&D3D11);
+        D3D11_ProfilerBeginFrame(D3D11);
 
 
         // Main scene rendering
-        D3D11_DrawScene(&D3D11, Scene);
+        D3D11_DrawScene(D3D11, Scene);
+
+        // Keep material textures under budget, drawing marked the ones in use
+        UpdateSceneTextureResidency(D3D11->Device, D3D11->Context, Scene, Streamer);
 
         // Debug rendering
         {
-            D3D11_PROFILE_BLOCK(&D3D11, D3D11_PROFILE_DEBUG_DRAW);
-            D3D11_DebugDraw(&D3D11, Camera.Projection * Camera.View);
+            D3D11_PROFILE_BLOCK(D3D11, D3D11_PROFILE_DEBUG_DRAW);
+            D3D11_DebugDraw(D3D11, Camera.Projection * Camera.View);
         }
 
         // GPU Profiler
-        D3D11_ProfilerEndFrame(&D3D11);
-        UpdateGpuFrameSlider(&D3D11);
+        D3D11_ProfilerEndFrame(D3D11);
+        UpdateGpuFrameSlider(D3D11);
 
         // Blit the intermediate target into the back buffer if there is no editor open
         if(!InspectorData.ShowEditor)
         {
             ID3D11Texture2D* BackBuffer;
-            HRESULT Result = D3D11.SwapChain->GetBuffer(0, IID_PPV_ARGS(&BackBuffer));
+            HRESULT Result = D3D11->SwapChain->GetBuffer(0, IID_PPV_ARGS(&BackBuffer));
             Assert(Result == S_OK);
-            D3D11.Context->CopyResource(BackBuffer, D3D11.DefaultRenderTarget.Texture);
+            D3D11->Context->CopyResource(BackBuffer, D3D11->DefaultRenderTarget.Texture);
             BackBuffer->Release();
         }
 
         // Render GUI
-        ImguiRender(&D3D11);
+        ImguiRender(D3D11);
 
         // Present
-        D3D11_Present(&D3D11, InspectorData.VSyncEnabled);
+        D3D11_Present(D3D11, InspectorData.VSyncEnabled);
 
         // Finilize frame
         EndDebugFrame();
@@ -350,5 +620,15 @@ WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, LPSTR CmdLine, int ShowCmd)
     // Cleanup ImGui Context, saves the .ini file
     ImguiCleanup();
 
+    if(StartupTracePath[0])
+    {
+        WriteStartupTrace(StartupTracePath);
+    }
+
+    if(Startup.TraceAssetReads)
+    {
+        WriteAssetReadTrace(&Startup.Assets, "../res/data.trace");
+    }
+
     return 0;
 }
@@ -0,0 +1,150 @@
+// Bounded multi-producer multi-consumer work queue (Vyukov style ring buffer).
+// Any thread can add work, including jobs running on the queue itself, and any
+// thread waiting on work helps executing entries instead of sleeping.
+
+#define WORK_QUEUE_SIZE 1024
+
+typedef void work_queue_callback(void* Data);
+
+struct work_queue_entry
+{
+    //Equal to the position when the slot is free, position + 1 once it's filled
+    volatile u32 Sequence;
+    
+    work_queue_callback* Callback;
+    void* Data;
+};
+
+struct work_queue
+{
+    work_queue_entry Entries[WORK_QUEUE_SIZE];
+    volatile u32 WritePosition;
+    volatile u32 ReadPosition;
+    
+    //Entries added and not completed yet
+    volatile u32 PendingCount;
+    
+    platform_semaphore Semaphore;
+    u32 ThreadCount;
+};
+
+static_assert(IS_POW2(WORK_QUEUE_SIZE), "Work queue size must be a power of 2");
+
+//Returns false if the queue was empty
+internal b32
+DoNextWorkQueueEntry(work_queue* Queue)
+{
+    for(;;)
+    {
+        u32 Position = Queue->ReadPosition;
+        work_queue_entry* Entry = &Queue->Entries[Position & (WORK_QUEUE_SIZE - 1)];
+        s32 Difference = (s32)(Entry->Sequence - (Position + 1));
+        
+        if(Difference < 0)
+        {
+            return false;
+        }
+        
+        if(Difference == 0 && Platform_AtomicCompareExchange(&Queue->ReadPosition, Position, Position + 1))
+        {
+            work_queue_callback* Callback = Entry->Callback;
+            void* Data = Entry->Data;
+            
+            //Hand the slot back to producers for the next lap around the ring
+            Platform_AtomicAdd(&Entry->Sequence, WORK_QUEUE_SIZE - 1);
+            
+            Callback(Data);
+            Platform_AtomicAdd(&Queue->PendingCount, (u32)-1);
+            return true;
+        }
+    }
+}
+
+internal void
+AddWorkQueueEntry(work_queue* Queue, work_queue_callback* Callback, void* Data)
+{
+    Platform_AtomicAdd(&Queue->PendingCount, 1);
+    
+    for(;;)
+    {
+        u32 Position = Queue->WritePosition;
+        work_queue_entry* Entry = &Queue->Entries[Position & (WORK_QUEUE_SIZE - 1)];
+        s32 Difference = (s32)(Entry->Sequence - Position);
+        
+        if(Difference == 0 && Platform_AtomicCompareExchange(&Queue->WritePosition, Position, Position + 1))
+        {
+            Entry->Callback = Callback;
+            Entry->Data = Data;
+            
+            //Publish the entry
+            Platform_AtomicAdd(&Entry->Sequence, 1);
+            Platform_SignalSemaphore(Queue->Semaphore);
+            return;
+        }
+        
+        if(Difference < 0)
+        {
+            //Queue is full, make room by doing some of the work ourselves
+            DoNextWorkQueueEntry(Queue);
+        }
+    }
+}
+
+//Helps with the queue until the counter reaches zero, used to wait for a group of
+//entries that decrement the counter when they complete
+internal void
+WaitForWorkCounter(work_queue* Queue, volatile u32* Counter)
+{
+    while(*Counter)
+    {
+        if(!DoNextWorkQueueEntry(Queue))
+        {
+            _mm_pause();
+        }
+    }
+}
+
+internal void
+CompleteAllWork(work_queue* Queue)
+{
+    WaitForWorkCounter(Queue, &Queue->PendingCount);
+}
+
+internal void
+WorkQueueThreadProc(void* Param)
+{
+    work_queue* Queue = (work_queue*)Param;
+    for(;;)
+    {
+        if(!DoNextWorkQueueEntry(Queue))
+        {
+            Platform_WaitSemaphore(Queue->Semaphore);
+        }
+    }
+}
+
+//A thread count of 0 uses one worker per core minus the calling thread
+internal work_queue*
+CreateWorkQueue(u32 ThreadCount = 0)
+{
+    if(ThreadCount == 0)
+    {
+        u32 ProcessorCount = Platform_GetProcessorCount();
+        ThreadCount = ProcessorCount > 1 ? ProcessorCount - 1 : 1;
+    }
+    
+    work_queue* Queue = (work_queue*)ZeroAlloc(sizeof(work_queue));
+    for(u32 Index = 0; Index < WORK_QUEUE_SIZE; Index++)
+    {
+        Queue->Entries[Index].Sequence = Index;
+    }
+    
+    Queue->Semaphore = Platform_CreateSemaphore(0);
+    Queue->ThreadCount = ThreadCount;
+    for(u32 Index = 0; Index < ThreadCount; Index++)
+    {
+        Platform_CreateThread(WorkQueueThreadProc, Queue);
+    }
+    
+    return Queue;
+}